@@ -70,6 +70,32 @@ struct rx_aggregate
     int64_t longinteger;
 };
 
+struct tx_aggregate
+{
+    double double_endpoint;
+    int32_t integer_endpoint;
+    bool boolean_endpoint;
+    double doublearray_endpoint[4];
+};
+
+static const astarte_bson_struct_field_t tx_aggregate_fields[] = {
+    ASTARTE_BSON_STRUCT_FIELD(
+        struct tx_aggregate, double_endpoint, "double_endpoint", BSON_TYPE_DOUBLE),
+    ASTARTE_BSON_STRUCT_FIELD(
+        struct tx_aggregate, integer_endpoint, "integer_endpoint", BSON_TYPE_INT32),
+    ASTARTE_BSON_STRUCT_FIELD(
+        struct tx_aggregate, boolean_endpoint, "boolean_endpoint", BSON_TYPE_BOOLEAN),
+    ASTARTE_BSON_STRUCT_ARRAY_FIELD(
+        struct tx_aggregate, doublearray_endpoint, "doublearray_endpoint", BSON_TYPE_DOUBLE),
+};
+
+static const astarte_bson_struct_field_t rx_aggregate_fields[] = {
+    ASTARTE_BSON_STRUCT_FIELD(
+        struct rx_aggregate, longinteger, "longinteger_endpoint", BSON_TYPE_INT64),
+    ASTARTE_BSON_STRUCT_ARRAY_FIELD(
+        struct rx_aggregate, booleans, "booleanarray_endpoint", BSON_TYPE_BOOLEAN),
+};
+
 /************************************************
  * Static functions declaration
  ***********************************************/
@@ -178,34 +204,28 @@ static void astarte_data_events_handler(astarte_device_data_event_t *event)
         ESP_LOGI(TAG, "booleanarray_endpoint: {%d, %d, %d, %d}", rx_data.booleans[0],
             rx_data.booleans[1], rx_data.booleans[2], rx_data.booleans[3]);
 
-        const double double_endpoint = 43.2;
-        const int32_t integer_endpoint = 54;
-        bool boolean_endpoint = true;
-        const double doubleanarray_endpoint[] = { 11.2, 2.2, 99.9, 421.1 };
+        const struct tx_aggregate tx_data = {
+            .double_endpoint = 43.2,
+            .integer_endpoint = 54,
+            .boolean_endpoint = true,
+            .doublearray_endpoint = { 11.2, 2.2, 99.9, 421.1 },
+        };
         ESP_LOGI(TAG, "Sending device aggregate with the following content:");
-        ESP_LOGI(TAG, "double_endpoint: %lf", double_endpoint);
-        ESP_LOGI(TAG, "integer_endpoint: %" PRIu32, integer_endpoint);
-        ESP_LOGI(TAG, "boolean_endpoint: %d", boolean_endpoint);
-        ESP_LOGI(TAG, "doubleanarray_endpoint: {%lf, %lf, %lf, %lf}", doubleanarray_endpoint[0],
-            doubleanarray_endpoint[1], doubleanarray_endpoint[2], doubleanarray_endpoint[3]);
-
-        astarte_bson_serializer_handle_t aggregate_bson = astarte_bson_serializer_new();
-        astarte_bson_serializer_append_double(aggregate_bson, "double_endpoint", double_endpoint);
-        astarte_bson_serializer_append_int32(aggregate_bson, "integer_endpoint", integer_endpoint);
-        astarte_bson_serializer_append_boolean(
-            aggregate_bson, "boolean_endpoint", boolean_endpoint);
-        astarte_bson_serializer_append_double_array(
-            aggregate_bson, "doublearray_endpoint", doubleanarray_endpoint, 4);
-        astarte_bson_serializer_append_end_of_document(aggregate_bson);
-
-        const void *doc = astarte_bson_serializer_get_document(aggregate_bson, NULL);
-        astarte_err_t res = astarte_device_stream_aggregate(
-            event->device, device_datastream_interface.name, "/24", doc, 0);
+        ESP_LOGI(TAG, "double_endpoint: %lf", tx_data.double_endpoint);
+        ESP_LOGI(TAG, "integer_endpoint: %" PRIi32, tx_data.integer_endpoint);
+        ESP_LOGI(TAG, "boolean_endpoint: %d", tx_data.boolean_endpoint);
+        ESP_LOGI(TAG, "doublearray_endpoint: {%lf, %lf, %lf, %lf}",
+            tx_data.doublearray_endpoint[0], tx_data.doublearray_endpoint[1],
+            tx_data.doublearray_endpoint[2], tx_data.doublearray_endpoint[3]);
+
+        astarte_err_t res = astarte_device_stream_struct(event->device,
+            device_datastream_interface.name, "/24", tx_aggregate_fields,
+            sizeof(tx_aggregate_fields) / sizeof(tx_aggregate_fields[0]), &tx_data,
+            ASTARTE_INVALID_TIMESTAMP, 0);
         if (res != ASTARTE_OK) {
             ESP_LOGE(TAG, "Error streaming the aggregate");
         }
 
-        astarte_bson_serializer_destroy(aggregate_bson);
         ESP_LOGI(TAG, "Device aggregate sent, using sensor_id: 24.");
     } else {
         ESP_LOGE(TAG, "Server aggregate incorrectly received.");
@@ -227,47 +247,14 @@ static uint8_t parse_received_bson(
     }
 
     astarte_bson_document_t doc = astarte_bson_deserializer_element_to_document(bson_element);
-    const uint32_t expected_doc_size = 0x4F;
-    if (doc.size != expected_doc_size) {
-        return 1U;
-    }
-
-    astarte_bson_element_t elem_longinteger_endpoint;
-    if ((astarte_bson_deserializer_element_lookup(
-             doc, "longinteger_endpoint", &elem_longinteger_endpoint)
-            != ASTARTE_OK)
-        || (elem_longinteger_endpoint.type != BSON_TYPE_INT64)) {
-        return 1U;
-    }
-    rx_data->longinteger = astarte_bson_deserializer_element_to_int64(elem_longinteger_endpoint);
-
-    astarte_bson_element_t elem_boolean_array;
-    if ((astarte_bson_deserializer_element_lookup(doc, "booleanarray_endpoint", &elem_boolean_array)
-            != ASTARTE_OK)
-        || (elem_boolean_array.type != BSON_TYPE_ARRAY)) {
-        return 1U;
-    }
-
-    astarte_bson_document_t arr = astarte_bson_deserializer_element_to_array(elem_boolean_array);
-    const uint32_t expected_arr_size = 0x15;
-    if (arr.size != expected_arr_size) {
+    uint32_t invalid_fields = 0U;
+    if (astarte_bson_deserializer_decode_struct(doc, rx_aggregate_fields,
+            sizeof(rx_aggregate_fields) / sizeof(rx_aggregate_fields[0]), rx_data,
+            &invalid_fields)
+        != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Invalid server aggregate fields: 0x%" PRIx32, invalid_fields);
         return 1U;
     }
 
-    astarte_bson_element_t elem_boolean;
-    if ((astarte_bson_deserializer_first_element(arr, &elem_boolean) != ASTARTE_OK)
-        || (elem_boolean.type != BSON_TYPE_BOOLEAN)) {
-        return 1U;
-    }
-    rx_data->booleans[0] = astarte_bson_deserializer_element_to_bool(elem_boolean);
-
-    for (size_t i = 1; i < 4; i++) {
-        if ((astarte_bson_deserializer_next_element(arr, elem_boolean, &elem_boolean) != ASTARTE_OK)
-            || (elem_boolean.type != BSON_TYPE_BOOLEAN)) {
-            return 1U;
-        }
-        rx_data->booleans[i] = astarte_bson_deserializer_element_to_bool(elem_boolean);
-    }
-
     return 0U;
 }
@@ -48,7 +48,9 @@ enum astarte_err_t
     ASTARTE_ERR_INVALID_INTROSPECTION = 19, /**< The introspection is not valid or empty */
     ASTARTE_ERR_INVALID_INTERFACE_VERSION = 20, /**< The interface is not valid */
     ASTARTE_ERR_CONFLICTING_INTERFACE = 21, /**< The interface conflicts with an interface present in introspection */
-    ASTARTE_ERR_INVALID_SIZE = 22 /**< An input parameter has been passed with invalid size */
+    ASTARTE_ERR_INVALID_SIZE = 22, /**< An input parameter has been passed with invalid size */
+    ASTARTE_ERR_QUEUE_FULL = 23, /**< The offline queue is full and the message has been discarded */
+    ASTARTE_ERR_TIMEOUT = 24 /**< The operation could not be completed in time */
 } __attribute__((deprecated("Please use the typedef astarte_err_t")));
 
 // clang-format on
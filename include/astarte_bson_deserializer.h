@@ -17,6 +17,7 @@
 #define _ASTARTE_BSON_DESERIALIZER_H_
 
 #include "astarte.h"
+#include "astarte_bson_struct.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -176,6 +177,30 @@ int64_t astarte_bson_deserializer_element_to_int64(astarte_bson_element_t elemen
 astarte_err_t astarte_bson_deserializer_element_lookup(
     astarte_bson_document_t document, const char *key, astarte_bson_element_t *element);
 
+/**
+ * @brief Decode a document into a C struct, in a single pass over the document.
+ *
+ * @details Each element of the document is matched against the fields table and stored in the
+ * corresponding struct member, see astarte_bson_struct.h. Elements not in the table are ignored.
+ * The search for each element starts from the field following the last match, documents listing
+ * their elements in the same order of the table are decoded comparing each name once.
+ *
+ * @param[in] document Document to decode.
+ * @param[in] fields Table of the fields of the struct, at most ASTARTE_BSON_STRUCT_MAX_FIELDS.
+ * @param[in] fields_count Number of fields in the table.
+ * @param[out] out_struct Struct where to store the decoded fields.
+ * @param[out] invalid_fields Bitmask of the fields missing from the document or having a different
+ * type or size, bit i is set for fields[i]. Optional, pass NULL if not used.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_INVALID_SIZE if the table has too many fields,
+ * - ASTARTE_ERR if the document is malformed or contains an unsupported type,
+ * - ASTARTE_ERR_NOT_FOUND if at least one field is missing or invalid, the other fields are stored,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_bson_deserializer_decode_struct(astarte_bson_document_t document,
+    const astarte_bson_struct_field_t *fields, size_t fields_count, void *out_struct,
+    uint32_t *invalid_fields);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,144 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+/**
+ * @file astarte_bson_parser.h
+ * @brief Astarte incremental BSON parser.
+ *
+ * @details The parser takes a BSON document one fragment at a time, in any split, and reports its
+ * content to a sink callback as it is received. String and binary values are reported in chunks
+ * pointing into the fragments, so the memory used by the parser does not depend on the document
+ * size. It supports the same subset of the BSON specification as astarte_bson_deserializer.h.
+ */
+
+#ifndef _ASTARTE_BSON_PARSER_H_
+#define _ASTARTE_BSON_PARSER_H_
+
+#include "astarte.h"
+#include "astarte_bson_deserializer.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Maximum nesting of documents and arrays, the root document included */
+#define ASTARTE_BSON_PARSER_MAX_DEPTH 8
+/** @brief Maximum length of an element name, not including the null terminator */
+#define ASTARTE_BSON_PARSER_MAX_NAME_LEN 63
+
+typedef enum
+{
+    /** @brief Start of an element. Fixed size values are complete, string and binary values
+     * follow as chunks and documents and arrays are followed by their elements */
+    ASTARTE_BSON_PARSER_EVENT_ELEMENT = 0,
+    /** @brief Part of the content of a string or binary value */
+    ASTARTE_BSON_PARSER_EVENT_CHUNK,
+    /** @brief End of a document or array, or of the root document */
+    ASTARTE_BSON_PARSER_EVENT_END_DOCUMENT,
+} astarte_bson_parser_event_type_t;
+
+typedef struct
+{
+    /** @brief Type of the event */
+    astarte_bson_parser_event_type_t type;
+    /** @brief Current element, not set for ASTARTE_BSON_PARSER_EVENT_END_DOCUMENT. The value is
+     * only set for fixed size types, it can be decoded with the deserializer functions */
+    astarte_bson_element_t element;
+    /** @brief Nesting level of the element, zero for the elements of the root document */
+    uint32_t depth;
+    /** @brief Length of the string or binary value, the string length excludes the null
+     * terminator */
+    uint32_t value_len;
+    /** @brief Content of the chunk, pointing into the fragment passed to the parser */
+    const uint8_t *chunk;
+    /** @brief Length of the chunk */
+    size_t chunk_len;
+    /** @brief Offset of the chunk in the value */
+    uint32_t chunk_offset;
+} astarte_bson_parser_event_t;
+
+/**
+ * @brief Sink receiving the content of the parsed document.
+ *
+ * @param[in] event Parsed content, only valid during the call.
+ * @param[in] user_data User data passed to astarte_bson_parser_init.
+ * @return ASTARTE_OK to continue parsing, any other value stops the parser and is returned by
+ * astarte_bson_parser_feed.
+ */
+typedef astarte_err_t (*astarte_bson_parser_sink_t)(
+    const astarte_bson_parser_event_t *event, void *user_data);
+
+typedef struct
+{
+    astarte_bson_parser_sink_t sink;
+    void *user_data;
+    /** Current state of the parser, one of the states defined in astarte_bson_parser.c */
+    int state;
+    /** Result of the parsing once stopped, ASTARTE_OK while parsing */
+    astarte_err_t result;
+    /** Bytes of the document consumed */
+    uint32_t offset;
+    /** End offset of each open document */
+    uint32_t ends[ASTARTE_BSON_PARSER_MAX_DEPTH];
+    /** Number of open documents */
+    uint32_t depth;
+    /** Type of the current element */
+    uint8_t type;
+    /** Name of the current element */
+    char name[ASTARTE_BSON_PARSER_MAX_NAME_LEN + 1];
+    size_t name_len;
+    /** Fixed size fields being collected, little endian */
+    uint8_t scratch[sizeof(uint64_t)];
+    size_t scratch_len;
+    size_t scratch_needed;
+    /** String or binary value being streamed */
+    uint32_t value_len;
+    uint32_t value_offset;
+} astarte_bson_parser_t;
+
+/**
+ * @brief Initialize a parser for a new document.
+ *
+ * @param[out] parser Parser to initialize.
+ * @param[in] sink Sink receiving the content of the document.
+ * @param[in] user_data User data passed to the sink.
+ */
+void astarte_bson_parser_init(
+    astarte_bson_parser_t *parser, astarte_bson_parser_sink_t sink, void *user_data);
+
+/**
+ * @brief Parse the next fragment of the document.
+ *
+ * @param[inout] parser Parser initialized with astarte_bson_parser_init.
+ * @param[in] data Fragment of the document.
+ * @param[in] data_len Length of the fragment.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR if the document is malformed or uses an unsupported type,
+ * - ASTARTE_ERR_INVALID_SIZE if the fragment continues past the end of the document, or if the
+ *   document is nested too deeply or has a name too long for the parser,
+ * - the error returned by the sink, if the sink stopped the parser,
+ * - ASTARTE_OK otherwise.
+ * Once an error is returned, the same error is returned for all the following fragments.
+ */
+astarte_err_t astarte_bson_parser_feed(
+    astarte_bson_parser_t *parser, const void *data, size_t data_len);
+
+/**
+ * @brief Check if the whole document has been parsed.
+ *
+ * @param[in] parser Parser initialized with astarte_bson_parser_init.
+ * @return True if the end of the root document has been parsed, false otherwise.
+ */
+bool astarte_bson_parser_is_complete(const astarte_bson_parser_t *parser);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ASTARTE_BSON_PARSER_H_
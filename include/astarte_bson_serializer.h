@@ -13,6 +13,7 @@
 #define _ASTARTE_BSON_SERIALIZER_H_
 
 #include "astarte.h"
+#include "astarte_bson_struct.h"
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -27,6 +28,10 @@ struct astarte_byte_array_t
     size_t capacity;
     size_t size;
     uint8_t *buf;
+    bool borrowed;
+    bool fixed;
+    bool count_only;
+    astarte_err_t error;
 } __attribute__((
     deprecated("This sould never be used directly, use astarte_bson_serializer_handle_t")));
 
@@ -41,8 +46,17 @@ struct astarte_bson_serializer_t
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 typedef struct astarte_bson_serializer_t *astarte_bson_serializer_handle_t;
+/** @brief Opaque storage for a BSON serializer, to be used with a caller provided buffer. */
+typedef struct astarte_bson_serializer_t astarte_bson_serializer_storage_t;
 #pragma GCC diagnostic pop
 
+/** @brief Nested document or array being written, returned when opened and used to close it. */
+typedef struct
+{
+    /** @brief Offset of the length of the nested document in the serializer buffer */
+    size_t start;
+} astarte_bson_serializer_nested_t;
+
 /**
  * @brief initialize given BSON serializer.
  *
@@ -58,7 +72,7 @@ void astarte_bson_serializer_init(astarte_bson_serializer_handle_t bson)
  *
  * @details This function has to be called to initialize and allocate memory for an instance of the
  * BSON serializer.
- * @return The handle to the initialized BSON serializer instance.
+ * @return The handle to the initialized BSON serializer instance, NULL if out of memory.
  */
 astarte_bson_serializer_handle_t astarte_bson_serializer_new(void);
 
@@ -71,6 +85,68 @@ astarte_bson_serializer_handle_t astarte_bson_serializer_new(void);
  */
 void astarte_bson_serializer_destroy(astarte_bson_serializer_handle_t bson);
 
+/**
+ * @brief initialize a BSON serializer on top of a caller provided buffer.
+ *
+ * @details The serializer is stored in @p storage and writes the document into @p buf, no heap
+ * memory is used as long as the document fits in @p buf. Should the document grow past
+ * @p buf_size the serializer moves it to a heap allocated buffer and continues from there.
+ * A serializer initialized with this function must be released with
+ * astarte_bson_serializer_deinit and not with astarte_bson_serializer_destroy.
+ * @param[out] storage the storage for the serializer, for example a stack variable.
+ * @param[in] buf the buffer where the document will be written.
+ * @param[in] buf_size the size of @p buf in bytes.
+ * @return The handle to the initialized BSON serializer instance.
+ */
+astarte_bson_serializer_handle_t astarte_bson_serializer_init_with_buffer(
+    astarte_bson_serializer_storage_t *storage, void *buf, size_t buf_size);
+
+/**
+ * @brief initialize a BSON serializer on top of a fixed size caller provided buffer.
+ *
+ * @details Same as astarte_bson_serializer_init_with_buffer, but the serializer never allocates
+ * heap memory. Should the document grow past @p buf_size the serializer records an
+ * ASTARTE_ERR_OUT_OF_MEMORY error, returned by astarte_bson_serializer_get_error, and stops
+ * writing. The size of the document keeps being computed, so that the caller can find out the
+ * size the document would have.
+ * @param[out] storage the storage for the serializer, for example a stack variable.
+ * @param[in] buf the buffer where the document will be written.
+ * @param[in] buf_size the size of @p buf in bytes.
+ * @return The handle to the initialized BSON serializer instance.
+ */
+astarte_bson_serializer_handle_t astarte_bson_serializer_init_fixed(
+    astarte_bson_serializer_storage_t *storage, void *buf, size_t buf_size);
+
+/**
+ * @brief initialize a BSON serializer computing the size of a document without writing it.
+ *
+ * @details The document is built with the usual functions, but nothing is written and no memory is
+ * used. Once the document is complete astarte_bson_serializer_document_size returns its exact size,
+ * this can be used to allocate the buffer for the document once.
+ * @param[out] storage the storage for the serializer, for example a stack variable.
+ * @return The handle to the initialized BSON serializer instance.
+ */
+astarte_bson_serializer_handle_t astarte_bson_serializer_init_size_calculator(
+    astarte_bson_serializer_storage_t *storage);
+
+/**
+ * @brief release a BSON serializer initialized with astarte_bson_serializer_init_with_buffer.
+ *
+ * @details Frees the heap memory the serializer might have allocated when its document outgrew
+ * the caller provided buffer. Neither the storage nor the caller provided buffer are freed.
+ * @param[in] bson a valid handle for the serializer instance that will be released.
+ */
+void astarte_bson_serializer_deinit(astarte_bson_serializer_handle_t bson);
+
+/**
+ * @brief reset a BSON serializer to an empty document.
+ *
+ * @details The memory already owned by the serializer is kept and reused for the next document,
+ * this can be used to serialize multiple documents without reallocating the internal buffer.
+ * @param[inout] bson a valid handle for the serializer instance.
+ */
+void astarte_bson_serializer_reset(astarte_bson_serializer_handle_t bson);
+
 /**
  * @brief getter for the BSON serializer internal buffer.
  *
@@ -78,10 +154,23 @@ void astarte_bson_serializer_destroy(astarte_bson_serializer_handle_t bson);
  * buffer will be invalid after serializer destruction.
  * @param[in] bson a valid handle for the serializer instance.
  * @param[out] size the size of the internal buffer. Optional, pass NULL if not used.
- * @return Reference to the internal buffer.
+ * @return Reference to the internal buffer, NULL if the serializer recorded an error or if it only
+ * computes the document size.
  */
 const void *astarte_bson_serializer_get_document(astarte_bson_serializer_handle_t bson, int *size);
 
+/**
+ * @brief getter for the error recorded by the BSON serializer.
+ *
+ * @details Once an error is recorded nothing else is written to the document, and
+ * astarte_bson_serializer_get_document returns NULL. The error is cleared by
+ * astarte_bson_serializer_reset.
+ * @param[in] bson a valid handle for the serializer instance.
+ * @return ASTARTE_ERR_OUT_OF_MEMORY if the document did not fit in the buffer of a fixed
+ * serializer or if its memory could not be allocated, ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_bson_serializer_get_error(astarte_bson_serializer_handle_t bson);
+
 /**
  * @brief copy BSON serializer internal buffer to a different buffer.
  *
@@ -100,7 +189,9 @@ astarte_err_t astarte_bson_serializer_write_document(
 /**
  * @brief return the document size
  *
- * @details This function returns BSON document size in bytes.
+ * @details This function returns BSON document size in bytes. After an error, or for a serializer
+ * initialized with astarte_bson_serializer_init_size_calculator, it returns the size the document
+ * would have.
  * @param[in] bson a valid handle for the serializer instance.
  */
 size_t astarte_bson_serializer_document_size(astarte_bson_serializer_handle_t bson);
@@ -202,6 +293,51 @@ void astarte_bson_serializer_append_boolean(
 void astarte_bson_serializer_append_document(
     astarte_bson_serializer_handle_t bson, const char *name, const void *document);
 
+/**
+ * @brief open a sub-BSON document written in place.
+ *
+ * @details The following elements are appended to the sub-document until it is closed with
+ * astarte_bson_serializer_end_document. Its length is written when closed, so no separate
+ * serializer and no copy of the sub-document are required. Sub-documents can be nested.
+ * @param[inout] bson a valid handle for the serializer instance.
+ * @param[in] name BSON element name, which is a C string.
+ * @return The nested document, to be passed to astarte_bson_serializer_end_document.
+ */
+astarte_bson_serializer_nested_t astarte_bson_serializer_begin_document(
+    astarte_bson_serializer_handle_t bson, const char *name);
+
+/**
+ * @brief close a sub-BSON document opened with astarte_bson_serializer_begin_document.
+ *
+ * @details All the documents and arrays opened after @p document must be closed first.
+ * @param[inout] bson a valid handle for the serializer instance.
+ * @param[in] document the nested document returned by astarte_bson_serializer_begin_document.
+ */
+void astarte_bson_serializer_end_document(
+    astarte_bson_serializer_handle_t bson, astarte_bson_serializer_nested_t document);
+
+/**
+ * @brief open an array written in place.
+ *
+ * @details Same as astarte_bson_serializer_begin_document for an array. The elements of the array
+ * must be named with their index as a decimal string, starting from "0".
+ * @param[inout] bson a valid handle for the serializer instance.
+ * @param[in] name BSON element name, which is a C string.
+ * @return The nested array, to be passed to astarte_bson_serializer_end_array.
+ */
+astarte_bson_serializer_nested_t astarte_bson_serializer_begin_array(
+    astarte_bson_serializer_handle_t bson, const char *name);
+
+/**
+ * @brief close an array opened with astarte_bson_serializer_begin_array.
+ *
+ * @details All the documents and arrays opened after @p array must be closed first.
+ * @param[inout] bson a valid handle for the serializer instance.
+ * @param[in] array the nested array returned by astarte_bson_serializer_begin_array.
+ */
+void astarte_bson_serializer_end_array(
+    astarte_bson_serializer_handle_t bson, astarte_bson_serializer_nested_t array);
+
 /**
  * @brief append a double array
  *
@@ -268,6 +404,22 @@ astarte_err_t astarte_bson_serializer_append_string_array(
 astarte_err_t astarte_bson_serializer_append_binary_array(astarte_bson_serializer_handle_t bson,
     const char *name, const void *const *arr, const int *sizes, int count);
 
+/**
+ * @brief append the fields of a C struct
+ *
+ * @details This function appends one element for each field of the struct, see
+ * astarte_bson_struct.h. The size of all the elements is computed from the fields table first,
+ * then the elements are written in place with a single check of the available memory.
+ * @param[inout] bson a valid handle for the serializer instance.
+ * @param[in] fields table of the fields of the struct.
+ * @param[in] fields_count number of fields in the table.
+ * @param[in] value the struct to append.
+ * @return ASTARTE_ERR if a field is not supported or a string member is not terminated, or upon
+ * serialization failure. ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_bson_serializer_append_struct(astarte_bson_serializer_handle_t bson,
+    const astarte_bson_struct_field_t *fields, size_t fields_count, const void *value);
+
 /**
  * @brief append a date time array
  *
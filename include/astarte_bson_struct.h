@@ -0,0 +1,91 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+/**
+ * @file astarte_bson_struct.h
+ * @brief Description of the mapping between the fields of a C struct and a BSON document.
+ *
+ * @details A constant table of fields, one for each element of the document, is declared once
+ * with the ASTARTE_BSON_STRUCT_FIELD and ASTARTE_BSON_STRUCT_ARRAY_FIELD macros. The table can be
+ * used to decode a document into the struct with astarte_bson_deserializer_decode_struct, and to
+ * encode the struct with astarte_bson_serializer_append_struct.
+ *
+ * Each BSON type is mapped to the following struct member types:
+ * - BSON_TYPE_DOUBLE: double,
+ * - BSON_TYPE_INT32: int32_t,
+ * - BSON_TYPE_INT64 and BSON_TYPE_DATETIME: int64_t,
+ * - BSON_TYPE_BOOLEAN: bool,
+ * - BSON_TYPE_STRING: char array, holding the string and its null terminator,
+ * - BSON_TYPE_BINARY: uint8_t array, the binary value must have the same size of the array,
+ * - BSON_TYPE_ARRAY: array of one of the fixed size types above, the BSON array must have the same
+ *   number of elements of the C array.
+ */
+
+#ifndef _ASTARTE_BSON_STRUCT_H_
+#define _ASTARTE_BSON_STRUCT_H_
+
+#include "astarte_bson_types.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Maximum number of fields of a struct, one bit for each field is used in bitmasks */
+#define ASTARTE_BSON_STRUCT_MAX_FIELDS 32
+
+typedef struct
+{
+    /** @brief Name of the BSON element */
+    const char *name;
+    /** @brief Length of the name, not including the null terminator */
+    size_t name_len;
+    /** @brief BSON type of the element, see astarte_bson_types.h */
+    uint8_t type;
+    /** @brief BSON type of the elements of an array, only used for BSON_TYPE_ARRAY */
+    uint8_t element_type;
+    /** @brief Offset of the member in the struct */
+    size_t offset;
+    /** @brief Size of the member in the struct */
+    size_t size;
+} astarte_bson_struct_field_t;
+
+/**
+ * @brief Field of a struct mapped to a BSON element.
+ *
+ * @param STRUCT Type of the struct.
+ * @param MEMBER Name of the struct member.
+ * @param NAME Name of the BSON element, a string literal.
+ * @param TYPE BSON type of the element.
+ */
+#define ASTARTE_BSON_STRUCT_FIELD(STRUCT, MEMBER, NAME, TYPE)                                      \
+    {                                                                                              \
+        .name = (NAME), .name_len = sizeof(NAME) - 1, .type = (TYPE), .element_type = 0,           \
+        .offset = offsetof(STRUCT, MEMBER), .size = sizeof(((STRUCT *) 0)->MEMBER),                \
+    }
+
+/**
+ * @brief Field of a struct, a C array, mapped to a BSON array.
+ *
+ * @param STRUCT Type of the struct.
+ * @param MEMBER Name of the struct member.
+ * @param NAME Name of the BSON element, a string literal.
+ * @param ELEMENT_TYPE BSON type of the elements of the array.
+ */
+#define ASTARTE_BSON_STRUCT_ARRAY_FIELD(STRUCT, MEMBER, NAME, ELEMENT_TYPE)                        \
+    {                                                                                              \
+        .name = (NAME), .name_len = sizeof(NAME) - 1, .type = BSON_TYPE_ARRAY,                     \
+        .element_type = (ELEMENT_TYPE), .offset = offsetof(STRUCT, MEMBER),                        \
+        .size = sizeof(((STRUCT *) 0)->MEMBER),                                                    \
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ASTARTE_BSON_STRUCT_H_
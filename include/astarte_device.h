@@ -15,6 +15,8 @@
 #include "astarte.h"
 
 #include "astarte_bson_deserializer.h"
+#include "astarte_bson_parser.h"
+#include "astarte_bson_serializer.h"
 #include "astarte_interface.h"
 
 #include <stdbool.h>
@@ -24,6 +26,7 @@
 #define ASTARTE_INVALID_TIMESTAMP 0
 
 typedef struct astarte_device *astarte_device_handle_t;
+typedef struct astarte_device_interface *astarte_device_interface_handle_t;
 
 typedef struct
 {
@@ -48,6 +51,43 @@ typedef struct
 
 typedef void (*astarte_device_data_event_callback_t)(astarte_device_data_event_t *event);
 
+/**
+ * @brief data event referencing the received MQTT message without copying it
+ *
+ * @details The interface name and path are not NULL terminated, they point into the topic of the
+ * MQTT message and are only valid during the callback.
+ */
+typedef struct
+{
+    astarte_device_handle_t device;
+    const char *interface_name;
+    size_t interface_name_len;
+    const char *path;
+    size_t path_len;
+    astarte_bson_element_t bson_element;
+    void *user_data;
+} astarte_device_data_view_event_t;
+
+typedef void (*astarte_device_data_view_event_callback_t)(astarte_device_data_view_event_t *event);
+
+/**
+ * @brief streamed data event
+ *
+ * @details Reports the content of an incoming message while its fragments are received. The BSON
+ * event is NULL when the message is dropped before its end, for example on a disconnection.
+ */
+typedef struct
+{
+    astarte_device_handle_t device;
+    const char *interface_name;
+    const char *path;
+    const astarte_bson_parser_event_t *bson_event;
+    void *user_data;
+} astarte_device_stream_event_t;
+
+typedef astarte_err_t (*astarte_device_stream_event_callback_t)(
+    astarte_device_stream_event_t *event);
+
 typedef struct
 {
     astarte_device_handle_t device;
@@ -80,8 +120,72 @@ typedef struct
     const char *hwid;
     const char *credentials_secret;
     const char *realm;
+    /** @brief When set, called in place of data_event_callback without copying the topic */
+    astarte_device_data_view_event_callback_t data_view_event_callback;
 } astarte_device_config_t;
 
+/**
+ * @brief offline queue policy
+ *
+ * This enum represents how datastreams published while the device is disconnected are handled when
+ * the offline queue is enabled in the Astarte SDK menu.
+ */
+typedef enum
+{
+    ASTARTE_OFFLINE_POLICY_DROP_OLDEST = 0, /**< Queue, dropping the oldest messages when full */
+    ASTARTE_OFFLINE_POLICY_DROP_NEWEST, /**< Queue, discarding the new message when full */
+    ASTARTE_OFFLINE_POLICY_NONE, /**< Never queue, as if the offline queue was disabled */
+} astarte_offline_policy_t;
+
+/**
+ * @brief statistics of the dispatcher queue
+ *
+ * This struct reports the state of the queue between the MQTT task and the dispatcher task, enabled
+ * in the Astarte SDK menu.
+ */
+typedef struct
+{
+    uint32_t queued; /**< Incoming messages waiting in the queue */
+    uint32_t max_queued; /**< Highest number of messages waiting in the queue */
+    uint32_t dispatched; /**< Messages handled by the dispatcher task */
+    uint32_t dropped; /**< Messages discarded because the queue was full */
+    uint32_t oversized; /**< Messages larger than a queue slot, queued as a heap copy */
+} astarte_device_dispatcher_stats_t;
+
+typedef uint32_t astarte_device_publish_ticket_t;
+
+/**
+ * @brief outcome of an asynchronous publish
+ */
+typedef enum
+{
+    ASTARTE_PUBLISH_RESULT_ACKED = 0, /**< Acknowledged by the broker, or sent for QoS 0 */
+    ASTARTE_PUBLISH_RESULT_FAILED, /**< The message could not be delivered */
+    ASTARTE_PUBLISH_RESULT_EXPIRED, /**< No acknowledgment has been received in time */
+} astarte_device_publish_result_t;
+
+typedef struct
+{
+    astarte_device_handle_t device;
+    astarte_device_publish_ticket_t ticket;
+    astarte_device_publish_result_t result;
+    void *user_data;
+} astarte_device_publish_event_t;
+
+typedef void (*astarte_device_publish_callback_t)(astarte_device_publish_event_t *event);
+
+/**
+ * @brief writer of the content of an aggregate, appending its elements to the outgoing message.
+ *
+ * @details The serializer is positioned inside the aggregate document, the elements are appended
+ * with the astarte_bson_serializer_append_* functions. The serializer must not be terminated with
+ * astarte_bson_serializer_append_end_of_document and is only valid during the call.
+ * @return ASTARTE_OK to publish the aggregate, any other value cancels the publish and is returned
+ * to the caller.
+ */
+typedef astarte_err_t (*astarte_device_aggregate_writer_t)(
+    astarte_bson_serializer_handle_t bson, void *user_data);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -137,11 +241,106 @@ void astarte_device_destroy(astarte_device_handle_t device);
  * @param interface A pointer to an astarte_interface_t struct describing the interface. The caller
  * is responsible for making sure the pointed interface remains valid for the lifetime of the
  * astarte_device. It is recommended to declare interface structs as static const.
- * @return ASTARTE_OK if the interface was succesfully added, another astarte_err_t otherwise.
+ * @return ASTARTE_OK if the interface was succesfully added, ASTARTE_ERR when called from a
+ * callback of the device, another astarte_err_t otherwise.
  */
 astarte_err_t astarte_device_add_interface(
     astarte_device_handle_t device, const astarte_interface_t *interface);
 
+/**
+ * @brief add an interface to the device and get a handle to it.
+ *
+ * @details Same as astarte_device_add_interface, but also returns a handle to the interface.
+ * The handle can be used with the astarte_device_interface_* functions to publish on the
+ * interface without looking it up by name and formatting its topic on each call.
+ * When an interface with the same name is already in the introspection, it is replaced by the new
+ * one and the same handle is returned.
+ * @param device A valid Astarte device handle.
+ * @param interface A pointer to an astarte_interface_t struct describing the interface. The caller
+ * is responsible for making sure the pointed interface remains valid for the lifetime of the
+ * astarte_device. It is recommended to declare interface structs as static const.
+ * @param handle Handle to the added interface, valid for the lifetime of the astarte_device.
+ * Optional, pass NULL if not used.
+ * @return ASTARTE_OK if the interface was succesfully added, ASTARTE_ERR when called from a
+ * callback of the device, another astarte_err_t otherwise.
+ */
+astarte_err_t astarte_device_add_interface_with_handle(astarte_device_handle_t device,
+    const astarte_interface_t *interface, astarte_device_interface_handle_t *handle);
+
+/**
+ * @brief add an interface to the device, with a callback for the data received on it.
+ *
+ * @details Same as astarte_device_add_interface_with_handle, the data received on the interface is
+ * passed to @p callback instead of the data callbacks set in astarte_device_config_t. Routes for
+ * specific paths of the interface can be added with astarte_device_interface_add_route.
+ * Unset events are still passed to the unset_event_callback of astarte_device_config_t.
+ * @param device A valid Astarte device handle.
+ * @param interface A pointer to an astarte_interface_t struct describing the interface. The caller
+ * is responsible for making sure the pointed interface remains valid for the lifetime of the
+ * astarte_device. It is recommended to declare interface structs as static const.
+ * @param callback Callback for the data received on the interface, on paths without a route.
+ * Optional, pass NULL to use the data callbacks set in astarte_device_config_t.
+ * @param user_data User data passed to the callback in place of callbacks_user_data.
+ * @param handle Handle to the added interface, valid for the lifetime of the astarte_device.
+ * Optional, pass NULL if not used.
+ * @return ASTARTE_OK if the interface was succesfully added, another astarte_err_t otherwise.
+ */
+astarte_err_t astarte_device_add_interface_with_callback(astarte_device_handle_t device,
+    const astarte_interface_t *interface, astarte_device_data_view_event_callback_t callback,
+    void *user_data, astarte_device_interface_handle_t *handle);
+
+/**
+ * @brief route the data received on some paths of an interface to a callback.
+ *
+ * @details The routes of all the interfaces are stored in a routing table, indexed by interface
+ * name and then by path segment, which is built when the routes are added. Each received message
+ * is dispatched with a single lookup. Routes should be added before starting the device.
+ * A path pattern is made of segments separated by '/'. A segment in the form %{name}, as in the
+ * endpoints of the interface mappings, matches any segment. Literal segments take precedence.
+ * Adding a route with the same pattern of an existing one replaces its callback.
+ *
+ * Example:
+ *
+ *  astarte_device_interface_add_route(device, sensors, "/%{sensor_id}/value", on_value, NULL);
+ *  astarte_device_interface_add_route(device, sensors, "/%{sensor_id}/name", on_name, NULL);
+ *
+ * @param device A valid Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle or
+ * astarte_device_add_interface_with_callback.
+ * @param path_pattern The path pattern, beginning with /.
+ * @param callback Callback for the data received on the paths matching the pattern.
+ * @param user_data User data passed to the callback in place of callbacks_user_data.
+ * @return ASTARTE_OK if the route was succesfully added, ASTARTE_ERR_INVALID_INTERFACE_PATH if the
+ * pattern is not valid, ASTARTE_ERR when called from a callback of the device, another
+ * astarte_err_t otherwise.
+ */
+astarte_err_t astarte_device_interface_add_route(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path_pattern,
+    astarte_device_data_view_event_callback_t callback, void *user_data);
+
+/**
+ * @brief stream the large messages received on an interface to a callback.
+ *
+ * @details Messages larger than the MQTT client buffer are received in several fragments. Instead
+ * of being reassembled, the fragments of the messages received on the interface are parsed as they
+ * arrive and their content is passed to @p callback, with string and binary values split in
+ * chunks. The memory used does not depend on the message size, so large binary values can be
+ * written to a file or partition as they are received. Smaller messages are still passed to the
+ * data callbacks. The callback is called by the MQTT task, and can stop the parsing of a message by
+ * returning an error. Only datastream interfaces can be streamed.
+ * @param device A valid Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle or
+ * astarte_device_add_interface_with_callback.
+ * @param callback Callback for the content of the streamed messages. Pass NULL to reassemble the
+ * messages again.
+ * @param user_data User data passed to the callback.
+ * @return ASTARTE_OK if the callback was set, ASTARTE_ERR when called from a callback of the
+ * device, another astarte_err_t otherwise.
+ */
+astarte_err_t astarte_device_interface_set_stream_callback(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, astarte_device_stream_event_callback_t callback,
+    void *user_data);
+
 /**
  * @brief start Astarte device.
  *
@@ -788,6 +987,69 @@ astarte_err_t astarte_device_stream_aggregate_with_timestamp(astarte_device_hand
     const char *interface_name, const char *path_prefix, const void *bson_document,
     uint64_t ts_epoch_millis, int qos);
 
+/**
+ * @brief send an aggregate value on a datastream endpoint, writing it directly in the message.
+ *
+ * @details Same as astarte_device_stream_aggregate_with_timestamp, with the aggregate appended by
+ * @p writer to the outgoing message. No separate BSON document is built and copied. For example:
+ *
+ *  astarte_err_t write_air_sensor(astarte_bson_serializer_handle_t bs, void *user_data)
+ *  {
+ *      const air_sensor_t *sensor = user_data;
+ *      astarte_bson_serializer_append_double(bs, "co2", sensor->co2);
+ *      astarte_bson_serializer_append_double(bs, "temperature", sensor->temperature);
+ *      astarte_bson_serializer_append_double(bs, "humidity", sensor->humidity);
+ *      return ASTARTE_OK;
+ *  }
+ *
+ * @param device A started Astarte device handle.
+ * @param interface_name A string containing the name of the interface.
+ * @param path_prefix A string containing the path prefix of the aggregate (beginning with /).
+ * @param writer Function appending the elements of the aggregate.
+ * @param user_data User data passed to @p writer.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, the error returned by @p writer if it
+ * failed, another astarte_err_t otherwise. Note that this just checks that the publish sequence
+ * correctly started, i.e. it doesn't wait for PUBACK for QoS 1 messages or for PUBCOMP for QoS 2
+ * messages
+ */
+astarte_err_t astarte_device_stream_aggregate_with_writer(astarte_device_handle_t device,
+    const char *interface_name, const char *path_prefix, astarte_device_aggregate_writer_t writer,
+    void *user_data, uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a C struct as an aggregate value on a datastream endpoint.
+ *
+ * @details Same as astarte_device_stream_aggregate_with_timestamp, with the aggregate encoded from
+ * a C struct and a constant table of its fields, see astarte_bson_struct.h. For example:
+ *
+ *  static const astarte_bson_struct_field_t air_sensor_fields[] = {
+ *      ASTARTE_BSON_STRUCT_FIELD(air_sensor_t, co2, "co2", BSON_TYPE_DOUBLE),
+ *      ASTARTE_BSON_STRUCT_FIELD(air_sensor_t, temperature, "temperature", BSON_TYPE_DOUBLE),
+ *      ASTARTE_BSON_STRUCT_FIELD(air_sensor_t, humidity, "humidity", BSON_TYPE_DOUBLE),
+ *  };
+ *
+ * @param device A started Astarte device handle.
+ * @param interface_name A string containing the name of the interface.
+ * @param path_prefix A string containing the path prefix of the aggregate (beginning with /).
+ * @param fields Table of the fields of the struct, one for each endpoint of the aggregate.
+ * @param fields_count Number of fields in the table.
+ * @param value The struct to be sent.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_stream_struct(astarte_device_handle_t device,
+    const char *interface_name, const char *path_prefix, const astarte_bson_struct_field_t *fields,
+    size_t fields_count, const void *value, uint64_t ts_epoch_millis, int qos);
+
 /**
  * @brief send a double value on a properties endpoint.
  *
@@ -911,6 +1173,594 @@ astarte_err_t astarte_device_set_datetime_property(
 astarte_err_t astarte_device_unset_path(
     astarte_device_handle_t device, const char *interface_name, const char *path);
 
+/**
+ * @brief send a double value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_double_with_timestamp, with the interface identified by
+ * its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_double(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, double value,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a 32 bit integer value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_integer_with_timestamp, with the interface identified by
+ * its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_integer(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, int32_t value,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a 64 bit integer value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_longinteger_with_timestamp, with the interface identified
+ * by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_longinteger(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, int64_t value,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a boolean value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_boolean_with_timestamp, with the interface identified by
+ * its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent (0 or 1).
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_boolean(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, bool value,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a UTF8 encoded string on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_string_with_timestamp, with the interface identified by
+ * its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent (a NULL terminated string).
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_string(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const char *value,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a binary blob on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_binaryblob_with_timestamp, with the interface identified
+ * by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value A pointer to the binary data to be sent.
+ * @param size The length in bytes of the binary data to be sent.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_binaryblob(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, void *value, size_t size,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a datetime value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_datetime_with_timestamp, with the interface identified by
+ * its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent, representing the number of milliseconds since Unix epoch
+ * (1970-01-01).
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_datetime(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, int64_t value,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a double array value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_double_array_with_timestamp, with the interface identified
+ * by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param values The array of double to be sent.
+ * @param count The number of values stored in values array.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_double_array(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const double *values, int count,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send an integer array value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_integer_array_with_timestamp, with the interface
+ * identified by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param values The array of int32_t to be sent.
+ * @param count The number of values stored in values array.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_integer_array(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const int32_t *values, int count,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a longinteger array value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_longinteger_array_with_timestamp, with the interface
+ * identified by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param values The array of int64_t to be sent.
+ * @param count The number of values stored in values array.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_longinteger_array(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const int64_t *values, int count,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a boolean array value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_boolean_array_with_timestamp, with the interface
+ * identified by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param values The array of bool to be sent.
+ * @param count The number of values stored in values array.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_boolean_array(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const bool *values, int count,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a string array value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_string_array_with_timestamp, with the interface identified
+ * by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param values The array of NULL terminated strings to be sent.
+ * @param count The number of values stored in values array.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_string_array(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const char *const *values,
+    int count, uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a binaryblob array value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_binaryblob_array_with_timestamp, with the interface
+ * identified by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param values The array of binary blobs to be sent (having each one const void * type).
+ * @param sizes The size of each binary blob that is in the given values array.
+ * @param count The number of values stored in values array.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_binaryblob_array(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const void *const *values,
+    const int *sizes, int count, uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a datetime array value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_datetime_array_with_timestamp, with the interface
+ * identified by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param values The array of datetimes, each one representing the number of milliseconds
+ * since Unix epoch (1970-01-01).
+ * @param count The number of values stored in values array.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_datetime_array(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const int64_t *values, int count,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send an aggregate value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_aggregate_with_timestamp, with the interface identified by
+ * its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path_prefix A string containing the path prefix of the aggregate (beginning with /).
+ * @param bson_document A pointer to the document buffer containing the aggregate.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_aggregate(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path_prefix, const void *bson_document,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send an aggregate value on a datastream endpoint using an interface handle, writing it
+ * directly in the message.
+ *
+ * @details Same as astarte_device_stream_aggregate_with_writer, with the interface identified by
+ * its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path_prefix A string containing the path prefix of the aggregate (beginning with /).
+ * @param writer Function appending the elements of the aggregate.
+ * @param user_data User data passed to @p writer.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, the error returned by @p writer if it
+ * failed, another astarte_err_t otherwise. Note that this just checks that the publish sequence
+ * correctly started, i.e. it doesn't wait for PUBACK for QoS 1 messages or for PUBCOMP for QoS 2
+ * messages
+ */
+astarte_err_t astarte_device_interface_stream_aggregate_with_writer(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path_prefix,
+    astarte_device_aggregate_writer_t writer, void *user_data, uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a C struct as an aggregate value on a datastream endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_stream_struct, with the interface identified by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path_prefix A string containing the path prefix of the aggregate (beginning with /).
+ * @param fields Table of the fields of the struct, one for each endpoint of the aggregate.
+ * @param fields_count Number of fields in the table.
+ * @param value The struct to be sent.
+ * @param ts_epoch_millis The timestamp of the datastream. This is useful only on mappings with
+ * explicit_timestamp set to true and it's represented as milliseconds since epoch. A value of
+ * ASTARTE_INVALID_TIMESTAMP is ignored.
+ * @param qos The MQTT QoS to be used for the publish (0, 1 or 2).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_stream_struct(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path_prefix,
+    const astarte_bson_struct_field_t *fields, size_t fields_count, const void *value,
+    uint64_t ts_epoch_millis, int qos);
+
+/**
+ * @brief send a double value on a properties endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_set_double_property, with the interface identified by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent.
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_set_double_property(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, double value);
+
+/**
+ * @brief send a 32 bit integer value on a properties endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_set_integer_property, with the interface identified by its
+ * handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent.
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_set_integer_property(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, int32_t value);
+
+/**
+ * @brief send a 64 bit integer value on a properties endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_set_longinteger_property, with the interface identified by its
+ * handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent.
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_set_longinteger_property(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, int64_t value);
+
+/**
+ * @brief send a boolean value on a properties endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_set_boolean_property, with the interface identified by its
+ * handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent (0 or 1).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_set_boolean_property(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, bool value);
+
+/**
+ * @brief send a UTF8 encoded string on a properties endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_set_string_property, with the interface identified by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent (a NULL terminated string).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_set_string_property(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const char *value);
+
+/**
+ * @brief send a binary blob on a properties endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_set_binaryblob_property, with the interface identified by its
+ * handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value A pointer to the binary data to be sent.
+ * @param size The length in bytes of the binary data to be sent.
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_set_binaryblob_property(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, void *value, size_t size);
+
+/**
+ * @brief send a datetime value on a properties endpoint using an interface handle.
+ *
+ * @details Same as astarte_device_set_datetime_property, with the interface identified by its
+ * handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param value The value to be sent, representing the number of milliseconds since Unix epoch
+ * (1970-01-01).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_set_datetime_property(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, int64_t value);
+
+/**
+ * @brief unset a path belonging to a properties interface using an interface handle.
+ *
+ * @details Same as astarte_device_unset_path, with the interface identified by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @return ASTARTE_OK if the value was correctly published, another astarte_err_t otherwise. Note
+ * that this just checks that the publish sequence correctly started, i.e. it doesn't wait for
+ * PUBACK for QoS 1 messages or for PUBCOMP for QoS 2 messages
+ */
+astarte_err_t astarte_device_interface_unset_path(
+    astarte_device_handle_t device, astarte_device_interface_handle_t interface, const char *path);
+
+/**
+ * @brief publish a BSON document without waiting for its acknowledgment.
+ *
+ * @details The BSON document is published as the payload of the message, and should contain the
+ * value in its "v" field and optionally the timestamp in its "t" field. The completion callback is
+ * called from the MQTT task once the broker acknowledges the message (PUBACK for QoS 1 and PUBCOMP
+ * for QoS 2), or when the message is discarded by the MQTT client or no acknowledgment has been
+ * received within the timeout configured in the Astarte SDK menu.
+ * For QoS 0 messages the callback is called before this function returns, as soon as the message
+ * is handed to the MQTT client. The callback is never called when this function returns an error.
+ * The number of messages in flight is bounded by the Astarte SDK menu configuration, when the limit
+ * is reached this function waits for a message to be completed for the configured time.
+ * Messages published with this function are never stored in the offline queue.
+ * Only datastream interfaces can be published with this function: device owned properties are
+ * stored when they are set, so they have to be set with the astarte_device_set_*_property
+ * functions.
+ * @param device A started Astarte device handle.
+ * @param interface_name A string containing the name of the interface.
+ * @param path A string containing the path (beginning with /).
+ * @param bson A BSON serializer containing the document to publish, terminated with
+ * astarte_bson_serializer_append_end_of_document.
+ * @param qos The Quality of Service for the publish (0, 1 or 2).
+ * @param callback Completion callback. Optional, pass NULL if not used.
+ * @param user_data User data passed to the completion callback.
+ * @param ticket Identifier of the message, also passed to the completion callback. Optional, pass
+ * NULL if not used.
+ * @return ASTARTE_OK if the publish sequence correctly started, ASTARTE_ERR_TIMEOUT if too many
+ * messages are in flight, ASTARTE_ERR if the interface is a properties interface, another
+ * astarte_err_t otherwise.
+ */
+astarte_err_t astarte_device_publish_async(astarte_device_handle_t device,
+    const char *interface_name, const char *path, astarte_bson_serializer_handle_t bson, int qos,
+    astarte_device_publish_callback_t callback, void *user_data,
+    astarte_device_publish_ticket_t *ticket);
+
+/**
+ * @brief publish a BSON document without waiting for its acknowledgment using an interface handle.
+ *
+ * @details Same as astarte_device_publish_async, with the interface identified by its handle.
+ * @param device A started Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param path A string containing the path (beginning with /).
+ * @param bson A BSON serializer containing the document to publish, terminated with
+ * astarte_bson_serializer_append_end_of_document.
+ * @param qos The Quality of Service for the publish (0, 1 or 2).
+ * @param callback Completion callback. Optional, pass NULL if not used.
+ * @param user_data User data passed to the completion callback.
+ * @param ticket Identifier of the message, also passed to the completion callback. Optional, pass
+ * NULL if not used.
+ * @return ASTARTE_OK if the publish sequence correctly started, ASTARTE_ERR_TIMEOUT if too many
+ * messages are in flight, ASTARTE_ERR if the interface is a properties interface, another
+ * astarte_err_t otherwise.
+ */
+astarte_err_t astarte_device_interface_publish_async(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path,
+    astarte_bson_serializer_handle_t bson, int qos, astarte_device_publish_callback_t callback,
+    void *user_data, astarte_device_publish_ticket_t *ticket);
+
+/**
+ * @brief set the offline queue policy of an interface.
+ *
+ * @details Datastreams published while the device is disconnected or being reinitialized are stored
+ * in the offline queue and published again when the device reconnects. This function selects how
+ * messages of an interface are handled when the queue is full, or excludes the interface from the
+ * queue.
+ * All interfaces default to ASTARTE_OFFLINE_POLICY_DROP_OLDEST. The policy has no effect when the
+ * offline queue is disabled in the Astarte SDK menu.
+ * @param device A valid Astarte device handle.
+ * @param interface An interface handle obtained from astarte_device_add_interface_with_handle.
+ * @param policy The policy to apply to the interface.
+ * @return ASTARTE_OK if the policy was set, another astarte_err_t otherwise.
+ */
+astarte_err_t astarte_device_interface_set_offline_policy(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, astarte_offline_policy_t policy);
+
+/**
+ * @brief get the statistics of the dispatcher queue.
+ *
+ * @details When the dispatcher task is enabled in the Astarte SDK menu, incoming messages are
+ * copied by the MQTT task in a bounded queue and the callbacks are called by the dispatcher task.
+ * The counters are never reset, they can be sampled periodically to detect bursts.
+ * @param device A valid Astarte device handle.
+ * @param stats The statistics of the queue.
+ * @return ASTARTE_OK if the statistics were read, ASTARTE_ERR_NOT_FOUND if the dispatcher task is
+ * disabled.
+ */
+astarte_err_t astarte_device_get_dispatcher_stats(
+    astarte_device_handle_t device, astarte_device_dispatcher_stats_t *stats);
+
 /**
  * @brief check if the device is connected.
  *
@@ -0,0 +1,43 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+/**
+ * @file astarte_hash.h
+ * @brief Non cryptographic hash functions used by the internal lookup tables.
+ */
+
+#ifndef _ASTARTE_HASH_H_
+#define _ASTARTE_HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Initial value for the 32 bits FNV-1a hash. */
+#define ASTARTE_HASH_FNV1A_32_INIT 0x811C9DC5U
+
+/**
+ * @brief Compute the 32 bits FNV-1a hash of a buffer.
+ *
+ * @param[in] data Buffer to hash.
+ * @param[in] len Length of the buffer.
+ * @return The computed hash.
+ */
+uint32_t astarte_hash_fnv1a_32(const void *data, size_t len);
+
+/**
+ * @brief Continue a 32 bits FNV-1a hash over a new buffer.
+ *
+ * @details Can be used to hash non contiguous data, the first call should be performed with
+ * ASTARTE_HASH_FNV1A_32_INIT as @p hash.
+ *
+ * @param[in] hash Hash computed over the previous buffers.
+ * @param[in] data Buffer to hash.
+ * @param[in] len Length of the buffer.
+ * @return The updated hash.
+ */
+uint32_t astarte_hash_fnv1a_32_update(uint32_t hash, const void *data, size_t len);
+
+#endif /* _ASTARTE_HASH_H_ */
@@ -0,0 +1,135 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+/**
+ * @file astarte_introspection.h
+ * @brief Registry of the interfaces added to an Astarte device.
+ *
+ * @details Interfaces are indexed by name in a hash table, each entry caches the MQTT topic
+ * prefix used to publish on the interface and doubles as the public interface handle.
+ */
+
+#ifndef _ASTARTE_INTROSPECTION_H_
+#define _ASTARTE_INTROSPECTION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "astarte.h"
+#include "astarte_device.h"
+#include "astarte_interface.h"
+#include "astarte_routes.h"
+
+/**
+ * @brief Introspection entry, used as the public astarte_device_interface_handle_t.
+ */
+struct astarte_device_interface
+{
+    /** @brief Interface definition, NULL for temporary entries not in the introspection */
+    const astarte_interface_t *interface;
+    /** @brief Interface name */
+    const char *name;
+    /** @brief Length of the interface name */
+    size_t name_len;
+    /** @brief Hash of the interface name */
+    uint32_t name_hash;
+    /** @brief Topic prefix in the format "<device_topic>/<interface_name>" */
+    char *topic_prefix;
+    /** @brief Length of the topic prefix */
+    size_t topic_prefix_len;
+    /** @brief Policy for messages published while the device is disconnected */
+    astarte_offline_policy_t offline_policy;
+    /** @brief Callbacks for the data received on the interface */
+    astarte_routes_t routes;
+    /** @brief Callback for the content of the fragmented messages, NULL to reassemble them */
+    astarte_device_stream_event_callback_t stream_callback;
+    /** @brief User data passed to the stream callback */
+    void *stream_user_data;
+    /** @brief Next entry in insertion order */
+    struct astarte_device_interface *next;
+    /** @brief Next entry in the same hash table bucket */
+    struct astarte_device_interface *bucket_next;
+};
+
+typedef struct
+{
+    /** @brief First entry in insertion order */
+    struct astarte_device_interface *head;
+    /** @brief Last entry in insertion order */
+    struct astarte_device_interface *tail;
+    /** @brief Hash table buckets */
+    struct astarte_device_interface **buckets;
+    /** @brief Number of buckets, always a power of two */
+    size_t buckets_count;
+    /** @brief Number of entries in the introspection */
+    size_t entries_count;
+    /** @brief Device topic used to compute the topic prefixes */
+    const char *device_topic;
+    /** @brief Length of the device topic */
+    size_t device_topic_len;
+} astarte_introspection_t;
+
+/**
+ * @brief Initialize an empty introspection
+ *
+ * @param[out] introspection Introspection to initialize
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the hash table could not be allocated,
+ * - ASTARTE_OK if operation has been successful
+ */
+astarte_err_t astarte_introspection_init(astarte_introspection_t *introspection);
+
+/**
+ * @brief Destroy an introspection, freeing all its entries
+ *
+ * @note The interface definitions are owned by the user and are not freed.
+ *
+ * @param[in] introspection Introspection to destroy
+ */
+void astarte_introspection_destroy(astarte_introspection_t *introspection);
+
+/**
+ * @brief Set the device topic and recompute the topic prefix of each entry
+ *
+ * @note The device topic is not copied and should remain valid until the next call to this
+ * function.
+ *
+ * @param[inout] introspection Introspection to update
+ * @param[in] device_topic Device topic, it can be NULL if not yet known
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_OUT_OF_MEMORY if a topic prefix could not be allocated,
+ * - ASTARTE_OK if operation has been successful
+ */
+astarte_err_t astarte_introspection_set_device_topic(
+    astarte_introspection_t *introspection, const char *device_topic);
+
+/**
+ * @brief Add a new interface to the introspection
+ *
+ * @note The caller should check that no interface with the same name is already present.
+ *
+ * @param[inout] introspection Introspection to update
+ * @param[in] interface Interface to add, it should remain valid for the introspection lifetime
+ * @param[out] entry The newly created entry
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the entry could not be allocated,
+ * - ASTARTE_OK if operation has been successful
+ */
+astarte_err_t astarte_introspection_add(astarte_introspection_t *introspection,
+    const astarte_interface_t *interface, struct astarte_device_interface **entry);
+
+/**
+ * @brief Get the entry for an interface name
+ *
+ * @param[in] introspection Introspection to search
+ * @param[in] name Interface name, it does not need to be NULL terminated
+ * @param[in] name_len Length of the interface name
+ * @return The entry for the interface or NULL if not present
+ */
+struct astarte_device_interface *astarte_introspection_get(
+    const astarte_introspection_t *introspection, const char *name, size_t name_len);
+
+#endif /* _ASTARTE_INTROSPECTION_H_ */
@@ -10,11 +10,17 @@
  *
  * @details The use of longer keys is made possible by storing both key and value as separate
  * NVS entries. This leads to overhead in terms of computational complexity and lookup speed.
+ * An optional RAM index, mapping the hash of each key to its position, avoids reading all the keys
+ * stored in NVS on each lookup.
+ * Erased pairs leave holes that are reused by the following insertions. The holes can be removed
+ * in a single batch with astarte_nvs_key_value_compact.
  */
 
 #ifndef _ASTARTE_NVS_KEY_VALUE_H_
 #define _ASTARTE_NVS_KEY_VALUE_H_
 
+#include <stdbool.h>
+
 #include <nvs.h>
 
 typedef struct
@@ -24,19 +30,67 @@ typedef struct
     nvs_type_t type;
 } astarte_nvs_key_value_iterator_t;
 
+typedef struct
+{
+    /** @brief Store index of the key, meaningful only for used slots */
+    uint64_t store_index;
+    /** @brief Hash of the key */
+    uint32_t key_hash;
+    /** @brief True if the slot contains a key */
+    bool used;
+} astarte_nvs_key_value_index_slot_t;
+
+typedef struct
+{
+    /** @brief Open addressing hash table, NULL until the index is built from NVS */
+    astarte_nvs_key_value_index_slot_t *slots;
+    /** @brief Number of slots, always a power of two */
+    size_t slots_count;
+    /** @brief Number of keys in the index */
+    size_t keys_count;
+    /** @brief Copy of the next store index stored in NVS */
+    uint64_t next_store_index;
+    /** @brief Store indexes of the erased pairs, in no particular order */
+    uint64_t *holes;
+    /** @brief Number of holes */
+    size_t holes_count;
+    /** @brief Allocated size of the holes array */
+    size_t holes_capacity;
+} astarte_nvs_key_value_index_t;
+
+/**
+ * @brief Initialize an empty index.
+ *
+ * @details The index is built from the content of NVS the first time it is used, then it is kept
+ * in sync by the set and erase functions. An index should only be used with a single NVS namespace
+ * and all the changes to the namespace should be performed through it.
+ *
+ * @param[out] index Index to initialize.
+ */
+void astarte_nvs_key_value_index_init(astarte_nvs_key_value_index_t *index);
+
+/**
+ * @brief Free the memory used by an index, the index can be used again and will be rebuilt.
+ *
+ * @param[in] index Index to destroy.
+ */
+void astarte_nvs_key_value_index_destroy(astarte_nvs_key_value_index_t *index);
+
 /**
  * @brief Sets variable length binary value for given key.
  *
  * @details Behaves as similar as possible to the nvs_set_blob function found in nvs_flash.
  *
  * @param[in] handle Handle obtained from nvs_open function. Read-only handles cannot be used.
+ * @param[inout] index Index of the keys stored in NVS. May be NULL, in this case the stored keys
+ * are scanned to find @p key.
  * @param[in] key Key name. Maximum length is 4000 bytes, including the terminating char.
  * @param[in] value Buffer containing the value to set.
  * @param[in] length Length of binary value to set, in bytes.
  * @return An ESP_OK when operation has been successful, an error code otherwise.
  */
-esp_err_t astarte_nvs_key_value_set(
-    nvs_handle_t handle, const char *key, const void *value, size_t length);
+esp_err_t astarte_nvs_key_value_set(nvs_handle_t handle, astarte_nvs_key_value_index_t *index,
+    const char *key, const void *value, size_t length);
 
 /**
  * @brief Gets blob value for given key.
@@ -44,6 +98,8 @@ esp_err_t astarte_nvs_key_value_set(
  * @details Behaves as similar as possible to the nvs_get_blob function found in nvs_flash.
  *
  * @param[in] handle Handle obtained from nvs_open function.
+ * @param[inout] index Index of the keys stored in NVS. May be NULL, in this case the stored keys
+ * are scanned to find @p key.
  * @param[in] key Key name. Maximum length is 4000 bytes, including the terminating char.
  * @param[out] out_value Pointer to the output value. May be NULL, in this case required length will
  * be returned in length argument.
@@ -52,25 +108,43 @@ esp_err_t astarte_nvs_key_value_set(
  * not NULL, will be set to the actual length of the value written.
  * @return An ESP_OK when operation has been successful, an error code otherwise.
  */
-esp_err_t astarte_nvs_key_value_get(
-    nvs_handle_t handle, const char *key, void *out_value, size_t *length);
+esp_err_t astarte_nvs_key_value_get(nvs_handle_t handle, astarte_nvs_key_value_index_t *index,
+    const char *key, void *out_value, size_t *length);
 
 /**
  * @brief Erases key-value pair with given key name.
  *
  * @details Behaves as similar as possible to the nvs_erase_key function found in nvs_flash.
- * However, its efficiency might be much lower as this function may require a large amount of write
- * and read operations.
+ * The two entries of the pair are erased, leaving a hole in place of the pair. No other pair is
+ * moved.
  *
  * @note This function might be called only for namespaces containing elements of a single type.
  * Do not use this funciton if you placed different types in the same namespace using the set
  * functions contained in this library.
  *
  * @param[in] handle Handle obtained from nvs_open function. Read only handles cannot be used.
+ * @param[inout] index Index of the keys stored in NVS. May be NULL, in this case the stored keys
+ * are scanned to find @p key.
  * @param[in] key Key name. Maximum length is 4000 bytes, including the terminating char.
  * @return An ESP_OK when operation has been successful, an error code otherwise.
  */
-esp_err_t astarte_nvs_key_value_erase_key(nvs_handle_t handle, const char *key);
+esp_err_t astarte_nvs_key_value_erase_key(
+    nvs_handle_t handle, astarte_nvs_key_value_index_t *index, const char *key);
+
+/**
+ * @brief Removes the holes left by the erased pairs.
+ *
+ * @details The last pairs are moved in the holes with the lowest store index, until all the pairs
+ * are stored one after the other. Each moved pair requires two writes and two erasures.
+ *
+ * @note Moving the pairs invalidates the iterators, do not compact while iterating.
+ *
+ * @param[in] handle Handle obtained from nvs_open function. Read only handles cannot be used.
+ * @param[inout] index Index of the keys stored in NVS, it is built if required.
+ * @return An ESP_OK when operation has been successful, an error code otherwise. On error the
+ * index is destroyed, it will be rebuilt on its next use.
+ */
+esp_err_t astarte_nvs_key_value_compact(nvs_handle_t handle, astarte_nvs_key_value_index_t *index);
 
 /**
  * @brief Creates an iterator to enumerate NVS entries.
@@ -147,4 +221,26 @@ esp_err_t astarte_nvs_key_value_iterator_next(astarte_nvs_key_value_iterator_t *
 esp_err_t astarte_nvs_key_value_iterator_get_element(astarte_nvs_key_value_iterator_t *iterator,
     char *out_key, size_t *out_key_len, void *out_value, size_t *out_value_len);
 
+/**
+ * @brief Reads the entry currently pointed to by the iterator in a single pass.
+ *
+ * @note This should be used only for an iterator that has been initialized with the blob type.
+ *
+ * @details Key and value are read directly in the provided buffers, without querying their
+ * lengths first. When one of the buffers is too small the required lengths are returned, so that
+ * the caller can grow its buffers and call the function again.
+ *
+ * @param[inout] iterator Iterator obtained from astarte_nvs_key_value_iterator_init.
+ * @param[out] out_key Buffer where to store the key.
+ * @param[inout] out_key_len Size of out_key, set to the length of the key.
+ * @param[out] out_value Buffer where to store the value.
+ * @param[inout] out_value_len Size of out_value, set to the length of the value.
+ * @return One of the follwing error codes:
+ * - ESP_ERR_NVS_INVALID_LENGTH if one of the buffers is too small, the lengths are still set,
+ * - ESP_OK if key and value have been read,
+ * - another error code if the operation failed.
+ */
+esp_err_t astarte_nvs_key_value_iterator_read_element(astarte_nvs_key_value_iterator_t *iterator,
+    char *out_key, size_t *out_key_len, void *out_value, size_t *out_value_len);
+
 #endif /* _ASTARTE_NVS_KEY_VALUE_H_ */
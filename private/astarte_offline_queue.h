@@ -0,0 +1,153 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+/**
+ * @file astarte_offline_queue.h
+ * @brief Persistent queue of MQTT messages stored in a dedicated flash partition.
+ *
+ * @details The partition is used as a ring of flash sectors, each one starting with a header
+ * containing an incremental sequence number. Messages are appended to the newest sector and are
+ * marked as consumed in place, by clearing bits of the record state. When the ring is full the
+ * oldest sector can be erased to make room for new messages.
+ */
+
+#ifndef _ASTARTE_OFFLINE_QUEUE_H_
+#define _ASTARTE_OFFLINE_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "astarte.h"
+
+/** @brief Size of a flash sector, the minimum erasable unit */
+#define ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE 4096
+/** @brief Maximum size for the sum of topic and payload of a single message */
+#define ASTARTE_OFFLINE_QUEUE_MAX_MESSAGE_SIZE (ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE - 20)
+
+typedef struct
+{
+    /** @brief Flash partition backing the queue */
+    const esp_partition_t *partition;
+    /** @brief Mutex protecting the queue state */
+    SemaphoreHandle_t mutex;
+    /** @brief Number of sectors in the partition */
+    uint32_t sectors_count;
+    /** @brief Sector containing the oldest message not yet consumed */
+    uint32_t head_sector;
+    /** @brief Sequence number of the head sector */
+    uint32_t head_seq;
+    /** @brief Offset of the oldest message not yet consumed in the head sector */
+    uint32_t head_offset;
+    /** @brief Sector where new messages are appended */
+    uint32_t tail_sector;
+    /** @brief Sequence number of the tail sector, zero if no sector has been written */
+    uint32_t tail_seq;
+    /** @brief Offset of the first free byte in the tail sector */
+    uint32_t tail_offset;
+    /** @brief Sequence number of the sector of the last peeked message, zero if none */
+    uint32_t peek_seq;
+    /** @brief Offset of the last peeked message */
+    uint32_t peek_offset;
+    /** @brief Number of messages not yet consumed */
+    size_t count;
+} astarte_offline_queue_t;
+
+/**
+ * @brief Open the queue stored in a flash partition, recovering any message already stored.
+ *
+ * @param[out] queue Queue to initialize.
+ * @param[in] partition_label Label of the data partition to use, it should span at least two
+ * sectors.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_PARTITION_SCHEME if the partition does not exist or is too small,
+ * - ASTARTE_ERR_ESP_SDK if reading or writing the flash failed,
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the queue mutex could not be created,
+ * - ASTARTE_OK if the queue has been opened.
+ */
+astarte_err_t astarte_offline_queue_open(
+    astarte_offline_queue_t *queue, const char *partition_label);
+
+/**
+ * @brief Close a queue, the stored messages are preserved in flash.
+ *
+ * @param[in] queue Queue to close.
+ */
+void astarte_offline_queue_close(astarte_offline_queue_t *queue);
+
+/**
+ * @brief Append a message to the queue.
+ *
+ * @param[in] queue Queue where to append the message.
+ * @param[in] topic MQTT topic of the message.
+ * @param[in] data Payload of the message.
+ * @param[in] data_len Size of the payload.
+ * @param[in] qos Quality of service to use when the message will be published.
+ * @param[in] drop_oldest When the queue is full, drop the oldest messages to make room instead
+ * of discarding the new one.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_INVALID_SIZE if the message is larger than ASTARTE_OFFLINE_QUEUE_MAX_MESSAGE_SIZE,
+ * - ASTARTE_ERR_QUEUE_FULL if the queue is full and drop_oldest is false,
+ * - ASTARTE_ERR_ESP_SDK if writing the flash failed,
+ * - ASTARTE_OK if the message has been stored.
+ */
+astarte_err_t astarte_offline_queue_push(astarte_offline_queue_t *queue, const char *topic,
+    const void *data, size_t data_len, int qos, bool drop_oldest);
+
+/**
+ * @brief Read the oldest message in the queue, without removing it.
+ *
+ * @param[in] queue Queue to read from.
+ * @param[out] topic Buffer where to store the NULL terminated topic.
+ * @param[in] topic_size Size of the topic buffer.
+ * @param[out] data Buffer where to store the payload.
+ * @param[inout] data_len Size of the payload buffer, overwritten with the size of the payload.
+ * @param[out] qos Quality of service of the message.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_NOT_FOUND if the queue is empty,
+ * - ASTARTE_ERR_INVALID_SIZE if the message does not fit the provided buffers,
+ * - ASTARTE_ERR_ESP_SDK if reading the flash failed,
+ * - ASTARTE_OK if the message has been read.
+ */
+astarte_err_t astarte_offline_queue_peek(astarte_offline_queue_t *queue, char *topic,
+    size_t topic_size, void *data, size_t *data_len, int *qos);
+
+/**
+ * @brief Remove the message returned by the last call to astarte_offline_queue_peek.
+ *
+ * @details If the message has been dropped in the meantime to make room for newer ones this
+ * function does nothing.
+ *
+ * @param[in] queue Queue to remove the message from.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_ESP_SDK if writing the flash failed,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_offline_queue_pop(astarte_offline_queue_t *queue);
+
+/**
+ * @brief Get the number of messages in the queue.
+ *
+ * @param[in] queue Queue to check.
+ * @return The number of messages not yet removed from the queue.
+ */
+size_t astarte_offline_queue_count(astarte_offline_queue_t *queue);
+
+/**
+ * @brief Remove all the messages from the queue, erasing the whole partition.
+ *
+ * @param[in] queue Queue to clear.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_ESP_SDK if erasing the flash failed,
+ * - ASTARTE_OK if the queue has been cleared.
+ */
+astarte_err_t astarte_offline_queue_clear(astarte_offline_queue_t *queue);
+
+#endif /* _ASTARTE_OFFLINE_QUEUE_H_ */
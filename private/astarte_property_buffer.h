@@ -0,0 +1,168 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+/**
+ * @file astarte_property_buffer.h
+ * @brief Coalescing buffer of the property changes waiting to be written in non volatile memory.
+ *
+ * @details Each entry is keyed on the interface name and path and holds the last change of the
+ * property, a new change replaces the pending one. Entries are kept after being written, to
+ * enforce a minimum interval between two writes of the same property. It does not perform any
+ * locking.
+ */
+
+#ifndef _ASTARTE_PROPERTY_BUFFER_H_
+#define _ASTARTE_PROPERTY_BUFFER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "astarte.h"
+
+typedef enum
+{
+    /** @brief The property has been written, or the entry is free */
+    ASTARTE_PROPERTY_BUFFER_CLEAN = 0,
+    /** @brief The property value should be stored */
+    ASTARTE_PROPERTY_BUFFER_STORE,
+    /** @brief The property should be deleted */
+    ASTARTE_PROPERTY_BUFFER_DELETE,
+} astarte_property_buffer_op_t;
+
+typedef struct
+{
+    /** @brief Hash of the interface name and path, meaningful only for used entries */
+    uint32_t key_hash;
+    /** @brief Interface name and path, NULL terminated and stored one after the other. NULL for
+     * free entries */
+    char *key;
+    /** @brief Length of the interface name */
+    size_t interface_name_len;
+    /** @brief Pending change */
+    astarte_property_buffer_op_t op;
+    /** @brief Major version of the interface, for pending stores */
+    int32_t major;
+    /** @brief Value to store, for pending stores */
+    uint8_t *data;
+    /** @brief Length of the value */
+    size_t data_len;
+    /** @brief True if the property has been written at least once */
+    bool written;
+    /** @brief Time of the last write, in milliseconds */
+    uint32_t last_write_ms;
+} astarte_property_buffer_entry_t;
+
+typedef struct
+{
+    /** @brief Buffer entries */
+    astarte_property_buffer_entry_t *entries;
+    /** @brief Maximum number of entries */
+    size_t capacity;
+    /** @brief Number of entries with a pending change */
+    size_t pending_count;
+} astarte_property_buffer_t;
+
+/**
+ * @brief Initialize a buffer.
+ *
+ * @param[out] buffer Buffer to initialize.
+ * @param[in] capacity Maximum number of properties in the buffer.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the entries could not be allocated,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_property_buffer_init(astarte_property_buffer_t *buffer, size_t capacity);
+
+/**
+ * @brief Free the memory used by a buffer, the pending changes are discarded.
+ *
+ * @param[in] buffer Buffer to destroy.
+ */
+void astarte_property_buffer_destroy(astarte_property_buffer_t *buffer);
+
+/**
+ * @brief Get the pending change of a property.
+ *
+ * @param[in] buffer Buffer to search.
+ * @param[in] interface_name Interface name of the property.
+ * @param[in] path Path of the property.
+ * @return The entry of the property if it has a pending change, NULL otherwise.
+ */
+const astarte_property_buffer_entry_t *astarte_property_buffer_get_pending(
+    astarte_property_buffer_t *buffer, const char *interface_name, const char *path);
+
+/**
+ * @brief Set the pending change of a property to a store of a new value.
+ *
+ * @param[in] buffer Buffer to update.
+ * @param[in] interface_name Interface name of the property.
+ * @param[in] path Path of the property.
+ * @param[in] major Major version of the interface.
+ * @param[in] data Value of the property.
+ * @param[in] data_len Length of the value.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_QUEUE_FULL if all the entries have a pending change,
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the change could not be allocated,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_property_buffer_store(astarte_property_buffer_t *buffer,
+    const char *interface_name, const char *path, int32_t major, const void *data, size_t data_len);
+
+/**
+ * @brief Set the pending change of a property to a deletion.
+ *
+ * @param[in] buffer Buffer to update.
+ * @param[in] interface_name Interface name of the property.
+ * @param[in] path Path of the property.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_QUEUE_FULL if all the entries have a pending change,
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the change could not be allocated,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_property_buffer_delete(
+    astarte_property_buffer_t *buffer, const char *interface_name, const char *path);
+
+/**
+ * @brief Get a pending change that can be written.
+ *
+ * @details Changes of properties written less than @p min_interval_ms ago are skipped.
+ *
+ * @param[in] buffer Buffer to search.
+ * @param[in] now_ms Current time in milliseconds.
+ * @param[in] min_interval_ms Minimum interval between two writes of the same property.
+ * @return An entry with a pending change, NULL if there is none to write.
+ */
+astarte_property_buffer_entry_t *astarte_property_buffer_next_due(
+    astarte_property_buffer_t *buffer, uint32_t now_ms, uint32_t min_interval_ms);
+
+/**
+ * @brief Mark the pending change of an entry as written.
+ *
+ * @param[in] buffer Buffer containing the entry.
+ * @param[in] entry Entry returned by astarte_property_buffer_next_due.
+ * @param[in] now_ms Current time in milliseconds.
+ */
+void astarte_property_buffer_mark_written(astarte_property_buffer_t *buffer,
+    astarte_property_buffer_entry_t *entry, uint32_t now_ms);
+
+/**
+ * @brief Get the interface name of an entry.
+ *
+ * @param[in] entry Entry to use.
+ * @return The NULL terminated interface name.
+ */
+const char *astarte_property_buffer_interface_name(const astarte_property_buffer_entry_t *entry);
+
+/**
+ * @brief Get the path of an entry.
+ *
+ * @param[in] entry Entry to use.
+ * @return The NULL terminated path.
+ */
+const char *astarte_property_buffer_path(const astarte_property_buffer_entry_t *entry);
+
+#endif /* _ASTARTE_PROPERTY_BUFFER_H_ */
@@ -0,0 +1,139 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+/**
+ * @file astarte_property_cache.h
+ * @brief Bounded RAM cache of the property values stored in non volatile memory.
+ *
+ * @details Each entry is keyed on the interface name and path and holds the major version and
+ * the value of the property. Values up to a configurable size are copied in the entry, for larger
+ * values only their length and hash are kept. When the cache is full the least recently used entry
+ * is evicted. It does not perform any locking.
+ */
+
+#ifndef _ASTARTE_PROPERTY_CACHE_H_
+#define _ASTARTE_PROPERTY_CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "astarte.h"
+
+typedef enum
+{
+    /** @brief The property is not cached, or the cache can not tell if the value is the same */
+    ASTARTE_PROPERTY_CACHE_MISS = 0,
+    /** @brief The property is cached with the same major version and value */
+    ASTARTE_PROPERTY_CACHE_SAME,
+    /** @brief The property is cached with a different major version or value */
+    ASTARTE_PROPERTY_CACHE_CHANGED,
+} astarte_property_cache_result_t;
+
+typedef struct
+{
+    /** @brief Hash of the interface name and path, meaningful only for used entries */
+    uint32_t key_hash;
+    /** @brief Interface name and path, NULL terminated and stored one after the other, followed
+     * by the copy of the value if any. NULL for free entries */
+    char *key;
+    /** @brief Length of the interface name */
+    size_t interface_name_len;
+    /** @brief Major version of the interface */
+    int32_t major;
+    /** @brief Length of the value */
+    size_t value_len;
+    /** @brief Hash of the value */
+    uint32_t value_hash;
+    /** @brief Copy of the value, NULL if the value is larger than the maximum cached size */
+    const uint8_t *value;
+    /** @brief Last time the entry has been used, as a counter of the cache accesses */
+    uint32_t last_used;
+} astarte_property_cache_entry_t;
+
+typedef struct
+{
+    /** @brief Cache entries */
+    astarte_property_cache_entry_t *entries;
+    /** @brief Maximum number of entries */
+    size_t capacity;
+    /** @brief Maximum size of a value copied in an entry */
+    size_t max_value_size;
+    /** @brief Counter of the cache accesses, used to find the least recently used entry */
+    uint32_t clock;
+} astarte_property_cache_t;
+
+/**
+ * @brief Initialize a cache.
+ *
+ * @param[out] cache Cache to initialize.
+ * @param[in] capacity Maximum number of cached properties, zero disables the cache.
+ * @param[in] max_value_size Maximum size of the values copied in the cache.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the entries could not be allocated,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_property_cache_init(
+    astarte_property_cache_t *cache, size_t capacity, size_t max_value_size);
+
+/**
+ * @brief Free the memory used by a cache.
+ *
+ * @param[in] cache Cache to destroy.
+ */
+void astarte_property_cache_destroy(astarte_property_cache_t *cache);
+
+/**
+ * @brief Compare a property value with the cached one.
+ *
+ * @param[in] cache Cache to search.
+ * @param[in] interface_name Interface name of the property.
+ * @param[in] path Path of the property.
+ * @param[in] major Major version of the interface.
+ * @param[in] data Value of the property.
+ * @param[in] data_len Length of the value.
+ * @return The result of the comparison, when ASTARTE_PROPERTY_CACHE_MISS is returned the value
+ * should be compared with the stored one.
+ */
+astarte_property_cache_result_t astarte_property_cache_check(astarte_property_cache_t *cache,
+    const char *interface_name, const char *path, int32_t major, const void *data, size_t data_len);
+
+/**
+ * @brief Insert or update a property in the cache.
+ *
+ * @details When the cache is full the least recently used property is evicted.
+ *
+ * @param[in] cache Cache to update.
+ * @param[in] interface_name Interface name of the property.
+ * @param[in] path Path of the property.
+ * @param[in] major Major version of the interface.
+ * @param[in] data Value of the property, as stored in non volatile memory.
+ * @param[in] data_len Length of the value.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the entry could not be allocated, the property is not cached,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_property_cache_set(astarte_property_cache_t *cache,
+    const char *interface_name, const char *path, int32_t major, const void *data, size_t data_len);
+
+/**
+ * @brief Remove a property from the cache.
+ *
+ * @param[in] cache Cache to update.
+ * @param[in] interface_name Interface name of the property.
+ * @param[in] path Path of the property.
+ */
+void astarte_property_cache_remove(
+    astarte_property_cache_t *cache, const char *interface_name, const char *path);
+
+/**
+ * @brief Remove all the properties from the cache.
+ *
+ * @param[in] cache Cache to clear.
+ */
+void astarte_property_cache_clear(astarte_property_cache_t *cache);
+
+#endif /* _ASTARTE_PROPERTY_CACHE_H_ */
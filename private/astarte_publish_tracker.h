@@ -0,0 +1,172 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+/**
+ * @file astarte_publish_tracker.h
+ * @brief Bookkeeping of the asynchronous publishes waiting for an acknowledgment.
+ *
+ * @details The tracker maps the tickets returned to the user to the MQTT message ids, it has a
+ * fixed capacity that bounds the number of messages in flight. It does not perform any locking.
+ */
+
+#ifndef _ASTARTE_PUBLISH_TRACKER_H_
+#define _ASTARTE_PUBLISH_TRACKER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "astarte.h"
+#include "astarte_device.h"
+
+/** @brief Number of acknowledgments stored while their message id is not yet known */
+#define ASTARTE_PUBLISH_TRACKER_EARLY_ACKS 8
+
+typedef struct
+{
+    /** @brief Ticket returned to the user, zero for free entries */
+    astarte_device_publish_ticket_t ticket;
+    /** @brief MQTT message id, negative until the message has been handed to the MQTT client */
+    int msg_id;
+    /** @brief Time when the entry has been reserved, in milliseconds */
+    uint32_t start_ms;
+    /** @brief Completion callback */
+    astarte_device_publish_callback_t callback;
+    /** @brief User data for the completion callback */
+    void *user_data;
+} astarte_publish_tracker_entry_t;
+
+typedef struct
+{
+    /** @brief Message id of the acknowledgment */
+    int msg_id;
+    /** @brief Time when the acknowledgment has been received, in milliseconds */
+    uint32_t time_ms;
+} astarte_publish_tracker_early_ack_t;
+
+typedef struct
+{
+    /** @brief Tracked entries */
+    astarte_publish_tracker_entry_t *entries;
+    /** @brief Maximum number of tracked entries */
+    size_t capacity;
+    /** @brief Number of tracked entries */
+    size_t count;
+    /** @brief Last ticket assigned */
+    astarte_device_publish_ticket_t last_ticket;
+    /** @brief Acknowledgments received before their message id was assigned to an entry */
+    astarte_publish_tracker_early_ack_t early_acks[ASTARTE_PUBLISH_TRACKER_EARLY_ACKS];
+    /** @brief Next slot to overwrite in the early acknowledgments ring */
+    size_t early_acks_next;
+} astarte_publish_tracker_t;
+
+/**
+ * @brief Initialize a tracker.
+ *
+ * @param[out] tracker Tracker to initialize.
+ * @param[in] capacity Maximum number of messages in flight.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the entries could not be allocated,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_publish_tracker_init(astarte_publish_tracker_t *tracker, size_t capacity);
+
+/**
+ * @brief Free the memory used by a tracker.
+ *
+ * @details The tracked entries are discarded, use astarte_publish_tracker_pop_any to complete them
+ * before calling this function.
+ *
+ * @param[in] tracker Tracker to destroy.
+ */
+void astarte_publish_tracker_destroy(astarte_publish_tracker_t *tracker);
+
+/**
+ * @brief Reserve an entry for a message that is about to be published.
+ *
+ * @param[in] tracker Tracker to use.
+ * @param[in] callback Completion callback.
+ * @param[in] user_data User data for the completion callback.
+ * @param[in] now_ms Current time in milliseconds.
+ * @param[out] ticket Ticket identifying the new entry.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_OUT_OF_MEMORY if all the entries are in use,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_publish_tracker_reserve(astarte_publish_tracker_t *tracker,
+    astarte_device_publish_callback_t callback, void *user_data, uint32_t now_ms,
+    astarte_device_publish_ticket_t *ticket);
+
+/**
+ * @brief Assign the MQTT message id to a reserved entry.
+ *
+ * @details If the acknowledgment for the message id has already been received the entry is
+ * removed from the tracker and copied in the completed parameter.
+ *
+ * @param[in] tracker Tracker to use.
+ * @param[in] ticket Ticket of the entry.
+ * @param[in] msg_id MQTT message id.
+ * @param[in] now_ms Current time in milliseconds.
+ * @param[out] completed Copy of the entry, when already acknowledged.
+ * @return true if the message has already been acknowledged, false otherwise.
+ */
+bool astarte_publish_tracker_set_msg_id(astarte_publish_tracker_t *tracker,
+    astarte_device_publish_ticket_t ticket, int msg_id, uint32_t now_ms,
+    astarte_publish_tracker_entry_t *completed);
+
+/**
+ * @brief Remove the entry with the provided message id.
+ *
+ * @details When no entry matches the message id and remember is set, the message id is stored
+ * for a short time as it could be assigned to an entry right after.
+ *
+ * @param[in] tracker Tracker to use.
+ * @param[in] msg_id MQTT message id.
+ * @param[in] remember Store the message id when not found.
+ * @param[in] now_ms Current time in milliseconds.
+ * @param[out] completed Copy of the removed entry.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_NOT_FOUND if no entry has the message id,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_publish_tracker_complete(astarte_publish_tracker_t *tracker, int msg_id,
+    bool remember, uint32_t now_ms, astarte_publish_tracker_entry_t *completed);
+
+/**
+ * @brief Remove the entry with the provided ticket.
+ *
+ * @param[in] tracker Tracker to use.
+ * @param[in] ticket Ticket of the entry.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_NOT_FOUND if no entry has the ticket,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_publish_tracker_cancel(
+    astarte_publish_tracker_t *tracker, astarte_device_publish_ticket_t ticket);
+
+/**
+ * @brief Remove one entry older than the timeout.
+ *
+ * @param[in] tracker Tracker to use.
+ * @param[in] now_ms Current time in milliseconds.
+ * @param[in] timeout_ms Maximum time an entry can wait for its acknowledgment.
+ * @param[out] expired Copy of the removed entry.
+ * @return true if an entry has been removed, false otherwise.
+ */
+bool astarte_publish_tracker_pop_expired(astarte_publish_tracker_t *tracker, uint32_t now_ms,
+    uint32_t timeout_ms, astarte_publish_tracker_entry_t *expired);
+
+/**
+ * @brief Remove any entry from the tracker.
+ *
+ * @param[in] tracker Tracker to use.
+ * @param[out] removed Copy of the removed entry.
+ * @return true if an entry has been removed, false if the tracker is empty.
+ */
+bool astarte_publish_tracker_pop_any(
+    astarte_publish_tracker_t *tracker, astarte_publish_tracker_entry_t *removed);
+
+#endif /* _ASTARTE_PUBLISH_TRACKER_H_ */
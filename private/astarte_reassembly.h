@@ -0,0 +1,96 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+/**
+ * @file astarte_reassembly.h
+ * @brief Reassembly of the incoming MQTT messages received in several fragments.
+ *
+ * @details The MQTT client delivers the messages larger than its buffer as a sequence of
+ * fragments, only the first one carrying the topic. The fragments are copied in a single buffer,
+ * which is kept and reused for the following messages. It does not perform any locking.
+ */
+
+#ifndef _ASTARTE_REASSEMBLY_H_
+#define _ASTARTE_REASSEMBLY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "astarte.h"
+
+typedef struct
+{
+    /** @brief Topic followed by the payload of the message, kept between messages */
+    char *buffer;
+    /** @brief Allocated size of the buffer */
+    size_t buffer_size;
+    /** @brief Maximum size of a message, topic included */
+    size_t max_message_size;
+    /** @brief Length of the topic of the message */
+    size_t topic_len;
+    /** @brief Total length of the payload of the message */
+    size_t data_len;
+    /** @brief Number of payload bytes received */
+    size_t received;
+    /** @brief True while the fragments of a message are being received */
+    bool in_progress;
+} astarte_reassembly_t;
+
+/**
+ * @brief Initialize a reassembly buffer, no memory is allocated until the first fragment.
+ *
+ * @param[out] reassembly Reassembly buffer to initialize.
+ * @param[in] max_message_size Maximum size of a message, topic included.
+ */
+void astarte_reassembly_init(astarte_reassembly_t *reassembly, size_t max_message_size);
+
+/**
+ * @brief Free the memory used by a reassembly buffer.
+ *
+ * @param[in] reassembly Reassembly buffer to destroy.
+ */
+void astarte_reassembly_destroy(astarte_reassembly_t *reassembly);
+
+/**
+ * @brief Drop the message being reassembled, keeping the buffer.
+ *
+ * @param[inout] reassembly Reassembly buffer to reset.
+ */
+void astarte_reassembly_reset(astarte_reassembly_t *reassembly);
+
+/**
+ * @brief Add a fragment to the message being reassembled.
+ *
+ * @details A fragment with a zero offset starts a new message, dropping the incomplete one. On
+ * error the message being reassembled is dropped.
+ *
+ * @param[inout] reassembly Reassembly buffer.
+ * @param[in] topic Topic of the message, only used for the first fragment.
+ * @param[in] topic_len Length of the topic.
+ * @param[in] data Payload of the fragment.
+ * @param[in] data_len Length of the payload of the fragment.
+ * @param[in] offset Offset of the fragment in the payload of the message.
+ * @param[in] total_len Total length of the payload of the message.
+ * @param[out] complete Set to true when the fragment completes the message.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_INVALID_SIZE if the message is larger than the maximum message size,
+ * - ASTARTE_ERR_NOT_FOUND if the fragment does not continue the message being reassembled,
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the buffer could not be allocated,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_reassembly_add(astarte_reassembly_t *reassembly, const char *topic,
+    size_t topic_len, const char *data, size_t data_len, size_t offset, size_t total_len,
+    bool *complete);
+
+/**
+ * @brief Get the payload of the reassembled message.
+ *
+ * @param[in] reassembly Reassembly buffer containing a complete message.
+ * @return The payload, its length is the data_len field of the reassembly buffer.
+ */
+char *astarte_reassembly_data(astarte_reassembly_t *reassembly);
+
+#endif /* _ASTARTE_REASSEMBLY_H_ */
@@ -0,0 +1,88 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+/**
+ * @file astarte_routes.h
+ * @brief Routing table mapping the paths of an interface to data callbacks.
+ *
+ * @details The routes are stored in a trie with one node for each path segment. A segment in the
+ * form `%{name}`, as in the endpoints of the interface mappings, matches any segment. Literal
+ * segments take precedence over parameters. The root node holds the callback for the paths not
+ * matched by any route.
+ */
+
+#ifndef _ASTARTE_ROUTES_H_
+#define _ASTARTE_ROUTES_H_
+
+#include <stddef.h>
+
+#include "astarte.h"
+#include "astarte_device.h"
+
+typedef struct astarte_route_node
+{
+    /** @brief Literal segment matched by the node, NULL for the root and parameter nodes */
+    char *segment;
+    /** @brief Length of the segment */
+    size_t segment_len;
+    /** @brief First child matching a literal segment */
+    struct astarte_route_node *children;
+    /** @brief Next child of the same parent */
+    struct astarte_route_node *sibling;
+    /** @brief Child matching any segment */
+    struct astarte_route_node *parameter;
+    /** @brief Callback for the paths ending in this node, NULL if no route ends here */
+    astarte_device_data_view_event_callback_t callback;
+    /** @brief User data passed to the callback */
+    void *user_data;
+} astarte_route_node_t;
+
+/**
+ * @brief Routing table, a zero initialized table is empty.
+ */
+typedef struct
+{
+    /** @brief Root of the trie */
+    astarte_route_node_t root;
+} astarte_routes_t;
+
+/**
+ * @brief Free the memory used by a routing table, leaving it empty.
+ *
+ * @param[in] routes Routing table to destroy.
+ */
+void astarte_routes_destroy(astarte_routes_t *routes);
+
+/**
+ * @brief Add a route, replacing the callback of an equal pattern.
+ *
+ * @param[inout] routes Routing table to update.
+ * @param[in] pattern Path pattern, such as "/%{sensor_id}/value". NULL for the callback of the
+ * paths not matched by any route.
+ * @param[in] callback Callback for the matched paths.
+ * @param[in] user_data User data passed to the callback.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_INVALID_INTERFACE_PATH if the pattern does not start with a '/' or has an empty
+ *   segment,
+ * - ASTARTE_ERR_OUT_OF_MEMORY if a node could not be allocated,
+ * - ASTARTE_OK otherwise.
+ */
+astarte_err_t astarte_routes_add(astarte_routes_t *routes, const char *pattern,
+    astarte_device_data_view_event_callback_t callback, void *user_data);
+
+/**
+ * @brief Find the route for a path.
+ *
+ * @param[in] routes Routing table to search.
+ * @param[in] path Path to match, it does not need to be NULL terminated.
+ * @param[in] path_len Length of the path.
+ * @return The node of the matched route. The root node when no route matches the path and the
+ * root has a callback, NULL otherwise.
+ */
+const astarte_route_node_t *astarte_routes_match(
+    const astarte_routes_t *routes, const char *path, size_t path_len);
+
+#endif /* _ASTARTE_ROUTES_H_ */
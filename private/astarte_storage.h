@@ -18,9 +18,18 @@
 #include "astarte.h"
 #include "astarte_nvs_key_value.h"
 
+typedef struct
+{
+    /** @brief Index of the stored properties */
+    astarte_nvs_key_value_index_t index;
+    /** @brief True between astarte_storage_begin_transaction and the following commit */
+    bool in_transaction;
+} astarte_storage_context_t;
+
 typedef struct
 {
     nvs_handle_t nvs_handle;
+    astarte_storage_context_t *context;
 } astarte_storage_handle_t;
 
 typedef struct
@@ -28,9 +37,39 @@ typedef struct
     astarte_nvs_key_value_iterator_t nvs_key_value_iterator;
 } astarte_storage_iterator_t;
 
+typedef struct
+{
+    /** @brief Buffer for the stored key, NULL until the first property is read */
+    char *key;
+    /** @brief Size of the key buffer */
+    size_t key_size;
+    /** @brief Buffer for the stored value, NULL until the first property is read */
+    uint8_t *value;
+    /** @brief Size of the value buffer */
+    size_t value_size;
+} astarte_storage_scratch_t;
+
+typedef struct
+{
+    /** @brief Interface name, NULL terminated */
+    const char *interface_name;
+    /** @brief Property endpoint, NULL terminated */
+    const char *path;
+    /** @brief Major version of the interface */
+    int32_t major;
+    /** @brief Property value */
+    const uint8_t *data;
+    /** @brief Length of the property value */
+    size_t data_len;
+} astarte_storage_property_t;
+
 /**
  * @brief Opens the underlying NVS memory
  *
+ * @details A handle can be kept open for a long time, the stored properties are indexed on first
+ * use and the index is kept until the handle is closed. All the changes to the storage should be
+ * performed through the same handle and a handle should not be used concurrently.
+ *
  * @param[out] handle Handle to initialize
  * @return One of the follwing error codes:
  * - ASTARTE_ERR if operation failed,
@@ -41,13 +80,43 @@ astarte_err_t astarte_storage_open(astarte_storage_handle_t *handle);
 /**
  * @brief Closes the underlying NVS memory
  *
+ * @details A transaction still in progress is committed.
+ *
  * @param[in] handle Handle to close
  */
 void astarte_storage_close(astarte_storage_handle_t handle);
 
+/**
+ * @brief Starts a transaction
+ *
+ * @details The following store and delete operations are not committed until
+ * astarte_storage_commit_transaction is called, so that many changes share a single commit.
+ *
+ * @param[in] handle Handle to astarte storage instance
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR if a transaction is already in progress,
+ * - ASTARTE_OK if operation has been successful
+ */
+astarte_err_t astarte_storage_begin_transaction(astarte_storage_handle_t handle);
+
+/**
+ * @brief Commits all the changes performed since astarte_storage_begin_transaction
+ *
+ * @details The holes left by the deleted properties are compacted here when enough of them are
+ * present, any iterator created during the transaction should not be used afterwards.
+ *
+ * @param[in] handle Handle to astarte storage instance
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR if no transaction is in progress or the commit failed,
+ * - ASTARTE_OK if operation has been successful
+ */
+astarte_err_t astarte_storage_commit_transaction(astarte_storage_handle_t handle);
+
 /**
  * @brief Stores a property
  *
+ * @details The change is committed immediately, unless a transaction is in progress.
+ *
  * @param[in] handle Handle to astarte storage instance
  * @param[in] interface_name Interface name
  * @param[in] path Property endpoint
@@ -108,6 +177,8 @@ astarte_err_t astarte_storage_load_property(astarte_storage_handle_t handle,
 /**
  * @brief Deletes a stored property
  *
+ * @details The change is committed immediately, unless a transaction is in progress.
+ *
  * @param[in] handle Handle to astarte storage instance
  * @param[in] interface_name Interface name
  * @param[in] path Property endpoint
@@ -196,4 +267,36 @@ astarte_err_t astarte_storage_iterator_get_property(astarte_storage_iterator_t *
     char *out_interface_name, size_t *out_interface_name_len, void *out_path, size_t *out_path_len,
     int32_t *out_major, void *out_data, size_t *out_data_len);
 
+/**
+ * @brief Initialize a scratch buffer for astarte_storage_iterator_read_property.
+ *
+ * @param[out] scratch Scratch buffer to initialize.
+ */
+void astarte_storage_scratch_init(astarte_storage_scratch_t *scratch);
+
+/**
+ * @brief Free the memory used by a scratch buffer.
+ *
+ * @param[in] scratch Scratch buffer to destroy.
+ */
+void astarte_storage_scratch_destroy(astarte_storage_scratch_t *scratch);
+
+/**
+ * @brief Read the property pointed to by the iterator in a single pass.
+ *
+ * @details All the fields are read at once into a scratch buffer owned by the caller, the buffer
+ * grows when a property does not fit and can be reused for all the properties of an iteration.
+ *
+ * @param[in] iterator Iterator to use.
+ * @param[inout] scratch Scratch buffer holding the property.
+ * @param[out] property Property read, it points into @p scratch and is valid until the next read
+ * or until the scratch buffer is destroyed.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the scratch buffer could not be grown,
+ * - ASTARTE_ERR if the operation failed for other reasons,
+ * - ASTARTE_OK if the operation has been successful
+ */
+astarte_err_t astarte_storage_iterator_read_property(astarte_storage_iterator_t *iterator,
+    astarte_storage_scratch_t *scratch, astarte_storage_property_t *property);
+
 #endif /* _ASTARTE_STORAGE_H_ */
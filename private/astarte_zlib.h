@@ -7,33 +7,163 @@
 /**
  * @file astarte_zlib.h
  * @brief Soft wrappers for zlib functions.
+ *
+ * @details All the zlib streams are owned by a context, which is reused for each compression and
+ * decompression. The memory allocated by zlib comes from a small pool owned by the context, the
+ * blocks freed by zlib are kept and reused by the next allocations of the same size.
+ * A context does not perform any locking, it should be used by a single task at a time.
  */
 
 #ifndef _ASTARTE_ZLIB_H_
 #define _ASTARTE_ZLIB_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #include <zlib.h>
 
+/** @brief Maximum number of blocks kept in the pool of a context */
+#define ASTARTE_ZLIB_POOL_SIZE 8
+
 /**
- * @brief Function equivalent to the `compress` function defined in zlib.h.
+ * @brief Callback receiving the entries decompressed by astarte_zlib_uncompress_split.
  *
- * @details The implementation is copied 1 to 1 from zlib, with a single difference.
- * `defalteInit` has been replaced by `deflateInit2`. This allows to reduce the memory usage of zlib
- * by setting custom values for the `windowBits` and `memLevel` parameters.
- * This could also have been done by changing the values of the defines `MAX_WBITS` and
- * `DEF_MEM_LEVEL` in zconf.h. However this would have required to change the source of a idf
- * component and has been avoided.
+ * @param entry First char of the entry, not NULL terminated. Only valid during the call.
+ * @param entry_len Length of the entry, never zero.
+ * @param user_data User data passed to astarte_zlib_uncompress_split.
+ */
+typedef void (*astarte_zlib_entry_cbk_t)(const char *entry, size_t entry_len, void *user_data);
+
+typedef struct
+{
+    /** @brief Allocated memory, NULL for free slots */
+    void *ptr;
+    /** @brief Size of the allocated memory */
+    size_t size;
+    /** @brief True if the block is in use by zlib */
+    bool used;
+} astarte_zlib_block_t;
+
+typedef struct
+{
+    /** @brief Blocks allocated for zlib */
+    astarte_zlib_block_t pool[ASTARTE_ZLIB_POOL_SIZE];
+    /** @brief Stream used by the compressors */
+    z_stream deflate_stream;
+    /** @brief True if deflate_stream has been initialized */
+    bool deflate_ready;
+    /** @brief Stream used for decompressing */
+    z_stream inflate_stream;
+    /** @brief True if inflate_stream has been initialized */
+    bool inflate_ready;
+    /** @brief Base two logarithm of the compression window size */
+    int windowBits;
+    /** @brief Memory used for the internal compression state */
+    int memLevel;
+} astarte_zlib_context_t;
+
+/**
+ * @brief Compressor producing a zlib stream in a growing buffer, from data appended incrementally.
+ */
+typedef struct
+{
+    /** @brief Stream of the context, total_in and total_out hold the length of the data */
+    z_stream *stream;
+    /** @brief Output buffer, starting with the reserved bytes followed by the compressed data */
+    Bytef *buffer;
+    /** @brief Allocated size of the output buffer */
+    size_t buffer_size;
+    /** @brief Number of bytes reserved at the start of the buffer for the caller */
+    size_t reserved;
+} astarte_zlib_compressor_t;
+
+/**
+ * @brief Initialize a context, no memory is allocated until the context is used.
+ *
+ * @details The compression uses `deflateInit2` with custom values for the `windowBits` and
+ * `memLevel` parameters. This allows to reduce the memory usage of zlib, which is mostly determined
+ * by these two values. See the docstrings for `deflateInit2` in zlib.h.
+ *
+ * @param context Context to initialize.
+ * @param windowBits Base two logarithm of the compression window size, in the range 9..15.
+ * @param memLevel Memory used for the internal compression state, in the range 1..9.
+ */
+void astarte_zlib_context_init(astarte_zlib_context_t *context, int windowBits, int memLevel);
+
+/**
+ * @brief Free all the memory used by a context, the context can still be used.
+ *
+ * @param context Context to release, no compressor should be using it.
+ */
+void astarte_zlib_context_release(astarte_zlib_context_t *context);
+
+/**
+ * @brief Initialize a compressor.
+ *
+ * @param compressor Compressor to initialize. Should be destroyed even if the initialization fails.
+ * @param context Context providing the zlib stream, used by a single compressor at a time.
+ * @param reserved Bytes reserved at the start of the output buffer, they are not written.
+ * @return Z_OK on success, Z_MEM_ERROR if there was not enough memory, Z_STREAM_ERROR if a
+ * parameter of the context is invalid.
+ */
+int astarte_zlib_compressor_init(
+    astarte_zlib_compressor_t *compressor, astarte_zlib_context_t *context, size_t reserved);
+
+/**
+ * @brief Compress some data, the output buffer is grown when needed.
+ *
+ * @param compressor Compressor initialized with astarte_zlib_compressor_init.
+ * @param data Data to compress.
+ * @param len Length of the data.
+ * @return Z_OK on success, Z_MEM_ERROR if the output buffer could not be grown.
+ */
+int astarte_zlib_compressor_append(
+    astarte_zlib_compressor_t *compressor, const void *data, size_t len);
+
+/**
+ * @brief Complete the zlib stream.
+ *
+ * @details After this call the buffer of the compressor contains the reserved bytes followed by the
+ * complete zlib stream. Nothing else should be appended.
+ *
+ * @param compressor Compressor initialized with astarte_zlib_compressor_init.
+ * @param out_len Set to the used length of the buffer, including the reserved bytes.
+ * @return Z_OK on success, Z_MEM_ERROR if the output buffer could not be grown.
+ */
+int astarte_zlib_compressor_finish(astarte_zlib_compressor_t *compressor, size_t *out_len);
+
+/**
+ * @brief Free the output buffer of a compressor, the zlib stream is kept by the context.
+ *
+ * @param compressor Compressor to destroy.
+ */
+void astarte_zlib_compressor_destroy(astarte_zlib_compressor_t *compressor);
+
+/**
+ * @brief Decompress a zlib stream made of entries separated by a delimiter, one entry at a time.
  *
- * @note Since this function is almost a copy and paste from zlib.c, it will not be linted as every
- * other function in this library.
+ * @details The stream is decompressed into @p buffer, each complete entry is passed to @p cbk as
+ * soon as it is decoded and its space is reused for the following data. The memory used does not
+ * depend on the length of the decompressed data, the zlib window is sized as specified in the
+ * header of the stream. Empty entries are skipped.
  *
- * @param dest See docstrings for `compress` in zlib.h
- * @param destLen See docstrings for `compress` in zlib.h
- * @param source See docstrings for `compress` in zlib.h
- * @param sourceLen See docstrings for `compress` in zlib.h
- * @return See docstrings for `compress` in zlib.h
+ * @param context Context providing the zlib stream.
+ * @param source Compressed data.
+ * @param sourceLen Length of the compressed data.
+ * @param delimiter Char separating the entries.
+ * @param buffer Buffer used for the decompression, it should fit the longest entry.
+ * @param buffer_size Size of the buffer.
+ * @param cbk Callback called for each entry.
+ * @param user_data User data passed to the callback.
+ * @param destLen Set to the total length of the decompressed data.
+ * @return One of the follwing error codes:
+ * - Z_OK if the stream has been decompressed completely,
+ * - Z_BUF_ERROR if the stream is truncated or if an entry does not fit in the buffer,
+ * - Z_DATA_ERROR if the stream is corrupted,
+ * - Z_MEM_ERROR if zlib could not allocate its state.
  */
-int ZEXPORT astarte_zlib_compress(
-    Bytef *dest, uLongf *destLen, const Bytef *source, uLong sourceLen);
+int astarte_zlib_uncompress_split(astarte_zlib_context_t *context, const Bytef *source,
+    uLong sourceLen, char delimiter, char *buffer, size_t buffer_size,
+    astarte_zlib_entry_cbk_t cbk, void *user_data, uLongf *destLen);
 
 #endif /* _ASTARTE_ZLIB_H_ */
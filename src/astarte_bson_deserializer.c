@@ -45,6 +45,39 @@ static uint32_t read_uint32(const void *buff);
  */
 static uint64_t read_uint64(const void *buff);
 
+/**
+ * @brief Store the value of an element in a struct member.
+ *
+ * @param[in] field Description of the struct member.
+ * @param[in] element Element matching the name of the field.
+ * @param[in] end End of the document containing the element.
+ * @param[out] out_struct Struct containing the member.
+ * @return True if the element has been stored, false if its type or size do not match the field.
+ */
+static bool decode_struct_field(const astarte_bson_struct_field_t *field,
+    astarte_bson_element_t element, const uint8_t *end, void *out_struct);
+
+/**
+ * @brief Store a fixed size value in a struct member or in an element of a member array.
+ *
+ * @param[in] type BSON type of the value.
+ * @param[in] element Element containing the value.
+ * @param[out] member Struct member where to store the value.
+ * @param[in] size Size of the struct member.
+ * @return True if the value has been stored, false if the type is not fixed size or the size of
+ * the member does not match.
+ */
+static bool decode_struct_value(
+    uint8_t type, astarte_bson_element_t element, void *member, size_t size);
+
+/**
+ * @brief Size of a fixed size BSON value stored in a struct member.
+ *
+ * @param[in] type BSON type of the value.
+ * @return Size of the struct member, zero if the type is not fixed size.
+ */
+static size_t struct_value_size(uint8_t type);
+
 /************************************************
  *         Global functions definitions         *
  ***********************************************/
@@ -219,6 +252,52 @@ astarte_err_t astarte_bson_deserializer_element_lookup(
     return err;
 }
 
+astarte_err_t astarte_bson_deserializer_decode_struct(astarte_bson_document_t document,
+    const astarte_bson_struct_field_t *fields, size_t fields_count, void *out_struct,
+    uint32_t *invalid_fields)
+{
+    if (fields_count > ASTARTE_BSON_STRUCT_MAX_FIELDS) {
+        ESP_LOGE(TAG, "Too many struct fields: %zu", fields_count);
+        return ASTARTE_ERR_INVALID_SIZE;
+    }
+
+    // Each field is invalid until decoded
+    uint32_t invalid = (fields_count == ASTARTE_BSON_STRUCT_MAX_FIELDS)
+        ? UINT32_MAX
+        : (uint32_t) ((UINT32_C(1) << fields_count) - 1U);
+    const uint8_t *end = (const uint8_t *) document.list + document.list_size;
+    size_t next_field = 0;
+
+    astarte_bson_element_t element;
+    astarte_err_t err = astarte_bson_deserializer_first_element(document, &element);
+    while (err == ASTARTE_OK) {
+        for (size_t i = 0; i < fields_count; i++) {
+            size_t index = (next_field + i) % fields_count;
+            const astarte_bson_struct_field_t *field = &fields[index];
+            if ((field->name_len != element.name_len)
+                || (memcmp(field->name, element.name, element.name_len) != 0)) {
+                continue;
+            }
+            if (decode_struct_field(field, element, end, out_struct)) {
+                invalid &= ~(UINT32_C(1) << index);
+            } else {
+                invalid |= UINT32_C(1) << index;
+            }
+            next_field = index + 1;
+            break;
+        }
+        err = astarte_bson_deserializer_next_element(document, element, &element);
+    }
+    if (err != ASTARTE_ERR_NOT_FOUND) {
+        return err;
+    }
+
+    if (invalid_fields) {
+        *invalid_fields = invalid;
+    }
+    return (invalid == 0U) ? ASTARTE_OK : ASTARTE_ERR_NOT_FOUND;
+}
+
 double astarte_bson_deserializer_element_to_double(astarte_bson_element_t element)
 {
     uint64_t value = read_uint64(element.value);
@@ -295,3 +374,114 @@ static uint64_t read_uint64(const void *buff)
         | ((uint64_t) bytes[3] << 24U) | ((uint64_t) bytes[4] << 32U) | ((uint64_t) bytes[5] << 40U)
         | ((uint64_t) bytes[6] << 48U) | ((uint64_t) bytes[7] << 56U));
 }
+
+static bool decode_struct_field(const astarte_bson_struct_field_t *field,
+    astarte_bson_element_t element, const uint8_t *end, void *out_struct)
+{
+    if (element.type != field->type) {
+        return false;
+    }
+
+    uint8_t *member = (uint8_t *) out_struct + field->offset;
+    switch (field->type) {
+        case BSON_TYPE_STRING: {
+            uint32_t len = 0U;
+            const char *string = astarte_bson_deserializer_element_to_string(element, &len);
+            if ((len >= field->size) || ((const uint8_t *) string + len >= end)) {
+                return false;
+            }
+            memcpy(member, string, len);
+            member[len] = '\0';
+            return true;
+        }
+        case BSON_TYPE_BINARY: {
+            uint32_t len = 0U;
+            const uint8_t *binary = astarte_bson_deserializer_element_to_binary(element, &len);
+            if ((len != field->size) || (binary + len > end)) {
+                return false;
+            }
+            memcpy(member, binary, len);
+            return true;
+        }
+        case BSON_TYPE_ARRAY: {
+            size_t value_size = struct_value_size(field->element_type);
+            if ((value_size == 0U) || (field->size % value_size != 0U)) {
+                return false;
+            }
+            astarte_bson_document_t array = astarte_bson_deserializer_element_to_array(element);
+            if ((const uint8_t *) element.value + array.size > end) {
+                return false;
+            }
+            size_t count = 0U;
+            astarte_bson_element_t item;
+            astarte_err_t err = astarte_bson_deserializer_first_element(array, &item);
+            while (err == ASTARTE_OK) {
+                if ((item.type != field->element_type) || ((count + 1) * value_size > field->size)
+                    || !decode_struct_value(
+                        item.type, item, member + count * value_size, value_size)) {
+                    return false;
+                }
+                count++;
+                err = astarte_bson_deserializer_next_element(array, item, &item);
+            }
+            return (err == ASTARTE_ERR_NOT_FOUND) && (count * value_size == field->size);
+        }
+        default: {
+            return decode_struct_value(field->type, element, member, field->size);
+        }
+    }
+}
+
+static bool decode_struct_value(
+    uint8_t type, astarte_bson_element_t element, void *member, size_t size)
+{
+    if ((struct_value_size(type) == 0U) || (size != struct_value_size(type))) {
+        return false;
+    }
+
+    switch (type) {
+        case BSON_TYPE_DOUBLE: {
+            *(double *) member = astarte_bson_deserializer_element_to_double(element);
+            break;
+        }
+        case BSON_TYPE_INT32: {
+            *(int32_t *) member = astarte_bson_deserializer_element_to_int32(element);
+            break;
+        }
+        case BSON_TYPE_INT64: {
+            *(int64_t *) member = astarte_bson_deserializer_element_to_int64(element);
+            break;
+        }
+        case BSON_TYPE_DATETIME: {
+            *(int64_t *) member = astarte_bson_deserializer_element_to_datetime(element);
+            break;
+        }
+        default: {
+            *(bool *) member = *(const uint8_t *) element.value != 0U;
+            break;
+        }
+    }
+    return true;
+}
+
+static size_t struct_value_size(uint8_t type)
+{
+    switch (type) {
+        case BSON_TYPE_DOUBLE: {
+            return sizeof(double);
+        }
+        case BSON_TYPE_INT32: {
+            return sizeof(int32_t);
+        }
+        case BSON_TYPE_INT64:
+        case BSON_TYPE_DATETIME: {
+            return sizeof(int64_t);
+        }
+        case BSON_TYPE_BOOLEAN: {
+            return sizeof(bool);
+        }
+        default: {
+            return 0U;
+        }
+    }
+}
@@ -0,0 +1,392 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+#include <astarte_bson_parser.h>
+
+#include <astarte_bson_types.h>
+
+#include <string.h>
+
+#include <esp_log.h>
+
+/************************************************
+ *        Defines, constants and typedef        *
+ ***********************************************/
+
+#define TAG "ASTARTE_BSON_PARSER"
+
+#define NULL_TERM_SIZE 1
+// Size of the smallest document, an empty list and its terminator
+#define EMPTY_DOCUMENT_SIZE (sizeof(uint32_t) + NULL_TERM_SIZE)
+
+enum
+{
+    /** @brief Collecting the size of the root document */
+    PARSER_STATE_DOCUMENT_SIZE = 0,
+    /** @brief Expecting the type of the next element, or the end of the current document */
+    PARSER_STATE_ELEMENT_TYPE,
+    /** @brief Collecting the name of the current element */
+    PARSER_STATE_ELEMENT_NAME,
+    /** @brief Collecting a fixed size value, or the size prefix of a variable size value */
+    PARSER_STATE_VALUE_HEADER,
+    /** @brief Streaming the content of a string or binary value */
+    PARSER_STATE_VALUE_CONTENT,
+    /** @brief Expecting the null terminator of a string value */
+    PARSER_STATE_STRING_TERMINATOR,
+    /** @brief The root document has been parsed */
+    PARSER_STATE_COMPLETE,
+    /** @brief Parsing stopped on an error */
+    PARSER_STATE_FAILED,
+};
+
+/************************************************
+ *         Static functions declaration         *
+ ***********************************************/
+
+/**
+ * @brief Stop the parser, the error is returned for all the following fragments.
+ *
+ * @param[inout] parser Parser to stop.
+ * @param[in] err Error causing the stop.
+ * @return The error passed as parameter.
+ */
+static astarte_err_t fail(astarte_bson_parser_t *parser, astarte_err_t err);
+/**
+ * @brief Handle the type byte of an element, or the terminator of the current document.
+ *
+ * @param[inout] parser Parser.
+ * @param[in] type Type byte.
+ * @return ASTARTE_OK on success, an error otherwise.
+ */
+static astarte_err_t parse_type(astarte_bson_parser_t *parser, uint8_t type);
+/**
+ * @brief Select the header to collect for the value of the current element.
+ *
+ * @param[inout] parser Parser with a complete element name.
+ * @return ASTARTE_ERR for unsupported types, ASTARTE_OK otherwise.
+ */
+static astarte_err_t start_value(astarte_bson_parser_t *parser);
+/**
+ * @brief Handle a complete header, collected in the scratch buffer.
+ *
+ * @param[inout] parser Parser.
+ * @return ASTARTE_OK on success, an error otherwise.
+ */
+static astarte_err_t parse_header(astarte_bson_parser_t *parser);
+/**
+ * @brief Open a document or array, checking that it fits in the enclosing one.
+ *
+ * @param[inout] parser Parser.
+ * @param[in] start Offset of the document.
+ * @param[in] size Size of the document.
+ * @return ASTARTE_OK on success, an error otherwise.
+ */
+static astarte_err_t push_document(astarte_bson_parser_t *parser, uint32_t start, uint32_t size);
+/**
+ * @brief Report an event for the current element to the sink.
+ *
+ * @param[inout] parser Parser.
+ * @param[in] type Type of the event.
+ * @param[in] chunk Chunk content, for chunk events.
+ * @param[in] chunk_len Chunk length, for chunk events.
+ * @return The value returned by the sink.
+ */
+static astarte_err_t emit(astarte_bson_parser_t *parser, astarte_bson_parser_event_type_t type,
+    const uint8_t *chunk, size_t chunk_len);
+/**
+ * @brief Cast the first four bytes of a little-endian buffer to a uint32_t in the host byte order.
+ *
+ * @param[in] buff Buffer containing the data to read.
+ * @return Resulting uint32_t value.
+ */
+static uint32_t read_uint32(const uint8_t *buff);
+
+/************************************************
+ *         Global functions definitions         *
+ ***********************************************/
+
+void astarte_bson_parser_init(
+    astarte_bson_parser_t *parser, astarte_bson_parser_sink_t sink, void *user_data)
+{
+    memset(parser, 0, sizeof(astarte_bson_parser_t));
+    parser->sink = sink;
+    parser->user_data = user_data;
+    parser->state = PARSER_STATE_DOCUMENT_SIZE;
+    parser->result = ASTARTE_OK;
+    parser->scratch_needed = sizeof(uint32_t);
+}
+
+astarte_err_t astarte_bson_parser_feed(
+    astarte_bson_parser_t *parser, const void *data, size_t data_len)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+    size_t pos = 0;
+    while ((pos < data_len) && (parser->result == ASTARTE_OK)) {
+        if (parser->state == PARSER_STATE_COMPLETE) {
+            ESP_LOGW(TAG, "Data past the end of the BSON document");
+            return fail(parser, ASTARTE_ERR_INVALID_SIZE);
+        }
+        // Each open document ends with its terminator, nothing can be read past it
+        if ((parser->depth > 0) && (parser->offset >= parser->ends[parser->depth - 1])) {
+            ESP_LOGW(TAG, "BSON element past the end of its document");
+            return fail(parser, ASTARTE_ERR);
+        }
+
+        const uint8_t *available = bytes + pos;
+        size_t available_len = data_len - pos;
+        size_t consumed = 0;
+        astarte_err_t err = ASTARTE_OK;
+        switch (parser->state) {
+            case PARSER_STATE_DOCUMENT_SIZE:
+            case PARSER_STATE_VALUE_HEADER: {
+                consumed = parser->scratch_needed - parser->scratch_len;
+                if (consumed > available_len) {
+                    consumed = available_len;
+                }
+                memcpy(parser->scratch + parser->scratch_len, available, consumed);
+                parser->scratch_len += consumed;
+                parser->offset += consumed;
+                if (parser->scratch_len == parser->scratch_needed) {
+                    err = parse_header(parser);
+                }
+                break;
+            }
+            case PARSER_STATE_ELEMENT_TYPE: {
+                consumed = 1;
+                parser->offset += consumed;
+                err = parse_type(parser, available[0]);
+                break;
+            }
+            case PARSER_STATE_ELEMENT_NAME: {
+                const uint8_t *terminator = memchr(available, '\0', available_len);
+                size_t name_part_len
+                    = (terminator) ? (size_t) (terminator - available) : available_len;
+                if (parser->name_len + name_part_len > ASTARTE_BSON_PARSER_MAX_NAME_LEN) {
+                    ESP_LOGW(TAG, "BSON element name too long");
+                    return fail(parser, ASTARTE_ERR_INVALID_SIZE);
+                }
+                memcpy(parser->name + parser->name_len, available, name_part_len);
+                parser->name_len += name_part_len;
+                consumed = (terminator) ? name_part_len + NULL_TERM_SIZE : name_part_len;
+                parser->offset += consumed;
+                if (terminator) {
+                    parser->name[parser->name_len] = '\0';
+                    err = start_value(parser);
+                }
+                break;
+            }
+            case PARSER_STATE_VALUE_CONTENT: {
+                consumed = parser->value_len - parser->value_offset;
+                if (consumed > available_len) {
+                    consumed = available_len;
+                }
+                err = emit(parser, ASTARTE_BSON_PARSER_EVENT_CHUNK, available, consumed);
+                parser->value_offset += consumed;
+                parser->offset += consumed;
+                if (parser->value_offset == parser->value_len) {
+                    parser->state = (parser->type == BSON_TYPE_STRING)
+                        ? PARSER_STATE_STRING_TERMINATOR
+                        : PARSER_STATE_ELEMENT_TYPE;
+                }
+                break;
+            }
+            case PARSER_STATE_STRING_TERMINATOR: {
+                consumed = 1;
+                parser->offset += consumed;
+                if (available[0] != '\0') {
+                    ESP_LOGW(TAG, "BSON string is not terminated by null byte");
+                    err = ASTARTE_ERR;
+                }
+                parser->state = PARSER_STATE_ELEMENT_TYPE;
+                break;
+            }
+            default:
+                err = ASTARTE_ERR;
+                break;
+        }
+        if (err != ASTARTE_OK) {
+            return fail(parser, err);
+        }
+        pos += consumed;
+    }
+    return parser->result;
+}
+
+bool astarte_bson_parser_is_complete(const astarte_bson_parser_t *parser)
+{
+    return parser->state == PARSER_STATE_COMPLETE;
+}
+
+/************************************************
+ *         Static functions definitions         *
+ ***********************************************/
+
+static astarte_err_t fail(astarte_bson_parser_t *parser, astarte_err_t err)
+{
+    parser->state = PARSER_STATE_FAILED;
+    parser->result = err;
+    return err;
+}
+
+static astarte_err_t parse_type(astarte_bson_parser_t *parser, uint8_t type)
+{
+    if (type == '\0') {
+        // The terminator should be the last byte of the document
+        if (parser->offset != parser->ends[parser->depth - 1]) {
+            ESP_LOGW(TAG, "BSON document terminated before its end");
+            return ASTARTE_ERR;
+        }
+        astarte_err_t err = emit(parser, ASTARTE_BSON_PARSER_EVENT_END_DOCUMENT, NULL, 0);
+        parser->depth--;
+        parser->state = (parser->depth == 0) ? PARSER_STATE_COMPLETE : PARSER_STATE_ELEMENT_TYPE;
+        return err;
+    }
+
+    parser->type = type;
+    parser->name_len = 0;
+    parser->state = PARSER_STATE_ELEMENT_NAME;
+    return ASTARTE_OK;
+}
+
+static astarte_err_t start_value(astarte_bson_parser_t *parser)
+{
+    switch (parser->type) {
+        case BSON_TYPE_BOOLEAN:
+            parser->scratch_needed = sizeof(int8_t);
+            break;
+        case BSON_TYPE_INT32:
+        case BSON_TYPE_STRING:
+        case BSON_TYPE_DOCUMENT:
+        case BSON_TYPE_ARRAY:
+            parser->scratch_needed = sizeof(int32_t);
+            break;
+        case BSON_TYPE_BINARY:
+            parser->scratch_needed = sizeof(int32_t) + sizeof(int8_t);
+            break;
+        case BSON_TYPE_DOUBLE:
+        case BSON_TYPE_DATETIME:
+        case BSON_TYPE_INT64:
+            parser->scratch_needed = sizeof(int64_t);
+            break;
+        default:
+            ESP_LOGW(TAG, "unrecognized BSON type: %i", (int) parser->type);
+            return ASTARTE_ERR;
+    }
+    parser->scratch_len = 0;
+    parser->value_len = 0;
+    parser->state = PARSER_STATE_VALUE_HEADER;
+    return ASTARTE_OK;
+}
+
+static astarte_err_t parse_header(astarte_bson_parser_t *parser)
+{
+    uint32_t header_start = parser->offset - parser->scratch_len;
+    if (parser->state == PARSER_STATE_DOCUMENT_SIZE) {
+        parser->state = PARSER_STATE_ELEMENT_TYPE;
+        return push_document(parser, header_start, read_uint32(parser->scratch));
+    }
+
+    // The value should be followed at least by the terminator of the enclosing document
+    if (parser->offset >= parser->ends[parser->depth - 1]) {
+        ESP_LOGW(TAG, "BSON element past the end of its document");
+        return ASTARTE_ERR;
+    }
+    uint32_t value_room = parser->ends[parser->depth - 1] - parser->offset - NULL_TERM_SIZE;
+    switch (parser->type) {
+        case BSON_TYPE_STRING: {
+            uint32_t len = read_uint32(parser->scratch);
+            if ((len < NULL_TERM_SIZE) || (len > value_room)) {
+                ESP_LOGW(TAG, "Invalid BSON string length: %u", (unsigned int) len);
+                return ASTARTE_ERR;
+            }
+            parser->value_len = len - NULL_TERM_SIZE;
+            break;
+        }
+        case BSON_TYPE_BINARY: {
+            uint32_t len = read_uint32(parser->scratch);
+            if (len > value_room) {
+                ESP_LOGW(TAG, "Invalid BSON binary length: %u", (unsigned int) len);
+                return ASTARTE_ERR;
+            }
+            parser->value_len = len;
+            break;
+        }
+        case BSON_TYPE_DOCUMENT:
+        case BSON_TYPE_ARRAY: {
+            astarte_err_t err = emit(parser, ASTARTE_BSON_PARSER_EVENT_ELEMENT, NULL, 0);
+            if (err != ASTARTE_OK) {
+                return err;
+            }
+            parser->state = PARSER_STATE_ELEMENT_TYPE;
+            return push_document(parser, header_start, read_uint32(parser->scratch));
+        }
+        default: {
+            // Fixed size value, complete in the scratch buffer
+            parser->state = PARSER_STATE_ELEMENT_TYPE;
+            return emit(parser, ASTARTE_BSON_PARSER_EVENT_ELEMENT, NULL, 0);
+        }
+    }
+
+    parser->value_offset = 0;
+    if (parser->value_len > 0) {
+        parser->state = PARSER_STATE_VALUE_CONTENT;
+    } else {
+        parser->state = (parser->type == BSON_TYPE_STRING) ? PARSER_STATE_STRING_TERMINATOR
+                                                           : PARSER_STATE_ELEMENT_TYPE;
+    }
+    return emit(parser, ASTARTE_BSON_PARSER_EVENT_ELEMENT, NULL, 0);
+}
+
+static astarte_err_t push_document(astarte_bson_parser_t *parser, uint32_t start, uint32_t size)
+{
+    if (parser->depth == ASTARTE_BSON_PARSER_MAX_DEPTH) {
+        ESP_LOGW(TAG, "BSON document nested too deeply");
+        return ASTARTE_ERR_INVALID_SIZE;
+    }
+    if (size < EMPTY_DOCUMENT_SIZE) {
+        ESP_LOGW(TAG, "Invalid BSON document size: %u", (unsigned int) size);
+        return ASTARTE_ERR;
+    }
+    if ((parser->depth > 0)
+        && (size > parser->ends[parser->depth - 1] - start - NULL_TERM_SIZE)) {
+        ESP_LOGW(TAG, "BSON document larger than the enclosing one");
+        return ASTARTE_ERR;
+    }
+    parser->ends[parser->depth] = start + size;
+    parser->depth++;
+    return ASTARTE_OK;
+}
+
+static astarte_err_t emit(astarte_bson_parser_t *parser, astarte_bson_parser_event_type_t type,
+    const uint8_t *chunk, size_t chunk_len)
+{
+    astarte_bson_parser_event_t event = {
+        .type = type,
+        .depth = parser->depth - 1,
+    };
+    if (type != ASTARTE_BSON_PARSER_EVENT_END_DOCUMENT) {
+        event.element.type = parser->type;
+        event.element.name = parser->name;
+        event.element.name_len = parser->name_len;
+        event.value_len = parser->value_len;
+    }
+    if (type == ASTARTE_BSON_PARSER_EVENT_ELEMENT) {
+        bool fixed_size = (parser->type != BSON_TYPE_STRING) && (parser->type != BSON_TYPE_BINARY)
+            && (parser->type != BSON_TYPE_DOCUMENT) && (parser->type != BSON_TYPE_ARRAY);
+        event.element.value = (fixed_size) ? parser->scratch : NULL;
+    } else if (type == ASTARTE_BSON_PARSER_EVENT_CHUNK) {
+        event.chunk = chunk;
+        event.chunk_len = chunk_len;
+        event.chunk_offset = parser->value_offset;
+    }
+    return parser->sink(&event, parser->user_data);
+}
+
+static uint32_t read_uint32(const uint8_t *buff)
+{
+    return ((uint32_t) buff[0]) | (((uint32_t) buff[1]) << 8U) | (((uint32_t) buff[2]) << 16U)
+        | (((uint32_t) buff[3]) << 24U);
+}
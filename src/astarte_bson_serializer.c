@@ -12,15 +12,13 @@
 
 #include <endian.h>
 #include <stdint.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define TAG "ASTARTE_BSON_SERIALIZER"
 
-// When serializing a C array into a BSON array, this is the maximum allowed size of the stringified
-// array length. 12 chars corresponding to 999999999999 elements.
-#define BSON_ARRAY_SIZE_STR_LEN 12
+// Maximum number of decimal digits of the index of a BSON array element, an int has at most 10.
+#define BSON_ARRAY_KEY_MAX_DIGITS 10
 
 // NOTE: this is a temporary typedef, once the structs astarte_byte_array_t and
 // astarte_bson_serializer_t deprecation period ends they should be moved here and renamed to
@@ -33,6 +31,25 @@ typedef struct astarte_bson_serializer_t astarte_bson_serializer;
 // NOLINTEND(readability-identifier-naming)
 #pragma GCC diagnostic pop
 
+// Smallest index having each number of decimal digits, the first entry is for one digit indexes.
+// Used to size and write the keys of BSON arrays without formatting them with snprintf.
+static const size_t array_key_digits_bounds[BSON_ARRAY_KEY_MAX_DIGITS] = { 0U, 10U, 100U, 1000U,
+    10000U, 100000U, 1000000U, 10000000U, 100000000U, 1000000000U };
+
+// Nested documents and arrays are written in place, their length is written once closed.
+// The arrays appended in a single call are sized up front, so the buffer is grown only once.
+static size_t array_keys_size(size_t count);
+static size_t nested_begin(
+    astarte_byte_array *byte_arr, uint8_t type, const char *name, size_t elements_size);
+static void array_append_key(astarte_byte_array *byte_arr, uint8_t type, size_t index);
+static void array_append_le(astarte_byte_array *byte_arr, const void *value, size_t size);
+static void nested_end(astarte_byte_array *byte_arr, size_t doc_start);
+// Structs are sized from their fields table, then all their elements are written in place.
+static size_t struct_field_size(const astarte_bson_struct_field_t *field, const uint8_t *member);
+static size_t struct_value_size(uint8_t type);
+static void struct_append_field(
+    astarte_byte_array *byte_arr, const astarte_bson_struct_field_t *field, const uint8_t *member);
+
 static void uint32_to_bytes(uint32_t input, uint8_t out[static sizeof(uint32_t)])
 {
     uint32_t tmp = htole32(input);
@@ -78,57 +95,111 @@ static void astarte_byte_array_init(astarte_byte_array *byte_arr, void *bytes, s
     byte_arr->capacity = size;
     byte_arr->size = size;
     byte_arr->buf = malloc(size);
+    byte_arr->borrowed = false;
+
+    byte_arr->fixed = false;
+    byte_arr->count_only = false;
+    byte_arr->error = ASTARTE_OK;
 
     if (!byte_arr->buf) {
         ESP_LOGE(TAG, "Cannot allocate memory for BSON payload (size: %zu)!", size);
-        abort();
+        byte_arr->capacity = 0;
+        byte_arr->size = 0;
+        byte_arr->error = ASTARTE_ERR_OUT_OF_MEMORY;
+        return;
     }
 
     memcpy(byte_arr->buf, bytes, size);
 }
 
+static void astarte_byte_array_init_borrowed(
+    astarte_byte_array *byte_arr, void *buf, size_t capacity)
+{
+    byte_arr->capacity = capacity;
+    byte_arr->size = 0;
+    byte_arr->buf = buf;
+    byte_arr->borrowed = true;
+    byte_arr->fixed = false;
+    byte_arr->count_only = false;
+    byte_arr->error = ASTARTE_OK;
+}
+
 static void astarte_byte_array_destroy(astarte_byte_array *byte_arr)
 {
     byte_arr->capacity = 0;
     byte_arr->size = 0;
-    free(byte_arr->buf);
+    if (!byte_arr->borrowed) {
+        free(byte_arr->buf);
+    }
     byte_arr->buf = NULL;
+    byte_arr->borrowed = false;
 }
 
-static void astarte_byte_array_grow(astarte_byte_array *byte_arr, size_t needed)
+static bool astarte_byte_array_writable(const astarte_byte_array *byte_arr)
 {
-    if (byte_arr->size + needed >= byte_arr->capacity) {
+    return !byte_arr->count_only && (byte_arr->error == ASTARTE_OK);
+}
+
+static bool astarte_byte_array_grow(astarte_byte_array *byte_arr, size_t needed)
+{
+    if (!astarte_byte_array_writable(byte_arr)) {
+        return false;
+    }
+    if (byte_arr->size + needed > byte_arr->capacity) {
+        if (byte_arr->fixed) {
+            ESP_LOGE(TAG, "BSON payload does not fit in the serializer buffer (size: %zu)!",
+                byte_arr->capacity);
+            byte_arr->error = ASTARTE_ERR_OUT_OF_MEMORY;
+            return false;
+        }
         size_t new_capacity = byte_arr->capacity * 2;
         if (new_capacity < byte_arr->capacity + needed) {
             new_capacity = byte_arr->capacity + needed;
         }
-        byte_arr->capacity = new_capacity;
         void *new_buf = malloc(new_capacity);
-        memcpy(new_buf, byte_arr->buf, byte_arr->size);
-        free(byte_arr->buf);
+        if (!new_buf) {
+            ESP_LOGE(TAG, "Cannot allocate memory for BSON payload (size: %zu)!", new_capacity);
+            byte_arr->error = ASTARTE_ERR_OUT_OF_MEMORY;
+            return false;
+        }
+        if (byte_arr->size > 0) {
+            memcpy(new_buf, byte_arr->buf, byte_arr->size);
+        }
+        // A borrowed buffer is owned by the caller, once outgrown it is simply left behind
+        if (!byte_arr->borrowed) {
+            free(byte_arr->buf);
+        }
+        byte_arr->capacity = new_capacity;
         byte_arr->buf = new_buf;
+        byte_arr->borrowed = false;
     }
+    return true;
 }
 
+// When the bytes cannot be written the size is still increased, so that it keeps track of the size
+// the document would have.
 static void astarte_byte_array_append_byte(astarte_byte_array *byte_arr, uint8_t byte)
 {
-    astarte_byte_array_grow(byte_arr, sizeof(uint8_t));
-    byte_arr->buf[byte_arr->size] = byte;
+    if (astarte_byte_array_grow(byte_arr, sizeof(uint8_t))) {
+        byte_arr->buf[byte_arr->size] = byte;
+    }
     byte_arr->size++;
 }
 
 static void astarte_byte_array_append(astarte_byte_array *byte_arr, const void *bytes, size_t count)
 {
-    astarte_byte_array_grow(byte_arr, count);
-
-    memcpy(byte_arr->buf + byte_arr->size, bytes, count);
+    if (astarte_byte_array_grow(byte_arr, count)) {
+        memcpy(byte_arr->buf + byte_arr->size, bytes, count);
+    }
     byte_arr->size += count;
 }
 
 static void astarte_byte_array_replace(
     astarte_byte_array *byte_arr, unsigned int pos, size_t count, const uint8_t *bytes)
 {
-    memcpy(byte_arr->buf + pos, bytes, count);
+    if (astarte_byte_array_writable(byte_arr)) {
+        memcpy(byte_arr->buf + pos, bytes, count);
+    }
 }
 
 void astarte_bson_serializer_init(astarte_bson_serializer_handle_t bson)
@@ -144,6 +215,10 @@ astarte_bson_serializer_handle_t astarte_bson_serializer_new(void)
         return NULL;
     }
     astarte_byte_array_init(&bson->ba, "\0\0\0\0", 4);
+    if (bson->ba.error != ASTARTE_OK) {
+        free(bson);
+        return NULL;
+    }
     return bson;
 }
 
@@ -153,14 +228,63 @@ void astarte_bson_serializer_destroy(astarte_bson_serializer_handle_t bson)
     free(bson);
 }
 
+astarte_bson_serializer_handle_t astarte_bson_serializer_init_with_buffer(
+    astarte_bson_serializer_storage_t *storage, void *buf, size_t buf_size)
+{
+    astarte_byte_array_init_borrowed(&storage->ba, buf, buf_size);
+    astarte_byte_array_append(&storage->ba, "\0\0\0\0", 4);
+    return storage;
+}
+
+astarte_bson_serializer_handle_t astarte_bson_serializer_init_fixed(
+    astarte_bson_serializer_storage_t *storage, void *buf, size_t buf_size)
+{
+    astarte_byte_array_init_borrowed(&storage->ba, buf, buf_size);
+    storage->ba.fixed = true;
+    astarte_byte_array_append(&storage->ba, "\0\0\0\0", 4);
+    return storage;
+}
+
+astarte_bson_serializer_handle_t astarte_bson_serializer_init_size_calculator(
+    astarte_bson_serializer_storage_t *storage)
+{
+    astarte_byte_array_init_borrowed(&storage->ba, NULL, 0);
+    storage->ba.count_only = true;
+    astarte_byte_array_append(&storage->ba, "\0\0\0\0", 4);
+    return storage;
+}
+
+void astarte_bson_serializer_deinit(astarte_bson_serializer_handle_t bson)
+{
+    astarte_byte_array_destroy(&bson->ba);
+}
+
+void astarte_bson_serializer_reset(astarte_bson_serializer_handle_t bson)
+{
+    bson->ba.size = 0;
+    // A buffer that could not be allocated is still missing, the error is kept
+    if (bson->ba.buf || bson->ba.count_only) {
+        bson->ba.error = ASTARTE_OK;
+    }
+    astarte_byte_array_append(&bson->ba, "\0\0\0\0", 4);
+}
+
 const void *astarte_bson_serializer_get_document(astarte_bson_serializer_handle_t bson, int *size)
 {
     if (size) {
         *size = (int) bson->ba.size;
     }
+    if (!astarte_byte_array_writable(&bson->ba)) {
+        return NULL;
+    }
     return bson->ba.buf;
 }
 
+astarte_err_t astarte_bson_serializer_get_error(astarte_bson_serializer_handle_t bson)
+{
+    return bson->ba.error;
+}
+
 astarte_err_t astarte_bson_serializer_write_document(
     astarte_bson_serializer_handle_t bson, void *out_buf, int out_buf_len, int *out_doc_size)
 {
@@ -169,7 +293,7 @@ astarte_err_t astarte_bson_serializer_write_document(
         *out_doc_size = (int) doc_size;
     }
 
-    if (out_buf_len < bson->ba.size) {
+    if (!astarte_byte_array_writable(&bson->ba) || (out_buf_len < bson->ba.size)) {
         return ASTARTE_ERR;
     }
 
@@ -285,66 +409,305 @@ void astarte_bson_serializer_append_document(
     astarte_byte_array_append(&bson->ba, document, size);
 }
 
-#define IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(TYPE, TYPE_NAME)                       \
+astarte_bson_serializer_nested_t astarte_bson_serializer_begin_document(
+    astarte_bson_serializer_handle_t bson, const char *name)
+{
+    astarte_bson_serializer_nested_t document
+        = { .start = nested_begin(&bson->ba, BSON_TYPE_DOCUMENT, name, 0U) };
+    return document;
+}
+
+void astarte_bson_serializer_end_document(
+    astarte_bson_serializer_handle_t bson, astarte_bson_serializer_nested_t document)
+{
+    nested_end(&bson->ba, document.start);
+}
+
+astarte_bson_serializer_nested_t astarte_bson_serializer_begin_array(
+    astarte_bson_serializer_handle_t bson, const char *name)
+{
+    astarte_bson_serializer_nested_t array
+        = { .start = nested_begin(&bson->ba, BSON_TYPE_ARRAY, name, 0U) };
+    return array;
+}
+
+void astarte_bson_serializer_end_array(
+    astarte_bson_serializer_handle_t bson, astarte_bson_serializer_nested_t array)
+{
+    nested_end(&bson->ba, array.start);
+}
+
+astarte_err_t astarte_bson_serializer_append_struct(astarte_bson_serializer_handle_t bson,
+    const astarte_bson_struct_field_t *fields, size_t fields_count, const void *value)
+{
+    const uint8_t *members = value;
+    size_t elements_size = 0U;
+    for (size_t i = 0; i < fields_count; i++) {
+        size_t field_size = struct_field_size(&fields[i], members + fields[i].offset);
+        if (field_size == 0U) {
+            ESP_LOGE(TAG, "Invalid struct field: %s", fields[i].name);
+            return ASTARTE_ERR;
+        }
+        elements_size += field_size;
+    }
+
+    if (!astarte_byte_array_grow(&bson->ba, elements_size)) {
+        // Only keep track of the size of the struct
+        bson->ba.size += elements_size;
+        return (bson->ba.error == ASTARTE_OK) ? ASTARTE_OK : ASTARTE_ERR;
+    }
+    for (size_t i = 0; i < fields_count; i++) {
+        struct_append_field(&bson->ba, &fields[i], members + fields[i].offset);
+    }
+
+    return ASTARTE_OK;
+}
+
+#define IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(TYPE, TYPE_NAME, BSON_TYPE)            \
     astarte_err_t astarte_bson_serializer_append_##TYPE_NAME##_array(                              \
-        astarte_bson_serializer_handle_t bson, const char *name, TYPE arr, int count)              \
+        astarte_bson_serializer_handle_t bson, const char *name, const TYPE *arr, int count)       \
     {                                                                                              \
-        astarte_err_t result = ASTARTE_OK;                                                         \
-        astarte_bson_serializer_handle_t array_ser = astarte_bson_serializer_new();                \
-        for (int i = 0; i < count; i++) {                                                          \
-            char key[BSON_ARRAY_SIZE_STR_LEN] = { 0 };                                             \
-            int ret = snprintf(key, BSON_ARRAY_SIZE_STR_LEN, "%i", i);                             \
-            if ((ret < 0) || (ret >= BSON_ARRAY_SIZE_STR_LEN)) {                                   \
-                result = ASTARTE_ERR;                                                              \
-            }                                                                                      \
-            astarte_bson_serializer_append_##TYPE_NAME(array_ser, key, arr[i]);                    \
+        size_t elements = (count > 0) ? (size_t) count : 0U;                                       \
+        size_t elements_size                                                                       \
+            = elements * (sizeof(uint8_t) + sizeof(TYPE)) + array_keys_size(elements);             \
+        size_t doc_start                                                                           \
+            = nested_begin(&bson->ba, BSON_TYPE_ARRAY, name, elements_size);                       \
+        if (!astarte_byte_array_writable(&bson->ba)) {                                             \
+            bson->ba.size += elements_size;                                                        \
+            elements = 0U;                                                                         \
         }                                                                                          \
-        astarte_bson_serializer_append_end_of_document(array_ser);                                 \
-                                                                                                   \
-        int size;                                                                                  \
-        const void *document = astarte_bson_serializer_get_document(array_ser, &size);             \
-                                                                                                   \
-        astarte_byte_array_append_byte(&bson->ba, BSON_TYPE_ARRAY);                                \
-        astarte_byte_array_append(&bson->ba, name, strlen(name) + sizeof(char));                   \
-                                                                                                   \
-        astarte_byte_array_append(&bson->ba, document, size);                                      \
-                                                                                                   \
-        astarte_bson_serializer_destroy(array_ser);                                                \
+        for (size_t i = 0; i < elements; i++) {                                                    \
+            array_append_key(&bson->ba, BSON_TYPE, i);                                             \
+            array_append_le(&bson->ba, &arr[i], sizeof(TYPE));                                     \
+        }                                                                                          \
+        nested_end(&bson->ba, doc_start);                                                          \
                                                                                                    \
-        return result;                                                                             \
+        return (bson->ba.error == ASTARTE_OK) ? ASTARTE_OK : ASTARTE_ERR;                          \
     }
 
-IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(const double *, double)
-IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(const int32_t *, int32)
-IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(const int64_t *, int64)
-IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(const char *const *, string)
-IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(const int64_t *, datetime)
-IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(const bool *, boolean)
+IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(double, double, BSON_TYPE_DOUBLE)
+IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(int32_t, int32, BSON_TYPE_INT32)
+IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(int64_t, int64, BSON_TYPE_INT64)
+IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(int64_t, datetime, BSON_TYPE_DATETIME)
+IMPLEMENT_ASTARTE_BSON_SERIALIZER_APPEND_TYPE_ARRAY(bool, boolean, BSON_TYPE_BOOLEAN)
+
+astarte_err_t astarte_bson_serializer_append_string_array(
+    astarte_bson_serializer_handle_t bson, const char *name, const char *const *arr, int count)
+{
+    size_t elements = (count > 0) ? (size_t) count : 0U;
+    size_t elements_size = array_keys_size(elements);
+    for (size_t i = 0; i < elements; i++) {
+        elements_size += sizeof(uint8_t) + sizeof(int32_t) + strlen(arr[i]) + sizeof(char);
+    }
+
+    size_t doc_start = nested_begin(&bson->ba, BSON_TYPE_ARRAY, name, elements_size);
+    if (!astarte_byte_array_writable(&bson->ba)) {
+        // Only keep track of the size of the array
+        bson->ba.size += elements_size;
+        elements = 0U;
+    }
+    for (size_t i = 0; i < elements; i++) {
+        size_t string_size = strlen(arr[i]) + sizeof(char);
+        array_append_key(&bson->ba, BSON_TYPE_STRING, i);
+        uint32_to_bytes(string_size, bson->ba.buf + bson->ba.size);
+        bson->ba.size += sizeof(int32_t);
+        memcpy(bson->ba.buf + bson->ba.size, arr[i], string_size);
+        bson->ba.size += string_size;
+    }
+    nested_end(&bson->ba, doc_start);
+
+    return (bson->ba.error == ASTARTE_OK) ? ASTARTE_OK : ASTARTE_ERR;
+}
 
 astarte_err_t astarte_bson_serializer_append_binary_array(astarte_bson_serializer_handle_t bson,
     const char *name, const void *const *arr, const int *sizes, int count)
 {
-    astarte_err_t result = ASTARTE_OK;
-    astarte_bson_serializer_handle_t array_ser = astarte_bson_serializer_new();
-    for (int i = 0; i < count; i++) {
-        char key[BSON_ARRAY_SIZE_STR_LEN] = { 0 };
-        int ret = snprintf(key, BSON_ARRAY_SIZE_STR_LEN, "%i", i);
-        if ((ret < 0) || (ret >= BSON_ARRAY_SIZE_STR_LEN)) {
-            result = ASTARTE_ERR;
-        }
-        astarte_bson_serializer_append_binary(array_ser, key, arr[i], sizes[i]);
+    size_t elements = (count > 0) ? (size_t) count : 0U;
+    size_t elements_size = array_keys_size(elements);
+    for (size_t i = 0; i < elements; i++) {
+        elements_size += sizeof(uint8_t) + sizeof(int32_t) + sizeof(uint8_t) + (size_t) sizes[i];
     }
-    astarte_bson_serializer_append_end_of_document(array_ser);
 
-    int size = 0;
-    const void *document = astarte_bson_serializer_get_document(array_ser, &size);
+    size_t doc_start = nested_begin(&bson->ba, BSON_TYPE_ARRAY, name, elements_size);
+    if (!astarte_byte_array_writable(&bson->ba)) {
+        // Only keep track of the size of the array
+        bson->ba.size += elements_size;
+        elements = 0U;
+    }
+    for (size_t i = 0; i < elements; i++) {
+        array_append_key(&bson->ba, BSON_TYPE_BINARY, i);
+        uint32_to_bytes(sizes[i], bson->ba.buf + bson->ba.size);
+        bson->ba.size += sizeof(int32_t);
+        bson->ba.buf[bson->ba.size++] = BSON_SUBTYPE_DEFAULT_BINARY;
+        memcpy(bson->ba.buf + bson->ba.size, arr[i], sizes[i]);
+        bson->ba.size += sizes[i];
+    }
+    nested_end(&bson->ba, doc_start);
 
-    astarte_byte_array_append_byte(&bson->ba, BSON_TYPE_ARRAY);
-    astarte_byte_array_append(&bson->ba, name, strlen(name) + sizeof(char));
+    return (bson->ba.error == ASTARTE_OK) ? ASTARTE_OK : ASTARTE_ERR;
+}
 
-    astarte_byte_array_append(&bson->ba, document, size);
+static size_t array_keys_size(size_t count)
+{
+    // One null terminator for each key, plus one char for each digit of each key
+    size_t size = count;
+    for (size_t i = 0; (i < BSON_ARRAY_KEY_MAX_DIGITS) && (count > array_key_digits_bounds[i]);
+         i++) {
+        size += count - array_key_digits_bounds[i];
+    }
+    return size;
+}
+
+static size_t nested_begin(
+    astarte_byte_array *byte_arr, uint8_t type, const char *name, size_t elements_size)
+{
+    size_t name_size = strlen(name) + sizeof(char);
+    if (astarte_byte_array_grow(byte_arr,
+            sizeof(uint8_t) + name_size + sizeof(int32_t) + elements_size + sizeof(char))) {
+        byte_arr->buf[byte_arr->size] = type;
+        memcpy(byte_arr->buf + byte_arr->size + sizeof(uint8_t), name, name_size);
+    }
+    byte_arr->size += sizeof(uint8_t) + name_size;
+
+    // The length is written by nested_end, once all the elements have been appended
+    size_t doc_start = byte_arr->size;
+    byte_arr->size += sizeof(int32_t);
+    return doc_start;
+}
+
+static void array_append_key(astarte_byte_array *byte_arr, uint8_t type, size_t index)
+{
+    size_t digits = 1;
+    while ((digits < BSON_ARRAY_KEY_MAX_DIGITS) && (index >= array_key_digits_bounds[digits])) {
+        digits++;
+    }
+
+    uint8_t *element = byte_arr->buf + byte_arr->size;
+    element[0] = type;
+    for (size_t i = digits; i > 0; i--) {
+        element[i] = (uint8_t) ('0' + (index % 10));
+        index /= 10;
+    }
+    element[digits + 1] = '\0';
+    byte_arr->size += sizeof(uint8_t) + digits + sizeof(char);
+}
 
-    astarte_bson_serializer_destroy(array_ser);
+static void array_append_le(astarte_byte_array *byte_arr, const void *value, size_t size)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(byte_arr->buf + byte_arr->size, value, size);
+#else
+    for (size_t i = 0; i < size; i++) {
+        byte_arr->buf[byte_arr->size + i] = ((const uint8_t *) value)[size - 1 - i];
+    }
+#endif
+    byte_arr->size += size;
+}
 
-    return result;
+static void nested_end(astarte_byte_array *byte_arr, size_t doc_start)
+{
+    astarte_byte_array_append_byte(byte_arr, '\0');
+
+    uint8_t size_buf[4];
+    uint32_to_bytes(byte_arr->size - doc_start, size_buf);
+    astarte_byte_array_replace(byte_arr, doc_start, sizeof(int32_t), size_buf);
+}
+
+static size_t struct_field_size(const astarte_bson_struct_field_t *field, const uint8_t *member)
+{
+    size_t element_size = sizeof(uint8_t) + field->name_len + sizeof(char);
+    switch (field->type) {
+        case BSON_TYPE_STRING: {
+            size_t string_len = strnlen((const char *) member, field->size);
+            if (string_len == field->size) {
+                // Not null terminated
+                return 0U;
+            }
+            return element_size + sizeof(int32_t) + string_len + sizeof(char);
+        }
+        case BSON_TYPE_BINARY: {
+            return element_size + sizeof(int32_t) + sizeof(uint8_t) + field->size;
+        }
+        case BSON_TYPE_ARRAY: {
+            size_t value_size = struct_value_size(field->element_type);
+            if ((value_size == 0U) || (field->size % value_size != 0U)) {
+                return 0U;
+            }
+            size_t count = field->size / value_size;
+            return element_size + sizeof(int32_t) + count * (sizeof(uint8_t) + value_size)
+                + array_keys_size(count) + sizeof(char);
+        }
+        default: {
+            size_t value_size = struct_value_size(field->type);
+            if ((value_size == 0U) || (value_size != field->size)) {
+                return 0U;
+            }
+            return element_size + value_size;
+        }
+    }
+}
+
+static size_t struct_value_size(uint8_t type)
+{
+    switch (type) {
+        case BSON_TYPE_DOUBLE: {
+            return sizeof(double);
+        }
+        case BSON_TYPE_INT32: {
+            return sizeof(int32_t);
+        }
+        case BSON_TYPE_INT64:
+        case BSON_TYPE_DATETIME: {
+            return sizeof(int64_t);
+        }
+        case BSON_TYPE_BOOLEAN: {
+            return sizeof(bool);
+        }
+        default: {
+            return 0U;
+        }
+    }
+}
+
+static void struct_append_field(
+    astarte_byte_array *byte_arr, const astarte_bson_struct_field_t *field, const uint8_t *member)
+{
+    byte_arr->buf[byte_arr->size++] = field->type;
+    memcpy(byte_arr->buf + byte_arr->size, field->name, field->name_len);
+    byte_arr->size += field->name_len;
+    byte_arr->buf[byte_arr->size++] = '\0';
+
+    switch (field->type) {
+        case BSON_TYPE_STRING: {
+            size_t string_size = strlen((const char *) member) + sizeof(char);
+            uint32_to_bytes(string_size, byte_arr->buf + byte_arr->size);
+            byte_arr->size += sizeof(int32_t);
+            memcpy(byte_arr->buf + byte_arr->size, member, string_size);
+            byte_arr->size += string_size;
+            break;
+        }
+        case BSON_TYPE_BINARY: {
+            uint32_to_bytes(field->size, byte_arr->buf + byte_arr->size);
+            byte_arr->size += sizeof(int32_t);
+            byte_arr->buf[byte_arr->size++] = BSON_SUBTYPE_DEFAULT_BINARY;
+            memcpy(byte_arr->buf + byte_arr->size, member, field->size);
+            byte_arr->size += field->size;
+            break;
+        }
+        case BSON_TYPE_ARRAY: {
+            size_t value_size = struct_value_size(field->element_type);
+            size_t doc_start = byte_arr->size;
+            byte_arr->size += sizeof(int32_t);
+            for (size_t i = 0; i < field->size / value_size; i++) {
+                array_append_key(byte_arr, field->element_type, i);
+                array_append_le(byte_arr, member + i * value_size, value_size);
+            }
+            nested_end(byte_arr, doc_start);
+            break;
+        }
+        default: {
+            array_append_le(byte_arr, member, field->size);
+            break;
+        }
+    }
 }
@@ -9,9 +9,21 @@
 #include <astarte_bson.h>
 #include <astarte_bson_serializer.h>
 #include <astarte_credentials.h>
+#include <astarte_hash.h>
 #include <astarte_hwid.h>
-#include <astarte_linked_list.h>
+#include <astarte_introspection.h>
+#ifdef CONFIG_ASTARTE_USE_OFFLINE_QUEUE
+#include <astarte_offline_queue.h>
+#endif
 #include <astarte_pairing.h>
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+#include <astarte_property_buffer.h>
+#endif
+#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
+#include <astarte_property_cache.h>
+#endif
+#include <astarte_publish_tracker.h>
+#include <astarte_reassembly.h>
 #include <astarte_storage.h>
 #include <astarte_zlib.h>
 
@@ -22,9 +34,15 @@
 #include <esp_crt_bundle.h>
 #endif
 #include <esp_log.h>
+#include <freertos/event_groups.h>
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+#include <freertos/queue.h>
+#endif
 #include <freertos/semphr.h>
 #include <freertos/task.h>
+#include <inttypes.h>
 #include <limits.h>
+#include <stdatomic.h>
 
 #define TAG "ASTARTE_DEVICE"
 
@@ -40,9 +58,33 @@
 #define INTERFACE_LENGTH 512
 #define PATH_LENGTH 512
 #define REINIT_RETRY_INTERVAL_MS (30 * 1000)
+#define PUBLISH_BSON_BUFFER_SIZE CONFIG_ASTARTE_PUBLISH_BSON_BUFFER_SIZE
+// The purge properties payload starts with the big endian length of the uncompressed list
+#define PURGE_PROPERTIES_HEADER_LENGTH 4
+// Each entry of the purge properties list is an interface name followed by a path
+#define PURGE_PROPERTIES_BUFFER_SIZE (INTERFACE_LENGTH + PATH_LENGTH)
+// Interface name and path of an incoming message, each one NULL terminated
+#define TOPIC_VIEWS_BUFFER_SIZE (INTERFACE_LENGTH + PATH_LENGTH)
 
 #define NOTIFY_TERMINATE (1U << 0U)
 #define NOTIFY_REINIT (1U << 1U)
+#define NOTIFY_DRAIN (1U << 2U)
+#define NOTIFY_FLUSH (1U << 3U)
+
+// The device state word counts the tasks using the MQTT client, the highest bit is set while a
+// task has exclusive access to replace the client or modify the introspection
+#define STATE_EXCLUSIVE (1U << 31U)
+#define STATE_USERS_MASK (~STATE_EXCLUSIVE)
+#define STATE_EVENT_READY (1U << 0U)
+#define STATE_EVENT_DRAINED (1U << 1U)
+#define DEVICE_READY_TIMEOUT_TICKS pdMS_TO_TICKS(CONFIG_ASTARTE_DEVICE_READY_TIMEOUT_MS)
+
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+#define DISPATCHER_QUEUE_LENGTH CONFIG_ASTARTE_DISPATCHER_QUEUE_LENGTH
+#define DISPATCHER_SLOT_SIZE CONFIG_ASTARTE_DISPATCHER_SLOT_SIZE
+// Slot index of the frame stopping the dispatcher task, it is queued after the pending frames
+#define DISPATCHER_TERMINATE_SLOT UINT16_MAX
+#endif
 
 struct astarte_device
 {
@@ -54,44 +96,213 @@ struct astarte_device
     char *key_pem;
     bool connected;
     astarte_device_data_event_callback_t data_event_callback;
+    astarte_device_data_view_event_callback_t data_view_event_callback;
     astarte_device_unset_event_callback_t unset_event_callback;
     astarte_device_connection_event_callback_t connection_event_callback;
     astarte_device_disconnection_event_callback_t disconnection_event_callback;
     void *callbacks_user_data;
     esp_mqtt_client_handle_t mqtt_client;
+    // Set by the MQTT event handler, the task of the client is not exposed by the MQTT library
+    TaskHandle_t mqtt_task_handle;
     TaskHandle_t reinit_task_handle;
-    SemaphoreHandle_t reinit_mutex;
-    astarte_linked_list_handle_t introspection;
+    atomic_uint state;
+    EventGroupHandle_t state_events;
+    SemaphoreHandle_t exclusive_mutex;
+    astarte_introspection_t introspection;
+    // The MQTT event handler runs without shared access, so that the client can be destroyed while
+    // holding exclusive access. It takes this mutex instead, after the exclusive access when both
+    // are needed. It is recursive since the callbacks can look up interfaces by name.
+    SemaphoreHandle_t introspection_mutex;
+    astarte_publish_tracker_t publish_tracker;
+    SemaphoreHandle_t publish_tracker_mutex;
+    SemaphoreHandle_t publish_slots;
+    // Only used by the MQTT event handler, when receiving messages split in several fragments
+    astarte_reassembly_t reassembly;
+    astarte_bson_parser_t stream_parser;
+    // Interface name and path of the message being streamed, NULL when no message is streamed
+    char *stream_topic;
+    const char *stream_path;
+    char stream_topic_buffer[TOPIC_VIEWS_BUFFER_SIZE];
+    // Only used by the task handling the incoming messages, the MQTT task or the dispatcher task
+    char incoming_topic[TOPIC_VIEWS_BUFFER_SIZE];
+    astarte_device_stream_event_callback_t stream_callback;
+    void *stream_user_data;
+#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
+    astarte_property_cache_t property_cache;
+    SemaphoreHandle_t property_mutex;
+    astarte_storage_handle_t storage_handle;
+    bool storage_opened;
+    // Used when sending and receiving the purge properties, the MQTT task and the dispatcher task
+    // hold the mutex from the first use of the context until it is released
+    astarte_zlib_context_t zlib_context;
+    SemaphoreHandle_t zlib_mutex;
+#endif
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+    astarte_property_buffer_t property_buffer;
+    TaskHandle_t property_writer_task_handle;
+    SemaphoreHandle_t property_writer_task_exit;
+#endif
+#ifdef CONFIG_ASTARTE_USE_OFFLINE_QUEUE
+    astarte_offline_queue_t offline_queue;
+    TaskHandle_t offline_queue_task_handle;
+    SemaphoreHandle_t offline_queue_task_exit;
+#endif
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+    // Incoming messages are copied by the MQTT task in the slots and handled by the dispatcher
+    uint8_t *dispatcher_slots;
+    QueueHandle_t dispatcher_free_slots;
+    QueueHandle_t dispatcher_frames;
+    TaskHandle_t dispatcher_task_handle;
+    SemaphoreHandle_t dispatcher_task_exit;
+    atomic_uint dispatcher_max_queued;
+    atomic_uint dispatcher_dispatched;
+    atomic_uint dispatcher_dropped;
+    atomic_uint dispatcher_oversized;
+#endif
     char *realm;
 };
 
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+// Incoming message stored in a dispatcher slot, the topic is followed by the data. Messages larger
+// than a slot are copied to the heap and the slot holds a pointer to the copy.
+typedef struct
+{
+    uint16_t slot;
+    uint16_t topic_len;
+    int data_len;
+    bool has_data;
+    bool by_reference;
+} dispatcher_frame_t;
+#endif
+
+#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
+// Stored server owned property that is deleted unless listed in a purge properties message
+typedef struct
+{
+    uint32_t name_hash;
+    // Interface name followed by the path, not NULL terminated
+    char *name;
+    size_t name_len;
+    bool listed;
+} purge_candidate_t;
+
+typedef struct
+{
+    // Sorted by name hash, candidates with the same hash are compared by name
+    purge_candidate_t *candidates;
+    size_t count;
+    size_t capacity;
+    size_t listed_entries;
+} purge_candidates_t;
+#endif
+
+static astarte_err_t acquire_shared(astarte_device_handle_t device, TickType_t timeout);
+static void release_shared(astarte_device_handle_t device);
+static astarte_err_t acquire_shared_state(astarte_device_handle_t device, TickType_t timeout);
+static void release_shared_state(astarte_device_handle_t device);
+static void acquire_exclusive(astarte_device_handle_t device);
+static void release_exclusive(astarte_device_handle_t device);
 static void astarte_device_reinit_task(void *ctx);
+#ifdef CONFIG_ASTARTE_USE_OFFLINE_QUEUE
+static void astarte_device_offline_queue_task(void *ctx);
+static void stop_offline_queue_task(astarte_device_handle_t device);
+static bool drain_offline_queue(astarte_device_handle_t device, char *topic, uint8_t *data);
+#endif
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+static astarte_err_t init_dispatcher(astarte_device_handle_t device);
+static void astarte_device_dispatcher_task(void *ctx);
+static void stop_dispatcher_task(astarte_device_handle_t device);
+static void release_dispatcher(astarte_device_handle_t device);
+static uint8_t *get_frame_message(astarte_device_handle_t device, const dispatcher_frame_t *frame);
+static void enqueue_incoming(
+    astarte_device_handle_t device, char *topic, int topic_len, char *data, int data_len);
+#endif
+static bool in_dispatcher_task(astarte_device_handle_t device);
+static bool in_callback_task(astarte_device_handle_t device);
+static bool use_offline_queue(astarte_device_interface_handle_t interface);
+static astarte_err_t enqueue_offline(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *topic, const void *data, int length,
+    int qos);
+static astarte_err_t enqueue_offline_unavailable(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const void *data, int length,
+    int qos);
 static astarte_err_t astarte_device_init_connection(
     astarte_device_handle_t device, const char *encoded_hwid, const char *realm);
 static astarte_err_t retrieve_credentials(astarte_pairing_config_t *pairing_config);
+#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
+static astarte_err_t store_property(astarte_device_handle_t device, const char *interface_name,
+    const char *path, int32_t major, const void *data, size_t data_len, bool *changed);
+static astarte_err_t delete_property(
+    astarte_device_handle_t device, const char *interface_name, const char *path);
+static astarte_err_t open_storage(astarte_device_handle_t device);
+static astarte_err_t write_property(astarte_device_handle_t device, const char *interface_name,
+    const char *path, int32_t major, const void *data, size_t data_len);
+#endif
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+static void astarte_device_property_writer_task(void *ctx);
+static void stop_property_writer_task(astarte_device_handle_t device);
+static void flush_properties(astarte_device_handle_t device, bool force);
+#endif
 static astarte_err_t check_device(astarte_device_handle_t device);
-static astarte_err_t publish_bson(astarte_device_handle_t device, const char *interface_name,
-    const char *path, astarte_bson_serializer_handle_t bson, int qos);
-static astarte_err_t publish_data(astarte_device_handle_t device, const char *interface_name,
-    const char *path, const void *data, int length, int qos);
+static astarte_err_t publish_bson(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path,
+    astarte_bson_serializer_handle_t bson, int qos);
+static astarte_err_t publish_data(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const void *data, int length,
+    int qos);
+static astarte_err_t build_topic(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, char *topic);
+static uint32_t get_time_ms(void);
+static void complete_publish(astarte_device_handle_t device,
+    const astarte_publish_tracker_entry_t *entry, astarte_device_publish_result_t result);
+static void expire_publishes(astarte_device_handle_t device);
+static astarte_device_interface_handle_t get_interface_handle(astarte_device_handle_t device,
+    const char *interface_name, struct astarte_device_interface *unregistered);
 static void setup_subscriptions(astarte_device_handle_t device);
 static void send_introspection(astarte_device_handle_t device);
 static void send_emptycache(astarte_device_handle_t device);
 #ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
 static void send_device_owned_properties(astarte_device_handle_t device);
+static int append_purge_device_property(
+    astarte_zlib_compressor_t *compressor, const char *interface_name, const char *path);
 static void send_purge_device_properties(
-    astarte_device_handle_t device, astarte_linked_list_handle_t *list_handle);
+    astarte_device_handle_t device, astarte_zlib_compressor_t *compressor);
 #endif
 static void on_connected(astarte_device_handle_t device, int session_present);
 static void on_disconnected(astarte_device_handle_t device);
+static void on_published(
+    astarte_device_handle_t device, int msg_id, astarte_device_publish_result_t result);
+static void on_data(astarte_device_handle_t device, esp_mqtt_event_handle_t event);
+static bool start_stream(astarte_device_handle_t device, const char *topic, int topic_len);
+static void feed_stream(astarte_device_handle_t device, esp_mqtt_event_handle_t event);
+static void stop_stream(astarte_device_handle_t device, bool dropped);
+static astarte_err_t on_stream_event(const astarte_bson_parser_event_t *bson_event, void *ctx);
+static void handle_incoming(
+    astarte_device_handle_t device, char *topic, int topic_len, char *data, int data_len);
 static void on_incoming(
     astarte_device_handle_t device, char *topic, int topic_len, char *data, int data_len);
-static void on_control_message(
-    astarte_device_handle_t device, char *control_topic, char *data, int data_len);
+static void on_control_message(astarte_device_handle_t device, const char *control_topic,
+    size_t control_topic_len, char *data, int data_len);
+static void on_unset(astarte_device_handle_t device, const char *interface_name,
+    size_t interface_name_len, const char *path, size_t path_len);
+static void dispatch_data_event(astarte_device_handle_t device, const char *interface_name,
+    size_t interface_name_len, const char *path, size_t path_len, char *data,
+    astarte_bson_element_t v_elem);
+static bool join_topic_views(char *joined, const char *interface_name, size_t interface_name_len,
+    const char *path, size_t path_len);
 #ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
 static void on_purge_properties(astarte_device_handle_t device, char *data, int data_len);
-static astarte_err_t uncompress_purge_properties(
-    char *data, int data_len, char **output, uLongf *output_len);
+static astarte_err_t collect_purge_candidates(astarte_device_handle_t device,
+    astarte_storage_scratch_t *scratch, purge_candidates_t *purge_candidates);
+static astarte_err_t uncompress_purge_properties(astarte_device_handle_t device, char *data,
+    int data_len, purge_candidates_t *purge_candidates);
+static void on_purge_properties_entry(const char *entry, size_t entry_len, void *user_data);
+static purge_candidate_t *find_purge_candidate(purge_candidates_t *purge_candidates,
+    const char *interface_name, size_t interface_name_len, const char *path, size_t path_len);
+static void destroy_purge_candidates(purge_candidates_t *purge_candidates);
+static int compare_purge_candidates(const void *a, const void *b);
+static uint32_t hash_property_name(
+    const char *interface_name, size_t interface_name_len, const char *path, size_t path_len);
 #endif
 static void on_certificate_error(astarte_device_handle_t device);
 static void mqtt_event_handler(
@@ -111,12 +322,78 @@ astarte_device_handle_t astarte_device_init(astarte_device_config_t *cfg)
         return NULL;
     }
 
-    ret->reinit_mutex = xSemaphoreCreateMutex();
-    if (!ret->reinit_mutex) {
-        ESP_LOGE(TAG, "Cannot create reinit_mutex");
+    astarte_err_t res = astarte_introspection_init(&ret->introspection);
+    if (res != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Cannot initialize the device introspection");
+        goto init_failed;
+    }
+
+    atomic_init(&ret->state, 0U);
+    ret->state_events = xEventGroupCreate();
+    if (!ret->state_events) {
+        ESP_LOGE(TAG, "Cannot create state_events");
+        goto init_failed;
+    }
+    xEventGroupSetBits(ret->state_events, STATE_EVENT_READY);
+
+    ret->exclusive_mutex = xSemaphoreCreateMutex();
+    if (!ret->exclusive_mutex) {
+        ESP_LOGE(TAG, "Cannot create exclusive_mutex");
+        goto init_failed;
+    }
+
+    ret->introspection_mutex = xSemaphoreCreateRecursiveMutex();
+    if (!ret->introspection_mutex) {
+        ESP_LOGE(TAG, "Cannot create introspection_mutex");
+        goto init_failed;
+    }
+
+    res = astarte_publish_tracker_init(
+        &ret->publish_tracker, CONFIG_ASTARTE_PUBLISH_ASYNC_MAX_IN_FLIGHT);
+    if (res != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Cannot initialize the publish tracker");
+        goto init_failed;
+    }
+
+    ret->publish_tracker_mutex = xSemaphoreCreateMutex();
+    if (!ret->publish_tracker_mutex) {
+        ESP_LOGE(TAG, "Cannot create publish_tracker_mutex");
+        goto init_failed;
+    }
+
+    ret->publish_slots = xSemaphoreCreateCounting(
+        CONFIG_ASTARTE_PUBLISH_ASYNC_MAX_IN_FLIGHT, CONFIG_ASTARTE_PUBLISH_ASYNC_MAX_IN_FLIGHT);
+    if (!ret->publish_slots) {
+        ESP_LOGE(TAG, "Cannot create publish_slots");
+        goto init_failed;
+    }
+
+    astarte_reassembly_init(&ret->reassembly, CONFIG_ASTARTE_INCOMING_MAX_MESSAGE_SIZE);
+
+#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
+    res = astarte_property_cache_init(&ret->property_cache, CONFIG_ASTARTE_PROPERTY_CACHE_SIZE,
+        CONFIG_ASTARTE_PROPERTY_CACHE_MAX_VALUE_SIZE);
+    if (res != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Cannot initialize the property cache");
+        goto init_failed;
+    }
+
+    ret->property_mutex = xSemaphoreCreateMutex();
+    if (!ret->property_mutex) {
+        ESP_LOGE(TAG, "Cannot create property_mutex");
         goto init_failed;
     }
 
+    ret->zlib_mutex = xSemaphoreCreateMutex();
+    if (!ret->zlib_mutex) {
+        ESP_LOGE(TAG, "Cannot create zlib_mutex");
+        goto init_failed;
+    }
+
+    astarte_zlib_context_init(&ret->zlib_context, CONFIG_ASTARTE_PURGE_PROPERTIES_ZLIB_WINDOW_BITS,
+        CONFIG_ASTARTE_PURGE_PROPERTIES_ZLIB_MEM_LEVEL);
+#endif
+
     const configSTACK_DEPTH_TYPE stack_depth = 6000;
     xTaskCreate(astarte_device_reinit_task, "astarte_device_reinit_task", stack_depth, ret,
         tskIDLE_PRIORITY, &ret->reinit_task_handle);
@@ -125,6 +402,58 @@ astarte_device_handle_t astarte_device_init(astarte_device_config_t *cfg)
         goto init_failed;
     }
 
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+    res = astarte_property_buffer_init(
+        &ret->property_buffer, CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND_CAPACITY);
+    if (res != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Cannot initialize the property buffer");
+        goto init_failed;
+    }
+
+    ret->property_writer_task_exit = xSemaphoreCreateBinary();
+    if (!ret->property_writer_task_exit) {
+        ESP_LOGE(TAG, "Cannot create property_writer_task_exit");
+        goto init_failed;
+    }
+
+    xTaskCreate(astarte_device_property_writer_task, "astarte_device_property_writer_task",
+        stack_depth, ret, tskIDLE_PRIORITY, &ret->property_writer_task_handle);
+    if (!ret->property_writer_task_handle) {
+        ESP_LOGE(TAG, "Cannot start astarte_device_property_writer_task");
+        goto init_failed;
+    }
+#endif
+
+#ifdef CONFIG_ASTARTE_USE_OFFLINE_QUEUE
+    res = astarte_offline_queue_open(
+        &ret->offline_queue, CONFIG_ASTARTE_OFFLINE_QUEUE_PARTITION_LABEL);
+    if (res != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Cannot open the offline queue");
+        goto init_failed;
+    }
+
+    ret->offline_queue_task_exit = xSemaphoreCreateBinary();
+    if (!ret->offline_queue_task_exit) {
+        ESP_LOGE(TAG, "Cannot create offline_queue_task_exit");
+        goto init_failed;
+    }
+
+    xTaskCreate(astarte_device_offline_queue_task, "astarte_device_offline_queue_task",
+        stack_depth, ret, tskIDLE_PRIORITY, &ret->offline_queue_task_handle);
+    if (!ret->offline_queue_task_handle) {
+        ESP_LOGE(TAG, "Cannot start astarte_device_offline_queue_task");
+        goto init_failed;
+    }
+#endif
+
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+    res = init_dispatcher(ret);
+    if (res != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Cannot initialize the dispatcher");
+        goto init_failed;
+    }
+#endif
+
     const char *encoded_hwid = NULL;
     if (cfg->hwid) {
         encoded_hwid = cfg->hwid;
@@ -157,7 +486,7 @@ astarte_device_handle_t astarte_device_init(astarte_device_config_t *cfg)
         realm = CONFIG_ASTARTE_REALM;
     }
 
-    astarte_err_t res = astarte_device_init_connection(ret, encoded_hwid, realm);
+    res = astarte_device_init_connection(ret, encoded_hwid, realm);
     if (res != ASTARTE_OK) {
         ESP_LOGE(TAG, "Cannot init Astarte device: %d", res);
         goto init_failed;
@@ -175,8 +504,8 @@ astarte_device_handle_t astarte_device_init(astarte_device_config_t *cfg)
         goto init_failed;
     }
 
-    ret->introspection = astarte_linked_list_init();
     ret->data_event_callback = cfg->data_event_callback;
+    ret->data_view_event_callback = cfg->data_view_event_callback;
     ret->unset_event_callback = cfg->unset_event_callback;
     ret->connection_event_callback = cfg->connection_event_callback;
     ret->disconnection_event_callback = cfg->disconnection_event_callback;
@@ -189,14 +518,57 @@ init_failed:
         free(ret->credentials_secret);
     }
 
-    if (ret->reinit_mutex) {
-        vSemaphoreDelete(ret->reinit_mutex);
+    if (ret->state_events) {
+        vEventGroupDelete(ret->state_events);
+    }
+
+    if (ret->exclusive_mutex) {
+        vSemaphoreDelete(ret->exclusive_mutex);
+    }
+
+    if (ret->introspection_mutex) {
+        vSemaphoreDelete(ret->introspection_mutex);
+    }
+
+    if (ret->publish_tracker_mutex) {
+        vSemaphoreDelete(ret->publish_tracker_mutex);
+    }
+
+    if (ret->publish_slots) {
+        vSemaphoreDelete(ret->publish_slots);
     }
 
     if (ret->reinit_task_handle) {
         xTaskNotify(ret->reinit_task_handle, NOTIFY_TERMINATE, eSetBits);
     }
 
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+    stop_dispatcher_task(ret);
+    release_dispatcher(ret);
+#endif
+
+#ifdef CONFIG_ASTARTE_USE_OFFLINE_QUEUE
+    stop_offline_queue_task(ret);
+    astarte_offline_queue_close(&ret->offline_queue);
+#endif
+
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+    stop_property_writer_task(ret);
+    astarte_property_buffer_destroy(&ret->property_buffer);
+#endif
+
+#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
+    if (ret->property_mutex) {
+        vSemaphoreDelete(ret->property_mutex);
+    }
+    if (ret->zlib_mutex) {
+        vSemaphoreDelete(ret->zlib_mutex);
+    }
+    astarte_property_cache_destroy(&ret->property_cache);
+#endif
+
+    astarte_publish_tracker_destroy(&ret->publish_tracker);
+    astarte_introspection_destroy(&ret->introspection);
     free(ret->encoded_hwid);
     free(ret->realm);
     free(ret);
@@ -219,16 +591,20 @@ static void astarte_device_reinit_task(void *ctx)
             // Terminate the task
             vTaskDelete(NULL);
         } else if (notification_value & NOTIFY_REINIT) {
-            xSemaphoreTake(device->reinit_mutex, portMAX_DELAY);
             ESP_LOGI(TAG, "Reinitializing the device");
             // Delete the old certificate
             astarte_credentials_delete_certificate();
-            // Retry until we succeed
-            bool reinitialized = true;
-
+            // Retry until we succeed, the exclusive access is released between attempts so that
+            // publishers waiting for the device are not held for the whole retry interval
             while (1) {
+                acquire_exclusive(device);
                 astarte_err_t res
                     = astarte_device_init_connection(device, device->encoded_hwid, device->realm);
+                if (res == ASTARTE_OK) {
+                    ESP_LOGI(TAG, "Device reinitialized, starting it again");
+                    esp_mqtt_client_start(device->mqtt_client);
+                }
+                release_exclusive(device);
                 if (res == ASTARTE_OK) {
                     break;
                 }
@@ -237,7 +613,12 @@ static void astarte_device_reinit_task(void *ctx)
                     "Cannot reinit Astarte device: %d, trying again in %d "
                     "milliseconds",
                     res, REINIT_RETRY_INTERVAL_MS);
-                vTaskDelay(REINIT_RETRY_INTERVAL_MS / portTICK_PERIOD_MS);
+                // The device can be destroyed while waiting, since the access is not exclusive
+                notification_value
+                    = ulTaskNotifyTake(pdTRUE, REINIT_RETRY_INTERVAL_MS / portTICK_PERIOD_MS);
+                if (notification_value & NOTIFY_TERMINATE) {
+                    vTaskDelete(NULL);
+                }
 
                 // We check if the device got connected again. If it has, then we
                 // can break away from the reinit process, since it was a false positive.
@@ -245,140 +626,540 @@ static void astarte_device_reinit_task(void *ctx)
                 // the next time it boots.
                 if (device->connected) {
                     ESP_LOGI(TAG, "Device reconnected, skipping device reinitialization");
-                    reinitialized = false;
                     break;
                 }
             }
-
-            if (reinitialized) {
-                ESP_LOGI(TAG, "Device reinitialized, starting it again");
-                esp_mqtt_client_start(device->mqtt_client);
-            }
-
-            xSemaphoreGive(device->reinit_mutex);
         }
     }
 }
 
-astarte_err_t astarte_device_init_connection(
-    astarte_device_handle_t device, const char *encoded_hwid, const char *realm)
+static astarte_err_t acquire_shared(astarte_device_handle_t device, TickType_t timeout)
 {
-    if (!astarte_credentials_is_initialized()) {
-        // TODO: this should be manually called from main before initializing the device,
-        // but we just print a warning to maintain backwards compatibility for now
-        ESP_LOGW(TAG,
-            "You should manually call astarte_credentials_init before calling "
-            "astarte_device_init");
-        astarte_err_t err = astarte_credentials_init();
-        if (err != ASTARTE_OK) {
-            ESP_LOGE(TAG, "Error in astarte_credentials_init");
-            return err;
-        }
+    if (in_dispatcher_task(device)) {
+        // The callbacks run with the shared access of the dispatcher task, acquiring it again
+        // would wait behind a task waiting for exclusive access, which waits for the dispatcher
+        return ASTARTE_OK;
     }
+    return acquire_shared_state(device, timeout);
+}
 
-    // If the device was already initialized, we free some resources first
-    if (device->mqtt_client) {
-        esp_mqtt_client_destroy(device->mqtt_client);
+static void release_shared(astarte_device_handle_t device)
+{
+    if (!in_dispatcher_task(device)) {
+        release_shared_state(device);
     }
+}
 
-    if (device->device_topic) {
-        free(device->device_topic);
+static astarte_err_t acquire_shared_state(astarte_device_handle_t device, TickType_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+    unsigned int state = atomic_load(&device->state);
+    while (1) {
+        if (!(state & STATE_EXCLUSIVE)) {
+            // Concurrent users only contend on the state word, a failed exchange reloads it
+            if (atomic_compare_exchange_weak(&device->state, &state, state + 1U)) {
+                return ASTARTE_OK;
+            }
+            continue;
+        }
+        // Queue behind the task with exclusive access, the ready event is set when it is done
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            return ASTARTE_ERR_DEVICE_NOT_READY;
+        }
+        xEventGroupWaitBits(
+            device->state_events, STATE_EVENT_READY, pdFALSE, pdTRUE, timeout - elapsed);
+        state = atomic_load(&device->state);
     }
+}
 
-    if (device->client_cert_pem) {
-        free(device->client_cert_pem);
+static void release_shared_state(astarte_device_handle_t device)
+{
+    unsigned int state = atomic_fetch_sub(&device->state, 1U);
+    if (state == (STATE_EXCLUSIVE | 1U)) {
+        // Last user leaving while a task is waiting for exclusive access
+        xEventGroupSetBits(device->state_events, STATE_EVENT_DRAINED);
     }
+}
 
-    if (device->key_pem) {
-        free(device->key_pem);
+static void acquire_exclusive(astarte_device_handle_t device)
+{
+    xSemaphoreTake(device->exclusive_mutex, portMAX_DELAY);
+    // The ready event is cleared before setting the flag, so new users always find it cleared
+    xEventGroupClearBits(device->state_events, STATE_EVENT_READY | STATE_EVENT_DRAINED);
+    atomic_fetch_or(&device->state, STATE_EXCLUSIVE);
+    while (atomic_load(&device->state) & STATE_USERS_MASK) {
+        xEventGroupWaitBits(
+            device->state_events, STATE_EVENT_DRAINED, pdTRUE, pdTRUE, portMAX_DELAY);
     }
+}
 
-    astarte_pairing_config_t pairing_config = {
-        .base_url = CONFIG_ASTARTE_PAIRING_BASE_URL,
-        .jwt = CONFIG_ASTARTE_PAIRING_JWT,
-        .realm = realm,
-        .hw_id = encoded_hwid,
-    };
+static void release_exclusive(astarte_device_handle_t device)
+{
+    atomic_fetch_and(&device->state, STATE_USERS_MASK);
+    xEventGroupSetBits(device->state_events, STATE_EVENT_READY);
+    xSemaphoreGive(device->exclusive_mutex);
+}
 
-    if (device->credentials_secret) {
-        pairing_config.credentials_secret = device->credentials_secret;
+#ifdef CONFIG_ASTARTE_USE_OFFLINE_QUEUE
+static void astarte_device_offline_queue_task(void *ctx)
+{
+    // This task publishes the messages stored in the offline queue. It's woken up on each
+    // connection and publishes a batch of messages every drain interval until the queue is
+    // empty, leaving room on the connection for the live messages.
+
+    astarte_device_handle_t device = (astarte_device_handle_t) ctx;
+    char topic[TOPIC_LENGTH];
+
+    while (1) {
+        uint32_t notification_value = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if ((notification_value & NOTIFY_DRAIN) && !(notification_value & NOTIFY_TERMINATE)) {
+            uint8_t *data = malloc(ASTARTE_OFFLINE_QUEUE_MAX_MESSAGE_SIZE);
+            if (!data) {
+                ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+                continue;
+            }
+            ESP_LOGI(TAG, "Publishing %zu messages from the offline queue",
+                astarte_offline_queue_count(&device->offline_queue));
+            while (drain_offline_queue(device, topic, data)) {
+                notification_value |= ulTaskNotifyTake(
+                    pdTRUE, pdMS_TO_TICKS(CONFIG_ASTARTE_OFFLINE_QUEUE_DRAIN_INTERVAL_MS));
+                if (notification_value & NOTIFY_TERMINATE) {
+                    break;
+                }
+            }
+            free(data);
+        }
+        if (notification_value & NOTIFY_TERMINATE) {
+            // Terminate the task
+            xSemaphoreGive(device->offline_queue_task_exit);
+            vTaskDelete(NULL);
+        }
     }
+}
 
-    char credentials_secret[CREDENTIALS_SECRET_LENGTH] = { 0 };
-    astarte_err_t err = astarte_pairing_get_credentials_secret(
-        &pairing_config, credentials_secret, CREDENTIALS_SECRET_LENGTH);
-    if (err != ASTARTE_OK) {
-        ESP_LOGE(TAG, "Error in get_credentials_secret");
-        return err;
+static void stop_offline_queue_task(astarte_device_handle_t device)
+{
+    if (device->offline_queue_task_handle) {
+        xTaskNotify(device->offline_queue_task_handle, NOTIFY_TERMINATE, eSetBits);
+        xSemaphoreTake(device->offline_queue_task_exit, portMAX_DELAY);
+        device->offline_queue_task_handle = NULL;
     }
-    ESP_LOGD(TAG, "credentials_secret is: %s", credentials_secret);
+    if (device->offline_queue_task_exit) {
+        vSemaphoreDelete(device->offline_queue_task_exit);
+        device->offline_queue_task_exit = NULL;
+    }
+}
 
-    char *client_cert_pem = NULL;
-    char *client_cert_cn = NULL;
-    char *key_pem = NULL;
+static bool drain_offline_queue(astarte_device_handle_t device, char *topic, uint8_t *data)
+{
+    for (int i = 0; i < CONFIG_ASTARTE_OFFLINE_QUEUE_DRAIN_BATCH; i++) {
+        size_t data_len = ASTARTE_OFFLINE_QUEUE_MAX_MESSAGE_SIZE;
+        int qos = 0;
+        astarte_err_t err = astarte_offline_queue_peek(
+            &device->offline_queue, topic, TOPIC_LENGTH, data, &data_len, &qos);
+        if (err == ASTARTE_ERR_NOT_FOUND) {
+            ESP_LOGI(TAG, "Offline queue empty");
+            return false;
+        }
+        if (err != ASTARTE_OK) {
+            ESP_LOGE(TAG, "Cannot read the offline queue: %s", astarte_err_to_name(err));
+            return false;
+        }
 
-    if (!astarte_credentials_has_certificate()) {
-        err = retrieve_credentials(&pairing_config);
+        // Stop on disconnections, the queue will be drained again on the next connection
+        if (!device->connected || (acquire_shared(device, 0) != ASTARTE_OK)) {
+            return false;
+        }
+        // Messages queued during a reinitialization have a topic relative to the device topic
+        const char *publish_topic = topic;
+        char full_topic[TOPIC_LENGTH];
+        if (topic[0] == '/') {
+            int len = snprintf(full_topic, TOPIC_LENGTH, "%s%s", device->device_topic, topic);
+            if ((len < 0) || (len >= TOPIC_LENGTH)) {
+                release_shared(device);
+                ESP_LOGE(TAG, "Error encoding topic, discarding queued message on %s", topic);
+                if (astarte_offline_queue_pop(&device->offline_queue) != ASTARTE_OK) {
+                    return false;
+                }
+                continue;
+            }
+            publish_topic = full_topic;
+        }
+        ESP_LOGD(TAG, "Publishing queued message on %s with QoS %d", publish_topic, qos);
+        int ret = esp_mqtt_client_publish(
+            device->mqtt_client, publish_topic, (const char *) data, (int) data_len, qos, 0);
+        release_shared(device);
+        if (ret < 0) {
+            ESP_LOGW(TAG, "Publish of queued message on %s failed", publish_topic);
+            return false;
+        }
+
+        err = astarte_offline_queue_pop(&device->offline_queue);
         if (err != ASTARTE_OK) {
-            ESP_LOGE(TAG, "Could not retrieve credentials");
-            goto init_failed;
+            ESP_LOGE(TAG, "Cannot remove a message from the offline queue");
+            return false;
         }
     }
+    return true;
+}
+#endif
 
-    key_pem = calloc(PRIVKEY_LENGTH, sizeof(char));
-    if (!key_pem) {
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+static astarte_err_t init_dispatcher(astarte_device_handle_t device)
+{
+    atomic_init(&device->dispatcher_max_queued, 0U);
+    atomic_init(&device->dispatcher_dispatched, 0U);
+    atomic_init(&device->dispatcher_dropped, 0U);
+    atomic_init(&device->dispatcher_oversized, 0U);
+
+    device->dispatcher_slots = malloc(DISPATCHER_QUEUE_LENGTH * DISPATCHER_SLOT_SIZE);
+    if (!device->dispatcher_slots) {
         ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
-        goto init_failed;
-    }
-    err = astarte_credentials_get_key(key_pem, PRIVKEY_LENGTH);
-    if (err != ASTARTE_OK) {
-        ESP_LOGE(TAG, "Error in get_key");
-        goto init_failed;
-    } else {
-        ESP_LOGD(TAG, "Key is: %s", key_pem);
+        return ASTARTE_ERR_OUT_OF_MEMORY;
     }
 
-    client_cert_pem = calloc(CERT_LENGTH, sizeof(char));
-    if (!client_cert_pem) {
-        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
-        goto init_failed;
+    device->dispatcher_free_slots = xQueueCreate(DISPATCHER_QUEUE_LENGTH, sizeof(uint16_t));
+    if (!device->dispatcher_free_slots) {
+        ESP_LOGE(TAG, "Cannot create dispatcher_free_slots");
+        return ASTARTE_ERR;
     }
-    err = astarte_credentials_get_certificate(client_cert_pem, CERT_LENGTH);
-    if (err != ASTARTE_OK) {
-        ESP_LOGE(TAG, "Error in get_certificate");
-        goto init_failed;
-    } else {
-        ESP_LOGD(TAG, "Certificate is: %s", client_cert_pem);
+    for (uint16_t slot = 0; slot < DISPATCHER_QUEUE_LENGTH; slot++) {
+        xQueueSend(device->dispatcher_free_slots, &slot, 0);
     }
 
-    client_cert_cn = calloc(CN_LENGTH, sizeof(char));
-    if (!client_cert_cn) {
-        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
-        goto init_failed;
+    // One more frame than the slots, so that the terminate frame always fits
+    device->dispatcher_frames
+        = xQueueCreate(DISPATCHER_QUEUE_LENGTH + 1, sizeof(dispatcher_frame_t));
+    if (!device->dispatcher_frames) {
+        ESP_LOGE(TAG, "Cannot create dispatcher_frames");
+        return ASTARTE_ERR;
     }
-    err = astarte_credentials_get_certificate_common_name(
-        client_cert_pem, client_cert_cn, CN_LENGTH);
-    if (err != ASTARTE_OK) {
-        ESP_LOGE(TAG, "Error in get_certificate_common_name");
-        goto init_failed;
-    } else {
-        ESP_LOGD(TAG, "Device topic is: %s", client_cert_cn);
+
+    device->dispatcher_task_exit = xSemaphoreCreateBinary();
+    if (!device->dispatcher_task_exit) {
+        ESP_LOGE(TAG, "Cannot create dispatcher_task_exit");
+        return ASTARTE_ERR;
     }
 
-    char broker_url[URL_LENGTH] = { 0 };
-    err = astarte_pairing_get_mqtt_v1_broker_url(&pairing_config, broker_url, URL_LENGTH);
-    if (err != ASTARTE_OK) {
-        ESP_LOGE(TAG, "Error in get_mqtt_v1_broker_url");
-        goto init_failed;
-    } else {
-        ESP_LOGD(TAG, "Broker URL is: %s", broker_url);
+    const configSTACK_DEPTH_TYPE stack_depth = 6000;
+    xTaskCreate(astarte_device_dispatcher_task, "astarte_device_dispatcher_task", stack_depth,
+        device, tskIDLE_PRIORITY, &device->dispatcher_task_handle);
+    if (!device->dispatcher_task_handle) {
+        ESP_LOGE(TAG, "Cannot start astarte_device_dispatcher_task");
+        return ASTARTE_ERR;
     }
 
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-    const esp_mqtt_client_config_t mqtt_cfg
-        = {.broker.address.uri = broker_url,
-#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
-              .broker.verification.crt_bundle_attach = esp_crt_bundle_attach,
+    return ASTARTE_OK;
+}
+
+static void astarte_device_dispatcher_task(void *ctx)
+{
+    // This task handles the messages received by the MQTT task, so that slow user callbacks and
+    // NVS writes don't delay the keepalives and the acknowledgments of the MQTT client.
+
+    astarte_device_handle_t device = (astarte_device_handle_t) ctx;
+
+    while (1) {
+        dispatcher_frame_t frame;
+        if (xQueueReceive(device->dispatcher_frames, &frame, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (frame.slot == DISPATCHER_TERMINATE_SLOT) {
+            // Terminate the task
+            xSemaphoreGive(device->dispatcher_task_exit);
+            vTaskDelete(NULL);
+        }
+        char *topic = (char *) get_frame_message(device, &frame);
+        char *data = (frame.has_data) ? topic + frame.topic_len : NULL;
+        // The device topic and the introspection are only modified with exclusive access, so
+        // unlike the MQTT event handler this task doesn't need the introspection mutex
+        acquire_shared_state(device, portMAX_DELAY);
+        on_incoming(device, topic, frame.topic_len, data, frame.data_len);
+        release_shared_state(device);
+        if (frame.by_reference) {
+            free(topic);
+        }
+        xQueueSend(device->dispatcher_free_slots, &frame.slot, 0);
+        atomic_fetch_add(&device->dispatcher_dispatched, 1U);
+    }
+}
+
+static void stop_dispatcher_task(astarte_device_handle_t device)
+{
+    if (device->dispatcher_task_handle) {
+        dispatcher_frame_t frame = { .slot = DISPATCHER_TERMINATE_SLOT };
+        xQueueSend(device->dispatcher_frames, &frame, portMAX_DELAY);
+        xSemaphoreTake(device->dispatcher_task_exit, portMAX_DELAY);
+        device->dispatcher_task_handle = NULL;
+    }
+    if (device->dispatcher_task_exit) {
+        vSemaphoreDelete(device->dispatcher_task_exit);
+        device->dispatcher_task_exit = NULL;
+    }
+}
+
+static void release_dispatcher(astarte_device_handle_t device)
+{
+    if (device->dispatcher_frames) {
+        // Frames queued after the terminate frame were never handled
+        dispatcher_frame_t frame;
+        while (xQueueReceive(device->dispatcher_frames, &frame, 0) == pdTRUE) {
+            if ((frame.slot != DISPATCHER_TERMINATE_SLOT) && frame.by_reference) {
+                free(get_frame_message(device, &frame));
+            }
+        }
+        vQueueDelete(device->dispatcher_frames);
+        device->dispatcher_frames = NULL;
+    }
+    if (device->dispatcher_free_slots) {
+        vQueueDelete(device->dispatcher_free_slots);
+        device->dispatcher_free_slots = NULL;
+    }
+    free(device->dispatcher_slots);
+    device->dispatcher_slots = NULL;
+}
+
+static uint8_t *get_frame_message(astarte_device_handle_t device, const dispatcher_frame_t *frame)
+{
+    uint8_t *slot_buffer = device->dispatcher_slots + (frame->slot * DISPATCHER_SLOT_SIZE);
+    if (!frame->by_reference) {
+        return slot_buffer;
+    }
+    uint8_t *message = NULL;
+    memcpy(&message, slot_buffer, sizeof(message));
+    return message;
+}
+
+static void enqueue_incoming(
+    astarte_device_handle_t device, char *topic, int topic_len, char *data, int data_len)
+{
+    if (topic_len > UINT16_MAX) {
+        atomic_fetch_add(&device->dispatcher_dropped, 1U);
+        ESP_LOGE(TAG, "Incoming message topic too long: %d bytes", topic_len);
+        return;
+    }
+
+    // Larger messages are still queued, so that they are handled in order with the other ones
+    uint8_t *message = NULL;
+    if (topic_len + data_len > DISPATCHER_SLOT_SIZE) {
+        atomic_fetch_add(&device->dispatcher_oversized, 1U);
+        message = malloc(topic_len + data_len);
+        if (!message) {
+            atomic_fetch_add(&device->dispatcher_dropped, 1U);
+            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+            return;
+        }
+        memcpy(message, topic, topic_len);
+        if (data) {
+            memcpy(message + topic_len, data, data_len);
+        }
+    }
+
+    uint16_t slot = 0;
+    if (xQueueReceive(device->dispatcher_free_slots, &slot, 0) != pdTRUE) {
+#if defined(CONFIG_ASTARTE_DISPATCHER_DROP_OLDEST)
+        // The oldest frame is reused, a frame being handled is never in the queue
+        dispatcher_frame_t oldest;
+        bool has_slot = (xQueueReceive(device->dispatcher_frames, &oldest, 0) == pdTRUE);
+        if (has_slot && (oldest.slot == DISPATCHER_TERMINATE_SLOT)) {
+            // The dispatcher is being stopped, the terminate frame has no slot and must stay at
+            // the head of the queue
+            xQueueSendToFront(device->dispatcher_frames, &oldest, 0);
+            has_slot = false;
+        }
+        if (has_slot) {
+            slot = oldest.slot;
+            if (oldest.by_reference) {
+                free(get_frame_message(device, &oldest));
+            }
+            atomic_fetch_add(&device->dispatcher_dropped, 1U);
+            ESP_LOGW(TAG, "Dispatcher queue full, dropping the oldest incoming message");
+        }
+#elif defined(CONFIG_ASTARTE_DISPATCHER_WAIT)
+        TickType_t wait_ticks = pdMS_TO_TICKS(CONFIG_ASTARTE_DISPATCHER_WAIT_MS);
+        bool has_slot = (xQueueReceive(device->dispatcher_free_slots, &slot, wait_ticks) == pdTRUE);
+#else
+        bool has_slot = false;
+#endif
+        if (!has_slot) {
+            free(message);
+            atomic_fetch_add(&device->dispatcher_dropped, 1U);
+            ESP_LOGW(TAG, "Dispatcher queue full, discarding incoming message: %.*s", topic_len,
+                topic);
+            return;
+        }
+    }
+
+    uint8_t *slot_buffer = device->dispatcher_slots + (slot * DISPATCHER_SLOT_SIZE);
+    if (message) {
+        memcpy(slot_buffer, &message, sizeof(message));
+    } else {
+        memcpy(slot_buffer, topic, topic_len);
+        if (data) {
+            memcpy(slot_buffer + topic_len, data, data_len);
+        }
+    }
+    dispatcher_frame_t frame = {
+        .slot = slot,
+        .topic_len = topic_len,
+        .data_len = data_len,
+        .has_data = (data != NULL),
+        .by_reference = (message != NULL),
+    };
+    xQueueSend(device->dispatcher_frames, &frame, 0);
+
+    // Only the MQTT task updates the maximum
+    unsigned int queued = uxQueueMessagesWaiting(device->dispatcher_frames);
+    if (queued > atomic_load(&device->dispatcher_max_queued)) {
+        atomic_store(&device->dispatcher_max_queued, queued);
+    }
+}
+#endif
+
+static bool in_dispatcher_task(astarte_device_handle_t device)
+{
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+    // The dispatcher holds shared access while calling the callbacks
+    return xTaskGetCurrentTaskHandle() == device->dispatcher_task_handle;
+#else
+    (void) device;
+    return false;
+#endif
+}
+
+static bool in_callback_task(astarte_device_handle_t device)
+{
+    // Adding interfaces and routes waits for exclusive access, which a reinitialization holds
+    // while destroying the MQTT client, which in turn waits for the MQTT task
+    return in_dispatcher_task(device) || (xTaskGetCurrentTaskHandle() == device->mqtt_task_handle);
+}
+
+astarte_err_t astarte_device_init_connection(
+    astarte_device_handle_t device, const char *encoded_hwid, const char *realm)
+{
+    if (!astarte_credentials_is_initialized()) {
+        // TODO: this should be manually called from main before initializing the device,
+        // but we just print a warning to maintain backwards compatibility for now
+        ESP_LOGW(TAG,
+            "You should manually call astarte_credentials_init before calling "
+            "astarte_device_init");
+        astarte_err_t err = astarte_credentials_init();
+        if (err != ASTARTE_OK) {
+            ESP_LOGE(TAG, "Error in astarte_credentials_init");
+            return err;
+        }
+    }
+
+    // If the device was already initialized, we free some resources first. The pointers are
+    // cleared since users can access the device between failed reinitialization attempts.
+    if (device->mqtt_client) {
+        esp_mqtt_client_destroy(device->mqtt_client);
+        device->mqtt_client = NULL;
+        device->mqtt_task_handle = NULL;
+    }
+
+    if (device->device_topic) {
+        free(device->device_topic);
+        device->device_topic = NULL;
+    }
+
+    if (device->client_cert_pem) {
+        free(device->client_cert_pem);
+        device->client_cert_pem = NULL;
+    }
+
+    if (device->key_pem) {
+        free(device->key_pem);
+        device->key_pem = NULL;
+    }
+
+    astarte_pairing_config_t pairing_config = {
+        .base_url = CONFIG_ASTARTE_PAIRING_BASE_URL,
+        .jwt = CONFIG_ASTARTE_PAIRING_JWT,
+        .realm = realm,
+        .hw_id = encoded_hwid,
+    };
+
+    if (device->credentials_secret) {
+        pairing_config.credentials_secret = device->credentials_secret;
+    }
+
+    char credentials_secret[CREDENTIALS_SECRET_LENGTH] = { 0 };
+    astarte_err_t err = astarte_pairing_get_credentials_secret(
+        &pairing_config, credentials_secret, CREDENTIALS_SECRET_LENGTH);
+    if (err != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Error in get_credentials_secret");
+        return err;
+    }
+    ESP_LOGD(TAG, "credentials_secret is: %s", credentials_secret);
+
+    char *client_cert_pem = NULL;
+    char *client_cert_cn = NULL;
+    char *key_pem = NULL;
+
+    if (!astarte_credentials_has_certificate()) {
+        err = retrieve_credentials(&pairing_config);
+        if (err != ASTARTE_OK) {
+            ESP_LOGE(TAG, "Could not retrieve credentials");
+            goto init_failed;
+        }
+    }
+
+    key_pem = calloc(PRIVKEY_LENGTH, sizeof(char));
+    if (!key_pem) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        goto init_failed;
+    }
+    err = astarte_credentials_get_key(key_pem, PRIVKEY_LENGTH);
+    if (err != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Error in get_key");
+        goto init_failed;
+    } else {
+        ESP_LOGD(TAG, "Key is: %s", key_pem);
+    }
+
+    client_cert_pem = calloc(CERT_LENGTH, sizeof(char));
+    if (!client_cert_pem) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        goto init_failed;
+    }
+    err = astarte_credentials_get_certificate(client_cert_pem, CERT_LENGTH);
+    if (err != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Error in get_certificate");
+        goto init_failed;
+    } else {
+        ESP_LOGD(TAG, "Certificate is: %s", client_cert_pem);
+    }
+
+    client_cert_cn = calloc(CN_LENGTH, sizeof(char));
+    if (!client_cert_cn) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        goto init_failed;
+    }
+    err = astarte_credentials_get_certificate_common_name(
+        client_cert_pem, client_cert_cn, CN_LENGTH);
+    if (err != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Error in get_certificate_common_name");
+        goto init_failed;
+    } else {
+        ESP_LOGD(TAG, "Device topic is: %s", client_cert_cn);
+    }
+
+    char broker_url[URL_LENGTH] = { 0 };
+    err = astarte_pairing_get_mqtt_v1_broker_url(&pairing_config, broker_url, URL_LENGTH);
+    if (err != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Error in get_mqtt_v1_broker_url");
+        goto init_failed;
+    } else {
+        ESP_LOGD(TAG, "Broker URL is: %s", broker_url);
+    }
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    const esp_mqtt_client_config_t mqtt_cfg
+        = {.broker.address.uri = broker_url,
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+              .broker.verification.crt_bundle_attach = esp_crt_bundle_attach,
 #endif
               .credentials.authentication.certificate = client_cert_pem,
               .credentials.authentication.key = key_pem,
@@ -415,7 +1196,13 @@ astarte_err_t astarte_device_init_connection(
     device->client_cert_pem = client_cert_pem;
     device->key_pem = key_pem;
 
-    return ASTARTE_OK;
+    // Interfaces topic prefixes depend on the device topic
+    err = astarte_introspection_set_device_topic(&device->introspection, device->device_topic);
+    if (err != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Error updating the interfaces topics");
+    }
+
+    return err;
 
 init_failed:
     free(key_pem);
@@ -431,30 +1218,85 @@ void astarte_device_destroy(astarte_device_handle_t device)
         return;
     }
 
-    // Avoid destroying a device that is being reinitialized
-    xSemaphoreTake(device->reinit_mutex, portMAX_DELAY);
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+    // Frames still in the queue are dropped, the MQTT task can keep queueing frames until the
+    // client is destroyed
+    stop_dispatcher_task(device);
+#endif
 
-    esp_mqtt_client_destroy(device->mqtt_client);
+#ifdef CONFIG_ASTARTE_USE_OFFLINE_QUEUE
+    // The queued messages are kept in flash and published by the next device
+    stop_offline_queue_task(device);
+    astarte_offline_queue_close(&device->offline_queue);
+#endif
+
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+    // Write the pending property changes before releasing the buffer
+    stop_property_writer_task(device);
+    flush_properties(device, true);
+    astarte_property_buffer_destroy(&device->property_buffer);
+#endif
+
+    // Stop the reinit task before waiting for it to release the device, a failed attempt will
+    // not be retried
     xTaskNotify(device->reinit_task_handle, NOTIFY_TERMINATE, eSetBits);
-    vSemaphoreDelete(device->reinit_mutex);
+    // Avoid destroying a device that is being reinitialized or used by other tasks
+    acquire_exclusive(device);
+
+    esp_mqtt_client_destroy(device->mqtt_client);
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+    release_dispatcher(device);
+#endif
+    astarte_reassembly_destroy(&device->reassembly);
+    vEventGroupDelete(device->state_events);
+    vSemaphoreDelete(device->exclusive_mutex);
+    vSemaphoreDelete(device->introspection_mutex);
+
+    // No more MQTT events will be received, fail all the messages still in flight
+    astarte_publish_tracker_entry_t entry;
+    while (astarte_publish_tracker_pop_any(&device->publish_tracker, &entry)) {
+        complete_publish(device, &entry, ASTARTE_PUBLISH_RESULT_FAILED);
+    }
+    astarte_publish_tracker_destroy(&device->publish_tracker);
+    vSemaphoreDelete(device->publish_tracker_mutex);
+    vSemaphoreDelete(device->publish_slots);
+#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
+    if (device->storage_opened) {
+        astarte_storage_close(device->storage_handle);
+    }
+    astarte_property_cache_destroy(&device->property_cache);
+    vSemaphoreDelete(device->property_mutex);
+    astarte_zlib_context_release(&device->zlib_context);
+    vSemaphoreDelete(device->zlib_mutex);
+#endif
     free(device->device_topic);
     free(device->client_cert_pem);
     free(device->key_pem);
     free(device->encoded_hwid);
     free(device->credentials_secret);
     free(device->realm);
-    astarte_linked_list_destroy(&device->introspection);
+    astarte_introspection_destroy(&device->introspection);
     free(device);
 }
 
 astarte_err_t astarte_device_add_interface(
     astarte_device_handle_t device, const astarte_interface_t *interface)
+{
+    return astarte_device_add_interface_with_handle(device, interface, NULL);
+}
+
+astarte_err_t astarte_device_add_interface_with_handle(astarte_device_handle_t device,
+    const astarte_interface_t *interface, astarte_device_interface_handle_t *handle)
 {
     astarte_err_t result = ASTARTE_OK;
-    if (xSemaphoreTake(device->reinit_mutex, (TickType_t) 10) == pdFALSE) {
-        ESP_LOGE(TAG, "Trying to add an interface to a device that is being reinitialized");
+    astarte_device_interface_handle_t entry = NULL;
+    if (in_callback_task(device)) {
+        ESP_LOGE(TAG, "Interfaces can't be added from the device callbacks");
         return ASTARTE_ERR;
     }
+    // The introspection can be resized, wait for the publishers looking up interfaces
+    acquire_exclusive(device);
+    xSemaphoreTakeRecursive(device->introspection_mutex, portMAX_DELAY);
 
     if (interface->major_version == 0 && interface->minor_version == 0) {
         ESP_LOGE(TAG, "Trying to add an interface with both major and minor version equal 0");
@@ -462,102 +1304,168 @@ astarte_err_t astarte_device_add_interface(
         goto end;
     }
 
-    // Loop over any interface in introspection searching for an interface with the same name
-    size_t interface_name_len = strlen(interface->name);
-    astarte_linked_list_iterator_t list_iter;
-    astarte_err_t iter_err = astarte_linked_list_iterator_init(&device->introspection, &list_iter);
-    while (iter_err != ASTARTE_ERR_NOT_FOUND) {
-        astarte_interface_t *tmp_interface = NULL;
-        astarte_linked_list_iterator_get_item(&list_iter, (void **) &tmp_interface);
-
-        // Check if the interface has the same name
-        size_t tmp_interface_name_len = strlen(tmp_interface->name);
-        size_t interfaces_min_len = (interface_name_len < tmp_interface_name_len)
-            ? interface_name_len
-            : tmp_interface_name_len;
-        if (strncmp(interface->name, tmp_interface->name, interfaces_min_len) == 0) {
-            ESP_LOGW(TAG, "Trying to add an interface already present in introspection");
-            // Check if ownership and type are the same
-            if ((interface->ownership != tmp_interface->ownership)
-                || (interface->type != tmp_interface->type)) {
-                ESP_LOGE(TAG, "Interface ownership/type conflicts with the one in introspection");
-                result = ASTARTE_ERR_CONFLICTING_INTERFACE;
-                goto end;
-            }
-            // Check if major versions align correctly
-            if (interface->major_version < tmp_interface->major_version) {
-                ESP_LOGE(TAG, "Interface with smaller major version than one in introspection");
-                result = ASTARTE_ERR_CONFLICTING_INTERFACE;
-                goto end;
-            }
-            // Check if minor versions aligns correctly
-            if ((interface->major_version == tmp_interface->major_version)
-                && (interface->minor_version < tmp_interface->minor_version)) {
-                ESP_LOGE(TAG,
-                    "Interface with same major version and smaller minor version than one in "
-                    "introspection");
-                result = ASTARTE_ERR_CONFLICTING_INTERFACE;
-                goto end;
-            }
-            ESP_LOGW(TAG, "Overwriting interface %s", interface->name);
-            astarte_linked_list_iterator_replace_item(
-                &list_iter, (astarte_interface_t *) interface);
+    // Search the introspection for an interface with the same name
+    entry = astarte_introspection_get(
+        &device->introspection, interface->name, strlen(interface->name));
+    if (entry) {
+        const astarte_interface_t *tmp_interface = entry->interface;
+        ESP_LOGW(TAG, "Trying to add an interface already present in introspection");
+        // Check if ownership and type are the same
+        if ((interface->ownership != tmp_interface->ownership)
+            || (interface->type != tmp_interface->type)) {
+            ESP_LOGE(TAG, "Interface ownership/type conflicts with the one in introspection");
+            result = ASTARTE_ERR_CONFLICTING_INTERFACE;
             goto end;
         }
-
-        iter_err = astarte_linked_list_iterator_advance(&list_iter);
+        // Check if major versions align correctly
+        if (interface->major_version < tmp_interface->major_version) {
+            ESP_LOGE(TAG, "Interface with smaller major version than one in introspection");
+            result = ASTARTE_ERR_CONFLICTING_INTERFACE;
+            goto end;
+        }
+        // Check if minor versions aligns correctly
+        if ((interface->major_version == tmp_interface->major_version)
+            && (interface->minor_version < tmp_interface->minor_version)) {
+            ESP_LOGE(TAG,
+                "Interface with same major version and smaller minor version than one in "
+                "introspection");
+            result = ASTARTE_ERR_CONFLICTING_INTERFACE;
+            goto end;
+        }
+        ESP_LOGW(TAG, "Overwriting interface %s", interface->name);
+        // The name is unchanged, so the entry position in the hash table and its topic prefix
+        // are still valid
+        entry->interface = interface;
+        entry->name = interface->name;
+        goto end;
     }
 
     ESP_LOGD(TAG, "Adding interface %s to device", interface->name);
-    astarte_err_t list_err
-        = astarte_linked_list_append(&device->introspection, (astarte_interface_t *) interface);
-    if (list_err != ASTARTE_OK) {
-        ESP_LOGE(TAG, "Can't add interface to introspection %s", astarte_err_to_name(list_err));
-        result = list_err;
+    result = astarte_introspection_add(&device->introspection, interface, &entry);
+    if (result != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Can't add interface to introspection %s", astarte_err_to_name(result));
         goto end;
     }
 
 end:
-    xSemaphoreGive(device->reinit_mutex);
+    if ((result == ASTARTE_OK) && handle) {
+        *handle = entry;
+    }
+    xSemaphoreGiveRecursive(device->introspection_mutex);
+    release_exclusive(device);
+    return result;
+}
+
+astarte_err_t astarte_device_add_interface_with_callback(astarte_device_handle_t device,
+    const astarte_interface_t *interface, astarte_device_data_view_event_callback_t callback,
+    void *user_data, astarte_device_interface_handle_t *handle)
+{
+    astarte_device_interface_handle_t entry = NULL;
+    astarte_err_t result = astarte_device_add_interface_with_handle(device, interface, &entry);
+    if ((result == ASTARTE_OK) && callback) {
+        result = astarte_device_interface_add_route(device, entry, NULL, callback, user_data);
+    }
+    if ((result == ASTARTE_OK) && handle) {
+        *handle = entry;
+    }
     return result;
 }
 
+astarte_err_t astarte_device_interface_add_route(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path_pattern,
+    astarte_device_data_view_event_callback_t callback, void *user_data)
+{
+    if (!interface || !callback) {
+        ESP_LOGE(TAG, "Invalid interface handle or callback");
+        return ASTARTE_ERR;
+    }
+    if (in_callback_task(device)) {
+        ESP_LOGE(TAG, "Routes can't be added from the device callbacks");
+        return ASTARTE_ERR;
+    }
+    // The routing table is read by the MQTT event handler
+    acquire_exclusive(device);
+    xSemaphoreTakeRecursive(device->introspection_mutex, portMAX_DELAY);
+    astarte_err_t result
+        = astarte_routes_add(&interface->routes, path_pattern, callback, user_data);
+    xSemaphoreGiveRecursive(device->introspection_mutex);
+    release_exclusive(device);
+    return result;
+}
+
+astarte_err_t astarte_device_interface_set_stream_callback(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, astarte_device_stream_event_callback_t callback,
+    void *user_data)
+{
+    if (!interface) {
+        ESP_LOGE(TAG, "Invalid interface handle");
+        return ASTARTE_ERR;
+    }
+    if (interface->interface->type == TYPE_PROPERTIES) {
+        // Streamed messages are not stored, properties are always reassembled
+        ESP_LOGE(TAG, "Only datastream interfaces can be streamed: %s", interface->name);
+        return ASTARTE_ERR;
+    }
+    if (in_callback_task(device)) {
+        ESP_LOGE(TAG, "Stream callbacks can't be set from the device callbacks");
+        return ASTARTE_ERR;
+    }
+    // The callback is read by the MQTT event handler
+    acquire_exclusive(device);
+    xSemaphoreTakeRecursive(device->introspection_mutex, portMAX_DELAY);
+    interface->stream_callback = callback;
+    interface->stream_user_data = user_data;
+    xSemaphoreGiveRecursive(device->introspection_mutex);
+    release_exclusive(device);
+    return ASTARTE_OK;
+}
+
 astarte_err_t astarte_device_start(astarte_device_handle_t device)
 {
-    if (xSemaphoreTake(device->reinit_mutex, (TickType_t) 10) == pdFALSE) {
+    if (acquire_shared(device, DEVICE_READY_TIMEOUT_TICKS) != ASTARTE_OK) {
         ESP_LOGE(TAG, "Trying to start device that is being reinitialized");
         return ASTARTE_ERR_DEVICE_NOT_READY;
     }
 
     astarte_err_t ret = ASTARTE_OK;
 
-    esp_err_t err = esp_mqtt_client_start(device->mqtt_client);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start MQTT client: %s", esp_err_to_name(err));
-        ret = ASTARTE_ERR;
+    if (!device->mqtt_client) {
+        ESP_LOGE(TAG, "Trying to start device that is being reinitialized");
+        ret = ASTARTE_ERR_DEVICE_NOT_READY;
+    } else {
+        esp_err_t err = esp_mqtt_client_start(device->mqtt_client);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start MQTT client: %s", esp_err_to_name(err));
+            ret = ASTARTE_ERR;
+        }
     }
 
-    xSemaphoreGive(device->reinit_mutex);
+    release_shared(device);
 
     return ret;
 }
 
 astarte_err_t astarte_device_stop(astarte_device_handle_t device)
 {
-    if (xSemaphoreTake(device->reinit_mutex, (TickType_t) 10) == pdFALSE) {
+    if (acquire_shared(device, DEVICE_READY_TIMEOUT_TICKS) != ASTARTE_OK) {
         ESP_LOGE(TAG, "Trying to stop device that is being reinitialized");
         return ASTARTE_ERR_DEVICE_NOT_READY;
     }
 
     astarte_err_t ret = ASTARTE_OK;
 
-    esp_err_t err = esp_mqtt_client_stop(device->mqtt_client);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to stop MQTT client: %s", esp_err_to_name(err));
-        ret = ASTARTE_ERR;
+    if (!device->mqtt_client) {
+        ESP_LOGE(TAG, "Trying to stop device that is being reinitialized");
+        ret = ASTARTE_ERR_DEVICE_NOT_READY;
+    } else {
+        esp_err_t err = esp_mqtt_client_stop(device->mqtt_client);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to stop MQTT client: %s", esp_err_to_name(err));
+            ret = ASTARTE_ERR;
+        }
     }
 
-    xSemaphoreGive(device->reinit_mutex);
+    release_shared(device);
 
     if (ret == ASTARTE_OK) {
         // If we succesfully disconnected, call on_disconnected since
@@ -565,96 +1473,89 @@ astarte_err_t astarte_device_stop(astarte_device_handle_t device)
         on_disconnected(device);
     }
 
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+    flush_properties(device, true);
+#endif
+
     return ret;
 }
 
-static astarte_err_t publish_bson(astarte_device_handle_t device, const char *interface_name,
-    const char *path, astarte_bson_serializer_handle_t bson, int qos)
+static astarte_err_t publish_bson(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path,
+    astarte_bson_serializer_handle_t bson, int qos)
 {
     int len = 0;
     const void *data = astarte_bson_serializer_get_document(bson, &len);
+    astarte_err_t bson_err = astarte_bson_serializer_get_error(bson);
+    if (bson_err != ASTARTE_OK) {
+        // The value is dropped, the device keeps running
+        ESP_LOGE(TAG, "Error during BSON serialization: %s", astarte_err_to_name(bson_err));
+        return bson_err;
+    }
     if (!data) {
         ESP_LOGE(TAG, "Error during BSON serialization");
         return ASTARTE_ERR;
     }
     if (len < 0) {
         ESP_LOGE(TAG, "BSON document is too long for MQTT publish.");
-        ESP_LOGE(TAG, "Interface: %s, path: %s", interface_name, path);
+        ESP_LOGE(TAG, "Interface: %s, path: %s", interface->name, path);
         return ASTARTE_ERR;
     }
 #ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
-    astarte_interface_t *interface = get_interface_from_introspection(device, interface_name);
-    if (interface && (interface->type == TYPE_PROPERTIES)) {
-        // Open storage
-        astarte_storage_handle_t storage_handle;
-        astarte_err_t storage_err = astarte_storage_open(&storage_handle);
+    if (interface->interface && (interface->interface->type == TYPE_PROPERTIES)) {
+        bool changed = false;
+        astarte_err_t storage_err = store_property(device, interface->name, path,
+            interface->interface->major_version, data, len, &changed);
         if (storage_err != ASTARTE_OK) {
-            ESP_LOGE(TAG, "Error opening storage.");
             return ASTARTE_ERR;
         }
-        // Check if property is already stored in nvs with same value
-        bool is_contained = false;
-        storage_err = astarte_storage_contains_property(storage_handle, interface_name, path,
-            interface->major_version, data, len, &is_contained);
-        if (storage_err != ASTARTE_OK) {
-            ESP_LOGE(TAG, "Error checking if property is in storage.");
-            astarte_storage_close(storage_handle);
-            return ASTARTE_ERR;
-        }
-        if (is_contained) {
-            ESP_LOGW(TAG, "Trying to set a property twice: '%s%s'", interface_name, path);
-            astarte_storage_close(storage_handle);
+        if (!changed) {
+            ESP_LOGW(TAG, "Trying to set a property twice: '%s%s'", interface->name, path);
             return ASTARTE_OK;
         }
-        // Store property
-        ESP_LOGD(TAG, "Storing device property: '%s%s'.", interface_name, path);
-        storage_err = astarte_storage_store_property(
-            storage_handle, interface_name, path, interface->major_version, data, len);
-        if (storage_err != ASTARTE_OK) {
-            ESP_LOGE(TAG, "Error storing property.");
-            astarte_storage_close(storage_handle);
-            return ASTARTE_ERR;
-        }
-        // Close storage
-        astarte_storage_close(storage_handle);
     }
 #endif
 
-    return publish_data(device, interface_name, path, data, len, qos);
+    return publish_data(device, interface, path, data, len, qos);
 }
 
-static astarte_err_t publish_data(astarte_device_handle_t device, const char *interface_name,
-    const char *path, const void *data, int length, int qos)
+static astarte_err_t publish_data(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const void *data, int length,
+    int qos)
 {
-    if (path[0] != '/') {
-        ESP_LOGE(TAG, "Invalid path: %s (must be start with /)", path);
-        return ASTARTE_ERR_INVALID_INTERFACE_PATH;
-    }
-
     if (qos < 0 || qos > 2) {
         ESP_LOGE(TAG, "Invalid QoS: %d (must be 0, 1 or 2)", qos);
         return ASTARTE_ERR_INVALID_QOS;
     }
 
-    char topic[TOPIC_LENGTH] = { 0 };
-    int print_ret
-        = snprintf(topic, TOPIC_LENGTH, "%s/%s%s", device->device_topic, interface_name, path);
-    if ((print_ret < 0) || (print_ret >= TOPIC_LENGTH)) {
-        ESP_LOGE(TAG, "Error encoding topic");
-        return ASTARTE_ERR;
-    }
-
-    if (xSemaphoreTake(device->reinit_mutex, (TickType_t) 10) == pdFALSE) {
+    // The MQTT client and the device topic stay valid until the shared access is released,
+    // publishers never wait for each other but only for a reinitialization in progress
+    if (acquire_shared(device, DEVICE_READY_TIMEOUT_TICKS) != ASTARTE_OK) {
+        if (use_offline_queue(interface)) {
+            return enqueue_offline_unavailable(device, interface, path, data, length, qos);
+        }
         ESP_LOGE(TAG, "Trying to publish to a device that is being reinitialized");
         return ASTARTE_ERR_DEVICE_NOT_READY;
     }
 
-    esp_mqtt_client_handle_t mqtt = device->mqtt_client;
+    char topic[TOPIC_LENGTH];
+    astarte_err_t topic_err = build_topic(device, interface, path, topic);
+    if (topic_err != ASTARTE_OK) {
+        release_shared(device);
+        return topic_err;
+    }
 
-    ESP_LOGD(TAG, "Publishing on %s with QoS %d", topic, qos);
-    int ret = esp_mqtt_client_publish(mqtt, topic, data, length, qos, 0);
-    xSemaphoreGive(device->reinit_mutex);
+    bool offline_queue = use_offline_queue(interface);
+    int ret = -1;
+    if (device->mqtt_client && (device->connected || !offline_queue)) {
+        ESP_LOGD(TAG, "Publishing on %s with QoS %d", topic, qos);
+        ret = esp_mqtt_client_publish(device->mqtt_client, topic, data, length, qos, 0);
+    }
+    release_shared(device);
     if (ret < 0) {
+        if (offline_queue) {
+            return enqueue_offline(device, interface, topic, data, length, qos);
+        }
         ESP_LOGE(TAG, "Publish on %s failed", topic);
         return ASTARTE_ERR_PUBLISH;
     }
@@ -663,6 +1564,154 @@ static astarte_err_t publish_data(astarte_device_handle_t device, const char *in
     return ASTARTE_OK;
 }
 
+static astarte_err_t build_topic(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, char *topic)
+{
+    if (path[0] != '/') {
+        ESP_LOGE(TAG, "Invalid path: %s (must be start with /)", path);
+        return ASTARTE_ERR_INVALID_INTERFACE_PATH;
+    }
+
+    if (interface->topic_prefix) {
+        // Fast path, the topic prefix has been computed when the interface was added
+        size_t path_len = strlen(path);
+        if (interface->topic_prefix_len + path_len >= TOPIC_LENGTH) {
+            ESP_LOGE(TAG, "Error encoding topic");
+            return ASTARTE_ERR;
+        }
+        memcpy(topic, interface->topic_prefix, interface->topic_prefix_len);
+        memcpy(topic + interface->topic_prefix_len, path, path_len + 1);
+    } else {
+        if (!device->device_topic) {
+            ESP_LOGE(TAG, "Device topic not available, the device is being reinitialized");
+            return ASTARTE_ERR_DEVICE_NOT_READY;
+        }
+        int print_ret
+            = snprintf(topic, TOPIC_LENGTH, "%s/%s%s", device->device_topic, interface->name, path);
+        if ((print_ret < 0) || (print_ret >= TOPIC_LENGTH)) {
+            ESP_LOGE(TAG, "Error encoding topic");
+            return ASTARTE_ERR;
+        }
+    }
+    return ASTARTE_OK;
+}
+
+static uint32_t get_time_ms(void)
+{
+    return (uint32_t) (xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
+static void complete_publish(astarte_device_handle_t device,
+    const astarte_publish_tracker_entry_t *entry, astarte_device_publish_result_t result)
+{
+    xSemaphoreGive(device->publish_slots);
+    if (entry->callback) {
+        astarte_device_publish_event_t event = {
+            .device = device,
+            .ticket = entry->ticket,
+            .result = result,
+            .user_data = entry->user_data,
+        };
+        entry->callback(&event);
+    }
+}
+
+static void expire_publishes(astarte_device_handle_t device)
+{
+    while (1) {
+        astarte_publish_tracker_entry_t entry;
+        xSemaphoreTake(device->publish_tracker_mutex, portMAX_DELAY);
+        bool expired = astarte_publish_tracker_pop_expired(&device->publish_tracker,
+            get_time_ms(), CONFIG_ASTARTE_PUBLISH_ASYNC_TIMEOUT_MS, &entry);
+        xSemaphoreGive(device->publish_tracker_mutex);
+        if (!expired) {
+            break;
+        }
+        ESP_LOGW(TAG, "Publish with ticket %" PRIu32 " expired", entry.ticket);
+        complete_publish(device, &entry, ASTARTE_PUBLISH_RESULT_EXPIRED);
+    }
+}
+
+static bool use_offline_queue(astarte_device_interface_handle_t interface)
+{
+#ifdef CONFIG_ASTARTE_USE_OFFLINE_QUEUE
+    // Interfaces not in introspection are assumed to be datastreams
+    if (interface->interface && (interface->interface->type != TYPE_DATASTREAM)) {
+        return false;
+    }
+    return interface->offline_policy != ASTARTE_OFFLINE_POLICY_NONE;
+#else
+    return false;
+#endif
+}
+
+static astarte_err_t enqueue_offline(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *topic, const void *data, int length,
+    int qos)
+{
+#ifdef CONFIG_ASTARTE_USE_OFFLINE_QUEUE
+    bool drop_oldest = (interface->offline_policy == ASTARTE_OFFLINE_POLICY_DROP_OLDEST);
+    astarte_err_t err = astarte_offline_queue_push(
+        &device->offline_queue, topic, data, (size_t) length, qos, drop_oldest);
+    if (err != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Cannot store the message on %s in the offline queue", topic);
+        return err;
+    }
+    ESP_LOGD(TAG, "Device disconnected, message on %s stored in the offline queue", topic);
+    return ASTARTE_OK;
+#else
+    return ASTARTE_ERR;
+#endif
+}
+
+static astarte_err_t enqueue_offline_unavailable(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const void *data, int length,
+    int qos)
+{
+    if (path[0] != '/') {
+        ESP_LOGE(TAG, "Invalid path: %s (must be start with /)", path);
+        return ASTARTE_ERR_INVALID_INTERFACE_PATH;
+    }
+    // The device topic can't be read during a reinitialization, the queued topic is relative to it
+    // and is completed when the queue is drained
+    char topic[TOPIC_LENGTH];
+    int ret = snprintf(topic, TOPIC_LENGTH, "/%s%s", interface->name, path);
+    if ((ret < 0) || (ret >= TOPIC_LENGTH)) {
+        ESP_LOGE(TAG, "Error encoding topic");
+        return ASTARTE_ERR;
+    }
+    return enqueue_offline(device, interface, topic, data, length, qos);
+}
+
+static astarte_device_interface_handle_t get_interface_handle(astarte_device_handle_t device,
+    const char *interface_name, struct astarte_device_interface *unregistered)
+{
+    size_t interface_name_len = strlen(interface_name);
+    astarte_device_interface_handle_t interface = NULL;
+    // Entries are never removed, only the lookup has to be protected from a concurrent resize
+    if (acquire_shared(device, 0) == ASTARTE_OK) {
+        interface
+            = astarte_introspection_get(&device->introspection, interface_name, interface_name_len);
+        release_shared(device);
+    } else if (xSemaphoreTakeRecursive(device->introspection_mutex, DEVICE_READY_TIMEOUT_TICKS)
+        == pdTRUE) {
+        // A reinitialization doesn't resize the introspection, the mutex excludes the writers and
+        // the publish is queued or fails as during any other reinitialization
+        interface
+            = astarte_introspection_get(&device->introspection, interface_name, interface_name_len);
+        xSemaphoreGiveRecursive(device->introspection_mutex);
+    }
+    if (interface) {
+        return interface;
+    }
+    // Publishing on interfaces not in introspection is still allowed, the topic for such
+    // interfaces is computed on each publish.
+    memset(unregistered, 0, sizeof(struct astarte_device_interface));
+    unregistered->name = interface_name;
+    unregistered->name_len = interface_name_len;
+    return unregistered;
+}
+
 static void maybe_append_timestamp(astarte_bson_serializer_handle_t bson, uint64_t ts_epoch_millis)
 {
     if (ts_epoch_millis != ASTARTE_INVALID_TIMESTAMP) {
@@ -670,160 +1719,258 @@ static void maybe_append_timestamp(astarte_bson_serializer_handle_t bson, uint64
     }
 }
 
-astarte_err_t astarte_device_stream_double_with_timestamp(astarte_device_handle_t device,
-    const char *interface_name, const char *path, double value, uint64_t ts_epoch_millis, int qos)
+#define IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_T(TYPE, TYPE_NAME, BSON_TYPE_NAME)                    \
+    astarte_err_t astarte_device_interface_stream_##TYPE_NAME(astarte_device_handle_t device,      \
+        astarte_device_interface_handle_t interface, const char *path, TYPE value,                 \
+        uint64_t ts_epoch_millis, int qos)                                                         \
+    {                                                                                              \
+        if (!interface) {                                                                          \
+            ESP_LOGE(TAG, "Invalid interface handle");                                             \
+            return ASTARTE_ERR;                                                                    \
+        }                                                                                          \
+        uint8_t bson_buf[PUBLISH_BSON_BUFFER_SIZE];                                                \
+        astarte_bson_serializer_storage_t bson_storage;                                            \
+        astarte_bson_serializer_handle_t bson                                                      \
+            = astarte_bson_serializer_init_with_buffer(&bson_storage, bson_buf, sizeof(bson_buf)); \
+        astarte_bson_serializer_append_##BSON_TYPE_NAME(bson, "v", value);                         \
+        maybe_append_timestamp(bson, ts_epoch_millis);                                             \
+        astarte_bson_serializer_append_end_of_document(bson);                                      \
+                                                                                                   \
+        astarte_err_t exit_code = publish_bson(device, interface, path, bson, qos);                \
+                                                                                                   \
+        astarte_bson_serializer_deinit(bson);                                                      \
+        return exit_code;                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    astarte_err_t astarte_device_stream_##TYPE_NAME##_with_timestamp(                              \
+        astarte_device_handle_t device, const char *interface_name, const char *path, TYPE value,  \
+        uint64_t ts_epoch_millis, int qos)                                                         \
+    {                                                                                              \
+        struct astarte_device_interface unregistered;                                              \
+        return astarte_device_interface_stream_##TYPE_NAME(device,                                 \
+            get_interface_handle(device, interface_name, &unregistered), path, value,              \
+            ts_epoch_millis, qos);                                                                 \
+    }
+
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_T(double, double, double)
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_T(int32_t, integer, int32)
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_T(int64_t, longinteger, int64)
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_T(bool, boolean, boolean)
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_T(const char *, string, string)
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_T(int64_t, datetime, datetime)
+
+astarte_err_t astarte_device_interface_stream_binaryblob(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, void *value, size_t size,
+    uint64_t ts_epoch_millis, int qos)
 {
-    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
-    astarte_bson_serializer_append_double(bson, "v", value);
+    if (!interface) {
+        ESP_LOGE(TAG, "Invalid interface handle");
+        return ASTARTE_ERR;
+    }
+    uint8_t bson_buf[PUBLISH_BSON_BUFFER_SIZE];
+    astarte_bson_serializer_storage_t bson_storage;
+    astarte_bson_serializer_handle_t bson
+        = astarte_bson_serializer_init_with_buffer(&bson_storage, bson_buf, sizeof(bson_buf));
+    astarte_bson_serializer_append_binary(bson, "v", value, size);
     maybe_append_timestamp(bson, ts_epoch_millis);
     astarte_bson_serializer_append_end_of_document(bson);
 
-    astarte_err_t exit_code = publish_bson(device, interface_name, path, bson, qos);
+    astarte_err_t exit_code = publish_bson(device, interface, path, bson, qos);
 
-    astarte_bson_serializer_destroy(bson);
+    astarte_bson_serializer_deinit(bson);
     return exit_code;
 }
 
-astarte_err_t astarte_device_stream_integer_with_timestamp(astarte_device_handle_t device,
-    const char *interface_name, const char *path, int32_t value, uint64_t ts_epoch_millis, int qos)
+astarte_err_t astarte_device_stream_binaryblob_with_timestamp(astarte_device_handle_t device,
+    const char *interface_name, const char *path, void *value, size_t size,
+    uint64_t ts_epoch_millis, int qos)
 {
-    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
-    astarte_bson_serializer_append_int32(bson, "v", value);
-    maybe_append_timestamp(bson, ts_epoch_millis);
-    astarte_bson_serializer_append_end_of_document(bson);
-
-    astarte_err_t exit_code = publish_bson(device, interface_name, path, bson, qos);
-
-    astarte_bson_serializer_destroy(bson);
-    return exit_code;
+    struct astarte_device_interface unregistered;
+    return astarte_device_interface_stream_binaryblob(device,
+        get_interface_handle(device, interface_name, &unregistered), path, value, size,
+        ts_epoch_millis, qos);
 }
 
-astarte_err_t astarte_device_stream_longinteger_with_timestamp(astarte_device_handle_t device,
-    const char *interface_name, const char *path, int64_t value, uint64_t ts_epoch_millis, int qos)
+#define IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_ARRAY_T(TYPE, TYPE_NAME, BSON_TYPE_NAME)              \
+    astarte_err_t astarte_device_interface_stream_##TYPE_NAME(astarte_device_handle_t device,      \
+        astarte_device_interface_handle_t interface, const char *path, TYPE value, int count,      \
+        uint64_t ts_epoch_millis, int qos)                                                         \
+    {                                                                                              \
+        if (!interface) {                                                                          \
+            ESP_LOGE(TAG, "Invalid interface handle");                                             \
+            return ASTARTE_ERR;                                                                    \
+        }                                                                                          \
+        uint8_t bson_buf[PUBLISH_BSON_BUFFER_SIZE];                                                \
+        astarte_bson_serializer_storage_t bson_storage;                                            \
+        astarte_bson_serializer_handle_t bson                                                      \
+            = astarte_bson_serializer_init_with_buffer(&bson_storage, bson_buf, sizeof(bson_buf)); \
+        astarte_bson_serializer_append_##BSON_TYPE_NAME(bson, "v", value, count);                  \
+        maybe_append_timestamp(bson, ts_epoch_millis);                                             \
+        astarte_bson_serializer_append_end_of_document(bson);                                      \
+                                                                                                   \
+        astarte_err_t exit_code = publish_bson(device, interface, path, bson, qos);                \
+                                                                                                   \
+        astarte_bson_serializer_deinit(bson);                                                      \
+        return exit_code;                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    astarte_err_t astarte_device_stream_##TYPE_NAME##_with_timestamp(                              \
+        astarte_device_handle_t device, const char *interface_name, const char *path, TYPE value,  \
+        int count, uint64_t ts_epoch_millis, int qos)                                              \
+    {                                                                                              \
+        struct astarte_device_interface unregistered;                                              \
+        return astarte_device_interface_stream_##TYPE_NAME(device,                                 \
+            get_interface_handle(device, interface_name, &unregistered), path, value, count,       \
+            ts_epoch_millis, qos);                                                                 \
+    }
+
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_ARRAY_T(const double *, double_array, double_array)
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_ARRAY_T(const int32_t *, integer_array, int32_array)
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_ARRAY_T(const int64_t *, longinteger_array, int64_array)
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_ARRAY_T(const bool *, boolean_array, boolean_array)
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_ARRAY_T(const char *const *, string_array, string_array)
+IMPL_ASTARTE_DEVICE_INTERFACE_STREAM_ARRAY_T(const int64_t *, datetime_array, datetime_array)
+
+astarte_err_t astarte_device_interface_stream_binaryblob_array(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, const void *const *values,
+    const int *sizes, int count, uint64_t ts_epoch_millis, int qos)
 {
-    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
-    astarte_bson_serializer_append_int64(bson, "v", value);
+    if (!interface) {
+        ESP_LOGE(TAG, "Invalid interface handle");
+        return ASTARTE_ERR;
+    }
+    uint8_t bson_buf[PUBLISH_BSON_BUFFER_SIZE];
+    astarte_bson_serializer_storage_t bson_storage;
+    astarte_bson_serializer_handle_t bson
+        = astarte_bson_serializer_init_with_buffer(&bson_storage, bson_buf, sizeof(bson_buf));
+    astarte_err_t exit_code
+        = astarte_bson_serializer_append_binary_array(bson, "v", values, sizes, count);
     maybe_append_timestamp(bson, ts_epoch_millis);
     astarte_bson_serializer_append_end_of_document(bson);
 
-    astarte_err_t exit_code = publish_bson(device, interface_name, path, bson, qos);
+    if (exit_code == ASTARTE_OK) {
+        exit_code = publish_bson(device, interface, path, bson, qos);
+    }
 
-    astarte_bson_serializer_destroy(bson);
+    astarte_bson_serializer_deinit(bson);
     return exit_code;
 }
 
-astarte_err_t astarte_device_stream_boolean_with_timestamp(astarte_device_handle_t device,
-    const char *interface_name, const char *path, bool value, uint64_t ts_epoch_millis, int qos)
+astarte_err_t astarte_device_stream_binaryblob_array_with_timestamp(astarte_device_handle_t device,
+    const char *interface_name, const char *path, const void *const *values, const int *sizes,
+    int count, uint64_t ts_epoch_millis, int qos)
 {
-    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
-    astarte_bson_serializer_append_boolean(bson, "v", value);
-    maybe_append_timestamp(bson, ts_epoch_millis);
-    astarte_bson_serializer_append_end_of_document(bson);
-
-    astarte_err_t exit_code = publish_bson(device, interface_name, path, bson, qos);
-
-    astarte_bson_serializer_destroy(bson);
-    return exit_code;
+    struct astarte_device_interface unregistered;
+    return astarte_device_interface_stream_binaryblob_array(device,
+        get_interface_handle(device, interface_name, &unregistered), path, values, sizes, count,
+        ts_epoch_millis, qos);
 }
 
-astarte_err_t astarte_device_stream_string_with_timestamp(astarte_device_handle_t device,
-    const char *interface_name, const char *path, const char *value, uint64_t ts_epoch_millis,
-    int qos)
+astarte_err_t astarte_device_interface_stream_aggregate(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path_prefix,
+    const void *bson_document, uint64_t ts_epoch_millis, int qos)
 {
-    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
-    astarte_bson_serializer_append_string(bson, "v", value);
+    if (!interface) {
+        ESP_LOGE(TAG, "Invalid interface handle");
+        return ASTARTE_ERR;
+    }
+    uint8_t bson_buf[PUBLISH_BSON_BUFFER_SIZE];
+    astarte_bson_serializer_storage_t bson_storage;
+    astarte_bson_serializer_handle_t bson
+        = astarte_bson_serializer_init_with_buffer(&bson_storage, bson_buf, sizeof(bson_buf));
+    astarte_bson_serializer_append_document(bson, "v", bson_document);
     maybe_append_timestamp(bson, ts_epoch_millis);
     astarte_bson_serializer_append_end_of_document(bson);
 
-    astarte_err_t exit_code = publish_bson(device, interface_name, path, bson, qos);
+    astarte_err_t exit_code = publish_bson(device, interface, path_prefix, bson, qos);
 
-    astarte_bson_serializer_destroy(bson);
+    astarte_bson_serializer_deinit(bson);
     return exit_code;
 }
 
-astarte_err_t astarte_device_stream_binaryblob_with_timestamp(astarte_device_handle_t device,
-    const char *interface_name, const char *path, void *value, size_t size,
+astarte_err_t astarte_device_stream_aggregate_with_timestamp(astarte_device_handle_t device,
+    const char *interface_name, const char *path_prefix, const void *bson_document,
     uint64_t ts_epoch_millis, int qos)
 {
-    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
-    astarte_bson_serializer_append_binary(bson, "v", value, size);
-    maybe_append_timestamp(bson, ts_epoch_millis);
-    astarte_bson_serializer_append_end_of_document(bson);
-
-    astarte_err_t exit_code = publish_bson(device, interface_name, path, bson, qos);
-
-    astarte_bson_serializer_destroy(bson);
-    return exit_code;
+    struct astarte_device_interface unregistered;
+    return astarte_device_interface_stream_aggregate(device,
+        get_interface_handle(device, interface_name, &unregistered), path_prefix, bson_document,
+        ts_epoch_millis, qos);
 }
 
-astarte_err_t astarte_device_stream_datetime_with_timestamp(astarte_device_handle_t device,
-    const char *interface_name, const char *path, int64_t value, uint64_t ts_epoch_millis, int qos)
+astarte_err_t astarte_device_interface_stream_aggregate_with_writer(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path_prefix,
+    astarte_device_aggregate_writer_t writer, void *user_data, uint64_t ts_epoch_millis, int qos)
 {
-    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
-    astarte_bson_serializer_append_datetime(bson, "v", value);
+    if (!interface || !writer) {
+        ESP_LOGE(TAG, "Invalid interface handle or aggregate writer");
+        return ASTARTE_ERR;
+    }
+    // The aggregate is written directly in the outgoing message, its length is set once closed
+    uint8_t bson_buf[PUBLISH_BSON_BUFFER_SIZE];
+    astarte_bson_serializer_storage_t bson_storage;
+    astarte_bson_serializer_handle_t bson
+        = astarte_bson_serializer_init_with_buffer(&bson_storage, bson_buf, sizeof(bson_buf));
+    astarte_bson_serializer_nested_t aggregate = astarte_bson_serializer_begin_document(bson, "v");
+    astarte_err_t exit_code = writer(bson, user_data);
+    astarte_bson_serializer_end_document(bson, aggregate);
     maybe_append_timestamp(bson, ts_epoch_millis);
     astarte_bson_serializer_append_end_of_document(bson);
 
-    astarte_err_t exit_code = publish_bson(device, interface_name, path, bson, qos);
+    if (exit_code == ASTARTE_OK) {
+        exit_code = publish_bson(device, interface, path_prefix, bson, qos);
+    }
 
-    astarte_bson_serializer_destroy(bson);
+    astarte_bson_serializer_deinit(bson);
     return exit_code;
 }
 
-#define IMPL_ASTARTE_DEVICE_STREAM_ARRAY_T_WITH_TIMESTAMP(TYPE, TYPE_NAME, BSON_TYPE_NAME)         \
-    astarte_err_t astarte_device_stream_##TYPE_NAME##_with_timestamp(                              \
-        astarte_device_handle_t device, const char *interface_name, const char *path, TYPE value,  \
-        int count, uint64_t ts_epoch_millis, int qos)                                              \
-    {                                                                                              \
-        astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();                     \
-        astarte_bson_serializer_append_##BSON_TYPE_NAME(bson, "v", value, count);                  \
-        maybe_append_timestamp(bson, ts_epoch_millis);                                             \
-        astarte_bson_serializer_append_end_of_document(bson);                                      \
-                                                                                                   \
-        astarte_err_t exit_code = publish_bson(device, interface_name, path, bson, qos);           \
-                                                                                                   \
-        astarte_bson_serializer_destroy(bson);                                                     \
-        return exit_code;                                                                          \
-    }
-
-IMPL_ASTARTE_DEVICE_STREAM_ARRAY_T_WITH_TIMESTAMP(const double *, double_array, double_array)
-IMPL_ASTARTE_DEVICE_STREAM_ARRAY_T_WITH_TIMESTAMP(const int32_t *, integer_array, int32_array)
-IMPL_ASTARTE_DEVICE_STREAM_ARRAY_T_WITH_TIMESTAMP(const int64_t *, longinteger_array, int64_array)
-IMPL_ASTARTE_DEVICE_STREAM_ARRAY_T_WITH_TIMESTAMP(const bool *, boolean_array, boolean_array)
-IMPL_ASTARTE_DEVICE_STREAM_ARRAY_T_WITH_TIMESTAMP(const char *const *, string_array, string_array)
-IMPL_ASTARTE_DEVICE_STREAM_ARRAY_T_WITH_TIMESTAMP(const int64_t *, datetime_array, datetime_array)
+astarte_err_t astarte_device_stream_aggregate_with_writer(astarte_device_handle_t device,
+    const char *interface_name, const char *path_prefix, astarte_device_aggregate_writer_t writer,
+    void *user_data, uint64_t ts_epoch_millis, int qos)
+{
+    struct astarte_device_interface unregistered;
+    return astarte_device_interface_stream_aggregate_with_writer(device,
+        get_interface_handle(device, interface_name, &unregistered), path_prefix, writer,
+        user_data, ts_epoch_millis, qos);
+}
 
-astarte_err_t astarte_device_stream_binaryblob_array_with_timestamp(astarte_device_handle_t device,
-    const char *interface_name, const char *path, const void *const *values, const int *sizes,
-    int count, uint64_t ts_epoch_millis, int qos)
+astarte_err_t astarte_device_interface_stream_struct(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path_prefix,
+    const astarte_bson_struct_field_t *fields, size_t fields_count, const void *value,
+    uint64_t ts_epoch_millis, int qos)
 {
-    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
+    if (!interface) {
+        ESP_LOGE(TAG, "Invalid interface handle");
+        return ASTARTE_ERR;
+    }
+    uint8_t bson_buf[PUBLISH_BSON_BUFFER_SIZE];
+    astarte_bson_serializer_storage_t bson_storage;
+    astarte_bson_serializer_handle_t bson
+        = astarte_bson_serializer_init_with_buffer(&bson_storage, bson_buf, sizeof(bson_buf));
+    astarte_bson_serializer_nested_t aggregate = astarte_bson_serializer_begin_document(bson, "v");
     astarte_err_t exit_code
-        = astarte_bson_serializer_append_binary_array(bson, "v", values, sizes, count);
+        = astarte_bson_serializer_append_struct(bson, fields, fields_count, value);
+    astarte_bson_serializer_end_document(bson, aggregate);
     maybe_append_timestamp(bson, ts_epoch_millis);
     astarte_bson_serializer_append_end_of_document(bson);
 
     if (exit_code == ASTARTE_OK) {
-        exit_code = publish_bson(device, interface_name, path, bson, qos);
+        exit_code = publish_bson(device, interface, path_prefix, bson, qos);
     }
 
-    astarte_bson_serializer_destroy(bson);
+    astarte_bson_serializer_deinit(bson);
     return exit_code;
 }
 
-astarte_err_t astarte_device_stream_aggregate_with_timestamp(astarte_device_handle_t device,
-    const char *interface_name, const char *path_prefix, const void *bson_document,
-    uint64_t ts_epoch_millis, int qos)
+astarte_err_t astarte_device_stream_struct(astarte_device_handle_t device,
+    const char *interface_name, const char *path_prefix, const astarte_bson_struct_field_t *fields,
+    size_t fields_count, const void *value, uint64_t ts_epoch_millis, int qos)
 {
-    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
-    astarte_bson_serializer_append_document(bson, "v", bson_document);
-    maybe_append_timestamp(bson, ts_epoch_millis);
-    astarte_bson_serializer_append_end_of_document(bson);
-
-    astarte_err_t exit_code = publish_bson(device, interface_name, path_prefix, bson, qos);
-
-    astarte_bson_serializer_destroy(bson);
-    return exit_code;
+    struct astarte_device_interface unregistered;
+    return astarte_device_interface_stream_struct(device,
+        get_interface_handle(device, interface_name, &unregistered), path_prefix, fields,
+        fields_count, value, ts_epoch_millis, qos);
 }
 
 astarte_err_t astarte_device_stream_double(astarte_device_handle_t device,
@@ -924,37 +2071,203 @@ astarte_err_t astarte_device_set_datetime_property(
     return astarte_device_stream_datetime(device, interface_name, path, value, 2);
 }
 
-astarte_err_t astarte_device_unset_path(
-    astarte_device_handle_t device, const char *interface_name, const char *path)
+#define IMPL_ASTARTE_DEVICE_INTERFACE_SET_T_PROPERTY(TYPE, TYPE_NAME)                             \
+    astarte_err_t astarte_device_interface_set_##TYPE_NAME##_property(                             \
+        astarte_device_handle_t device, astarte_device_interface_handle_t interface,               \
+        const char *path, TYPE value)                                                              \
+    {                                                                                              \
+        return astarte_device_interface_stream_##TYPE_NAME(                                        \
+            device, interface, path, value, ASTARTE_INVALID_TIMESTAMP, 2);                         \
+    }
+
+IMPL_ASTARTE_DEVICE_INTERFACE_SET_T_PROPERTY(double, double)
+IMPL_ASTARTE_DEVICE_INTERFACE_SET_T_PROPERTY(int32_t, integer)
+IMPL_ASTARTE_DEVICE_INTERFACE_SET_T_PROPERTY(int64_t, longinteger)
+IMPL_ASTARTE_DEVICE_INTERFACE_SET_T_PROPERTY(bool, boolean)
+IMPL_ASTARTE_DEVICE_INTERFACE_SET_T_PROPERTY(const char *, string)
+IMPL_ASTARTE_DEVICE_INTERFACE_SET_T_PROPERTY(int64_t, datetime)
+
+astarte_err_t astarte_device_interface_set_binaryblob_property(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path, void *value, size_t size)
+{
+    return astarte_device_interface_stream_binaryblob(
+        device, interface, path, value, size, ASTARTE_INVALID_TIMESTAMP, 2);
+}
+
+astarte_err_t astarte_device_interface_unset_path(
+    astarte_device_handle_t device, astarte_device_interface_handle_t interface, const char *path)
 {
+    if (!interface) {
+        ESP_LOGE(TAG, "Invalid interface handle");
+        return ASTARTE_ERR;
+    }
 #ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
-    astarte_interface_t *interface = get_interface_from_introspection(device, interface_name);
-    if (interface && (interface->type == TYPE_PROPERTIES)) {
-        // Open storage
-        astarte_storage_handle_t storage_handle;
-        astarte_err_t storage_err = astarte_storage_open(&storage_handle);
-        if (storage_err != ASTARTE_OK) {
-            ESP_LOGE(TAG, "Error opening storage.");
-            return ASTARTE_ERR;
-        }
-        // Delete property
-        ESP_LOGD(TAG, "Deleting device property '%s%s' from storage", interface_name, path);
-        storage_err = astarte_storage_delete_property(storage_handle, interface_name, path);
+    if (interface->interface && (interface->interface->type == TYPE_PROPERTIES)) {
+        ESP_LOGD(TAG, "Deleting device property '%s%s' from storage", interface->name, path);
+        astarte_err_t storage_err = delete_property(device, interface->name, path);
         if ((storage_err != ASTARTE_OK) && (storage_err != ASTARTE_ERR_NOT_FOUND)) {
-            ESP_LOGE(TAG, "Error deleting property from storage.");
-            astarte_storage_close(storage_handle);
             return ASTARTE_ERR;
         }
         if (storage_err == ASTARTE_ERR_NOT_FOUND) {
-            ESP_LOGW(TAG, "Trying to unset property already unset: '%s%s'.", interface_name, path);
-            astarte_storage_close(storage_handle);
+            ESP_LOGW(TAG, "Trying to unset property already unset: '%s%s'.", interface->name, path);
             return ASTARTE_OK;
         }
-        // Close storage
-        astarte_storage_close(storage_handle);
     }
 #endif
-    return publish_data(device, interface_name, path, "", 0, 2);
+    return publish_data(device, interface, path, "", 0, 2);
+}
+
+astarte_err_t astarte_device_unset_path(
+    astarte_device_handle_t device, const char *interface_name, const char *path)
+{
+    struct astarte_device_interface unregistered;
+    return astarte_device_interface_unset_path(
+        device, get_interface_handle(device, interface_name, &unregistered), path);
+}
+
+astarte_err_t astarte_device_interface_publish_async(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, const char *path,
+    astarte_bson_serializer_handle_t bson, int qos, astarte_device_publish_callback_t callback,
+    void *user_data, astarte_device_publish_ticket_t *ticket)
+{
+    if (!interface) {
+        ESP_LOGE(TAG, "Invalid interface handle");
+        return ASTARTE_ERR;
+    }
+    if (interface->interface && (interface->interface->type == TYPE_PROPERTIES)) {
+        // Device owned properties have to be stored before being sent, as the set property
+        // functions do
+        ESP_LOGE(TAG, "Only datastream interfaces can be published asynchronously: %s",
+            interface->name);
+        return ASTARTE_ERR;
+    }
+
+    if (qos < 0 || qos > 2) {
+        ESP_LOGE(TAG, "Invalid QoS: %d (must be 0, 1 or 2)", qos);
+        return ASTARTE_ERR_INVALID_QOS;
+    }
+
+    int len = 0;
+    const void *data = astarte_bson_serializer_get_document(bson, &len);
+    if (!data || (len < 0)) {
+        ESP_LOGE(TAG, "Error during BSON serialization");
+        return ASTARTE_ERR;
+    }
+
+    // Free the slots of messages that will never be acknowledged before waiting for one
+    expire_publishes(device);
+    if (xSemaphoreTake(device->publish_slots, pdMS_TO_TICKS(CONFIG_ASTARTE_PUBLISH_ASYNC_WAIT_MS))
+        == pdFALSE) {
+        ESP_LOGW(TAG, "Too many messages in flight, cannot publish on %s%s", interface->name, path);
+        return ASTARTE_ERR_TIMEOUT;
+    }
+
+    astarte_device_publish_ticket_t new_ticket = 0;
+    xSemaphoreTake(device->publish_tracker_mutex, portMAX_DELAY);
+    astarte_err_t err = astarte_publish_tracker_reserve(
+        &device->publish_tracker, callback, user_data, get_time_ms(), &new_ticket);
+    xSemaphoreGive(device->publish_tracker_mutex);
+    if (err != ASTARTE_OK) {
+        xSemaphoreGive(device->publish_slots);
+        return err;
+    }
+
+    int msg_id = -1;
+    char topic[TOPIC_LENGTH];
+    if (acquire_shared(device, DEVICE_READY_TIMEOUT_TICKS) != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Trying to publish to a device that is being reinitialized");
+        err = ASTARTE_ERR_DEVICE_NOT_READY;
+    } else {
+        err = build_topic(device, interface, path, topic);
+        if ((err == ASTARTE_OK) && !device->mqtt_client) {
+            ESP_LOGE(TAG, "Trying to publish to a device that is being reinitialized");
+            err = ASTARTE_ERR_DEVICE_NOT_READY;
+        }
+        if (err == ASTARTE_OK) {
+            ESP_LOGD(TAG, "Publishing on %s with QoS %d", topic, qos);
+            msg_id = esp_mqtt_client_publish(device->mqtt_client, topic, data, len, qos, 0);
+            if (msg_id < 0) {
+                ESP_LOGE(TAG, "Publish on %s failed", topic);
+                err = ASTARTE_ERR_PUBLISH;
+            }
+        }
+        release_shared(device);
+    }
+
+    // QoS 0 messages are never acknowledged, they are completed once handed to the MQTT client
+    astarte_publish_tracker_entry_t entry = {
+        .ticket = new_ticket,
+        .callback = callback,
+        .user_data = user_data,
+    };
+    bool completed = (err == ASTARTE_OK) && (qos == 0);
+    xSemaphoreTake(device->publish_tracker_mutex, portMAX_DELAY);
+    if ((err != ASTARTE_OK) || completed) {
+        astarte_publish_tracker_cancel(&device->publish_tracker, new_ticket);
+    } else {
+        completed = astarte_publish_tracker_set_msg_id(
+            &device->publish_tracker, new_ticket, msg_id, get_time_ms(), &entry);
+    }
+    xSemaphoreGive(device->publish_tracker_mutex);
+
+    if (err != ASTARTE_OK) {
+        xSemaphoreGive(device->publish_slots);
+        return err;
+    }
+
+    ESP_LOGD(TAG, "Publish succeeded, msg_id: %d, ticket: %" PRIu32, msg_id, new_ticket);
+    if (ticket) {
+        *ticket = new_ticket;
+    }
+    if (completed) {
+        complete_publish(device, &entry, ASTARTE_PUBLISH_RESULT_ACKED);
+    }
+    return ASTARTE_OK;
+}
+
+astarte_err_t astarte_device_publish_async(astarte_device_handle_t device,
+    const char *interface_name, const char *path, astarte_bson_serializer_handle_t bson, int qos,
+    astarte_device_publish_callback_t callback, void *user_data,
+    astarte_device_publish_ticket_t *ticket)
+{
+    struct astarte_device_interface unregistered;
+    return astarte_device_interface_publish_async(device,
+        get_interface_handle(device, interface_name, &unregistered), path, bson, qos, callback,
+        user_data, ticket);
+}
+
+astarte_err_t astarte_device_interface_set_offline_policy(astarte_device_handle_t device,
+    astarte_device_interface_handle_t interface, astarte_offline_policy_t policy)
+{
+    if (!interface) {
+        ESP_LOGE(TAG, "Invalid interface handle");
+        return ASTARTE_ERR;
+    }
+    if ((policy != ASTARTE_OFFLINE_POLICY_DROP_OLDEST)
+        && (policy != ASTARTE_OFFLINE_POLICY_DROP_NEWEST)
+        && (policy != ASTARTE_OFFLINE_POLICY_NONE)) {
+        ESP_LOGE(TAG, "Invalid offline policy: %d", policy);
+        return ASTARTE_ERR;
+    }
+    interface->offline_policy = policy;
+    return ASTARTE_OK;
+}
+
+astarte_err_t astarte_device_get_dispatcher_stats(
+    astarte_device_handle_t device, astarte_device_dispatcher_stats_t *stats)
+{
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+    stats->queued = uxQueueMessagesWaiting(device->dispatcher_frames);
+    stats->max_queued = atomic_load(&device->dispatcher_max_queued);
+    stats->dispatched = atomic_load(&device->dispatcher_dispatched);
+    stats->dropped = atomic_load(&device->dispatcher_dropped);
+    stats->oversized = atomic_load(&device->dispatcher_oversized);
+    return ASTARTE_OK;
+#else
+    (void) device;
+    (void) stats;
+    return ASTARTE_ERR_NOT_FOUND;
+#endif
 }
 
 bool astarte_device_is_connected(astarte_device_handle_t device)
@@ -1043,19 +2356,13 @@ static size_t get_int_string_size(int number)
 static size_t get_introspection_string_size(astarte_device_handle_t device)
 {
     size_t introspection_size = 0;
-    astarte_linked_list_iterator_t list_iter;
-    astarte_err_t iter_err = astarte_linked_list_iterator_init(&device->introspection, &list_iter);
-    while (iter_err != ASTARTE_ERR_NOT_FOUND) {
-        astarte_interface_t *interface = NULL;
-        astarte_linked_list_iterator_get_item(&list_iter, (void **) &interface);
-
-        size_t major_digits = get_int_string_size(interface->major_version);
-        size_t minor_digits = get_int_string_size(interface->minor_version);
+    for (astarte_device_interface_handle_t entry = device->introspection.head; entry;
+         entry = entry->next) {
+        size_t major_digits = get_int_string_size(entry->interface->major_version);
+        size_t minor_digits = get_int_string_size(entry->interface->minor_version);
 
         // The interface name in introspection is composed as  "name:major:minor;"
-        introspection_size += strlen(interface->name) + major_digits + minor_digits + 3;
-
-        iter_err = astarte_linked_list_iterator_advance(&list_iter);
+        introspection_size += entry->name_len + major_digits + minor_digits + 3;
     }
     return introspection_size;
 }
@@ -1083,16 +2390,10 @@ static void send_introspection(astarte_device_handle_t device)
     }
     int len = 0;
 
-    astarte_linked_list_iterator_t list_iter;
-    astarte_err_t iter_err = astarte_linked_list_iterator_init(&device->introspection, &list_iter);
-    while (iter_err != ASTARTE_ERR_NOT_FOUND) {
-        astarte_interface_t *interface = NULL;
-        astarte_linked_list_iterator_get_item(&list_iter, (void **) &interface);
-
-        len += sprintf(introspection_string + len, "%s:%d:%d;", interface->name,
-            interface->major_version, interface->minor_version);
-
-        iter_err = astarte_linked_list_iterator_advance(&list_iter);
+    for (astarte_device_interface_handle_t entry = device->introspection.head; entry;
+         entry = entry->next) {
+        len += sprintf(introspection_string + len, "%s:%d:%d;", entry->name,
+            entry->interface->major_version, entry->interface->minor_version);
     }
     // Remove last ; from introspection
     introspection_string[len - 1] = 0;
@@ -1124,15 +2425,11 @@ static void setup_subscriptions(astarte_device_handle_t device)
     ESP_LOGD(TAG, "Subscribing to %s", topic);
     esp_mqtt_client_subscribe(mqtt, topic, 2);
 
-    astarte_linked_list_iterator_t list_iter;
-    astarte_err_t iter_err = astarte_linked_list_iterator_init(&device->introspection, &list_iter);
-    while (iter_err != ASTARTE_ERR_NOT_FOUND) {
-        astarte_interface_t *interface = NULL;
-        astarte_linked_list_iterator_get_item(&list_iter, (void **) &interface);
-
-        if (interface->ownership == OWNERSHIP_SERVER) {
+    for (astarte_device_interface_handle_t entry = device->introspection.head; entry;
+         entry = entry->next) {
+        if (entry->interface->ownership == OWNERSHIP_SERVER) {
             // Subscribe to server interface subtopics
-            ret = snprintf(topic, TOPIC_LENGTH, "%s/%s/#", device->device_topic, interface->name);
+            ret = snprintf(topic, TOPIC_LENGTH, "%s/#", entry->topic_prefix);
             if ((ret < 0) || (ret >= TOPIC_LENGTH)) {
                 ESP_LOGE(TAG, "Error encoding topic");
                 continue;
@@ -1140,8 +2437,6 @@ static void setup_subscriptions(astarte_device_handle_t device)
             ESP_LOGD(TAG, "Subscribing to %s", topic);
             esp_mqtt_client_subscribe(mqtt, topic, 2);
         }
-
-        iter_err = astarte_linked_list_iterator_advance(&list_iter);
     }
 }
 
@@ -1170,79 +2465,77 @@ static void send_device_owned_properties(astarte_device_handle_t device)
         return;
     }
 
-    char *interface_name = NULL;
-    char *path = NULL;
-    uint8_t *value = NULL;
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+    // The stored properties are iterated, they should include the pending changes
+    flush_properties(device, true);
+#endif
 
-    astarte_linked_list_handle_t list_handle = astarte_linked_list_init();
+    astarte_storage_scratch_t scratch;
+    astarte_storage_scratch_init(&scratch);
+    bool completed = false;
 
-    // Open storage
-    astarte_storage_handle_t storage_handle;
-    astarte_err_t storage_err = astarte_storage_open(&storage_handle);
+    // The list of the device owned properties is compressed while the properties are read
+    xSemaphoreTake(device->zlib_mutex, portMAX_DELAY);
+    astarte_zlib_compressor_t compressor;
+    int compress_res = astarte_zlib_compressor_init(
+        &compressor, &device->zlib_context, PURGE_PROPERTIES_HEADER_LENGTH);
+    if (compress_res != Z_OK) {
+        ESP_LOGE(TAG, "Compression error %d.", compress_res);
+        goto end;
+    }
+
+    // The outdated properties are deleted in a single transaction
+    xSemaphoreTake(device->property_mutex, portMAX_DELAY);
+    astarte_err_t storage_err = open_storage(device);
+    if (storage_err == ASTARTE_OK) {
+        storage_err = astarte_storage_begin_transaction(device->storage_handle);
+    }
     if (storage_err != ASTARTE_OK) {
-        ESP_LOGE(TAG, "Error opening storage.");
+        xSemaphoreGive(device->property_mutex);
         goto end;
     }
 
     // Create iterator
     astarte_storage_iterator_t storage_iterator;
-    storage_err = astarte_storage_iterator_create(storage_handle, &storage_iterator);
+    storage_err = astarte_storage_iterator_create(device->storage_handle, &storage_iterator);
     if ((storage_err != ASTARTE_OK) && (storage_err != ASTARTE_ERR_NOT_FOUND)) {
         ESP_LOGE(TAG, "Error creating the properties iterator.");
-        astarte_storage_close(storage_handle);
-        goto end;
+        goto unlock;
     }
 
     while (storage_err == ASTARTE_OK) {
-        // Fetch property len
-        size_t interface_name_len = 0;
-        size_t path_len = 0;
-        size_t value_len = 0;
-        storage_err = astarte_storage_iterator_get_property(
-            &storage_iterator, NULL, &interface_name_len, NULL, &path_len, NULL, NULL, &value_len);
-        if (storage_err != ASTARTE_OK) {
-            ESP_LOGE(TAG, "Error preparing to get one of the properties.");
-            astarte_storage_close(storage_handle);
-            goto end;
-        }
-        // Allocate memory for property data
-        interface_name = calloc(interface_name_len, sizeof(char));
-        path = calloc(path_len, sizeof(char));
-        value = calloc(value_len, sizeof(uint8_t));
-        if (!interface_name || !path || !value) {
-            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
-            astarte_storage_close(storage_handle);
-            goto end;
-        }
-        // Fetch property content
-        int32_t major = 0;
-        storage_err = astarte_storage_iterator_get_property(&storage_iterator, interface_name,
-            &interface_name_len, path, &path_len, &major, value, &value_len);
+        // Fetch the property, reusing the same buffers for all the properties
+        astarte_storage_property_t property;
+        storage_err
+            = astarte_storage_iterator_read_property(&storage_iterator, &scratch, &property);
         if (storage_err != ASTARTE_OK) {
             ESP_LOGE(TAG, "Error getting one of the properties.");
-            astarte_storage_close(storage_handle);
-            goto end;
+            goto unlock;
         }
+        const char *interface_name = property.interface_name;
+        const char *path = property.path;
 
         bool advance_iterator = true;
-        astarte_interface_t *interface = get_interface_from_introspection(device, interface_name);
+        astarte_device_interface_handle_t entry = astarte_introspection_get(
+            &device->introspection, interface_name, strlen(interface_name));
+        const astarte_interface_t *interface = (entry) ? entry->interface : NULL;
         // If property is not in introspection anymore, delete it from storage
-        if ((!interface) || (interface->major_version != major)) {
+        if ((!interface) || (interface->major_version != property.major)) {
             // Check if this is the last iterable item
             bool has_next = false;
             storage_err = astarte_storage_iterator_peek(&storage_iterator, &has_next);
             if (storage_err != ASTARTE_OK) {
                 ESP_LOGE(TAG, "Error peaking next property.");
-                astarte_storage_close(storage_handle);
-                goto end;
+                goto unlock;
             }
             // Delete the property
             ESP_LOGD(TAG, "Deleting old property '%s%s' from storage", interface_name, path);
-            storage_err = astarte_storage_delete_property(storage_handle, interface_name, path);
+            astarte_property_cache_remove(&device->property_cache, interface_name, path);
+            storage_err = astarte_storage_delete_property(
+                device->storage_handle, interface_name, path);
             if ((storage_err != ASTARTE_OK) && (storage_err != ASTARTE_ERR_NOT_FOUND)) {
                 ESP_LOGE(TAG, "Error deleting the property.");
-                astarte_storage_close(storage_handle);
-                goto end;
+                goto unlock;
             }
             // If the deleted iterm was the last one, break the loop here
             if (!has_next) {
@@ -1255,30 +2548,15 @@ static void send_device_owned_properties(astarte_device_handle_t device)
         else if (interface->ownership == OWNERSHIP_DEVICE) {
             // Assuming that since the property is present in storage the size of the value
             // has already been checked and does not exceed the max value for an integer.
-            publish_data(device, interface_name, path, value, (int) value_len, 2);
-
-            // Get the combined interface_name and path for the property
-            size_t property_full_path_len = interface_name_len + path_len - 1;
-            char *property_full_path = calloc(property_full_path_len, sizeof(char));
-            strncat(strncpy(property_full_path, interface_name, interface_name_len), path,
-                path_len - 1);
-
-            // Store the property full path in a temporary set
-            astarte_err_t list_err = astarte_linked_list_append(&list_handle, property_full_path);
-            if (list_err != ASTARTE_OK) {
-                ESP_LOGE(TAG, "Error adding a property name to the set %s.",
-                    astarte_err_to_name(list_err));
-                astarte_storage_close(storage_handle);
-                goto end;
+            publish_data(device, entry, path, property.data, (int) property.data_len, 2);
+
+            // Add the property to the compressed list of the device owned properties
+            compress_res = append_purge_device_property(&compressor, interface_name, path);
+            if (compress_res != Z_OK) {
+                ESP_LOGE(TAG, "Compression error %d.", compress_res);
+                goto unlock;
             }
         }
-        // Free memory of property data
-        free(interface_name);
-        interface_name = NULL;
-        free(path);
-        path = NULL;
-        free(value);
-        value = NULL;
         // Advance the iterator if required
         if (advance_iterator) {
             storage_err = astarte_storage_iterator_advance(&storage_iterator);
@@ -1288,112 +2566,78 @@ static void send_device_owned_properties(astarte_device_handle_t device)
         }
     }
 
-    // Close astarte storage
-    astarte_storage_close(storage_handle);
+    completed = true;
+
+unlock:
+    if (astarte_storage_commit_transaction(device->storage_handle) != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Error committing the properties to storage.");
+    }
+    xSemaphoreGive(device->property_mutex);
 
     // Send purge device properties
-    send_purge_device_properties(device, &list_handle);
+    if (completed) {
+        send_purge_device_properties(device, &compressor);
+    }
 
 end:
-    // Destroy the set
-    astarte_linked_list_destroy_and_release(&list_handle);
+    astarte_zlib_compressor_destroy(&compressor);
+#ifndef CONFIG_ASTARTE_PURGE_PROPERTIES_ZLIB_KEEP_STATE
+    astarte_zlib_context_release(&device->zlib_context);
+#endif
+    xSemaphoreGive(device->zlib_mutex);
+    astarte_storage_scratch_destroy(&scratch);
+}
 
-    // Free all data
-    free(interface_name);
-    free(path);
-    free(value);
+static int append_purge_device_property(
+    astarte_zlib_compressor_t *compressor, const char *interface_name, const char *path)
+{
+    // The properties are separated by a ';' char
+    int res = Z_OK;
+    if (compressor->stream->total_in > 0) {
+        res = astarte_zlib_compressor_append(compressor, ";", 1);
+    }
+    if (res == Z_OK) {
+        res = astarte_zlib_compressor_append(compressor, interface_name, strlen(interface_name));
+    }
+    if (res == Z_OK) {
+        res = astarte_zlib_compressor_append(compressor, path, strlen(path));
+    }
+    return res;
 }
 
 static void send_purge_device_properties(
-    astarte_device_handle_t device, astarte_linked_list_handle_t *list_handle)
+    astarte_device_handle_t device, astarte_zlib_compressor_t *compressor)
 {
-    // Pointer to string that will contain a list of interface names separated by the ';' char
-    char *properties_list = NULL;
-    // Size of the string contained in properties_list including the '\0' terminating char
-    size_t properties_list_len = 0;
-
-    char *payload = NULL;
     size_t payload_len = 0;
-
-    // Create the uncompressed properties string
-    char *property_path = NULL;
-    while (astarte_linked_list_remove_tail(list_handle, (void **) &property_path)
-        != ASTARTE_ERR_NOT_FOUND) {
-        // Append interface name to the ';' separated string
-        // properties_list_len includes a +1 for the '\0' char
-        // We add 1 since we need an extra char to store the ';'
-        size_t ext_properties_list_len = properties_list_len + strlen(property_path) + 1;
-        char *ext_properties_list = (char *) realloc(properties_list, ext_properties_list_len);
-        if (!ext_properties_list) {
-            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
-            free(property_path);
-            // Deallocate everything from the set
-            while (astarte_linked_list_remove_tail(list_handle, (void **) &property_path)
-                != ASTARTE_ERR_NOT_FOUND) {
-                free(property_path);
-            }
-            goto end;
-        }
-        if (properties_list_len == 0) {
-            // Set the first char to '\0' for the first interface name
-            *ext_properties_list = '\0';
-        } else {
-            // Append a ';' for any subsequent interface name
-            strcat(ext_properties_list, ";");
-        }
-        // Append the new interface name
-        properties_list = strcat(ext_properties_list, property_path);
-        properties_list_len = ext_properties_list_len;
-
-        free(property_path);
-    }
-
-    // Estimate compression result size and payload size
-    size_t compression_input_len = (properties_list) ? (properties_list_len - 1) : 0;
-    uLongf compressed_len = compressBound(compression_input_len);
-    // Allocate enough memory for the payload
-    payload_len = 4 + compressed_len;
-    payload = calloc(payload_len, sizeof(char));
-    if (!payload) {
-        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
-        goto end;
-    }
-    // Fill the first 32 bits of the payload
-    uint32_t *payload_uint32 = (uint32_t *) payload;
-    *payload_uint32 = __builtin_bswap32(compression_input_len);
-    // Perform the compression and store result in the payload
-    int compress_res = astarte_zlib_compress((char unsigned *) &payload[4], &compressed_len,
-        (char unsigned *) properties_list, compression_input_len);
+    int compress_res = astarte_zlib_compressor_finish(compressor, &payload_len);
     if (compress_res != Z_OK) {
         ESP_LOGE(TAG, "Compression error %d.", compress_res);
-        goto end;
+        return;
     }
-    // 'astarte_zlib_compress' updates 'compressed_len' to the actual size of the compressed data
-    payload_len = 4 + compressed_len;
     // Check if payload is not too large for a MQTT message
     if (payload_len > INT_MAX) {
         // MQTT supports sending a maximum payload length of INT_MAX
         ESP_LOGE(TAG, "Purge properties payload is too long for a single MQTT message.");
-        goto end;
+        return;
     }
+    // Fill the first 32 bits of the payload, reserved by the compressor
+    char *payload = (char *) compressor->buffer;
+    uint32_t uncompressed_len = __builtin_bswap32((uint32_t) compressor->stream->total_in);
+    memcpy(payload, &uncompressed_len, PURGE_PROPERTIES_HEADER_LENGTH);
 
     // Compose MQTT topic
     char topic[TOPIC_LENGTH] = { 0 };
     int ret = snprintf(topic, TOPIC_LENGTH, "%s/control/producer/properties", device->device_topic);
     if ((ret < 0) || (ret >= TOPIC_LENGTH)) {
         ESP_LOGE(TAG, "Error encoding topic");
-        goto end;
+        return;
     }
     // Set constant for MQTT QoS
     const int qos = 2;
     // Publish MQTT message
-    ESP_LOGD(TAG, "Sending purge properties to: '%s', with uncompressed content: '%s'", topic,
-        (properties_list) ? properties_list : "");
+    ESP_LOGD(TAG, "Sending purge properties to: '%s', with uncompressed length: %lu", topic,
+        (unsigned long) compressor->stream->total_in);
     esp_mqtt_client_publish(device->mqtt_client, topic, payload, (int) payload_len, qos, 0);
-
-end:
-    free(properties_list);
-    free(payload);
 }
 #endif
 
@@ -1411,21 +2655,27 @@ static void on_connected(astarte_device_handle_t device, int session_present)
         device->connection_event_callback(&event);
     }
 
-    if (session_present) {
-        return;
+    if (!session_present) {
+        setup_subscriptions(device);
+        send_introspection(device);
+        send_emptycache(device);
+#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
+        send_device_owned_properties(device);
+#endif
     }
 
-    setup_subscriptions(device);
-    send_introspection(device);
-    send_emptycache(device);
-#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
-    send_device_owned_properties(device);
+#ifdef CONFIG_ASTARTE_USE_OFFLINE_QUEUE
+    // Queued messages are published once the introspection has been sent
+    xTaskNotify(device->offline_queue_task_handle, NOTIFY_DRAIN, eSetBits);
 #endif
 }
 
 static void on_disconnected(astarte_device_handle_t device)
 {
     device->connected = false;
+    // The remaining fragments of a message are not received after a disconnection
+    astarte_reassembly_reset(&device->reassembly);
+    stop_stream(device, true);
 
     if (device->disconnection_event_callback) {
         astarte_device_disconnection_event_t event = {
@@ -1437,106 +2687,202 @@ static void on_disconnected(astarte_device_handle_t device)
     }
 }
 
-static void on_incoming(
-    astarte_device_handle_t device, char *topic, int topic_len, char *data, int data_len)
+static void on_published(
+    astarte_device_handle_t device, int msg_id, astarte_device_publish_result_t result)
 {
-    if (check_device(device) != ASTARTE_OK) {
+    astarte_publish_tracker_entry_t entry;
+    xSemaphoreTake(device->publish_tracker_mutex, portMAX_DELAY);
+    // Acknowledgments can be received before the message id is returned to the publishing task
+    astarte_err_t err = astarte_publish_tracker_complete(&device->publish_tracker, msg_id,
+        result == ASTARTE_PUBLISH_RESULT_ACKED, get_time_ms(), &entry);
+    xSemaphoreGive(device->publish_tracker_mutex);
+    if (err == ASTARTE_OK) {
+        complete_publish(device, &entry, result);
+    }
+    expire_publishes(device);
+}
+
+static void on_data(astarte_device_handle_t device, esp_mqtt_event_handle_t event)
+{
+    // Messages larger than the buffer of the MQTT client are received in several fragments
+    if (event->total_data_len <= event->data_len) {
+        handle_incoming(device, event->topic, event->topic_len, event->data, event->data_len);
         return;
     }
 
-    if (!device->data_event_callback) {
-        ESP_LOGE(TAG, "data_event_callback not set");
+    // Only the first fragment has a topic, a new message drops the one being streamed
+    if (event->current_data_offset == 0) {
+        stop_stream(device, true);
+        start_stream(device, event->topic, event->topic_len);
+    }
+    if (device->stream_topic) {
+        feed_stream(device, event);
         return;
     }
 
-    if (strstr(topic, device->device_topic) != topic) {
-        ESP_LOGE(TAG, "Incoming message topic doesn't begin with device_topic: %s", topic);
+    bool complete = false;
+    astarte_err_t err = astarte_reassembly_add(&device->reassembly, event->topic,
+        event->topic_len, event->data, event->data_len, event->current_data_offset,
+        event->total_data_len, &complete);
+    if (err == ASTARTE_ERR_NOT_FOUND) {
+        ESP_LOGD(TAG, "Discarding a fragment of a dropped message");
+        return;
+    }
+    if (err != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Cannot reassemble an incoming message of %d bytes: %s",
+            event->total_data_len, astarte_err_to_name(err));
         return;
     }
+    if (complete) {
+        handle_incoming(device, device->reassembly.buffer, device->reassembly.topic_len,
+            astarte_reassembly_data(&device->reassembly), device->reassembly.data_len);
+    }
+}
 
-    char control_prefix[TOPIC_LENGTH] = { 0 };
-    int ret = snprintf(control_prefix, TOPIC_LENGTH, "%s/control", device->device_topic);
-    if ((ret < 0) || (ret >= TOPIC_LENGTH)) {
-        ESP_LOGE(TAG, "Error encoding control prefix");
+static bool start_stream(astarte_device_handle_t device, const char *topic, int topic_len)
+{
+    size_t device_topic_len = device->device_topic_len;
+    if (!device->device_topic || (topic_len <= device_topic_len + strlen("/"))
+        || (memcmp(topic, device->device_topic, device_topic_len) != 0)
+        || (topic[device_topic_len] != '/')) {
+        return false;
+    }
+    const char *interface_name = topic + device_topic_len + strlen("/");
+    const char *topic_end = topic + topic_len;
+    const char *path = memchr(interface_name, '/', topic_end - interface_name);
+    if (!path) {
+        return false;
+    }
+    size_t interface_name_len = path - interface_name;
+    // Control messages never match an interface
+    astarte_device_interface_handle_t entry
+        = astarte_introspection_get(&device->introspection, interface_name, interface_name_len);
+    if (!entry || !entry->stream_callback) {
+        return false;
+    }
+
+    if (!join_topic_views(device->stream_topic_buffer, interface_name, interface_name_len, path,
+            topic_end - path)) {
+        return false;
+    }
+    device->stream_topic = device->stream_topic_buffer;
+    device->stream_path = device->stream_topic + interface_name_len + 1;
+    // The callback is copied, so that it can be changed while a message is streamed
+    device->stream_callback = entry->stream_callback;
+    device->stream_user_data = entry->stream_user_data;
+    astarte_bson_parser_init(&device->stream_parser, on_stream_event, device);
+    return true;
+}
+
+static void feed_stream(astarte_device_handle_t device, esp_mqtt_event_handle_t event)
+{
+    astarte_err_t err
+        = astarte_bson_parser_feed(&device->stream_parser, event->data, event->data_len);
+    if (err != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Cannot parse the streamed message: %s", astarte_err_to_name(err));
+        stop_stream(device, true);
         return;
     }
+    if (event->current_data_offset + event->data_len < event->total_data_len) {
+        return;
+    }
+    if (!astarte_bson_parser_is_complete(&device->stream_parser)) {
+        ESP_LOGE(TAG, "Streamed message ended before the end of its BSON document");
+        stop_stream(device, true);
+        return;
+    }
+    stop_stream(device, false);
+}
 
-    // Control message
-    size_t control_prefix_len = strlen(control_prefix);
-    if (strstr(topic, control_prefix)) {
-        char *control_topic = topic + control_prefix_len;
-        ESP_LOGD(TAG, "Received control message on control topic %s", control_topic);
-        on_control_message(device, control_topic, data, data_len);
+static void stop_stream(astarte_device_handle_t device, bool dropped)
+{
+    if (!device->stream_topic) {
         return;
     }
+    if (dropped) {
+        on_stream_event(NULL, device);
+    }
+    device->stream_topic = NULL;
+    device->stream_path = NULL;
+}
 
-    // Data message
-    if (topic_len < device->device_topic_len + strlen("/")
-        || topic[device->device_topic_len] != '/') {
-        ESP_LOGE(TAG, "No / after device_topic, can't find interface: %s", topic);
+static astarte_err_t on_stream_event(const astarte_bson_parser_event_t *bson_event, void *ctx)
+{
+    astarte_device_handle_t device = (astarte_device_handle_t) ctx;
+    astarte_device_stream_event_t event = {
+        .device = device,
+        .interface_name = device->stream_topic,
+        .path = device->stream_path,
+        .bson_event = bson_event,
+        .user_data = device->stream_user_data,
+    };
+    return device->stream_callback(&event);
+}
+
+static void handle_incoming(
+    astarte_device_handle_t device, char *topic, int topic_len, char *data, int data_len)
+{
+#ifdef CONFIG_ASTARTE_DISPATCHER_TASK
+    enqueue_incoming(device, topic, topic_len, data, data_len);
+#else
+    on_incoming(device, topic, topic_len, data, data_len);
+#endif
+}
+
+static void on_incoming(
+    astarte_device_handle_t device, char *topic, int topic_len, char *data, int data_len)
+{
+    if (check_device(device) != ASTARTE_OK) {
+        return;
+    }
+
+    // The topic is not NULL terminated, it is only accessed through its length
+    size_t device_topic_len = device->device_topic_len;
+    if ((topic_len < device_topic_len)
+        || (memcmp(topic, device->device_topic, device_topic_len) != 0)) {
+        ESP_LOGE(TAG, "Incoming message topic doesn't begin with device_topic: %.*s", topic_len,
+            topic);
+        return;
+    }
+    const char *topic_end = topic + topic_len;
+    const char *topic_suffix = topic + device_topic_len;
+    size_t topic_suffix_len = topic_end - topic_suffix;
+
+    // Control message
+    const char control_prefix[] = "/control";
+    const size_t control_prefix_len = strlen(control_prefix);
+    if ((topic_suffix_len > control_prefix_len)
+        && (memcmp(topic_suffix, control_prefix, control_prefix_len) == 0)
+        && (topic_suffix[control_prefix_len] == '/')) {
+        const char *control_topic = topic_suffix + control_prefix_len;
+        size_t control_topic_len = topic_suffix_len - control_prefix_len;
+        ESP_LOGD(TAG, "Received control message on control topic %.*s", (int) control_topic_len,
+            control_topic);
+        on_control_message(device, control_topic, control_topic_len, data, data_len);
         return;
     }
 
-    char *interface_name_begin = topic + device->device_topic_len + strlen("/");
-    char *path_begin = strchr(interface_name_begin, '/');
-    if (!path_begin) {
-        ESP_LOGE(TAG, "No / after interface_name, can't find path: %s", topic);
+    // Data message
+    if ((topic_suffix_len < strlen("/")) || (topic_suffix[0] != '/')) {
+        ESP_LOGE(TAG, "No / after device_topic, can't find interface: %.*s", topic_len, topic);
         return;
     }
 
-    int interface_name_len = path_begin - interface_name_begin;
-    char interface_name[INTERFACE_LENGTH] = { 0 };
-    ret = snprintf(
-        interface_name, INTERFACE_LENGTH, "%.*s", interface_name_len, interface_name_begin);
-    if ((ret < 0) || (ret >= INTERFACE_LENGTH)) {
-        ESP_LOGE(TAG, "Error encoding interface name");
+    const char *interface_name = topic_suffix + strlen("/");
+    const char *path = memchr(interface_name, '/', topic_end - interface_name);
+    if (!path) {
+        ESP_LOGE(TAG, "No / after interface_name, can't find path: %.*s", topic_len, topic);
         return;
     }
-
-    size_t path_len = topic_len - device->device_topic_len - strlen("/") - interface_name_len;
-    char path[PATH_LENGTH] = { 0 };
-    ret = snprintf(path, PATH_LENGTH, "%.*s", path_len, path_begin);
-    if ((ret < 0) || (ret >= PATH_LENGTH)) {
-        ESP_LOGE(TAG, "Error encoding path");
+    size_t interface_name_len = path - interface_name;
+    size_t path_len = topic_end - path;
+    if ((interface_name_len >= INTERFACE_LENGTH) || (path_len >= PATH_LENGTH)) {
+        ESP_LOGE(TAG, "Interface name or path too long: %.*s", topic_len, topic);
         return;
     }
 
     if (!data && data_len == 0) {
-#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
-        astarte_interface_t *interface = get_interface_from_introspection(device, interface_name);
-        if (interface && (interface->type == TYPE_PROPERTIES)) {
-            // Open storage
-            astarte_storage_handle_t storage_handle;
-            astarte_err_t storage_err = astarte_storage_open(&storage_handle);
-            if (storage_err != ASTARTE_OK) {
-                ESP_LOGE(TAG, "Error opening storage.");
-                return;
-            }
-            // Delete property
-            ESP_LOGD(TAG, "Deleting server property '%s%s' from storage", interface_name, path);
-            storage_err = astarte_storage_delete_property(storage_handle, interface_name, path);
-            if ((storage_err != ASTARTE_OK) && (storage_err != ASTARTE_ERR_NOT_FOUND)) {
-                ESP_LOGE(TAG, "Error deleting property from storage.");
-            }
-            // Close storage
-            astarte_storage_close(storage_handle);
-            if (storage_err != ASTARTE_OK) {
-                return;
-            }
-        }
-#endif
-        if (device->unset_event_callback) {
-            astarte_device_unset_event_t event = {
-                .device = device,
-                .interface_name = interface_name,
-                .path = path,
-                .user_data = device->callbacks_user_data,
-            };
-            device->unset_event_callback(&event);
-        } else {
-            ESP_LOGE(
-                TAG, "Unset data for %s received, but unset_event_callback is not defined", path);
-        }
+        on_unset(device, interface_name, interface_name_len, path, path_len);
         return;
     }
 
@@ -1545,295 +2891,461 @@ static void on_incoming(
         return;
     }
 
+    astarte_device_interface_handle_t entry
+        = astarte_introspection_get(&device->introspection, interface_name, interface_name_len);
+    const astarte_route_node_t *route
+        = (entry) ? astarte_routes_match(&entry->routes, path, path_len) : NULL;
+    if (!route && !device->data_event_callback && !device->data_view_event_callback) {
+        ESP_LOGE(TAG, "data_event_callback not set");
+        return;
+    }
+
 #ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
-    astarte_interface_t *interface = get_interface_from_introspection(device, interface_name);
-    if (interface && (interface->type == TYPE_PROPERTIES)) {
-        // Open storage
-        astarte_storage_handle_t storage_handle;
-        astarte_err_t storage_err = astarte_storage_open(&storage_handle);
-        if (storage_err != ASTARTE_OK) {
-            ESP_LOGE(TAG, "Error opening storage.");
+    if (entry && (entry->interface->type == TYPE_PROPERTIES)) {
+        // The storage requires NULL terminated strings, only properties are copied
+        char *property_name = device->incoming_topic;
+        if (!join_topic_views(property_name, interface_name, interface_name_len, path, path_len)) {
             return;
         }
-        // Check if property is already stored in nvs with same value
-        bool is_contained = false;
-        storage_err = astarte_storage_contains_property(storage_handle, interface_name, path,
-            interface->major_version, data, data_len, &is_contained);
+        bool changed = false;
+        astarte_err_t storage_err = store_property(device, property_name,
+            property_name + interface_name_len + 1, entry->interface->major_version, data,
+            data_len, &changed);
         if (storage_err != ASTARTE_OK) {
-            ESP_LOGE(TAG, "Error checking if received property is in storage.");
-            astarte_storage_close(storage_handle);
             return;
         }
-        if (is_contained) {
+        if (!changed) {
             ESP_LOGD(TAG,
-                "Trying to set a server property already stored with the same value: %s%s.",
-                interface_name, path);
-            astarte_storage_close(storage_handle);
+                "Trying to set a server property already stored with the same value: %.*s.",
+                topic_len, topic);
             return;
         }
+    }
+#endif
 
-        // Store property
-        ESP_LOGD(TAG, "Storing server property: '%s%s'.", interface_name, path);
-        storage_err = astarte_storage_store_property(
-            storage_handle, interface_name, path, interface->major_version, data, data_len);
+    astarte_bson_document_t full_document = astarte_bson_deserializer_init_doc(data);
+    astarte_bson_element_t v_elem;
+    if (astarte_bson_deserializer_element_lookup(full_document, "v", &v_elem) != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Cannot retrieve BSON value from data");
+        return;
+    }
+
+    // Routes registered for the interface take precedence over the device callbacks
+    if (route || device->data_view_event_callback) {
+        astarte_device_data_view_event_t event = {
+            .device = device,
+            .interface_name = interface_name,
+            .interface_name_len = interface_name_len,
+            .path = path,
+            .path_len = path_len,
+            .bson_element = v_elem,
+            .user_data = (route) ? route->user_data : device->callbacks_user_data,
+        };
+        if (route) {
+            route->callback(&event);
+        } else {
+            device->data_view_event_callback(&event);
+        }
+        return;
+    }
+
+    dispatch_data_event(device, interface_name, interface_name_len, path, path_len, data, v_elem);
+}
+
+static void on_unset(astarte_device_handle_t device, const char *interface_name,
+    size_t interface_name_len, const char *path, size_t path_len)
+{
+    char *property_name = device->incoming_topic;
+    if (!join_topic_views(property_name, interface_name, interface_name_len, path, path_len)) {
+        return;
+    }
+    const char *path_copy = property_name + interface_name_len + 1;
+
+#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
+    astarte_interface_t *interface = get_interface_from_introspection(device, property_name);
+    if (interface && (interface->type == TYPE_PROPERTIES)) {
+        ESP_LOGD(TAG, "Deleting server property '%s%s' from storage", property_name, path_copy);
+        astarte_err_t storage_err = delete_property(device, property_name, path_copy);
         if (storage_err != ASTARTE_OK) {
-            ESP_LOGE(TAG, "Error storing received property.");
-            astarte_storage_close(storage_handle);
             return;
         }
-        // Close storage
-        astarte_storage_close(storage_handle);
     }
 #endif
+    if (device->unset_event_callback) {
+        astarte_device_unset_event_t event = {
+            .device = device,
+            .interface_name = property_name,
+            .path = path_copy,
+            .user_data = device->callbacks_user_data,
+        };
+        device->unset_event_callback(&event);
+    } else {
+        ESP_LOGE(TAG, "Unset data for %s received, but unset_event_callback is not defined",
+            path_copy);
+    }
+}
 
-    // Keep old deserializer for compatibility
+static void dispatch_data_event(astarte_device_handle_t device, const char *interface_name,
+    size_t interface_name_len, const char *path, size_t path_len, char *data,
+    astarte_bson_element_t v_elem)
+{
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
     uint8_t bson_value_type = 0U;
-    const void *bson_value = astarte_bson_key_lookup("v", data, &bson_value_type);
+    const void *bson_value = NULL;
+#ifdef CONFIG_ASTARTE_DEPRECATED_BSON_VALUE
+    // Keep old deserializer for compatibility
+    bson_value = astarte_bson_key_lookup("v", data, &bson_value_type);
     if (!bson_value) {
         ESP_LOGE(TAG, "Cannot retrieve BSON value from data");
         return;
     }
-#pragma GCC diagnostic pop
+#endif
 
-    // Use new deserializer
-    astarte_bson_document_t full_document = astarte_bson_deserializer_init_doc(data);
-    astarte_bson_element_t v_elem;
-    if (astarte_bson_deserializer_element_lookup(full_document, "v", &v_elem) != ASTARTE_OK) {
-        ESP_LOGE(TAG, "Cannot retrieve BSON value from data");
+    // The event exposes NULL terminated strings
+    char *property_name = device->incoming_topic;
+    if (!join_topic_views(property_name, interface_name, interface_name_len, path, path_len)) {
         return;
     }
 
     astarte_device_data_event_t event = {
         .device = device,
-        .interface_name = interface_name,
-        .path = path,
+        .interface_name = property_name,
+        .path = property_name + interface_name_len + 1,
         .bson_value = bson_value,
         .bson_value_type = bson_value_type,
         .bson_element = v_elem,
         .user_data = device->callbacks_user_data,
     };
+#pragma GCC diagnostic pop
 
     device->data_event_callback(&event);
 }
 
+static bool join_topic_views(char *joined, const char *interface_name, size_t interface_name_len,
+    const char *path, size_t path_len)
+{
+    // Interface name and path are copied one after the other in a TOPIC_VIEWS_BUFFER_SIZE buffer,
+    // each one NULL terminated
+    if ((interface_name_len >= INTERFACE_LENGTH) || (path_len >= PATH_LENGTH)) {
+        ESP_LOGE(TAG, "Topic too long: %.*s%.*s", (int) interface_name_len, interface_name,
+            (int) path_len, path);
+        return false;
+    }
+    memcpy(joined, interface_name, interface_name_len);
+    joined[interface_name_len] = '\0';
+    memcpy(joined + interface_name_len + 1, path, path_len);
+    joined[interface_name_len + 1 + path_len] = '\0';
+    return true;
+}
+
 // NOLINTBEGIN(misc-unused-parameters)
-static void on_control_message(
-    astarte_device_handle_t device, char *control_topic, char *data, int data_len)
+static void on_control_message(astarte_device_handle_t device, const char *control_topic,
+    size_t control_topic_len, char *data, int data_len)
 // NOLINTEND(misc-unused-parameters)
 {
-    if (strcmp(control_topic, "/consumer/properties") == 0) {
+    const char purge_topic[] = "/consumer/properties";
+    if ((control_topic_len == strlen(purge_topic))
+        && (memcmp(control_topic, purge_topic, control_topic_len) == 0)) {
 #ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
         on_purge_properties(device, data, data_len);
 #endif
     } else {
-        ESP_LOGE(TAG, "Received unrecognized control message: %s.", control_topic);
+        ESP_LOGE(TAG, "Received unrecognized control message: %.*s.", (int) control_topic_len,
+            control_topic);
     }
 }
 
 #ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
 static void on_purge_properties(astarte_device_handle_t device, char *data, int data_len)
 {
-    char *uncompressed = NULL;
-    uLongf uncompressed_len = 0;
-    astarte_err_t uncompress_err
-        = uncompress_purge_properties(data, data_len, &uncompressed, &uncompressed_len);
-    if (uncompress_err != ASTARTE_OK) {
-        ESP_LOGE(TAG, "Failed uncompressing the purge properties %s.",
-            astarte_err_to_name(uncompress_err));
+    if (data_len < PURGE_PROPERTIES_HEADER_LENGTH) {
+        ESP_LOGE(TAG, "Malformed purge properties message.");
         return;
     }
 
-    ESP_LOGD(TAG, "Received purge properties: '%s'", (uncompressed) ? uncompressed : "");
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+    // The stored properties are iterated, they should include the pending changes
+    flush_properties(device, true);
+#endif
 
-    // Split the payload in individual properties and store them in a list
-    astarte_linked_list_handle_t list_handle = astarte_linked_list_init();
-    if (uncompressed_len != 0) {
-        char *property = strtok(uncompressed, ";");
-        if (!property) {
-            ESP_LOGE(TAG, "Error parsing the purge property message %s.", uncompressed);
-            goto end;
-        }
-        do {
-            if (ASTARTE_OK != astarte_linked_list_append(&list_handle, property)) {
-                ESP_LOGE(TAG, "Error appending entry to linked list.");
-                goto end;
-            }
-            property = strtok(NULL, ";");
-        } while (property);
-    }
+    astarte_storage_scratch_t scratch;
+    astarte_storage_scratch_init(&scratch);
+    purge_candidates_t purge_candidates = { 0 };
 
-    // Open storage
-    astarte_storage_handle_t storage_handle;
-    if (ASTARTE_OK != astarte_storage_open(&storage_handle)) {
-        ESP_LOGE(TAG, "Error opening storage.");
+    // The purged properties are deleted in a single transaction
+    xSemaphoreTake(device->zlib_mutex, portMAX_DELAY);
+    xSemaphoreTake(device->property_mutex, portMAX_DELAY);
+    if ((open_storage(device) != ASTARTE_OK)
+        || (astarte_storage_begin_transaction(device->storage_handle) != ASTARTE_OK)) {
+        xSemaphoreGive(device->property_mutex);
         goto end;
     }
 
+    // The stored server owned properties are collected first, then they are matched with the
+    // purge properties list while it is decompressed. The list is never kept in memory.
+    if (collect_purge_candidates(device, &scratch, &purge_candidates) != ASTARTE_OK) {
+        goto unlock;
+    }
+    astarte_err_t uncompress_err
+        = uncompress_purge_properties(device, data, data_len, &purge_candidates);
+    if (uncompress_err != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Failed uncompressing the purge properties %s.",
+            astarte_err_to_name(uncompress_err));
+        goto unlock;
+    }
+
     // Create storage iterator
     astarte_storage_iterator_t storage_iterator;
-    astarte_err_t storage_err = astarte_storage_iterator_create(storage_handle, &storage_iterator);
+    astarte_err_t storage_err
+        = astarte_storage_iterator_create(device->storage_handle, &storage_iterator);
     if ((storage_err != ASTARTE_OK) && (storage_err != ASTARTE_ERR_NOT_FOUND)) {
         ESP_LOGE(TAG, "Error creating the properties iterator.");
-        astarte_storage_close(storage_handle);
-        goto end;
+        goto unlock;
     }
 
     // Iterate through all the properties stored in memory
     while (storage_err != ASTARTE_ERR_NOT_FOUND) {
-        // Fetch property lengths
-        size_t interface_name_len = 0;
-        size_t path_len = 0;
-        size_t value_len = 0;
-        storage_err = astarte_storage_iterator_get_property(
-            &storage_iterator, NULL, &interface_name_len, NULL, &path_len, NULL, NULL, &value_len);
-        if (storage_err != ASTARTE_OK) {
-            ESP_LOGE(TAG, "Error fetching property lengths.");
-            astarte_storage_close(storage_handle);
-            goto end;
-        }
-        // Allocate memory for property data
-        char *interface_name = calloc(interface_name_len, sizeof(char));
-        char *path = calloc(path_len, sizeof(char));
-        if (!interface_name || !path) {
-            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
-            free(interface_name);
-            free(path);
-            astarte_storage_close(storage_handle);
-            goto end;
-        }
-        // Fetch property interface name and path
-        int32_t major = 0;
-        storage_err = astarte_storage_iterator_get_property(&storage_iterator, interface_name,
-            &interface_name_len, path, &path_len, &major, NULL, &value_len);
+        // Fetch the property, reusing the same buffers for all the properties
+        astarte_storage_property_t property;
+        storage_err
+            = astarte_storage_iterator_read_property(&storage_iterator, &scratch, &property);
         if (storage_err != ASTARTE_OK) {
             ESP_LOGE(TAG, "Error fetching property data.");
-            free(interface_name);
-            free(path);
-            astarte_storage_close(storage_handle);
-            goto end;
+            goto unlock;
         }
+        const char *interface_name = property.interface_name;
+        const char *path = property.path;
 
-        // If interface is in introspection and is server owned, search for it in the purge
-        // properties list
+        // If interface is in introspection and is server owned, check if it has been listed in
+        // the purge properties message
         astarte_interface_t *interface = get_interface_from_introspection(device, interface_name);
         bool advance_iterator = true;
         bool interface_in_purge_prop_list = false;
-        if (interface && (interface->ownership == OWNERSHIP_SERVER)
-            && !astarte_linked_list_is_empty(&list_handle)) {
-
-            // Format full property name
-            size_t full_prop_len = interface_name_len + path_len - 1;
-            char *full_prop = calloc(full_prop_len, sizeof(char));
-            full_prop = strncat(strncpy(full_prop, interface_name, full_prop_len), path,
-                full_prop_len - strlen(interface_name) - 1);
-            // Iterate over the purge properties list
-            astarte_linked_list_iterator_t iterator;
-            astarte_err_t err = astarte_linked_list_iterator_init(&list_handle, &iterator);
-            // Iterator init and advance only return ASTARTE_ERR_NOT_FOUND or ASTARTE_OK
-            while (err != ASTARTE_ERR_NOT_FOUND) {
-                char *maybe_full_prop = NULL;
-                astarte_linked_list_iterator_get_item(&iterator, (void **) &maybe_full_prop);
-                size_t maybe_full_prop_len = strlen(maybe_full_prop) + 1;
-                // Check if the two properties are the same
-                if ((maybe_full_prop_len == full_prop_len)
-                    && (strncmp(maybe_full_prop, full_prop, maybe_full_prop_len - 1) == 0)) {
-                    interface_in_purge_prop_list = true;
-                    break;
-                }
-                err = astarte_linked_list_iterator_advance(&iterator);
-            }
-            // Free full property name
-            free(full_prop);
+        if (interface && (interface->ownership == OWNERSHIP_SERVER)) {
+            purge_candidate_t *candidate = find_purge_candidate(
+                &purge_candidates, interface_name, strlen(interface_name), path, strlen(path));
+            interface_in_purge_prop_list = candidate && candidate->listed;
         }
 
         // Delete from storage if interface:
         // - not in introspection or
         // - major version is different compare to the one in introspection
         // - is server owned but is not in purge properties list
-        if ((!interface) || (interface->major_version != major)
+        if ((!interface) || (interface->major_version != property.major)
             || ((interface->ownership == OWNERSHIP_SERVER) && !interface_in_purge_prop_list)) {
             // Check if this is the last property
             bool has_next = false;
             storage_err = astarte_storage_iterator_peek(&storage_iterator, &has_next);
             if (storage_err != ASTARTE_OK) {
                 ESP_LOGE(TAG, "Error peaking next property.");
-                free(interface_name);
-                free(path);
-                astarte_storage_close(storage_handle);
-                goto end;
+                goto unlock;
             }
             // Delete property
             ESP_LOGD(TAG, "Deleting server property '%s%s' from storage", interface_name, path);
-            storage_err = astarte_storage_delete_property(storage_handle, interface_name, path);
+            astarte_property_cache_remove(&device->property_cache, interface_name, path);
+            storage_err = astarte_storage_delete_property(
+                device->storage_handle, interface_name, path);
             if ((storage_err != ASTARTE_OK) && (storage_err != ASTARTE_ERR_NOT_FOUND)) {
                 ESP_LOGE(TAG, "Error deleting the property.");
-                free(interface_name);
-                free(path);
-                astarte_storage_close(storage_handle);
-                goto end;
+                goto unlock;
             }
             // If it was the last property, exit
             if (!has_next) {
-                free(interface_name);
-                free(path);
-                astarte_storage_close(storage_handle);
-                goto end;
+                goto unlock;
             }
             advance_iterator = false; // Iterator has been advanced by the delete function
         }
 
-        // Free individual property data
-        free(interface_name);
-        free(path);
-
         // Advance the iterator if required
         if (advance_iterator) {
             storage_err = astarte_storage_iterator_advance(&storage_iterator);
             if ((storage_err != ASTARTE_OK) && (storage_err != ASTARTE_ERR_NOT_FOUND)) {
                 ESP_LOGE(TAG, "Error iterating through the properties.");
-                astarte_storage_close(storage_handle);
-                goto end;
+                goto unlock;
             }
         }
     }
 
-    // Close storage
-    astarte_storage_close(storage_handle);
+unlock:
+    if (astarte_storage_commit_transaction(device->storage_handle) != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Error committing the properties to storage.");
+    }
+    xSemaphoreGive(device->property_mutex);
 
 end:
-    // Destroy the linked list
-    // No need to free the memory as all the data contained in this list is part of uncompressed
-    astarte_linked_list_destroy(&list_handle);
-    // Free uncompressed payload
-    free(uncompressed);
+    destroy_purge_candidates(&purge_candidates);
+#ifndef CONFIG_ASTARTE_PURGE_PROPERTIES_ZLIB_KEEP_STATE
+    astarte_zlib_context_release(&device->zlib_context);
+#endif
+    xSemaphoreGive(device->zlib_mutex);
+    astarte_storage_scratch_destroy(&scratch);
 }
 
-static astarte_err_t uncompress_purge_properties(
-    char *data, int data_len, char **output, uLongf *output_len)
+static astarte_err_t collect_purge_candidates(astarte_device_handle_t device,
+    astarte_storage_scratch_t *scratch, purge_candidates_t *purge_candidates)
 {
-    char *uncompressed = NULL;
-    uLongf uncompressed_len = __builtin_bswap32(*(uint32_t *) data);
-    if (uncompressed_len != 0) {
-        uncompressed = calloc(uncompressed_len + 1, sizeof(char));
-        if (!uncompressed) {
-            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
-            return ASTARTE_ERR_OUT_OF_MEMORY;
+    astarte_storage_iterator_t storage_iterator;
+    astarte_err_t storage_err
+        = astarte_storage_iterator_create(device->storage_handle, &storage_iterator);
+    if ((storage_err != ASTARTE_OK) && (storage_err != ASTARTE_ERR_NOT_FOUND)) {
+        ESP_LOGE(TAG, "Error creating the properties iterator.");
+        return storage_err;
+    }
+
+    while (storage_err != ASTARTE_ERR_NOT_FOUND) {
+        astarte_storage_property_t property;
+        storage_err = astarte_storage_iterator_read_property(&storage_iterator, scratch, &property);
+        if (storage_err != ASTARTE_OK) {
+            ESP_LOGE(TAG, "Error fetching property data.");
+            return storage_err;
         }
-        int uncompress_res = uncompress((char unsigned *) uncompressed, &uncompressed_len,
-            (char unsigned *) data + 4, data_len - 4);
-        if (uncompress_res != Z_OK) {
-            ESP_LOGE(TAG, "Decompression error %d.", uncompress_res);
-            free(uncompressed);
-            return ASTARTE_ERR;
+
+        astarte_interface_t *interface
+            = get_interface_from_introspection(device, property.interface_name);
+        if (interface && (interface->ownership == OWNERSHIP_SERVER)) {
+            if (purge_candidates->count == purge_candidates->capacity) {
+                size_t capacity
+                    = (purge_candidates->capacity == 0) ? 8 : purge_candidates->capacity * 2;
+                purge_candidate_t *candidates = realloc(
+                    purge_candidates->candidates, capacity * sizeof(purge_candidate_t));
+                if (!candidates) {
+                    ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+                    return ASTARTE_ERR_OUT_OF_MEMORY;
+                }
+                purge_candidates->candidates = candidates;
+                purge_candidates->capacity = capacity;
+            }
+            size_t interface_name_len = strlen(property.interface_name);
+            size_t path_len = strlen(property.path);
+            char *name = malloc(interface_name_len + path_len);
+            if (!name) {
+                ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+                return ASTARTE_ERR_OUT_OF_MEMORY;
+            }
+            memcpy(name, property.interface_name, interface_name_len);
+            memcpy(name + interface_name_len, property.path, path_len);
+            purge_candidate_t *candidate = &purge_candidates->candidates[purge_candidates->count];
+            candidate->name_hash = hash_property_name(
+                property.interface_name, interface_name_len, property.path, path_len);
+            candidate->name = name;
+            candidate->name_len = interface_name_len + path_len;
+            candidate->listed = false;
+            purge_candidates->count++;
+        }
+
+        storage_err = astarte_storage_iterator_advance(&storage_iterator);
+        if ((storage_err != ASTARTE_OK) && (storage_err != ASTARTE_ERR_NOT_FOUND)) {
+            ESP_LOGE(TAG, "Error iterating through the properties.");
+            return storage_err;
         }
     }
 
-    *output = uncompressed;
-    *output_len = uncompressed_len;
+    if (purge_candidates->count > 0) {
+        qsort(purge_candidates->candidates, purge_candidates->count, sizeof(purge_candidate_t),
+            compare_purge_candidates);
+    }
+    return ASTARTE_OK;
+}
+
+static astarte_err_t uncompress_purge_properties(astarte_device_handle_t device, char *data,
+    int data_len, purge_candidates_t *purge_candidates)
+{
+    uLongf expected_len = __builtin_bswap32(*(uint32_t *) data);
+    if (expected_len == 0) {
+        ESP_LOGD(TAG, "Received an empty purge properties list");
+        return ASTARTE_OK;
+    }
+
+    // The window only has to fit a single entry, the size of the list is not relevant
+    char *buffer = malloc(PURGE_PROPERTIES_BUFFER_SIZE);
+    if (!buffer) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ASTARTE_ERR_OUT_OF_MEMORY;
+    }
+    uLongf uncompressed_len = 0;
+    int uncompress_res = astarte_zlib_uncompress_split(&device->zlib_context,
+        (const Bytef *) data + PURGE_PROPERTIES_HEADER_LENGTH,
+        data_len - PURGE_PROPERTIES_HEADER_LENGTH, ';', buffer, PURGE_PROPERTIES_BUFFER_SIZE,
+        on_purge_properties_entry, purge_candidates, &uncompressed_len);
+    free(buffer);
+
+    if (uncompress_res != Z_OK) {
+        ESP_LOGE(TAG, "Decompression error %d.", uncompress_res);
+        return (uncompress_res == Z_MEM_ERROR) ? ASTARTE_ERR_OUT_OF_MEMORY : ASTARTE_ERR;
+    }
+    if ((uncompressed_len != expected_len) || (purge_candidates->listed_entries == 0)) {
+        ESP_LOGE(TAG, "Error parsing the purge property message.");
+        return ASTARTE_ERR;
+    }
     return ASTARTE_OK;
 }
+
+static void on_purge_properties_entry(const char *entry, size_t entry_len, void *user_data)
+{
+    purge_candidates_t *purge_candidates = (purge_candidates_t *) user_data;
+    purge_candidates->listed_entries++;
+    ESP_LOGD(TAG, "Received purge property '%.*s'", (int) entry_len, entry);
+
+    // The entry is the full property name, matched as an interface name with an empty path
+    purge_candidate_t *candidate = find_purge_candidate(purge_candidates, entry, entry_len, "", 0);
+    if (candidate) {
+        candidate->listed = true;
+    }
+}
+
+static purge_candidate_t *find_purge_candidate(purge_candidates_t *purge_candidates,
+    const char *interface_name, size_t interface_name_len, const char *path, size_t path_len)
+{
+    if (purge_candidates->count == 0) {
+        return NULL;
+    }
+    uint32_t name_hash = hash_property_name(interface_name, interface_name_len, path, path_len);
+    purge_candidate_t key = { .name_hash = name_hash };
+    purge_candidate_t *candidate = bsearch(&key, purge_candidates->candidates,
+        purge_candidates->count, sizeof(purge_candidate_t), compare_purge_candidates);
+    if (!candidate) {
+        return NULL;
+    }
+
+    // Candidates with the same hash are contiguous, the names tell colliding properties apart
+    purge_candidate_t *begin = purge_candidates->candidates;
+    purge_candidate_t *end = begin + purge_candidates->count;
+    while ((candidate > begin) && ((candidate - 1)->name_hash == name_hash)) {
+        candidate--;
+    }
+    for (; (candidate < end) && (candidate->name_hash == name_hash); candidate++) {
+        if ((candidate->name_len == interface_name_len + path_len)
+            && (memcmp(candidate->name, interface_name, interface_name_len) == 0)
+            && (memcmp(candidate->name + interface_name_len, path, path_len) == 0)) {
+            return candidate;
+        }
+    }
+    return NULL;
+}
+
+static void destroy_purge_candidates(purge_candidates_t *purge_candidates)
+{
+    for (size_t i = 0; i < purge_candidates->count; i++) {
+        free(purge_candidates->candidates[i].name);
+    }
+    free(purge_candidates->candidates);
+}
+
+static int compare_purge_candidates(const void *a, const void *b)
+{
+    uint32_t hash_a = ((const purge_candidate_t *) a)->name_hash;
+    uint32_t hash_b = ((const purge_candidate_t *) b)->name_hash;
+    return (hash_a > hash_b) - (hash_a < hash_b);
+}
+
+static uint32_t hash_property_name(
+    const char *interface_name, size_t interface_name_len, const char *path, size_t path_len)
+{
+    // Hashing the two parts in sequence matches the hash of the full name in the purge list
+    uint32_t hash = astarte_hash_fnv1a_32(interface_name, interface_name_len);
+    return astarte_hash_fnv1a_32_update(hash, path, path_len);
+}
 #endif
 
 static int has_connectivity()
@@ -1875,6 +3387,7 @@ static void mqtt_event_handler(
 
     esp_mqtt_event_handle_t event = event_data;
     astarte_device_handle_t device = (astarte_device_handle_t) handler_args;
+    device->mqtt_task_handle = xTaskGetCurrentTaskHandle();
     switch ((esp_mqtt_event_id_t) event_id) {
         case MQTT_EVENT_BEFORE_CONNECT:
             ESP_LOGD(TAG, "MQTT_EVENT_BEFORE_CONNECT");
@@ -1882,7 +3395,9 @@ static void mqtt_event_handler(
 
         case MQTT_EVENT_CONNECTED:
             ESP_LOGD(TAG, "MQTT_EVENT_CONNECTED");
+            xSemaphoreTakeRecursive(device->introspection_mutex, portMAX_DELAY);
             on_connected(device, event->session_present);
+            xSemaphoreGiveRecursive(device->introspection_mutex);
             break;
 
         case MQTT_EVENT_DISCONNECTED:
@@ -1900,11 +3415,19 @@ static void mqtt_event_handler(
 
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGD(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            on_published(device, event->msg_id, ASTARTE_PUBLISH_RESULT_ACKED);
+            break;
+
+        case MQTT_EVENT_DELETED:
+            ESP_LOGD(TAG, "MQTT_EVENT_DELETED, msg_id=%d", event->msg_id);
+            on_published(device, event->msg_id, ASTARTE_PUBLISH_RESULT_EXPIRED);
             break;
 
         case MQTT_EVENT_DATA:
             ESP_LOGD(TAG, "MQTT_EVENT_DATA");
-            on_incoming(device, event->topic, event->topic_len, event->data, event->data_len);
+            xSemaphoreTakeRecursive(device->introspection_mutex, portMAX_DELAY);
+            on_data(device, event);
+            xSemaphoreGiveRecursive(device->introspection_mutex);
             break;
 
         case MQTT_EVENT_ERROR:
@@ -1924,16 +3447,245 @@ static void mqtt_event_handler(
 static astarte_interface_t *get_interface_from_introspection(
     astarte_device_handle_t device, const char *name)
 {
-    astarte_linked_list_iterator_t list_iter;
-    astarte_err_t iter_err = astarte_linked_list_iterator_init(&device->introspection, &list_iter);
-    while (iter_err != ASTARTE_ERR_NOT_FOUND) {
-        astarte_interface_t *interface = NULL;
-        astarte_linked_list_iterator_get_item(&list_iter, (void **) &interface);
-        if (strcmp(interface->name, name) == 0) {
-            return interface;
+    astarte_device_interface_handle_t entry
+        = astarte_introspection_get(&device->introspection, name, strlen(name));
+    return (entry) ? (astarte_interface_t *) entry->interface : NULL;
+}
+
+static astarte_err_t store_property(astarte_device_handle_t device, const char *interface_name,
+    const char *path, int32_t major, const void *data, size_t data_len, bool *changed)
+{
+    // The mutex keeps the cache consistent with the storage when the same property is set
+    // concurrently
+    xSemaphoreTake(device->property_mutex, portMAX_DELAY);
+    astarte_property_cache_result_t cached = astarte_property_cache_check(
+        &device->property_cache, interface_name, path, major, data, data_len);
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+    // A pending change is more recent than the stored value
+    const astarte_property_buffer_entry_t *pending
+        = astarte_property_buffer_get_pending(&device->property_buffer, interface_name, path);
+    if (pending) {
+        cached = ((pending->op == ASTARTE_PROPERTY_BUFFER_STORE) && (pending->major == major)
+                     && (pending->data_len == data_len)
+                     && (memcmp(pending->data, data, data_len) == 0))
+            ? ASTARTE_PROPERTY_CACHE_SAME
+            : ASTARTE_PROPERTY_CACHE_CHANGED;
+    }
+#endif
+    if (cached == ASTARTE_PROPERTY_CACHE_SAME) {
+        xSemaphoreGive(device->property_mutex);
+        *changed = false;
+        return ASTARTE_OK;
+    }
+
+    // Only values unknown to the cache are compared with the stored ones
+    bool is_contained = false;
+    astarte_err_t storage_err = ASTARTE_OK;
+    if (cached == ASTARTE_PROPERTY_CACHE_MISS) {
+        storage_err = open_storage(device);
+        if (storage_err != ASTARTE_OK) {
+            goto end;
+        }
+        storage_err = astarte_storage_contains_property(
+            device->storage_handle, interface_name, path, major, data, data_len, &is_contained);
+        if (storage_err != ASTARTE_OK) {
+            ESP_LOGE(TAG, "Error checking if property is in storage.");
+            goto end;
         }
-        iter_err = astarte_linked_list_iterator_advance(&list_iter);
     }
-    return NULL;
+    if (!is_contained) {
+        ESP_LOGD(TAG, "Storing property: '%s%s'.", interface_name, path);
+        storage_err = write_property(device, interface_name, path, major, data, data_len);
+        if (storage_err != ASTARTE_OK) {
+            goto end;
+        }
+    }
+    *changed = !is_contained;
+
+end:
+    if (storage_err == ASTARTE_OK) {
+        // Failing to cache the property only costs a storage access the next time it is set
+        astarte_property_cache_set(
+            &device->property_cache, interface_name, path, major, data, data_len);
+    } else {
+        astarte_property_cache_remove(&device->property_cache, interface_name, path);
+    }
+    xSemaphoreGive(device->property_mutex);
+    return (storage_err == ASTARTE_OK) ? ASTARTE_OK : ASTARTE_ERR;
+}
+
+static astarte_err_t delete_property(
+    astarte_device_handle_t device, const char *interface_name, const char *path)
+{
+    xSemaphoreTake(device->property_mutex, portMAX_DELAY);
+    astarte_property_cache_remove(&device->property_cache, interface_name, path);
+    astarte_err_t storage_err = ASTARTE_OK;
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+    // Deletions are buffered as well, check now if the property exists
+    const astarte_property_buffer_entry_t *pending
+        = astarte_property_buffer_get_pending(&device->property_buffer, interface_name, path);
+    if (pending) {
+        storage_err
+            = (pending->op == ASTARTE_PROPERTY_BUFFER_STORE) ? ASTARTE_OK : ASTARTE_ERR_NOT_FOUND;
+    } else {
+        storage_err = open_storage(device);
+        if (storage_err != ASTARTE_OK) {
+            xSemaphoreGive(device->property_mutex);
+            return ASTARTE_ERR;
+        }
+        size_t data_len = 0;
+        storage_err = astarte_storage_load_property(
+            device->storage_handle, interface_name, path, NULL, NULL, &data_len);
+    }
+    if (storage_err == ASTARTE_OK) {
+        storage_err = write_property(device, interface_name, path, 0, NULL, 0);
+    }
+#else
+    storage_err = write_property(device, interface_name, path, 0, NULL, 0);
+#endif
+    if ((storage_err != ASTARTE_OK) && (storage_err != ASTARTE_ERR_NOT_FOUND)) {
+        ESP_LOGE(TAG, "Error deleting property from storage.");
+        storage_err = ASTARTE_ERR;
+    }
+    xSemaphoreGive(device->property_mutex);
+    return storage_err;
+}
+
+static astarte_err_t open_storage(astarte_device_handle_t device)
+{
+    // The handle is kept open until the device is destroyed, keeping the storage index in RAM
+    if (device->storage_opened) {
+        return ASTARTE_OK;
+    }
+    if (astarte_storage_open(&device->storage_handle) != ASTARTE_OK) {
+        ESP_LOGE(TAG, "Error opening storage.");
+        return ASTARTE_ERR;
+    }
+    device->storage_opened = true;
+    return ASTARTE_OK;
+}
+
+static astarte_err_t write_property(astarte_device_handle_t device, const char *interface_name,
+    const char *path, int32_t major, const void *data, size_t data_len)
+{
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+    astarte_err_t err = (data)
+        ? astarte_property_buffer_store(
+            &device->property_buffer, interface_name, path, major, data, data_len)
+        : astarte_property_buffer_delete(&device->property_buffer, interface_name, path);
+    if (err == ASTARTE_OK) {
+        if (device->property_buffer.pending_count == CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND_BURST) {
+            xTaskNotify(device->property_writer_task_handle, NOTIFY_FLUSH, eSetBits);
+        }
+        return ASTARTE_OK;
+    }
+    ESP_LOGW(TAG, "Cannot buffer the change of '%s%s', writing it immediately", interface_name,
+        path);
+#endif
+
+    if (open_storage(device) != ASTARTE_OK) {
+        return ASTARTE_ERR;
+    }
+    astarte_err_t storage_err = ASTARTE_OK;
+    if (data) {
+        storage_err = astarte_storage_store_property(
+            device->storage_handle, interface_name, path, major, data, data_len);
+        if (storage_err != ASTARTE_OK) {
+            ESP_LOGE(TAG, "Error storing property.");
+        }
+    } else {
+        storage_err = astarte_storage_delete_property(device->storage_handle, interface_name, path);
+    }
+    return storage_err;
+}
+#endif
+
+#ifdef CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND
+static void astarte_device_property_writer_task(void *ctx)
+{
+    // This task writes the pending property changes to the NVS, once every flush interval or
+    // as soon as enough changes are pending. All the changes are written with a single commit.
+
+    astarte_device_handle_t device = (astarte_device_handle_t) ctx;
+
+    while (1) {
+        uint32_t notification_value = ulTaskNotifyTake(
+            pdTRUE, pdMS_TO_TICKS(CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND_FLUSH_INTERVAL_MS));
+        if (notification_value & NOTIFY_TERMINATE) {
+            // Terminate the task
+            xSemaphoreGive(device->property_writer_task_exit);
+            vTaskDelete(NULL);
+        }
+        flush_properties(device, false);
+    }
+}
+
+static void stop_property_writer_task(astarte_device_handle_t device)
+{
+    if (device->property_writer_task_handle) {
+        xTaskNotify(device->property_writer_task_handle, NOTIFY_TERMINATE, eSetBits);
+        xSemaphoreTake(device->property_writer_task_exit, portMAX_DELAY);
+        device->property_writer_task_handle = NULL;
+    }
+    if (device->property_writer_task_exit) {
+        vSemaphoreDelete(device->property_writer_task_exit);
+        device->property_writer_task_exit = NULL;
+    }
+}
+
+static void flush_properties(astarte_device_handle_t device, bool force)
+{
+    uint32_t min_interval_ms
+        = (force) ? 0 : CONFIG_ASTARTE_PROPERTY_WRITE_BEHIND_MIN_KEY_INTERVAL_MS;
+    bool transaction_begun = false;
+    size_t written = 0;
+
+    // All the writes are committed at once, no other write should happen meanwhile
+    xSemaphoreTake(device->property_mutex, portMAX_DELAY);
+    while (1) {
+        uint32_t now_ms = get_time_ms();
+        astarte_property_buffer_entry_t *entry
+            = astarte_property_buffer_next_due(&device->property_buffer, now_ms, min_interval_ms);
+        if (!entry) {
+            break;
+        }
+        if (!transaction_begun) {
+            if ((open_storage(device) != ASTARTE_OK)
+                || (astarte_storage_begin_transaction(device->storage_handle) != ASTARTE_OK)) {
+                break;
+            }
+            transaction_begun = true;
+        }
+
+        const char *interface_name = astarte_property_buffer_interface_name(entry);
+        const char *path = astarte_property_buffer_path(entry);
+        astarte_err_t storage_err = ASTARTE_OK;
+        if (entry->op == ASTARTE_PROPERTY_BUFFER_STORE) {
+            storage_err = astarte_storage_store_property(device->storage_handle, interface_name,
+                path, entry->major, entry->data, entry->data_len);
+        } else {
+            storage_err
+                = astarte_storage_delete_property(device->storage_handle, interface_name, path);
+            if (storage_err == ASTARTE_ERR_NOT_FOUND) {
+                storage_err = ASTARTE_OK;
+            }
+        }
+        if (storage_err != ASTARTE_OK) {
+            // The change stays pending and is retried on the next flush
+            ESP_LOGE(TAG, "Error writing property '%s%s'.", interface_name, path);
+            break;
+        }
+        astarte_property_buffer_mark_written(&device->property_buffer, entry, now_ms);
+        written++;
+    }
+    if (transaction_begun
+        && (astarte_storage_commit_transaction(device->storage_handle) != ASTARTE_OK)) {
+        ESP_LOGE(TAG, "Error committing the properties to storage.");
+    }
+    xSemaphoreGive(device->property_mutex);
+
+    if (written > 0) {
+        ESP_LOGD(TAG, "Written %zu properties to storage", written);
+    }
 }
 #endif
@@ -42,6 +42,8 @@ static const astarte_err_msg_t astarte_err_msg_table[] = {
     ERR_TBL_IT(ASTARTE_ERR_INVALID_INTERFACE_VERSION),
     ERR_TBL_IT(ASTARTE_ERR_CONFLICTING_INTERFACE),
     ERR_TBL_IT(ASTARTE_ERR_INVALID_SIZE),
+    ERR_TBL_IT(ASTARTE_ERR_QUEUE_FULL),
+    ERR_TBL_IT(ASTARTE_ERR_TIMEOUT),
 };
 
 static const char astarte_unknown_msg[] = "ERROR";
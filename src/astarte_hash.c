@@ -0,0 +1,32 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+#include "astarte_hash.h"
+
+/************************************************
+ *        Defines, constants and typedef        *
+ ***********************************************/
+
+#define FNV1A_32_PRIME 0x01000193U
+
+/************************************************
+ *         Global functions definitions         *
+ ***********************************************/
+
+uint32_t astarte_hash_fnv1a_32(const void *data, size_t len)
+{
+    return astarte_hash_fnv1a_32_update(ASTARTE_HASH_FNV1A_32_INIT, data, len);
+}
+
+uint32_t astarte_hash_fnv1a_32_update(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= FNV1A_32_PRIME;
+    }
+    return hash;
+}
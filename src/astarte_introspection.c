@@ -0,0 +1,205 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+#include "astarte_introspection.h"
+
+#include "astarte_hash.h"
+
+#include <esp_log.h>
+#include <stdlib.h>
+#include <string.h>
+
+/************************************************
+ *        Defines, constants and typedef        *
+ ***********************************************/
+
+#define TAG "ASTARTE_INTROSPECTION"
+
+#define INITIAL_BUCKETS_COUNT 8
+
+/************************************************
+ *         Static functions declaration         *
+ ***********************************************/
+
+/**
+ * @brief Compute the topic prefix for an entry, replacing the previous one.
+ *
+ * @param[in] introspection Introspection containing the device topic
+ * @param[inout] entry Entry to update
+ * @return ASTARTE_ERR_OUT_OF_MEMORY when the allocation fails, ASTARTE_OK otherwise.
+ */
+static astarte_err_t update_topic_prefix(
+    astarte_introspection_t *introspection, struct astarte_device_interface *entry);
+/**
+ * @brief Double the number of buckets of the hash table, rehashing each entry.
+ *
+ * @param[inout] introspection Introspection to update
+ * @return ASTARTE_ERR_OUT_OF_MEMORY when the allocation fails, ASTARTE_OK otherwise.
+ */
+static astarte_err_t grow_buckets(astarte_introspection_t *introspection);
+
+/************************************************
+ *         Global functions definitions         *
+ ***********************************************/
+
+astarte_err_t astarte_introspection_init(astarte_introspection_t *introspection)
+{
+    memset(introspection, 0, sizeof(astarte_introspection_t));
+    introspection->buckets
+        = calloc(INITIAL_BUCKETS_COUNT, sizeof(struct astarte_device_interface *));
+    if (!introspection->buckets) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ASTARTE_ERR_OUT_OF_MEMORY;
+    }
+    introspection->buckets_count = INITIAL_BUCKETS_COUNT;
+    return ASTARTE_OK;
+}
+
+void astarte_introspection_destroy(astarte_introspection_t *introspection)
+{
+    struct astarte_device_interface *entry = introspection->head;
+    while (entry) {
+        struct astarte_device_interface *next = entry->next;
+        free(entry->topic_prefix);
+        astarte_routes_destroy(&entry->routes);
+        free(entry);
+        entry = next;
+    }
+    free(introspection->buckets);
+    memset(introspection, 0, sizeof(astarte_introspection_t));
+}
+
+astarte_err_t astarte_introspection_set_device_topic(
+    astarte_introspection_t *introspection, const char *device_topic)
+{
+    introspection->device_topic = device_topic;
+    introspection->device_topic_len = (device_topic) ? strlen(device_topic) : 0;
+
+    for (struct astarte_device_interface *entry = introspection->head; entry;
+         entry = entry->next) {
+        astarte_err_t err = update_topic_prefix(introspection, entry);
+        if (err != ASTARTE_OK) {
+            return err;
+        }
+    }
+    return ASTARTE_OK;
+}
+
+astarte_err_t astarte_introspection_add(astarte_introspection_t *introspection,
+    const astarte_interface_t *interface, struct astarte_device_interface **entry)
+{
+    if (introspection->entries_count >= introspection->buckets_count) {
+        astarte_err_t err = grow_buckets(introspection);
+        if (err != ASTARTE_OK) {
+            return err;
+        }
+    }
+
+    struct astarte_device_interface *new_entry = calloc(1, sizeof(struct astarte_device_interface));
+    if (!new_entry) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ASTARTE_ERR_OUT_OF_MEMORY;
+    }
+    new_entry->interface = interface;
+    new_entry->name = interface->name;
+    new_entry->name_len = strlen(interface->name);
+    new_entry->name_hash = astarte_hash_fnv1a_32(new_entry->name, new_entry->name_len);
+
+    astarte_err_t err = update_topic_prefix(introspection, new_entry);
+    if (err != ASTARTE_OK) {
+        free(new_entry);
+        return err;
+    }
+
+    size_t bucket = new_entry->name_hash & (introspection->buckets_count - 1);
+    new_entry->bucket_next = introspection->buckets[bucket];
+    introspection->buckets[bucket] = new_entry;
+
+    if (introspection->tail) {
+        introspection->tail->next = new_entry;
+    } else {
+        introspection->head = new_entry;
+    }
+    introspection->tail = new_entry;
+    introspection->entries_count++;
+
+    *entry = new_entry;
+    return ASTARTE_OK;
+}
+
+struct astarte_device_interface *astarte_introspection_get(
+    const astarte_introspection_t *introspection, const char *name, size_t name_len)
+{
+    if (introspection->buckets_count == 0) {
+        return NULL;
+    }
+
+    uint32_t name_hash = astarte_hash_fnv1a_32(name, name_len);
+    size_t bucket = name_hash & (introspection->buckets_count - 1);
+    for (struct astarte_device_interface *entry = introspection->buckets[bucket]; entry;
+         entry = entry->bucket_next) {
+        if ((entry->name_hash == name_hash) && (entry->name_len == name_len)
+            && (memcmp(entry->name, name, name_len) == 0)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/************************************************
+ *         Static functions definitions         *
+ ***********************************************/
+
+static astarte_err_t update_topic_prefix(
+    astarte_introspection_t *introspection, struct astarte_device_interface *entry)
+{
+    free(entry->topic_prefix);
+    entry->topic_prefix = NULL;
+    entry->topic_prefix_len = 0;
+
+    if (!introspection->device_topic) {
+        return ASTARTE_OK;
+    }
+
+    // Topic prefix is "<device_topic>/<interface_name>"
+    size_t prefix_len = introspection->device_topic_len + 1 + entry->name_len;
+    char *prefix = malloc(prefix_len + 1);
+    if (!prefix) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ASTARTE_ERR_OUT_OF_MEMORY;
+    }
+    memcpy(prefix, introspection->device_topic, introspection->device_topic_len);
+    prefix[introspection->device_topic_len] = '/';
+    memcpy(prefix + introspection->device_topic_len + 1, entry->name, entry->name_len);
+    prefix[prefix_len] = '\0';
+
+    entry->topic_prefix = prefix;
+    entry->topic_prefix_len = prefix_len;
+    return ASTARTE_OK;
+}
+
+static astarte_err_t grow_buckets(astarte_introspection_t *introspection)
+{
+    size_t new_buckets_count = introspection->buckets_count * 2;
+    struct astarte_device_interface **new_buckets
+        = calloc(new_buckets_count, sizeof(struct astarte_device_interface *));
+    if (!new_buckets) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ASTARTE_ERR_OUT_OF_MEMORY;
+    }
+
+    for (struct astarte_device_interface *entry = introspection->head; entry;
+         entry = entry->next) {
+        size_t bucket = entry->name_hash & (new_buckets_count - 1);
+        entry->bucket_next = new_buckets[bucket];
+        new_buckets[bucket] = entry;
+    }
+
+    free(introspection->buckets);
+    introspection->buckets = new_buckets;
+    introspection->buckets_count = new_buckets_count;
+    return ASTARTE_OK;
+}
@@ -16,23 +16,37 @@
  * The two entries are stored using incremental keys in the format "EntryNx" where x is an
  * incremental identifier.
  *
- * The number of key-value pairs already stored is written to a special 64 bytes NVS entry with a
- * fixed key "next store idx".
+ * The store index following the last key-value pair is written to a special 64 bytes NVS entry
+ * with a fixed key "next store idx".
+ *
+ * Erasing a pair erases its two entries and leaves a hole, a store index without a key entry.
+ * Holes are skipped by lookups and iterators, they are reused by new pairs and removed by the
+ * compaction, which moves the last pairs into them.
+ *
+ * The optional index is an open addressing hash table, with linear probing, mapping the hash of
+ * each key to its store index. Only the hash is kept in RAM, a single key entry is read from NVS to
+ * confirm a match. The index also tracks the holes.
  */
 
 #include "astarte_nvs_key_value.h"
 
 #include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <esp_log.h>
 
+#include "astarte_hash.h"
+
 /************************************************
  *        Defines, constants and typedef        *
  ***********************************************/
 
 #define TAG "NVS_KEY_VALUE"
 
+#define INDEX_MIN_SLOTS_COUNT 16
+#define INDEX_MIN_HOLES_CAPACITY 8
+
 /************************************************
  *         Static functions declaration         *
  ***********************************************/
@@ -40,10 +54,11 @@
 /**
  * @brief Find the key position (store index) for the provided key.
  *
- * @details Loops over all the keys stored in NVS and returns the store index corresponding to the
- * matching key, if found.
+ * @details Uses the index when provided, building it if required. Otherwise loops over all the keys
+ * stored in NVS and returns the store index corresponding to the matching key, if found.
  *
  * @param[in] handle Handle obtained from nvs_open function.
+ * @param[inout] index Index of the stored keys, may be NULL.
  * @param[in] key Key to search for.
  * @param[out] store_index Store index corresponding to the provided key, in case of an error this
  * value is left unmodified.
@@ -52,7 +67,149 @@
  * - ESP_FAIL if an internal error has occurred,
  * - ESP_OK if key has been found and store_index is valid
  */
-static esp_err_t lookup_key_position(nvs_handle_t handle, const char *key, uint64_t *store_index);
+static esp_err_t lookup_key_position(nvs_handle_t handle, astarte_nvs_key_value_index_t *index,
+    const char *key, uint64_t *store_index);
+
+/**
+ * @brief Find the index slot of the provided key.
+ *
+ * @param[in] handle Handle obtained from nvs_open function.
+ * @param[in] index Built index of the stored keys.
+ * @param[in] key Key to search for.
+ * @param[out] slot Slot containing the key, in case of an error this value is left unmodified.
+ * @return One of the follwing error codes:
+ * - ESP_ERR_NOT_FOUND if the key has not been found,
+ * - ESP_FAIL if an internal error has occurred,
+ * - ESP_OK if key has been found and slot is valid
+ */
+static esp_err_t find_index_slot(
+    nvs_handle_t handle, const astarte_nvs_key_value_index_t *index, const char *key, size_t *slot);
+
+/**
+ * @brief Get the store index following the last key-value pair.
+ *
+ * @param[in] handle Handle obtained from nvs_open function.
+ * @param[in] index Index of the stored keys, may be NULL. When provided it should be already built.
+ * @param[out] next_store_index Next store index, zero if no pair has ever been stored.
+ * @return ESP_OK if the next store index has been read, an error code otherwise.
+ */
+static esp_err_t get_next_store_index(
+    nvs_handle_t handle, const astarte_nvs_key_value_index_t *index, uint64_t *next_store_index);
+
+/**
+ * @brief Find the first key-value pair stored at or after a store index, skipping the holes.
+ *
+ * @param[in] handle Handle obtained from nvs_open function.
+ * @param[in] from Store index where to start the search.
+ * @param[in] next_store_index Store index following the last key-value pair.
+ * @param[out] store_index Store index of the pair found.
+ * @return One of the follwing error codes:
+ * - ESP_ERR_NOT_FOUND if only holes follow @p from,
+ * - ESP_FAIL if an internal error has occurred,
+ * - ESP_OK if a pair has been found and store_index is valid
+ */
+static esp_err_t find_stored_pair(
+    nvs_handle_t handle, uint64_t from, uint64_t next_store_index, uint64_t *store_index);
+
+/**
+ * @brief Point the iterator to the following pair if the current one has been erased.
+ *
+ * @param[inout] iterator Iterator to update.
+ * @return One of the follwing error codes:
+ * - ESP_ERR_NVS_NOT_FOUND if no pair follows the erased one,
+ * - ESP_FAIL if an internal error has occurred,
+ * - ESP_OK if the iterator points to a stored pair
+ */
+static esp_err_t seek_stored_pair(astarte_nvs_key_value_iterator_t *iterator);
+
+/**
+ * @brief Move a key-value pair to a different store index, used by the compaction.
+ *
+ * @details The pair is written in the new position before erasing the old one, an interruption
+ * can leave the pair duplicated but never lost.
+ *
+ * @param[in] handle Handle obtained from nvs_open function.
+ * @param[inout] index Built index of the stored keys.
+ * @param[in] from Store index of the pair to move.
+ * @param[in] to Store index of the hole where the pair is moved.
+ * @return ESP_OK if the pair has been moved, an error code otherwise.
+ */
+static esp_err_t move_pair(
+    nvs_handle_t handle, astarte_nvs_key_value_index_t *index, uint64_t from, uint64_t to);
+
+/**
+ * @brief Build an index reading all the keys stored in NVS.
+ *
+ * @param[in] handle Handle obtained from nvs_open function.
+ * @param[out] index Index to build.
+ * @return ESP_OK if the index has been built, an error code otherwise.
+ */
+static esp_err_t build_index(nvs_handle_t handle, astarte_nvs_key_value_index_t *index);
+
+/**
+ * @brief Make room in the index for a new key.
+ *
+ * @details Called before changing NVS, so that an allocation failure can not leave the index out of
+ * sync.
+ *
+ * @param[inout] index Index to grow.
+ * @return ESP_ERR_NO_MEM if the index could not be grown, ESP_OK otherwise.
+ */
+static esp_err_t reserve_index_slot(astarte_nvs_key_value_index_t *index);
+
+/**
+ * @brief Make room in the index for a new hole.
+ *
+ * @param[inout] index Index to grow.
+ * @return ESP_ERR_NO_MEM if the index could not be grown, ESP_OK otherwise.
+ */
+static esp_err_t reserve_index_hole(astarte_nvs_key_value_index_t *index);
+
+/**
+ * @brief Insert a key in the index, the index should have room for it.
+ *
+ * @param[inout] index Index to update.
+ * @param[in] key_hash Hash of the key.
+ * @param[in] store_index Store index of the key.
+ */
+static void insert_index_key(
+    astarte_nvs_key_value_index_t *index, uint32_t key_hash, uint64_t store_index);
+
+/**
+ * @brief Remove a slot from the index.
+ *
+ * @param[inout] index Index to update.
+ * @param[in] slot Slot to remove.
+ */
+static void remove_index_slot(astarte_nvs_key_value_index_t *index, size_t slot);
+
+/**
+ * @brief Check if the key stored at a given store index is equal to the provided one.
+ *
+ * @param[in] handle Handle obtained from nvs_open function.
+ * @param[in] store_index Store index of the key to check.
+ * @param[in] key Key to compare.
+ * @param[out] match True if the keys are equal.
+ * @return ESP_OK if the comparison has been performed, an error code otherwise.
+ */
+static esp_err_t compare_stored_key(
+    nvs_handle_t handle, uint64_t store_index, const char *key, bool *match);
+
+/**
+ * @brief Read the key stored at a given store index in a growable buffer.
+ *
+ * @param[in] handle Handle obtained from nvs_open function.
+ * @param[in] store_index Store index of the key to read.
+ * @param[inout] key Buffer where to store the key, reallocated when too small.
+ * @param[inout] key_size Size of the buffer.
+ * @return One of the follwing error codes:
+ * - ESP_ERR_NVS_NOT_FOUND if the store index is a hole,
+ * - ESP_ERR_NO_MEM if the buffer could not be reallocated,
+ * - ESP_FAIL if an internal error has occurred,
+ * - ESP_OK if the key has been read
+ */
+static esp_err_t read_stored_key(
+    nvs_handle_t handle, uint64_t store_index, char **key, size_t *key_size);
 
 /**
  * @brief Format an entry key in the format 'EntryNx'.
@@ -66,63 +223,100 @@ static esp_err_t lookup_key_position(nvs_handle_t handle, const char *key, uint6
  */
 static esp_err_t get_entry_name(uint64_t store_index, char *entry_name);
 
+/**
+ * @brief Compare two store indexes, used to sort the holes.
+ *
+ * @param[in] a First store index.
+ * @param[in] b Second store index.
+ * @return A negative value, zero or a positive value if a is less, equal or greater than b.
+ */
+static int compare_store_indexes(const void *a, const void *b);
+
 /************************************************
  *         Global functions definitions         *
  ***********************************************/
 
-esp_err_t astarte_nvs_key_value_set(
-    nvs_handle_t handle, const char *key, const void *value, size_t length)
+void astarte_nvs_key_value_index_init(astarte_nvs_key_value_index_t *index)
+{
+    memset(index, 0, sizeof(astarte_nvs_key_value_index_t));
+}
+
+void astarte_nvs_key_value_index_destroy(astarte_nvs_key_value_index_t *index)
+{
+    free(index->slots);
+    free(index->holes);
+    memset(index, 0, sizeof(astarte_nvs_key_value_index_t));
+}
+
+esp_err_t astarte_nvs_key_value_set(nvs_handle_t handle, astarte_nvs_key_value_index_t *index,
+    const char *key, const void *value, size_t length)
 {
     esp_err_t esp_err = ESP_OK;
 
     // Step 1: Set the store index with the logic:
     // - If the key is already in NVS set it to the store index of the old entry
+    // - If the key is not in NVS and the index knows a hole set it to the hole
     // - If the key is not in NVS set it to the next store index
     // - If the key is not in NVS and there is no next store index set it to 0
     uint64_t key_store_index = 0;
-    esp_err_t lookup_err = lookup_key_position(handle, key, &key_store_index);
+    uint64_t next_store_index = 0;
+    bool use_hole = false;
+    esp_err_t lookup_err = lookup_key_position(handle, index, key, &key_store_index);
     if (lookup_err == ESP_ERR_NVS_NOT_FOUND) {
-        uint64_t next_store_index = 0;
-        esp_err = nvs_get_u64(handle, "next store idx", &next_store_index);
-        if ((esp_err != ESP_ERR_NVS_NOT_FOUND) && (esp_err != ESP_OK)) {
-            ESP_LOGE(TAG, "Error getting the next store index.");
+        esp_err = get_next_store_index(handle, index, &next_store_index);
+        if (esp_err != ESP_OK) {
             return esp_err;
         }
         key_store_index = next_store_index;
+        if (index) {
+            esp_err = reserve_index_slot(index);
+            if (esp_err != ESP_OK) {
+                return esp_err;
+            }
+            if (index->holes_count > 0) {
+                key_store_index = index->holes[index->holes_count - 1];
+                use_hole = true;
+            }
+        }
     } else if (lookup_err != ESP_OK) {
         return ESP_FAIL;
     }
 
-    // Step 2: store the key
-    char key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
-    esp_err = get_entry_name(key_store_index, key_entry_name);
+    // Step 2: store the value, before the key so that a stored key always has a value
+    char value_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    esp_err = get_entry_name(key_store_index + 1, value_entry_name);
     if (esp_err != ESP_OK) {
         return ESP_FAIL;
     }
-    // Confusing for clang-tidy as second parameter is called 'key'
-    // NOLINTNEXTLINE(readability-suspicious-call-argument)
-    esp_err = nvs_set_str(handle, key_entry_name, key);
+    esp_err = nvs_set_blob(handle, value_entry_name, value, length);
     if (esp_err != ESP_OK) {
-        ESP_LOGE(TAG, "Error storing the key.");
+        ESP_LOGE(TAG, "Error storing the value.");
         return esp_err;
     }
 
-    // Step 3: store the value
-    char value_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
-    esp_err = get_entry_name(key_store_index + 1, value_entry_name);
+    // The key of an existing pair is already stored
+    if (lookup_err == ESP_OK) {
+        return ESP_OK;
+    }
+
+    // Step 3: store the key
+    char key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    esp_err = get_entry_name(key_store_index, key_entry_name);
     if (esp_err != ESP_OK) {
-        nvs_erase_key(handle, key_entry_name);
+        nvs_erase_key(handle, value_entry_name);
         return ESP_FAIL;
     }
-    esp_err = nvs_set_blob(handle, value_entry_name, value, length);
+    // Confusing for clang-tidy as second parameter is called 'key'
+    // NOLINTNEXTLINE(readability-suspicious-call-argument)
+    esp_err = nvs_set_str(handle, key_entry_name, key);
     if (esp_err != ESP_OK) {
-        ESP_LOGE(TAG, "Error storing the value.");
-        nvs_erase_key(handle, key_entry_name);
+        ESP_LOGE(TAG, "Error storing the key.");
+        nvs_erase_key(handle, value_entry_name);
         return esp_err;
     }
 
-    // Step 4: If the key was not already in NVS increment the next store index
-    if (lookup_err == ESP_ERR_NVS_NOT_FOUND) {
+    // Step 4: If the pair has been appended increment the next store index
+    if (!use_hole) {
         esp_err = nvs_set_u64(handle, "next store idx", key_store_index + 2);
         if (esp_err != ESP_OK) {
             ESP_LOGE(TAG, "Error updating the next store index.");
@@ -132,15 +326,25 @@ esp_err_t astarte_nvs_key_value_set(
         }
     }
 
+    // Step 5: Update the index
+    if (index) {
+        insert_index_key(index, astarte_hash_fnv1a_32(key, strlen(key)), key_store_index);
+        if (use_hole) {
+            index->holes_count--;
+        } else {
+            index->next_store_index = key_store_index + 2;
+        }
+    }
+
     return esp_err;
 }
 
-esp_err_t astarte_nvs_key_value_get(
-    nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+esp_err_t astarte_nvs_key_value_get(nvs_handle_t handle, astarte_nvs_key_value_index_t *index,
+    const char *key, void *out_value, size_t *length)
 {
     // Step 1: Find the store index for the key
     uint64_t key_store_index = 0;
-    esp_err_t esp_err = lookup_key_position(handle, key, &key_store_index);
+    esp_err_t esp_err = lookup_key_position(handle, index, key, &key_store_index);
     if (esp_err != ESP_OK) {
         return esp_err;
     }
@@ -158,139 +362,105 @@ esp_err_t astarte_nvs_key_value_get(
     return esp_err;
 }
 
-esp_err_t astarte_nvs_key_value_erase_key(nvs_handle_t handle, const char *key)
+esp_err_t astarte_nvs_key_value_erase_key(
+    nvs_handle_t handle, astarte_nvs_key_value_index_t *index, const char *key)
 {
     // Step 1: Find the store index for the key
     uint64_t key_store_index = 0;
-    esp_err_t esp_err = lookup_key_position(handle, key, &key_store_index);
-    if (esp_err != ESP_OK) {
-        return esp_err;
-    }
-
-    // Step 2: Find the next store index
-    uint64_t next_store_index = 0;
-    esp_err = nvs_get_u64(handle, "next store idx", &next_store_index);
-    if (esp_err != ESP_OK) {
-        ESP_LOGE(TAG, "Error getting the next store index.");
-        return esp_err;
-    }
-
-    // Step 3: Shift back all the keys of one position (erasing the entry in the process)
-    for (uint64_t i = key_store_index + 2; i < next_store_index; i += 2) {
-        // Get the key to shift using the store index
-        char tmp_key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
-        esp_err = get_entry_name(i, tmp_key_entry_name);
-        if (esp_err != ESP_OK) {
-            return ESP_FAIL;
-        }
-        size_t tmp_key_len = 0;
-        esp_err = nvs_get_str(handle, tmp_key_entry_name, NULL, &tmp_key_len);
-        if (esp_err != ESP_OK) {
-            ESP_LOGE(TAG, "Error fetching key from nvs during erase operation.");
-            return esp_err;
-        }
-        char *tmp_key = calloc(tmp_key_len, sizeof(char));
-        if (!tmp_key) {
-            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
-            return ESP_FAIL;
-        }
-        // Confusing for clang-tidy as second parameter is called 'key'
-        // NOLINTNEXTLINE(readability-suspicious-call-argument)
-        esp_err = nvs_get_str(handle, tmp_key_entry_name, tmp_key, &tmp_key_len);
-        if (esp_err != ESP_OK) {
-            ESP_LOGE(TAG, "Error fetching key from nvs during erase operation.");
-            free(tmp_key);
-            return esp_err;
-        }
-        // Get the value to shift using the store index
-        char tmp_value_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
-        esp_err = get_entry_name(i + 1, tmp_value_entry_name);
-        if (esp_err != ESP_OK) {
-            free(tmp_key);
-            return ESP_FAIL;
-        }
-        size_t tmp_value_len = 0;
-        esp_err = nvs_get_blob(handle, tmp_value_entry_name, NULL, &tmp_value_len);
-        if (esp_err != ESP_OK) {
-            ESP_LOGE(TAG, "Error fetching value from nvs during erase operation.");
-            free(tmp_key);
-            return esp_err;
-        }
-        char *tmp_value = calloc(tmp_value_len, sizeof(char));
-        if (!tmp_value) {
-            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
-            free(tmp_key);
-            return ESP_FAIL;
-        }
-        esp_err = nvs_get_blob(handle, tmp_value_entry_name, tmp_value, &tmp_value_len);
-        if (esp_err != ESP_OK) {
-            ESP_LOGE(TAG, "Error fetching value from nvs during erase operation.");
-            free(tmp_key);
-            free(tmp_value);
-            return esp_err;
-        }
-        // Store the key in the new position
-        char new_key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
-        esp_err = get_entry_name(i - 2, new_key_entry_name);
-        if (esp_err != ESP_OK) {
-            free(tmp_key);
-            free(tmp_value);
-            return ESP_FAIL;
+    size_t slot = 0;
+    esp_err_t esp_err = ESP_OK;
+    if (index) {
+        if (!index->slots) {
+            esp_err = build_index(handle, index);
         }
-        // Confusing for clang-tidy as second parameter is called 'key'
-        // NOLINTNEXTLINE(readability-suspicious-call-argument)
-        esp_err = nvs_set_str(handle, new_key_entry_name, tmp_key);
-        free(tmp_key);
-        if (esp_err != ESP_OK) {
-            ESP_LOGE(TAG, "Error storing the key.");
-            free(tmp_value);
-            return esp_err;
+        if (esp_err == ESP_OK) {
+            esp_err = find_index_slot(handle, index, key, &slot);
         }
-        // Store the value in the new position
-        char new_value_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
-        esp_err = get_entry_name(i - 1, new_value_entry_name);
-        if (esp_err != ESP_OK) {
-            free(tmp_value);
-            return ESP_FAIL;
-        }
-        esp_err = nvs_set_blob(handle, new_value_entry_name, tmp_value, tmp_value_len);
-        free(tmp_value);
-        if (esp_err != ESP_OK) {
-            ESP_LOGE(TAG, "Error storing the value.");
-            return esp_err;
+        if (esp_err == ESP_OK) {
+            key_store_index = index->slots[slot].store_index;
+            esp_err = reserve_index_hole(index);
         }
+    } else {
+        esp_err = lookup_key_position(handle, NULL, key, &key_store_index);
+    }
+    if (esp_err != ESP_OK) {
+        return esp_err;
     }
 
-    // Step 4: Erase the last two entries that are dangling at this point
-    char key_to_erase_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
-    esp_err = get_entry_name(next_store_index - 2, key_to_erase_entry_name);
+    // Step 2: Erase the key, leaving a hole, then the value
+    char key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    esp_err = get_entry_name(key_store_index, key_entry_name);
     if (esp_err != ESP_OK) {
         return ESP_FAIL;
     }
-    esp_err = nvs_erase_key(handle, key_to_erase_entry_name);
+    esp_err = nvs_erase_key(handle, key_entry_name);
     if (esp_err != ESP_OK) {
         ESP_LOGE(TAG, "Failed erasing a key.");
         return esp_err;
     }
-    char value_to_erase_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
-    esp_err = get_entry_name(next_store_index - 1, value_to_erase_entry_name);
+    if (index) {
+        remove_index_slot(index, slot);
+        index->holes[index->holes_count++] = key_store_index;
+    }
+    char value_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    esp_err = get_entry_name(key_store_index + 1, value_entry_name);
     if (esp_err != ESP_OK) {
         return ESP_FAIL;
     }
-    esp_err = nvs_erase_key(handle, value_to_erase_entry_name);
-    if (esp_err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed erasing a key.");
-        return esp_err;
+    // A value left in a hole is overwritten when the hole is reused
+    esp_err = nvs_erase_key(handle, value_entry_name);
+    if ((esp_err != ESP_OK) && (esp_err != ESP_ERR_NVS_NOT_FOUND)) {
+        ESP_LOGW(TAG, "Failed erasing a value.");
     }
 
-    // Step 5: Update the next store index
-    esp_err = nvs_set_u64(handle, "next store idx", next_store_index - 2);
+    return ESP_OK;
+}
+
+esp_err_t astarte_nvs_key_value_compact(nvs_handle_t handle, astarte_nvs_key_value_index_t *index)
+{
+    if (!index->slots) {
+        esp_err_t esp_err = build_index(handle, index);
+        if (esp_err != ESP_OK) {
+            return esp_err;
+        }
+    }
+    if (index->holes_count == 0) {
+        return ESP_OK;
+    }
+
+    // Fill the lowest holes with the last pairs, dropping the holes at the end
+    qsort(index->holes, index->holes_count, sizeof(uint64_t), compare_store_indexes);
+    uint64_t end = index->next_store_index;
+    size_t lowest = 0;
+    esp_err_t esp_err = ESP_OK;
+    while (lowest < index->holes_count) {
+        if (index->holes[index->holes_count - 1] == end - 2) {
+            index->holes_count--;
+            end -= 2;
+            continue;
+        }
+        esp_err = move_pair(handle, index, end - 2, index->holes[lowest]);
+        if (esp_err != ESP_OK) {
+            break;
+        }
+        lowest++;
+        end -= 2;
+    }
+
+    // Pairs moved before an error leave holes at the end, as if they had been erased
+    if (esp_err == ESP_OK) {
+        esp_err = nvs_set_u64(handle, "next store idx", end);
+        if (esp_err != ESP_OK) {
+            ESP_LOGE(TAG, "Error updating the next store index.");
+        }
+    }
     if (esp_err != ESP_OK) {
-        ESP_LOGE(TAG, "Error updating the next store index.");
+        astarte_nvs_key_value_index_destroy(index);
         return esp_err;
     }
-
-    return esp_err;
+    index->holes_count = 0;
+    index->next_store_index = end;
+    return ESP_OK;
 }
 
 esp_err_t astarte_nvs_key_value_iterator_init(
@@ -312,8 +482,15 @@ esp_err_t astarte_nvs_key_value_iterator_init(
         return esp_err;
     }
 
+    // Point to the first pair, skipping the holes
+    uint64_t store_index = 0;
+    esp_err = find_stored_pair(handle, 0, next_store_index, &store_index);
+    if (esp_err != ESP_OK) {
+        return esp_err;
+    }
+
     // Initialize the iterator
-    iterator->store_index = 0;
+    iterator->store_index = store_index;
     iterator->handle = handle;
     iterator->type = type;
 
@@ -335,29 +512,42 @@ esp_err_t astarte_nvs_key_value_iterator_peek(
         return esp_err;
     }
 
-    // Check if the current pair is the last one
-    if (iterator->store_index + 2 >= next_store_index) {
+    // Check if a pair follows the current one
+    uint64_t store_index = 0;
+    esp_err = find_stored_pair(
+        iterator->handle, iterator->store_index + 2, next_store_index, &store_index);
+    if (esp_err == ESP_ERR_NVS_NOT_FOUND) {
         *has_next = false;
-    } else {
-        *has_next = true;
+        return ESP_OK;
     }
+    if (esp_err != ESP_OK) {
+        return esp_err;
+    }
+    *has_next = true;
     return ESP_OK;
 }
 
 esp_err_t astarte_nvs_key_value_iterator_next(astarte_nvs_key_value_iterator_t *iterator)
 {
-    bool has_next = false;
-    esp_err_t esp_err = astarte_nvs_key_value_iterator_peek(iterator, &has_next);
+    // Get the next store index
+    uint64_t next_store_index = 0;
+    esp_err_t esp_err = nvs_get_u64(iterator->handle, "next store idx", &next_store_index);
+    if ((esp_err == ESP_ERR_NVS_NOT_FOUND) || ((esp_err == ESP_OK) && (next_store_index == 0))) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
     if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Error getting the next store index.");
         return esp_err;
     }
 
-    if (!has_next) {
-        return ESP_ERR_NVS_NOT_FOUND;
+    // Advance the iterator to the following pair, skipping the holes
+    uint64_t store_index = 0;
+    esp_err = find_stored_pair(
+        iterator->handle, iterator->store_index + 2, next_store_index, &store_index);
+    if (esp_err != ESP_OK) {
+        return esp_err;
     }
-
-    // Advance the iterator
-    iterator->store_index += 2;
+    iterator->store_index = store_index;
 
     return ESP_OK;
 }
@@ -371,8 +561,12 @@ esp_err_t astarte_nvs_key_value_iterator_get_element(astarte_nvs_key_value_itera
     }
 
     // Step 1: Get the key using the store index contained in the iterator
+    esp_err_t esp_err = seek_stored_pair(iterator);
+    if (esp_err != ESP_OK) {
+        return ESP_FAIL;
+    }
     char key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
-    esp_err_t esp_err = get_entry_name(iterator->store_index, key_entry_name);
+    esp_err = get_entry_name(iterator->store_index, key_entry_name);
     if (esp_err != ESP_OK) {
         return ESP_FAIL;
     }
@@ -428,6 +622,58 @@ esp_err_t astarte_nvs_key_value_iterator_get_element(astarte_nvs_key_value_itera
     return esp_err;
 }
 
+esp_err_t astarte_nvs_key_value_iterator_read_element(astarte_nvs_key_value_iterator_t *iterator,
+    char *out_key, size_t *out_key_len, void *out_value, size_t *out_value_len)
+{
+    if (iterator->type != NVS_TYPE_BLOB) {
+        ESP_LOGE(TAG, "Calling getter function for binary blob over an iterator of other type.");
+        return ESP_FAIL;
+    }
+
+    esp_err_t esp_err = seek_stored_pair(iterator);
+    if (esp_err != ESP_OK) {
+        return ESP_FAIL;
+    }
+    char key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    char value_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    esp_err = get_entry_name(iterator->store_index, key_entry_name);
+    if (esp_err == ESP_OK) {
+        esp_err = get_entry_name(iterator->store_index + 1, value_entry_name);
+    }
+    if (esp_err != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    // Read key and value directly, the lengths are only fetched when the buffers are too small
+    bool too_small = false;
+    size_t key_len = *out_key_len;
+    // Confusing for clang-tidy as second parameter is called 'key'
+    // NOLINTNEXTLINE(readability-suspicious-call-argument)
+    esp_err = nvs_get_str(iterator->handle, key_entry_name, out_key, &key_len);
+    if (esp_err == ESP_ERR_NVS_INVALID_LENGTH) {
+        too_small = true;
+        esp_err = nvs_get_str(iterator->handle, key_entry_name, NULL, &key_len);
+    }
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Error fetching key from nvs during iteration.");
+        return esp_err;
+    }
+    size_t value_len = *out_value_len;
+    esp_err = nvs_get_blob(iterator->handle, value_entry_name, out_value, &value_len);
+    if (esp_err == ESP_ERR_NVS_INVALID_LENGTH) {
+        too_small = true;
+        esp_err = nvs_get_blob(iterator->handle, value_entry_name, NULL, &value_len);
+    }
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Error fetching value from nvs during iteration.");
+        return esp_err;
+    }
+
+    *out_key_len = key_len;
+    *out_value_len = value_len;
+    return (too_small) ? ESP_ERR_NVS_INVALID_LENGTH : ESP_OK;
+}
+
 /************************************************
  *         Static functions definitions         *
  ***********************************************/
@@ -442,8 +688,24 @@ static esp_err_t get_entry_name(uint64_t store_index, char *entry_name)
     return ESP_OK;
 }
 
-static esp_err_t lookup_key_position(nvs_handle_t handle, const char *key, uint64_t *store_index)
+static esp_err_t lookup_key_position(nvs_handle_t handle, astarte_nvs_key_value_index_t *index,
+    const char *key, uint64_t *store_index)
 {
+    if (index) {
+        if (!index->slots) {
+            esp_err_t esp_err = build_index(handle, index);
+            if (esp_err != ESP_OK) {
+                return ESP_FAIL;
+            }
+        }
+        size_t slot = 0;
+        esp_err_t esp_err = find_index_slot(handle, index, key, &slot);
+        if (esp_err == ESP_OK) {
+            *store_index = index->slots[slot].store_index;
+        }
+        return esp_err;
+    }
+
     // Read the next "store" index
     uint64_t next_store_index = 0;
     esp_err_t esp_err = nvs_get_u64(handle, "next store idx", &next_store_index);
@@ -457,36 +719,389 @@ static esp_err_t lookup_key_position(nvs_handle_t handle, const char *key, uint6
 
     // Loop over all the stored entries using the "store" index
     for (uint64_t i = 0; i < next_store_index; i += 2) {
-        char tmp_key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
-        esp_err = get_entry_name(i, tmp_key_entry_name);
+        bool match = false;
+        esp_err = compare_stored_key(handle, i, key, &match);
+        if (esp_err == ESP_ERR_NVS_NOT_FOUND) {
+            continue;
+        }
         if (esp_err != ESP_OK) {
             return ESP_FAIL;
         }
-        size_t tmp_key_len = 0;
-        esp_err = nvs_get_str(handle, tmp_key_entry_name, NULL, &tmp_key_len);
+        if (match) {
+            *store_index = i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+static esp_err_t find_index_slot(
+    nvs_handle_t handle, const astarte_nvs_key_value_index_t *index, const char *key, size_t *slot)
+{
+    uint32_t key_hash = astarte_hash_fnv1a_32(key, strlen(key));
+    size_t mask = index->slots_count - 1;
+    // The index is never full, the probing always ends on an unused slot
+    for (size_t i = key_hash & mask; index->slots[i].used; i = (i + 1) & mask) {
+        if (index->slots[i].key_hash != key_hash) {
+            continue;
+        }
+        bool match = false;
+        esp_err_t esp_err = compare_stored_key(handle, index->slots[i].store_index, key, &match);
         if (esp_err != ESP_OK) {
-            ESP_LOGE(TAG, "Error getting the key length for %s", tmp_key_entry_name);
             return ESP_FAIL;
         }
-        char *tmp_key = calloc(tmp_key_len, sizeof(char));
-        if (!tmp_key) {
-            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
-            return ESP_FAIL;
+        if (match) {
+            *slot = i;
+            return ESP_OK;
         }
-        // Confusing for clang-tidy as second parameter is called 'key'
-        // NOLINTNEXTLINE(readability-suspicious-call-argument)
-        esp_err = nvs_get_str(handle, tmp_key_entry_name, tmp_key, &tmp_key_len);
+    }
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+static esp_err_t get_next_store_index(
+    nvs_handle_t handle, const astarte_nvs_key_value_index_t *index, uint64_t *next_store_index)
+{
+    if (index) {
+        *next_store_index = index->next_store_index;
+        return ESP_OK;
+    }
+    *next_store_index = 0;
+    esp_err_t esp_err = nvs_get_u64(handle, "next store idx", next_store_index);
+    if (esp_err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Error getting the next store index.");
+    }
+    return esp_err;
+}
+
+static esp_err_t find_stored_pair(
+    nvs_handle_t handle, uint64_t from, uint64_t next_store_index, uint64_t *store_index)
+{
+    for (uint64_t i = from; i < next_store_index; i += 2) {
+        char key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+        esp_err_t esp_err = get_entry_name(i, key_entry_name);
         if (esp_err != ESP_OK) {
-            ESP_LOGE(TAG, "Error getting the key for %s", tmp_key_entry_name);
-            free(tmp_key);
             return ESP_FAIL;
         }
-        if (strcmp(key, tmp_key) == 0) {
-            *store_index = i;
-            free(tmp_key);
-            return ESP_OK;
+        size_t key_len = 0;
+        esp_err = nvs_get_str(handle, key_entry_name, NULL, &key_len);
+        if (esp_err == ESP_ERR_NVS_NOT_FOUND) {
+            continue;
         }
-        free(tmp_key);
+        if (esp_err != ESP_OK) {
+            ESP_LOGE(TAG, "Error getting the key length for %s", key_entry_name);
+            return ESP_FAIL;
+        }
+        *store_index = i;
+        return ESP_OK;
     }
     return ESP_ERR_NVS_NOT_FOUND;
 }
+
+static esp_err_t seek_stored_pair(astarte_nvs_key_value_iterator_t *iterator)
+{
+    char key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    esp_err_t esp_err = get_entry_name(iterator->store_index, key_entry_name);
+    if (esp_err != ESP_OK) {
+        return ESP_FAIL;
+    }
+    size_t key_len = 0;
+    esp_err = nvs_get_str(iterator->handle, key_entry_name, NULL, &key_len);
+    if (esp_err != ESP_ERR_NVS_NOT_FOUND) {
+        return esp_err;
+    }
+
+    // The pair pointed to has been erased, move to the following one
+    uint64_t next_store_index = 0;
+    esp_err = nvs_get_u64(iterator->handle, "next store idx", &next_store_index);
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Error getting the next store index.");
+        return esp_err;
+    }
+    return find_stored_pair(
+        iterator->handle, iterator->store_index, next_store_index, &iterator->store_index);
+}
+
+static esp_err_t move_pair(
+    nvs_handle_t handle, astarte_nvs_key_value_index_t *index, uint64_t from, uint64_t to)
+{
+    char *key = NULL;
+    size_t key_size = 0;
+    void *value = NULL;
+    char from_key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    char from_value_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    char to_key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    char to_value_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    esp_err_t esp_err = get_entry_name(from, from_key_entry_name);
+    if (esp_err == ESP_OK) {
+        esp_err = get_entry_name(from + 1, from_value_entry_name);
+    }
+    if (esp_err == ESP_OK) {
+        esp_err = get_entry_name(to, to_key_entry_name);
+    }
+    if (esp_err == ESP_OK) {
+        esp_err = get_entry_name(to + 1, to_value_entry_name);
+    }
+    if (esp_err != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    // Read the pair to move
+    esp_err = read_stored_key(handle, from, &key, &key_size);
+    if (esp_err != ESP_OK) {
+        goto end;
+    }
+    size_t value_len = 0;
+    esp_err = nvs_get_blob(handle, from_value_entry_name, NULL, &value_len);
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Error fetching value from nvs during compaction.");
+        goto end;
+    }
+    value = malloc(value_len);
+    if (!value && (value_len > 0)) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        esp_err = ESP_ERR_NO_MEM;
+        goto end;
+    }
+    esp_err = nvs_get_blob(handle, from_value_entry_name, value, &value_len);
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Error fetching value from nvs during compaction.");
+        goto end;
+    }
+
+    // Write it in the hole, the value first so that a stored key always has a value
+    esp_err = nvs_set_blob(handle, to_value_entry_name, value, value_len);
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Error storing the value.");
+        goto end;
+    }
+    // Confusing for clang-tidy as second parameter is called 'key'
+    // NOLINTNEXTLINE(readability-suspicious-call-argument)
+    esp_err = nvs_set_str(handle, to_key_entry_name, key);
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Error storing the key.");
+        goto end;
+    }
+    esp_err = nvs_erase_key(handle, from_key_entry_name);
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed erasing a key.");
+        goto end;
+    }
+    nvs_erase_key(handle, from_value_entry_name);
+
+    // Update the slot of the moved key
+    size_t mask = index->slots_count - 1;
+    uint32_t key_hash = astarte_hash_fnv1a_32(key, strlen(key));
+    for (size_t i = key_hash & mask; index->slots[i].used; i = (i + 1) & mask) {
+        if (index->slots[i].store_index == from) {
+            index->slots[i].store_index = to;
+            break;
+        }
+    }
+
+end:
+    free(key);
+    free(value);
+    return esp_err;
+}
+
+static esp_err_t build_index(nvs_handle_t handle, astarte_nvs_key_value_index_t *index)
+{
+    uint64_t next_store_index = 0;
+    esp_err_t esp_err = get_next_store_index(handle, NULL, &next_store_index);
+    if (esp_err != ESP_OK) {
+        return esp_err;
+    }
+
+    // Keep the load factor of the table below one half
+    size_t slots_count = INDEX_MIN_SLOTS_COUNT;
+    while (slots_count < next_store_index) {
+        slots_count *= 2;
+    }
+    astarte_nvs_key_value_index_slot_t *slots
+        = calloc(slots_count, sizeof(astarte_nvs_key_value_index_slot_t));
+    if (!slots) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ESP_ERR_NO_MEM;
+    }
+    index->slots = slots;
+    index->slots_count = slots_count;
+    index->keys_count = 0;
+    index->holes_count = 0;
+    index->next_store_index = next_store_index;
+
+    // Read each key once, reusing the same buffer
+    char *key = NULL;
+    size_t key_size = 0;
+    for (uint64_t i = 0; i < next_store_index; i += 2) {
+        esp_err = read_stored_key(handle, i, &key, &key_size);
+        if (esp_err == ESP_ERR_NVS_NOT_FOUND) {
+            esp_err = reserve_index_hole(index);
+            if (esp_err != ESP_OK) {
+                goto error;
+            }
+            index->holes[index->holes_count++] = i;
+            continue;
+        }
+        if (esp_err != ESP_OK) {
+            goto error;
+        }
+        insert_index_key(index, astarte_hash_fnv1a_32(key, strlen(key)), i);
+    }
+    free(key);
+    return ESP_OK;
+
+error:
+    free(key);
+    astarte_nvs_key_value_index_destroy(index);
+    return esp_err;
+}
+
+static esp_err_t reserve_index_slot(astarte_nvs_key_value_index_t *index)
+{
+    if ((index->keys_count + 1) * 2 <= index->slots_count) {
+        return ESP_OK;
+    }
+
+    size_t slots_count = index->slots_count * 2;
+    astarte_nvs_key_value_index_slot_t *slots
+        = calloc(slots_count, sizeof(astarte_nvs_key_value_index_slot_t));
+    if (!slots) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ESP_ERR_NO_MEM;
+    }
+    astarte_nvs_key_value_index_slot_t *old_slots = index->slots;
+    size_t old_slots_count = index->slots_count;
+    index->slots = slots;
+    index->slots_count = slots_count;
+    index->keys_count = 0;
+    for (size_t i = 0; i < old_slots_count; i++) {
+        if (old_slots[i].used) {
+            insert_index_key(index, old_slots[i].key_hash, old_slots[i].store_index);
+        }
+    }
+    free(old_slots);
+    return ESP_OK;
+}
+
+static esp_err_t reserve_index_hole(astarte_nvs_key_value_index_t *index)
+{
+    if (index->holes_count < index->holes_capacity) {
+        return ESP_OK;
+    }
+
+    size_t holes_capacity = (index->holes_capacity > 0) ? index->holes_capacity * 2
+                                                        : INDEX_MIN_HOLES_CAPACITY;
+    uint64_t *holes = realloc(index->holes, holes_capacity * sizeof(uint64_t));
+    if (!holes) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ESP_ERR_NO_MEM;
+    }
+    index->holes = holes;
+    index->holes_capacity = holes_capacity;
+    return ESP_OK;
+}
+
+static void insert_index_key(
+    astarte_nvs_key_value_index_t *index, uint32_t key_hash, uint64_t store_index)
+{
+    size_t mask = index->slots_count - 1;
+    size_t slot = key_hash & mask;
+    while (index->slots[slot].used) {
+        slot = (slot + 1) & mask;
+    }
+    index->slots[slot].store_index = store_index;
+    index->slots[slot].key_hash = key_hash;
+    index->slots[slot].used = true;
+    index->keys_count++;
+}
+
+static void remove_index_slot(astarte_nvs_key_value_index_t *index, size_t slot)
+{
+    // Move back the following keys that would not be reachable anymore from their home slot
+    size_t mask = index->slots_count - 1;
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & mask; index->slots[next].used; next = (next + 1) & mask) {
+        size_t home = index->slots[next].key_hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            index->slots[hole] = index->slots[next];
+            hole = next;
+        }
+    }
+    index->slots[hole].used = false;
+    index->keys_count--;
+}
+
+static esp_err_t compare_stored_key(
+    nvs_handle_t handle, uint64_t store_index, const char *key, bool *match)
+{
+    char key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    esp_err_t esp_err = get_entry_name(store_index, key_entry_name);
+    if (esp_err != ESP_OK) {
+        return ESP_FAIL;
+    }
+    // Longer stored keys do not fit in the buffer and are discarded without reading them
+    size_t key_len = strlen(key) + 1;
+    char *stored_key = malloc(key_len);
+    if (!stored_key) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ESP_FAIL;
+    }
+    size_t stored_key_len = key_len;
+    esp_err = nvs_get_str(handle, key_entry_name, stored_key, &stored_key_len);
+    if (esp_err == ESP_ERR_NVS_INVALID_LENGTH) {
+        *match = false;
+        esp_err = ESP_OK;
+    } else if (esp_err == ESP_OK) {
+        *match = (stored_key_len == key_len) && (strcmp(stored_key, key) == 0);
+    } else if (esp_err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGE(TAG, "Error getting the key for %s", key_entry_name);
+    }
+    free(stored_key);
+    return esp_err;
+}
+
+static esp_err_t read_stored_key(
+    nvs_handle_t handle, uint64_t store_index, char **key, size_t *key_size)
+{
+    char key_entry_name[NVS_KEY_NAME_MAX_SIZE] = { 0 };
+    esp_err_t esp_err = get_entry_name(store_index, key_entry_name);
+    if (esp_err != ESP_OK) {
+        return ESP_FAIL;
+    }
+    size_t key_len = 0;
+    esp_err = nvs_get_str(handle, key_entry_name, NULL, &key_len);
+    if (esp_err == ESP_ERR_NVS_NOT_FOUND) {
+        return esp_err;
+    }
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Error getting the key length for %s", key_entry_name);
+        return ESP_FAIL;
+    }
+    if (key_len > *key_size) {
+        char *new_key = realloc(*key, key_len);
+        if (!new_key) {
+            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+            return ESP_ERR_NO_MEM;
+        }
+        *key = new_key;
+        *key_size = key_len;
+    }
+    // Confusing for clang-tidy as second parameter is called 'key'
+    // NOLINTNEXTLINE(readability-suspicious-call-argument)
+    esp_err = nvs_get_str(handle, key_entry_name, *key, &key_len);
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Error getting the key for %s", key_entry_name);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static int compare_store_indexes(const void *a, const void *b)
+{
+    uint64_t store_index_a = *(const uint64_t *) a;
+    uint64_t store_index_b = *(const uint64_t *) b;
+    return (store_index_a > store_index_b) - (store_index_a < store_index_b);
+}
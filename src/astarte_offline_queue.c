@@ -0,0 +1,549 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+#include "astarte_offline_queue.h"
+
+#include "astarte_hash.h"
+
+#include <esp_log.h>
+#include <string.h>
+
+/************************************************
+ *        Defines, constants and typedef        *
+ ***********************************************/
+
+#define TAG "ASTARTE_OFFLINE_QUEUE"
+
+#define SECTOR_MAGIC 0x51545341U // "ASTQ"
+
+// Flash bits can only be cleared without an erase, each state clears one more bit
+#define RECORD_STATE_EMPTY 0xFFU
+#define RECORD_STATE_WRITING 0xFEU
+#define RECORD_STATE_VALID 0xFCU
+#define RECORD_STATE_CONSUMED 0xF8U
+
+#define RECORD_ALIGNMENT 4U
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;
+} sector_header_t;
+
+typedef struct
+{
+    uint8_t state;
+    uint8_t qos;
+    uint16_t topic_len;
+    uint32_t data_len;
+    uint32_t checksum;
+} record_header_t;
+
+/************************************************
+ *         Static functions declaration         *
+ ***********************************************/
+
+/**
+ * @brief Compute the space occupied in flash by a record.
+ *
+ * @param[in] header Header of the record.
+ * @return The size of the record, including its header and alignment padding.
+ */
+static uint32_t record_size(const record_header_t *header);
+/**
+ * @brief Check if a record header can be trusted, it could be corrupted by a power loss.
+ *
+ * @param[in] header Header of the record.
+ * @param[in] offset Offset of the record in its sector.
+ * @return true if the record fits in the sector, false otherwise.
+ */
+static bool record_is_sane(const record_header_t *header, uint32_t offset);
+/**
+ * @brief Read a record header from flash.
+ *
+ * @param[in] queue Queue to read from.
+ * @param[in] sector Sector containing the record.
+ * @param[in] offset Offset of the record in the sector.
+ * @param[out] header Header to fill.
+ * @return ASTARTE_ERR_ESP_SDK when the read fails, ASTARTE_OK otherwise.
+ */
+static astarte_err_t read_record_header(astarte_offline_queue_t *queue, uint32_t sector,
+    uint32_t offset, record_header_t *header);
+/**
+ * @brief Clear bits of the state of a record.
+ *
+ * @param[in] queue Queue to write to.
+ * @param[in] sector Sector containing the record.
+ * @param[in] offset Offset of the record in the sector.
+ * @param[in] state New state for the record.
+ * @return ASTARTE_ERR_ESP_SDK when the write fails, ASTARTE_OK otherwise.
+ */
+static astarte_err_t write_record_state(
+    astarte_offline_queue_t *queue, uint32_t sector, uint32_t offset, uint8_t state);
+/**
+ * @brief Count the valid records in a sector, starting from an offset.
+ *
+ * @param[in] queue Queue to read from.
+ * @param[in] sector Sector to scan.
+ * @param[in] offset Offset of the first record to check.
+ * @param[out] count Number of valid records.
+ * @param[out] end Offset of the first free byte of the sector, can be NULL.
+ * @return ASTARTE_ERR_ESP_SDK when the read fails, ASTARTE_OK otherwise.
+ */
+static astarte_err_t scan_sector(astarte_offline_queue_t *queue, uint32_t sector,
+    uint32_t offset, size_t *count, uint32_t *end);
+/**
+ * @brief Erase a sector and make it the new tail of the queue.
+ *
+ * @param[in] queue Queue to update.
+ * @param[in] sector Sector to start.
+ * @return ASTARTE_ERR_ESP_SDK when the flash operations fail, ASTARTE_OK otherwise.
+ */
+static astarte_err_t start_sector(astarte_offline_queue_t *queue, uint32_t sector);
+/**
+ * @brief Drop the messages still contained in the head sector and advance the head.
+ *
+ * @param[in] queue Queue to update.
+ * @return ASTARTE_ERR_ESP_SDK when reading the flash fails, ASTARTE_OK otherwise.
+ */
+static astarte_err_t drop_head_sector(astarte_offline_queue_t *queue);
+/**
+ * @brief Move the head of the queue to the oldest valid record.
+ *
+ * @param[in] queue Queue to update.
+ * @param[out] header Header of the oldest valid record.
+ * @return ASTARTE_ERR_NOT_FOUND if the queue is empty, ASTARTE_ERR_ESP_SDK if reading the flash
+ * fails, ASTARTE_OK otherwise.
+ */
+static astarte_err_t seek_head(astarte_offline_queue_t *queue, record_header_t *header);
+
+/************************************************
+ *         Global functions definitions         *
+ ***********************************************/
+
+astarte_err_t astarte_offline_queue_open(
+    astarte_offline_queue_t *queue, const char *partition_label)
+{
+    memset(queue, 0, sizeof(astarte_offline_queue_t));
+
+    queue->partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+    if (!queue->partition) {
+        ESP_LOGE(TAG, "Partition %s not found", partition_label);
+        return ASTARTE_ERR_PARTITION_SCHEME;
+    }
+    queue->sectors_count = queue->partition->size / ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE;
+    if (queue->sectors_count < 2) {
+        ESP_LOGE(TAG, "Partition %s should span at least two sectors", partition_label);
+        return ASTARTE_ERR_PARTITION_SCHEME;
+    }
+
+    queue->mutex = xSemaphoreCreateMutex();
+    if (!queue->mutex) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ASTARTE_ERR_OUT_OF_MEMORY;
+    }
+
+    // The head is the sector with the lowest sequence number, the tail the one with the highest
+    bool found = false;
+    for (uint32_t sector = 0; sector < queue->sectors_count; sector++) {
+        sector_header_t header;
+        esp_err_t esp_err = esp_partition_read(queue->partition,
+            sector * ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE, &header, sizeof(header));
+        if (esp_err != ESP_OK) {
+            ESP_LOGE(TAG, "Flash read failed: %s", esp_err_to_name(esp_err));
+            goto error;
+        }
+        if ((header.magic != SECTOR_MAGIC) || (header.seq == 0) || (header.seq == UINT32_MAX)) {
+            continue;
+        }
+        if (!found || (header.seq < queue->head_seq)) {
+            queue->head_sector = sector;
+            queue->head_seq = header.seq;
+        }
+        if (!found || (header.seq > queue->tail_seq)) {
+            queue->tail_sector = sector;
+            queue->tail_seq = header.seq;
+        }
+        found = true;
+    }
+
+    queue->head_offset = sizeof(sector_header_t);
+    queue->tail_offset = sizeof(sector_header_t);
+    if (!found) {
+        // The first push will start the sector with sequence number one
+        queue->head_seq = 1;
+        return ASTARTE_OK;
+    }
+
+    uint32_t sector = queue->head_sector;
+    while (true) {
+        size_t count = 0;
+        uint32_t end = 0;
+        if (scan_sector(queue, sector, sizeof(sector_header_t), &count, &end) != ASTARTE_OK) {
+            goto error;
+        }
+        queue->count += count;
+        if (sector == queue->tail_sector) {
+            queue->tail_offset = end;
+            break;
+        }
+        sector = (sector + 1) % queue->sectors_count;
+    }
+
+    ESP_LOGI(TAG, "Recovered %zu messages from partition %s", queue->count, partition_label);
+    return ASTARTE_OK;
+
+error:
+    vSemaphoreDelete(queue->mutex);
+    queue->mutex = NULL;
+    return ASTARTE_ERR_ESP_SDK;
+}
+
+void astarte_offline_queue_close(astarte_offline_queue_t *queue)
+{
+    if (queue->mutex) {
+        vSemaphoreDelete(queue->mutex);
+    }
+    memset(queue, 0, sizeof(astarte_offline_queue_t));
+}
+
+astarte_err_t astarte_offline_queue_push(astarte_offline_queue_t *queue, const char *topic,
+    const void *data, size_t data_len, int qos, bool drop_oldest)
+{
+    size_t topic_len = strlen(topic);
+    if ((topic_len + data_len) > ASTARTE_OFFLINE_QUEUE_MAX_MESSAGE_SIZE) {
+        ESP_LOGE(TAG, "Message on %s is too large for the queue", topic);
+        return ASTARTE_ERR_INVALID_SIZE;
+    }
+
+    uint32_t checksum = astarte_hash_fnv1a_32(topic, topic_len);
+    record_header_t header = {
+        .state = RECORD_STATE_WRITING,
+        .qos = (uint8_t) qos,
+        .topic_len = (uint16_t) topic_len,
+        .data_len = (uint32_t) data_len,
+        .checksum = astarte_hash_fnv1a_32_update(checksum, data, data_len),
+    };
+    uint32_t size = record_size(&header);
+
+    xSemaphoreTake(queue->mutex, portMAX_DELAY);
+
+    astarte_err_t ret = ASTARTE_OK;
+    if (queue->tail_seq == 0) {
+        ret = start_sector(queue, queue->tail_sector);
+    } else if (queue->tail_offset + size > ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE) {
+        uint32_t next_sector = (queue->tail_sector + 1) % queue->sectors_count;
+        if (next_sector == queue->head_sector) {
+            if (!drop_oldest) {
+                ESP_LOGW(TAG, "Queue full, discarding message on %s", topic);
+                ret = ASTARTE_ERR_QUEUE_FULL;
+                goto end;
+            }
+            ret = drop_head_sector(queue);
+            if (ret != ASTARTE_OK) {
+                goto end;
+            }
+        }
+        ret = start_sector(queue, next_sector);
+    }
+    if (ret != ASTARTE_OK) {
+        goto end;
+    }
+
+    // The record is valid only once all its content has been written
+    uint32_t address = queue->tail_sector * ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE + queue->tail_offset;
+    esp_err_t esp_err = esp_partition_write(queue->partition, address, &header, sizeof(header));
+    if (esp_err == ESP_OK) {
+        esp_err = esp_partition_write(queue->partition, address + sizeof(header), topic, topic_len);
+    }
+    if ((esp_err == ESP_OK) && (data_len > 0)) {
+        esp_err = esp_partition_write(
+            queue->partition, address + sizeof(header) + topic_len, data, data_len);
+    }
+    // Even if the write failed the space is not usable anymore
+    uint32_t record_offset = queue->tail_offset;
+    queue->tail_offset += size;
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Flash write failed: %s", esp_err_to_name(esp_err));
+        ret = ASTARTE_ERR_ESP_SDK;
+        goto end;
+    }
+    ret = write_record_state(queue, queue->tail_sector, record_offset, RECORD_STATE_VALID);
+    if (ret == ASTARTE_OK) {
+        queue->count++;
+    }
+
+end:
+    xSemaphoreGive(queue->mutex);
+    return ret;
+}
+
+astarte_err_t astarte_offline_queue_peek(astarte_offline_queue_t *queue, char *topic,
+    size_t topic_size, void *data, size_t *data_len, int *qos)
+{
+    xSemaphoreTake(queue->mutex, portMAX_DELAY);
+
+    astarte_err_t ret = ASTARTE_OK;
+    while (true) {
+        record_header_t header;
+        ret = seek_head(queue, &header);
+        if (ret != ASTARTE_OK) {
+            break;
+        }
+        if ((header.topic_len >= topic_size) || (header.data_len > *data_len)) {
+            ESP_LOGE(TAG, "Provided buffers are too small for the queued message");
+            ret = ASTARTE_ERR_INVALID_SIZE;
+            break;
+        }
+
+        uint32_t address
+            = queue->head_sector * ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE + queue->head_offset;
+        esp_err_t esp_err = esp_partition_read(
+            queue->partition, address + sizeof(header), topic, header.topic_len);
+        if ((esp_err == ESP_OK) && (header.data_len > 0)) {
+            esp_err = esp_partition_read(queue->partition,
+                address + sizeof(header) + header.topic_len, data, header.data_len);
+        }
+        if (esp_err != ESP_OK) {
+            ESP_LOGE(TAG, "Flash read failed: %s", esp_err_to_name(esp_err));
+            ret = ASTARTE_ERR_ESP_SDK;
+            break;
+        }
+
+        uint32_t checksum = astarte_hash_fnv1a_32(topic, header.topic_len);
+        if (astarte_hash_fnv1a_32_update(checksum, data, header.data_len) != header.checksum) {
+            // Skip corrupted messages
+            ESP_LOGW(TAG, "Discarding a corrupted message");
+            ret = write_record_state(
+                queue, queue->head_sector, queue->head_offset, RECORD_STATE_CONSUMED);
+            if (ret != ASTARTE_OK) {
+                break;
+            }
+            queue->head_offset += record_size(&header);
+            queue->count--;
+            continue;
+        }
+
+        topic[header.topic_len] = '\0';
+        *data_len = header.data_len;
+        *qos = header.qos;
+        queue->peek_seq = queue->head_seq;
+        queue->peek_offset = queue->head_offset;
+        break;
+    }
+
+    xSemaphoreGive(queue->mutex);
+    return ret;
+}
+
+astarte_err_t astarte_offline_queue_pop(astarte_offline_queue_t *queue)
+{
+    xSemaphoreTake(queue->mutex, portMAX_DELAY);
+
+    astarte_err_t ret = ASTARTE_OK;
+    if ((queue->peek_seq == 0) || (queue->peek_seq != queue->head_seq)
+        || (queue->peek_offset != queue->head_offset)) {
+        // The message has been dropped since it was peeked
+        goto end;
+    }
+
+    record_header_t header;
+    ret = read_record_header(queue, queue->head_sector, queue->head_offset, &header);
+    if (ret != ASTARTE_OK) {
+        goto end;
+    }
+    ret = write_record_state(queue, queue->head_sector, queue->head_offset, RECORD_STATE_CONSUMED);
+    if (ret != ASTARTE_OK) {
+        goto end;
+    }
+    queue->head_offset += record_size(&header);
+    queue->count--;
+
+end:
+    queue->peek_seq = 0;
+    xSemaphoreGive(queue->mutex);
+    return ret;
+}
+
+size_t astarte_offline_queue_count(astarte_offline_queue_t *queue)
+{
+    xSemaphoreTake(queue->mutex, portMAX_DELAY);
+    size_t count = queue->count;
+    xSemaphoreGive(queue->mutex);
+    return count;
+}
+
+astarte_err_t astarte_offline_queue_clear(astarte_offline_queue_t *queue)
+{
+    xSemaphoreTake(queue->mutex, portMAX_DELAY);
+
+    astarte_err_t ret = ASTARTE_OK;
+    esp_err_t esp_err = esp_partition_erase_range(
+        queue->partition, 0, queue->sectors_count * ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE);
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Flash erase failed: %s", esp_err_to_name(esp_err));
+        ret = ASTARTE_ERR_ESP_SDK;
+    }
+
+    queue->head_sector = 0;
+    queue->head_seq = 1;
+    queue->head_offset = sizeof(sector_header_t);
+    queue->tail_sector = 0;
+    queue->tail_seq = 0;
+    queue->tail_offset = sizeof(sector_header_t);
+    queue->peek_seq = 0;
+    queue->count = 0;
+
+    xSemaphoreGive(queue->mutex);
+    return ret;
+}
+
+/************************************************
+ *         Static functions definitions         *
+ ***********************************************/
+
+static uint32_t record_size(const record_header_t *header)
+{
+    uint32_t size = sizeof(record_header_t) + header->topic_len + header->data_len;
+    return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+static bool record_is_sane(const record_header_t *header, uint32_t offset)
+{
+    if ((header->topic_len + header->data_len) > ASTARTE_OFFLINE_QUEUE_MAX_MESSAGE_SIZE) {
+        return false;
+    }
+    return offset + record_size(header) <= ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE;
+}
+
+static astarte_err_t read_record_header(astarte_offline_queue_t *queue, uint32_t sector,
+    uint32_t offset, record_header_t *header)
+{
+    esp_err_t esp_err = esp_partition_read(queue->partition,
+        sector * ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE + offset, header, sizeof(record_header_t));
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Flash read failed: %s", esp_err_to_name(esp_err));
+        return ASTARTE_ERR_ESP_SDK;
+    }
+    return ASTARTE_OK;
+}
+
+static astarte_err_t write_record_state(
+    astarte_offline_queue_t *queue, uint32_t sector, uint32_t offset, uint8_t state)
+{
+    esp_err_t esp_err = esp_partition_write(
+        queue->partition, sector * ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE + offset, &state, 1);
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Flash write failed: %s", esp_err_to_name(esp_err));
+        return ASTARTE_ERR_ESP_SDK;
+    }
+    return ASTARTE_OK;
+}
+
+static astarte_err_t scan_sector(astarte_offline_queue_t *queue, uint32_t sector,
+    uint32_t offset, size_t *count, uint32_t *end)
+{
+    *count = 0;
+    while (offset + sizeof(record_header_t) <= ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE) {
+        record_header_t header;
+        astarte_err_t ret = read_record_header(queue, sector, offset, &header);
+        if (ret != ASTARTE_OK) {
+            return ret;
+        }
+        if ((header.state == RECORD_STATE_EMPTY) && (header.data_len == UINT32_MAX)) {
+            break;
+        }
+        if (!record_is_sane(&header, offset)) {
+            // A write has been interrupted, the rest of the sector can't be used
+            offset = ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE;
+            break;
+        }
+        if (header.state == RECORD_STATE_VALID) {
+            (*count)++;
+        }
+        offset += record_size(&header);
+    }
+    if (end) {
+        *end = offset;
+    }
+    return ASTARTE_OK;
+}
+
+static astarte_err_t start_sector(astarte_offline_queue_t *queue, uint32_t sector)
+{
+    uint32_t address = sector * ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE;
+    esp_err_t esp_err
+        = esp_partition_erase_range(queue->partition, address, ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE);
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Flash erase failed: %s", esp_err_to_name(esp_err));
+        return ASTARTE_ERR_ESP_SDK;
+    }
+    sector_header_t header = { .magic = SECTOR_MAGIC, .seq = queue->tail_seq + 1 };
+    esp_err = esp_partition_write(queue->partition, address, &header, sizeof(header));
+    if (esp_err != ESP_OK) {
+        ESP_LOGE(TAG, "Flash write failed: %s", esp_err_to_name(esp_err));
+        return ASTARTE_ERR_ESP_SDK;
+    }
+    queue->tail_sector = sector;
+    queue->tail_seq = header.seq;
+    queue->tail_offset = sizeof(sector_header_t);
+    return ASTARTE_OK;
+}
+
+static astarte_err_t drop_head_sector(astarte_offline_queue_t *queue)
+{
+    size_t count = 0;
+    astarte_err_t ret = scan_sector(queue, queue->head_sector, queue->head_offset, &count, NULL);
+    if (ret != ASTARTE_OK) {
+        return ret;
+    }
+    if (count > 0) {
+        ESP_LOGW(TAG, "Queue full, dropping %zu old messages", count);
+    }
+    queue->count -= count;
+    queue->head_sector = (queue->head_sector + 1) % queue->sectors_count;
+    queue->head_seq++;
+    queue->head_offset = sizeof(sector_header_t);
+    return ASTARTE_OK;
+}
+
+static astarte_err_t seek_head(astarte_offline_queue_t *queue, record_header_t *header)
+{
+    while (true) {
+        bool is_tail = (queue->head_sector == queue->tail_sector);
+        if (is_tail && (queue->head_offset >= queue->tail_offset)) {
+            return ASTARTE_ERR_NOT_FOUND;
+        }
+
+        bool sector_end = true;
+        if (queue->head_offset + sizeof(record_header_t) <= ASTARTE_OFFLINE_QUEUE_SECTOR_SIZE) {
+            astarte_err_t ret
+                = read_record_header(queue, queue->head_sector, queue->head_offset, header);
+            if (ret != ASTARTE_OK) {
+                return ret;
+            }
+            sector_end = ((header->state == RECORD_STATE_EMPTY) && (header->data_len == UINT32_MAX))
+                || !record_is_sane(header, queue->head_offset);
+        }
+
+        if (sector_end) {
+            if (is_tail) {
+                return ASTARTE_ERR_NOT_FOUND;
+            }
+            queue->head_sector = (queue->head_sector + 1) % queue->sectors_count;
+            queue->head_seq++;
+            queue->head_offset = sizeof(sector_header_t);
+            continue;
+        }
+
+        if (header->state == RECORD_STATE_VALID) {
+            return ASTARTE_OK;
+        }
+        // Skip consumed records and records with an interrupted write
+        queue->head_offset += record_size(header);
+    }
+}
@@ -0,0 +1,236 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+#include "astarte_property_buffer.h"
+
+#include <esp_log.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "astarte_hash.h"
+
+/************************************************
+ *        Defines, constants and typedef        *
+ ***********************************************/
+
+#define TAG "ASTARTE_PROPERTY_BUFFER"
+
+/************************************************
+ *         Static functions declaration         *
+ ***********************************************/
+
+/**
+ * @brief Compute the hash of the key of a property.
+ *
+ * @param[in] interface_name Interface name of the property.
+ * @param[in] interface_name_len Length of the interface name.
+ * @param[in] path Path of the property.
+ * @return The computed hash.
+ */
+static uint32_t hash_key(const char *interface_name, size_t interface_name_len, const char *path);
+/**
+ * @brief Find the entry of a property, or allocate a new one.
+ *
+ * @details When the buffer is full, the entry of the property written least recently is reused.
+ *
+ * @param[in] buffer Buffer to search.
+ * @param[in] interface_name Interface name of the property.
+ * @param[in] path Path of the property.
+ * @param[in] create Allocate a new entry if the property is not in the buffer.
+ * @return The entry, NULL if not found or if it could not be allocated.
+ */
+static astarte_property_buffer_entry_t *find_entry(astarte_property_buffer_t *buffer,
+    const char *interface_name, const char *path, bool create);
+/**
+ * @brief Replace the pending change of an entry.
+ *
+ * @param[in] buffer Buffer containing the entry.
+ * @param[in] entry Entry to update.
+ * @param[in] op New pending change.
+ * @param[in] data Value to store, NULL for deletions.
+ * @param[in] data_len Length of the value.
+ * @return ASTARTE_ERR_OUT_OF_MEMORY if the value could not be copied, ASTARTE_OK otherwise.
+ */
+static astarte_err_t set_pending(astarte_property_buffer_t *buffer,
+    astarte_property_buffer_entry_t *entry, astarte_property_buffer_op_t op, const void *data,
+    size_t data_len);
+
+/************************************************
+ *         Global functions definitions         *
+ ***********************************************/
+
+astarte_err_t astarte_property_buffer_init(astarte_property_buffer_t *buffer, size_t capacity)
+{
+    memset(buffer, 0, sizeof(astarte_property_buffer_t));
+    buffer->entries = calloc(capacity, sizeof(astarte_property_buffer_entry_t));
+    if (!buffer->entries) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ASTARTE_ERR_OUT_OF_MEMORY;
+    }
+    buffer->capacity = capacity;
+    return ASTARTE_OK;
+}
+
+void astarte_property_buffer_destroy(astarte_property_buffer_t *buffer)
+{
+    for (size_t i = 0; i < buffer->capacity; i++) {
+        free(buffer->entries[i].key);
+        free(buffer->entries[i].data);
+    }
+    free(buffer->entries);
+    memset(buffer, 0, sizeof(astarte_property_buffer_t));
+}
+
+const astarte_property_buffer_entry_t *astarte_property_buffer_get_pending(
+    astarte_property_buffer_t *buffer, const char *interface_name, const char *path)
+{
+    if (buffer->pending_count == 0) {
+        return NULL;
+    }
+    astarte_property_buffer_entry_t *entry = find_entry(buffer, interface_name, path, false);
+    return (entry && (entry->op != ASTARTE_PROPERTY_BUFFER_CLEAN)) ? entry : NULL;
+}
+
+astarte_err_t astarte_property_buffer_store(astarte_property_buffer_t *buffer,
+    const char *interface_name, const char *path, int32_t major, const void *data, size_t data_len)
+{
+    astarte_property_buffer_entry_t *entry = find_entry(buffer, interface_name, path, true);
+    if (!entry) {
+        return ASTARTE_ERR_QUEUE_FULL;
+    }
+    astarte_err_t err = set_pending(buffer, entry, ASTARTE_PROPERTY_BUFFER_STORE, data, data_len);
+    if (err == ASTARTE_OK) {
+        entry->major = major;
+    }
+    return err;
+}
+
+astarte_err_t astarte_property_buffer_delete(
+    astarte_property_buffer_t *buffer, const char *interface_name, const char *path)
+{
+    astarte_property_buffer_entry_t *entry = find_entry(buffer, interface_name, path, true);
+    if (!entry) {
+        return ASTARTE_ERR_QUEUE_FULL;
+    }
+    return set_pending(buffer, entry, ASTARTE_PROPERTY_BUFFER_DELETE, NULL, 0);
+}
+
+astarte_property_buffer_entry_t *astarte_property_buffer_next_due(
+    astarte_property_buffer_t *buffer, uint32_t now_ms, uint32_t min_interval_ms)
+{
+    if (buffer->pending_count == 0) {
+        return NULL;
+    }
+    for (size_t i = 0; i < buffer->capacity; i++) {
+        astarte_property_buffer_entry_t *entry = &buffer->entries[i];
+        if ((entry->op != ASTARTE_PROPERTY_BUFFER_CLEAN)
+            && (!entry->written || (now_ms - entry->last_write_ms >= min_interval_ms))) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void astarte_property_buffer_mark_written(
+    astarte_property_buffer_t *buffer, astarte_property_buffer_entry_t *entry, uint32_t now_ms)
+{
+    set_pending(buffer, entry, ASTARTE_PROPERTY_BUFFER_CLEAN, NULL, 0);
+    entry->written = true;
+    entry->last_write_ms = now_ms;
+}
+
+const char *astarte_property_buffer_interface_name(const astarte_property_buffer_entry_t *entry)
+{
+    return entry->key;
+}
+
+const char *astarte_property_buffer_path(const astarte_property_buffer_entry_t *entry)
+{
+    return entry->key + entry->interface_name_len + 1;
+}
+
+/************************************************
+ *         Static functions definitions         *
+ ***********************************************/
+
+static uint32_t hash_key(const char *interface_name, size_t interface_name_len, const char *path)
+{
+    // The separator avoids collisions between keys splitting the same string differently
+    uint32_t hash = astarte_hash_fnv1a_32(interface_name, interface_name_len + 1);
+    return astarte_hash_fnv1a_32_update(hash, path, strlen(path));
+}
+
+static astarte_property_buffer_entry_t *find_entry(astarte_property_buffer_t *buffer,
+    const char *interface_name, const char *path, bool create)
+{
+    size_t interface_name_len = strlen(interface_name);
+    uint32_t key_hash = hash_key(interface_name, interface_name_len, path);
+    astarte_property_buffer_entry_t *reusable = NULL;
+    for (size_t i = 0; i < buffer->capacity; i++) {
+        astarte_property_buffer_entry_t *entry = &buffer->entries[i];
+        if (!entry->key) {
+            if (!reusable || reusable->key) {
+                reusable = entry;
+            }
+            continue;
+        }
+        if ((entry->key_hash == key_hash) && (entry->interface_name_len == interface_name_len)
+            && (strcmp(entry->key, interface_name) == 0)
+            && (strcmp(entry->key + interface_name_len + 1, path) == 0)) {
+            return entry;
+        }
+        // Free entries are preferred, then the ones written least recently
+        if ((entry->op == ASTARTE_PROPERTY_BUFFER_CLEAN)
+            && (!reusable
+                || (reusable->key && (entry->last_write_ms < reusable->last_write_ms)))) {
+            reusable = entry;
+        }
+    }
+    if (!create || !reusable) {
+        return NULL;
+    }
+
+    size_t path_len = strlen(path);
+    char *key = malloc(interface_name_len + path_len + 2);
+    if (!key) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return NULL;
+    }
+    memcpy(key, interface_name, interface_name_len + 1);
+    memcpy(key + interface_name_len + 1, path, path_len + 1);
+    free(reusable->key);
+    memset(reusable, 0, sizeof(astarte_property_buffer_entry_t));
+    reusable->key_hash = key_hash;
+    reusable->key = key;
+    reusable->interface_name_len = interface_name_len;
+    return reusable;
+}
+
+static astarte_err_t set_pending(astarte_property_buffer_t *buffer,
+    astarte_property_buffer_entry_t *entry, astarte_property_buffer_op_t op, const void *data,
+    size_t data_len)
+{
+    uint8_t *data_copy = NULL;
+    if (data_len > 0) {
+        data_copy = malloc(data_len);
+        if (!data_copy) {
+            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+            return ASTARTE_ERR_OUT_OF_MEMORY;
+        }
+        memcpy(data_copy, data, data_len);
+    }
+    if ((entry->op == ASTARTE_PROPERTY_BUFFER_CLEAN) && (op != ASTARTE_PROPERTY_BUFFER_CLEAN)) {
+        buffer->pending_count++;
+    } else if ((entry->op != ASTARTE_PROPERTY_BUFFER_CLEAN)
+        && (op == ASTARTE_PROPERTY_BUFFER_CLEAN)) {
+        buffer->pending_count--;
+    }
+    free(entry->data);
+    entry->op = op;
+    entry->data = data_copy;
+    entry->data_len = data_len;
+    return ASTARTE_OK;
+}
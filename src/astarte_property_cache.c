@@ -0,0 +1,200 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+#include "astarte_property_cache.h"
+
+#include <esp_log.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "astarte_hash.h"
+
+/************************************************
+ *        Defines, constants and typedef        *
+ ***********************************************/
+
+#define TAG "ASTARTE_PROPERTY_CACHE"
+
+/************************************************
+ *         Static functions declaration         *
+ ***********************************************/
+
+/**
+ * @brief Compute the hash of the key of a property.
+ *
+ * @param[in] interface_name Interface name of the property.
+ * @param[in] interface_name_len Length of the interface name.
+ * @param[in] path Path of the property.
+ * @param[in] path_len Length of the path.
+ * @return The computed hash.
+ */
+static uint32_t hash_key(
+    const char *interface_name, size_t interface_name_len, const char *path, size_t path_len);
+/**
+ * @brief Find the entry of a property.
+ *
+ * @param[in] cache Cache to search.
+ * @param[in] interface_name Interface name of the property.
+ * @param[in] path Path of the property.
+ * @return The entry if found, NULL otherwise.
+ */
+static astarte_property_cache_entry_t *find_entry(
+    astarte_property_cache_t *cache, const char *interface_name, const char *path);
+/**
+ * @brief Free the memory of an entry and mark it as free.
+ *
+ * @param[in] entry Entry to release.
+ */
+static void release_entry(astarte_property_cache_entry_t *entry);
+
+/************************************************
+ *         Global functions definitions         *
+ ***********************************************/
+
+astarte_err_t astarte_property_cache_init(
+    astarte_property_cache_t *cache, size_t capacity, size_t max_value_size)
+{
+    memset(cache, 0, sizeof(astarte_property_cache_t));
+    if (capacity == 0) {
+        return ASTARTE_OK;
+    }
+    cache->entries = calloc(capacity, sizeof(astarte_property_cache_entry_t));
+    if (!cache->entries) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ASTARTE_ERR_OUT_OF_MEMORY;
+    }
+    cache->capacity = capacity;
+    cache->max_value_size = max_value_size;
+    return ASTARTE_OK;
+}
+
+void astarte_property_cache_destroy(astarte_property_cache_t *cache)
+{
+    astarte_property_cache_clear(cache);
+    free(cache->entries);
+    memset(cache, 0, sizeof(astarte_property_cache_t));
+}
+
+astarte_property_cache_result_t astarte_property_cache_check(astarte_property_cache_t *cache,
+    const char *interface_name, const char *path, int32_t major, const void *data, size_t data_len)
+{
+    astarte_property_cache_entry_t *entry = find_entry(cache, interface_name, path);
+    if (!entry) {
+        return ASTARTE_PROPERTY_CACHE_MISS;
+    }
+    entry->last_used = ++cache->clock;
+    if ((entry->major != major) || (entry->value_len != data_len)) {
+        return ASTARTE_PROPERTY_CACHE_CHANGED;
+    }
+    if (entry->value) {
+        return (memcmp(entry->value, data, data_len) == 0) ? ASTARTE_PROPERTY_CACHE_SAME
+                                                           : ASTARTE_PROPERTY_CACHE_CHANGED;
+    }
+    // Equal hashes of large values could still be a collision
+    return (entry->value_hash == astarte_hash_fnv1a_32(data, data_len))
+        ? ASTARTE_PROPERTY_CACHE_MISS
+        : ASTARTE_PROPERTY_CACHE_CHANGED;
+}
+
+astarte_err_t astarte_property_cache_set(astarte_property_cache_t *cache,
+    const char *interface_name, const char *path, int32_t major, const void *data, size_t data_len)
+{
+    if (cache->capacity == 0) {
+        return ASTARTE_OK;
+    }
+
+    astarte_property_cache_entry_t *entry = find_entry(cache, interface_name, path);
+    if (entry) {
+        release_entry(entry);
+    } else {
+        // Use a free entry or evict the least recently used one
+        entry = &cache->entries[0];
+        for (size_t i = 0; (i < cache->capacity) && entry->key; i++) {
+            if (!cache->entries[i].key || (cache->entries[i].last_used < entry->last_used)) {
+                entry = &cache->entries[i];
+            }
+        }
+        release_entry(entry);
+    }
+
+    size_t interface_name_len = strlen(interface_name);
+    size_t path_len = strlen(path);
+    bool copy_value = (data_len <= cache->max_value_size);
+    char *key = malloc(interface_name_len + path_len + 2 + (copy_value ? data_len : 0));
+    if (!key) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ASTARTE_ERR_OUT_OF_MEMORY;
+    }
+    memcpy(key, interface_name, interface_name_len + 1);
+    memcpy(key + interface_name_len + 1, path, path_len + 1);
+
+    entry->key_hash = hash_key(interface_name, interface_name_len, path, path_len);
+    entry->key = key;
+    entry->interface_name_len = interface_name_len;
+    entry->major = major;
+    entry->value_len = data_len;
+    if (copy_value) {
+        uint8_t *value = (uint8_t *) key + interface_name_len + path_len + 2;
+        memcpy(value, data, data_len);
+        entry->value = value;
+    } else {
+        entry->value_hash = astarte_hash_fnv1a_32(data, data_len);
+    }
+    entry->last_used = ++cache->clock;
+    return ASTARTE_OK;
+}
+
+void astarte_property_cache_remove(
+    astarte_property_cache_t *cache, const char *interface_name, const char *path)
+{
+    astarte_property_cache_entry_t *entry = find_entry(cache, interface_name, path);
+    if (entry) {
+        release_entry(entry);
+    }
+}
+
+void astarte_property_cache_clear(astarte_property_cache_t *cache)
+{
+    for (size_t i = 0; i < cache->capacity; i++) {
+        release_entry(&cache->entries[i]);
+    }
+}
+
+/************************************************
+ *         Static functions definitions         *
+ ***********************************************/
+
+static uint32_t hash_key(
+    const char *interface_name, size_t interface_name_len, const char *path, size_t path_len)
+{
+    // The separator avoids collisions between keys splitting the same string differently
+    uint32_t hash = astarte_hash_fnv1a_32(interface_name, interface_name_len + 1);
+    return astarte_hash_fnv1a_32_update(hash, path, path_len);
+}
+
+static astarte_property_cache_entry_t *find_entry(
+    astarte_property_cache_t *cache, const char *interface_name, const char *path)
+{
+    size_t interface_name_len = strlen(interface_name);
+    size_t path_len = strlen(path);
+    uint32_t key_hash = hash_key(interface_name, interface_name_len, path, path_len);
+    for (size_t i = 0; i < cache->capacity; i++) {
+        astarte_property_cache_entry_t *entry = &cache->entries[i];
+        if (entry->key && (entry->key_hash == key_hash)
+            && (entry->interface_name_len == interface_name_len)
+            && (strcmp(entry->key, interface_name) == 0)
+            && (strcmp(entry->key + interface_name_len + 1, path) == 0)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void release_entry(astarte_property_cache_entry_t *entry)
+{
+    free(entry->key);
+    memset(entry, 0, sizeof(astarte_property_cache_entry_t));
+}
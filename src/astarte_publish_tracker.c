@@ -0,0 +1,197 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+#include "astarte_publish_tracker.h"
+
+#include <esp_log.h>
+#include <stdlib.h>
+#include <string.h>
+
+/************************************************
+ *        Defines, constants and typedef        *
+ ***********************************************/
+
+#define TAG "ASTARTE_PUBLISH_TRACKER"
+
+// Message ids are reused by the MQTT client, early acknowledgments older than this are stale
+#define EARLY_ACK_VALIDITY_MS 1000U
+
+/************************************************
+ *         Static functions declaration         *
+ ***********************************************/
+
+/**
+ * @brief Find an entry by ticket.
+ *
+ * @param[in] tracker Tracker to search.
+ * @param[in] ticket Ticket to look for.
+ * @return The entry if found, NULL otherwise.
+ */
+static astarte_publish_tracker_entry_t *find_by_ticket(
+    astarte_publish_tracker_t *tracker, astarte_device_publish_ticket_t ticket);
+/**
+ * @brief Copy an entry in the output parameter and release it.
+ *
+ * @param[in] tracker Tracker containing the entry.
+ * @param[in] entry Entry to release.
+ * @param[out] removed Copy of the entry, can be NULL.
+ */
+static void remove_entry(astarte_publish_tracker_t *tracker,
+    astarte_publish_tracker_entry_t *entry, astarte_publish_tracker_entry_t *removed);
+
+/************************************************
+ *         Global functions definitions         *
+ ***********************************************/
+
+astarte_err_t astarte_publish_tracker_init(astarte_publish_tracker_t *tracker, size_t capacity)
+{
+    memset(tracker, 0, sizeof(astarte_publish_tracker_t));
+    tracker->entries = calloc(capacity, sizeof(astarte_publish_tracker_entry_t));
+    if (!tracker->entries) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ASTARTE_ERR_OUT_OF_MEMORY;
+    }
+    tracker->capacity = capacity;
+    for (size_t i = 0; i < ASTARTE_PUBLISH_TRACKER_EARLY_ACKS; i++) {
+        tracker->early_acks[i].msg_id = -1;
+    }
+    return ASTARTE_OK;
+}
+
+void astarte_publish_tracker_destroy(astarte_publish_tracker_t *tracker)
+{
+    free(tracker->entries);
+    memset(tracker, 0, sizeof(astarte_publish_tracker_t));
+}
+
+astarte_err_t astarte_publish_tracker_reserve(astarte_publish_tracker_t *tracker,
+    astarte_device_publish_callback_t callback, void *user_data, uint32_t now_ms,
+    astarte_device_publish_ticket_t *ticket)
+{
+    if (tracker->count == tracker->capacity) {
+        return ASTARTE_ERR_OUT_OF_MEMORY;
+    }
+    astarte_publish_tracker_entry_t *entry = find_by_ticket(tracker, 0);
+    // Zero is reserved for free entries
+    if (++tracker->last_ticket == 0) {
+        tracker->last_ticket = 1;
+    }
+    entry->ticket = tracker->last_ticket;
+    entry->msg_id = -1;
+    entry->start_ms = now_ms;
+    entry->callback = callback;
+    entry->user_data = user_data;
+    tracker->count++;
+    *ticket = entry->ticket;
+    return ASTARTE_OK;
+}
+
+bool astarte_publish_tracker_set_msg_id(astarte_publish_tracker_t *tracker,
+    astarte_device_publish_ticket_t ticket, int msg_id, uint32_t now_ms,
+    astarte_publish_tracker_entry_t *completed)
+{
+    astarte_publish_tracker_entry_t *entry = (ticket != 0) ? find_by_ticket(tracker, ticket) : NULL;
+    if (!entry) {
+        return false;
+    }
+    for (size_t i = 0; i < ASTARTE_PUBLISH_TRACKER_EARLY_ACKS; i++) {
+        astarte_publish_tracker_early_ack_t *early_ack = &tracker->early_acks[i];
+        if ((early_ack->msg_id == msg_id)
+            && (now_ms - early_ack->time_ms <= EARLY_ACK_VALIDITY_MS)) {
+            early_ack->msg_id = -1;
+            remove_entry(tracker, entry, completed);
+            return true;
+        }
+    }
+    entry->msg_id = msg_id;
+    return false;
+}
+
+astarte_err_t astarte_publish_tracker_complete(astarte_publish_tracker_t *tracker, int msg_id,
+    bool remember, uint32_t now_ms, astarte_publish_tracker_entry_t *completed)
+{
+    for (size_t i = 0; i < tracker->capacity; i++) {
+        astarte_publish_tracker_entry_t *entry = &tracker->entries[i];
+        if ((entry->ticket != 0) && (entry->msg_id == msg_id)) {
+            remove_entry(tracker, entry, completed);
+            return ASTARTE_OK;
+        }
+    }
+    if (remember) {
+        // The message id could be assigned to an entry right after the publish call returns
+        astarte_publish_tracker_early_ack_t *early_ack
+            = &tracker->early_acks[tracker->early_acks_next];
+        early_ack->msg_id = msg_id;
+        early_ack->time_ms = now_ms;
+        tracker->early_acks_next
+            = (tracker->early_acks_next + 1) % ASTARTE_PUBLISH_TRACKER_EARLY_ACKS;
+    }
+    return ASTARTE_ERR_NOT_FOUND;
+}
+
+astarte_err_t astarte_publish_tracker_cancel(
+    astarte_publish_tracker_t *tracker, astarte_device_publish_ticket_t ticket)
+{
+    astarte_publish_tracker_entry_t *entry = (ticket != 0) ? find_by_ticket(tracker, ticket) : NULL;
+    if (!entry) {
+        return ASTARTE_ERR_NOT_FOUND;
+    }
+    remove_entry(tracker, entry, NULL);
+    return ASTARTE_OK;
+}
+
+bool astarte_publish_tracker_pop_expired(astarte_publish_tracker_t *tracker, uint32_t now_ms,
+    uint32_t timeout_ms, astarte_publish_tracker_entry_t *expired)
+{
+    for (size_t i = 0; i < tracker->capacity; i++) {
+        astarte_publish_tracker_entry_t *entry = &tracker->entries[i];
+        // Entries still being published are completed by the publishing task
+        if ((entry->ticket != 0) && (entry->msg_id >= 0)
+            && (now_ms - entry->start_ms > timeout_ms)) {
+            remove_entry(tracker, entry, expired);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool astarte_publish_tracker_pop_any(
+    astarte_publish_tracker_t *tracker, astarte_publish_tracker_entry_t *removed)
+{
+    for (size_t i = 0; i < tracker->capacity; i++) {
+        astarte_publish_tracker_entry_t *entry = &tracker->entries[i];
+        if (entry->ticket != 0) {
+            remove_entry(tracker, entry, removed);
+            return true;
+        }
+    }
+    return false;
+}
+
+/************************************************
+ *         Static functions definitions         *
+ ***********************************************/
+
+static astarte_publish_tracker_entry_t *find_by_ticket(
+    astarte_publish_tracker_t *tracker, astarte_device_publish_ticket_t ticket)
+{
+    for (size_t i = 0; i < tracker->capacity; i++) {
+        if (tracker->entries[i].ticket == ticket) {
+            return &tracker->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void remove_entry(astarte_publish_tracker_t *tracker,
+    astarte_publish_tracker_entry_t *entry, astarte_publish_tracker_entry_t *removed)
+{
+    if (removed) {
+        *removed = *entry;
+    }
+    memset(entry, 0, sizeof(astarte_publish_tracker_entry_t));
+    tracker->count--;
+}
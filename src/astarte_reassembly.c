@@ -0,0 +1,127 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+#include "astarte_reassembly.h"
+
+#include <esp_log.h>
+#include <stdlib.h>
+#include <string.h>
+
+/************************************************
+ *        Defines, constants and typedef        *
+ ***********************************************/
+
+#define TAG "ASTARTE_REASSEMBLY"
+
+/************************************************
+ *         Static functions declaration         *
+ ***********************************************/
+
+/**
+ * @brief Start the reassembly of a message, growing the buffer if required.
+ *
+ * @param[inout] reassembly Reassembly buffer.
+ * @param[in] topic Topic of the message.
+ * @param[in] topic_len Length of the topic.
+ * @param[in] total_len Total length of the payload of the message.
+ * @return One of the follwing error codes:
+ * - ASTARTE_ERR_INVALID_SIZE if the message is larger than the maximum message size,
+ * - ASTARTE_ERR_OUT_OF_MEMORY if the buffer could not be allocated,
+ * - ASTARTE_OK otherwise.
+ */
+static astarte_err_t start_message(
+    astarte_reassembly_t *reassembly, const char *topic, size_t topic_len, size_t total_len);
+
+/************************************************
+ *         Global functions definitions         *
+ ***********************************************/
+
+void astarte_reassembly_init(astarte_reassembly_t *reassembly, size_t max_message_size)
+{
+    memset(reassembly, 0, sizeof(astarte_reassembly_t));
+    reassembly->max_message_size = max_message_size;
+}
+
+void astarte_reassembly_destroy(astarte_reassembly_t *reassembly)
+{
+    free(reassembly->buffer);
+    astarte_reassembly_init(reassembly, reassembly->max_message_size);
+}
+
+void astarte_reassembly_reset(astarte_reassembly_t *reassembly)
+{
+    reassembly->topic_len = 0;
+    reassembly->data_len = 0;
+    reassembly->received = 0;
+    reassembly->in_progress = false;
+}
+
+astarte_err_t astarte_reassembly_add(astarte_reassembly_t *reassembly, const char *topic,
+    size_t topic_len, const char *data, size_t data_len, size_t offset, size_t total_len,
+    bool *complete)
+{
+    *complete = false;
+    if (offset == 0) {
+        astarte_err_t err = start_message(reassembly, topic, topic_len, total_len);
+        if (err != ASTARTE_OK) {
+            astarte_reassembly_reset(reassembly);
+            return err;
+        }
+    } else if (!reassembly->in_progress || (offset != reassembly->received)
+        || (total_len != reassembly->data_len)) {
+        astarte_reassembly_reset(reassembly);
+        return ASTARTE_ERR_NOT_FOUND;
+    }
+
+    if (data_len > reassembly->data_len - reassembly->received) {
+        astarte_reassembly_reset(reassembly);
+        return ASTARTE_ERR_INVALID_SIZE;
+    }
+    memcpy(astarte_reassembly_data(reassembly) + offset, data, data_len);
+    reassembly->received += data_len;
+    if (reassembly->received == reassembly->data_len) {
+        reassembly->in_progress = false;
+        *complete = true;
+    }
+    return ASTARTE_OK;
+}
+
+char *astarte_reassembly_data(astarte_reassembly_t *reassembly)
+{
+    return reassembly->buffer + reassembly->topic_len;
+}
+
+/************************************************
+ *         Static functions definitions         *
+ ***********************************************/
+
+static astarte_err_t start_message(
+    astarte_reassembly_t *reassembly, const char *topic, size_t topic_len, size_t total_len)
+{
+    if ((topic_len > reassembly->max_message_size)
+        || (total_len > reassembly->max_message_size - topic_len)) {
+        return ASTARTE_ERR_INVALID_SIZE;
+    }
+
+    size_t message_size = topic_len + total_len;
+    if (message_size > reassembly->buffer_size) {
+        // The buffer only grows, the messages received later are likely to have a similar size
+        char *buffer = realloc(reassembly->buffer, message_size);
+        if (!buffer) {
+            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+            return ASTARTE_ERR_OUT_OF_MEMORY;
+        }
+        reassembly->buffer = buffer;
+        reassembly->buffer_size = message_size;
+    }
+
+    memcpy(reassembly->buffer, topic, topic_len);
+    reassembly->topic_len = topic_len;
+    reassembly->data_len = total_len;
+    reassembly->received = 0;
+    reassembly->in_progress = true;
+    return ASTARTE_OK;
+}
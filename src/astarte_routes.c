@@ -0,0 +1,222 @@
+/*
+ * (C) Copyright 2023, SECO Mind Srl
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ */
+
+#include "astarte_routes.h"
+
+#include <esp_log.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/************************************************
+ *        Defines, constants and typedef        *
+ ***********************************************/
+
+#define TAG "ASTARTE_ROUTES"
+
+/************************************************
+ *         Static functions declaration         *
+ ***********************************************/
+
+/**
+ * @brief Free a node and all its descendants.
+ *
+ * @param[in] node Node to free, may be NULL.
+ */
+static void free_node(astarte_route_node_t *node);
+/**
+ * @brief Free the descendants of a node.
+ *
+ * @param[in] node Node whose children are freed.
+ */
+static void free_children(astarte_route_node_t *node);
+/**
+ * @brief Get the child of a node matching a pattern segment, adding it if not present.
+ *
+ * @param[inout] node Parent node.
+ * @param[in] segment Pattern segment, not NULL terminated.
+ * @param[in] segment_len Length of the segment.
+ * @return The child node, NULL if it could not be allocated.
+ */
+static astarte_route_node_t *get_or_add_child(
+    astarte_route_node_t *node, const char *segment, size_t segment_len);
+/**
+ * @brief Check if a pattern segment is a parameter, in the form `%{name}`.
+ *
+ * @param[in] segment Pattern segment, not NULL terminated.
+ * @param[in] segment_len Length of the segment.
+ * @return True if the segment is a parameter.
+ */
+static bool is_parameter(const char *segment, size_t segment_len);
+/**
+ * @brief Match the remaining part of a path, starting from a node.
+ *
+ * @details Literal children are tried before the parameter child, backtracking when the literal
+ * child does not lead to a route.
+ *
+ * @param[in] node Node matching the path consumed so far.
+ * @param[in] path Remaining path, starting with a '/' unless empty.
+ * @param[in] path_len Length of the remaining path.
+ * @return The matched node with a callback, NULL if none.
+ */
+static const astarte_route_node_t *match_node(
+    const astarte_route_node_t *node, const char *path, size_t path_len);
+
+/************************************************
+ *         Global functions definitions         *
+ ***********************************************/
+
+void astarte_routes_destroy(astarte_routes_t *routes)
+{
+    free_children(&routes->root);
+    memset(routes, 0, sizeof(astarte_routes_t));
+}
+
+astarte_err_t astarte_routes_add(astarte_routes_t *routes, const char *pattern,
+    astarte_device_data_view_event_callback_t callback, void *user_data)
+{
+    astarte_route_node_t *node = &routes->root;
+    if (pattern) {
+        size_t pattern_len = strlen(pattern);
+        if ((pattern_len == 0) || (pattern[0] != '/')) {
+            ESP_LOGE(TAG, "Route pattern does not start with a /: %s", pattern);
+            return ASTARTE_ERR_INVALID_INTERFACE_PATH;
+        }
+        const char *pattern_end = pattern + pattern_len;
+        const char *separator = pattern;
+        while (separator) {
+            const char *segment = separator + 1;
+            separator = memchr(segment, '/', pattern_end - segment);
+            size_t segment_len = ((separator) ? separator : pattern_end) - segment;
+            if (segment_len == 0) {
+                ESP_LOGE(TAG, "Route pattern with an empty segment: %s", pattern);
+                return ASTARTE_ERR_INVALID_INTERFACE_PATH;
+            }
+            node = get_or_add_child(node, segment, segment_len);
+            if (!node) {
+                return ASTARTE_ERR_OUT_OF_MEMORY;
+            }
+        }
+    }
+    node->callback = callback;
+    node->user_data = user_data;
+    return ASTARTE_OK;
+}
+
+const astarte_route_node_t *astarte_routes_match(
+    const astarte_routes_t *routes, const char *path, size_t path_len)
+{
+    if ((path_len > 0) && (path[0] == '/')) {
+        const astarte_route_node_t *node = match_node(&routes->root, path, path_len);
+        if (node) {
+            return node;
+        }
+    }
+    return (routes->root.callback) ? &routes->root : NULL;
+}
+
+/************************************************
+ *         Static functions definitions         *
+ ***********************************************/
+
+static void free_node(astarte_route_node_t *node)
+{
+    if (!node) {
+        return;
+    }
+    free_children(node);
+    free(node->segment);
+    free(node);
+}
+
+static void free_children(astarte_route_node_t *node)
+{
+    astarte_route_node_t *child = node->children;
+    while (child) {
+        astarte_route_node_t *sibling = child->sibling;
+        free_node(child);
+        child = sibling;
+    }
+    free_node(node->parameter);
+    node->children = NULL;
+    node->parameter = NULL;
+}
+
+static astarte_route_node_t *get_or_add_child(
+    astarte_route_node_t *node, const char *segment, size_t segment_len)
+{
+    bool parameter = is_parameter(segment, segment_len);
+    if (parameter && node->parameter) {
+        return node->parameter;
+    }
+    if (!parameter) {
+        for (astarte_route_node_t *child = node->children; child; child = child->sibling) {
+            if ((child->segment_len == segment_len)
+                && (memcmp(child->segment, segment, segment_len) == 0)) {
+                return child;
+            }
+        }
+    }
+
+    astarte_route_node_t *child = calloc(1, sizeof(astarte_route_node_t));
+    if (!child) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return NULL;
+    }
+    if (parameter) {
+        node->parameter = child;
+        return child;
+    }
+    child->segment = malloc(segment_len);
+    if (!child->segment) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        free(child);
+        return NULL;
+    }
+    memcpy(child->segment, segment, segment_len);
+    child->segment_len = segment_len;
+    child->sibling = node->children;
+    node->children = child;
+    return child;
+}
+
+static bool is_parameter(const char *segment, size_t segment_len)
+{
+    return (segment_len >= strlen("%{}")) && (segment[0] == '%') && (segment[1] == '{')
+        && (segment[segment_len - 1] == '}');
+}
+
+static const astarte_route_node_t *match_node(
+    const astarte_route_node_t *node, const char *path, size_t path_len)
+{
+    if (path_len == 0) {
+        return (node->callback) ? node : NULL;
+    }
+    // Skip the '/' and isolate the next segment
+    const char *segment = path + 1;
+    const char *separator = memchr(segment, '/', path_len - 1);
+    size_t segment_len = ((separator) ? separator : path + path_len) - segment;
+    const char *rest = segment + segment_len;
+    size_t rest_len = path_len - 1 - segment_len;
+    if (segment_len == 0) {
+        return NULL;
+    }
+
+    for (const astarte_route_node_t *child = node->children; child; child = child->sibling) {
+        if ((child->segment_len == segment_len)
+            && (memcmp(child->segment, segment, segment_len) == 0)) {
+            const astarte_route_node_t *matched = match_node(child, rest, rest_len);
+            if (matched) {
+                return matched;
+            }
+            break;
+        }
+    }
+    if (node->parameter) {
+        return match_node(node->parameter, rest, rest_len);
+    }
+    return NULL;
+}
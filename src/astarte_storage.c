@@ -18,6 +18,41 @@
 #define TAG "ASTARTE_STORAGE"
 
 #define NVS_NAMESPACE "ASTARTE_STORAGE"
+// Initial sizes of the scratch buffers, large enough for most properties
+#define SCRATCH_MIN_KEY_SIZE 128
+#define SCRATCH_MIN_VALUE_SIZE 32
+
+/************************************************
+ *         Static functions declaration         *
+ ***********************************************/
+
+/**
+ * @brief Commit the changes to the NVS.
+ *
+ * @param[in] handle Handle to astarte storage instance.
+ * @return ASTARTE_ERR if the commit failed, ASTARTE_OK otherwise.
+ */
+static astarte_err_t commit(astarte_storage_handle_t handle);
+
+/**
+ * @brief Remove the holes left by the deleted properties, if enough of them are present.
+ *
+ * @note Should not be called while iterating over the stored properties.
+ *
+ * @param[in] handle Handle to astarte storage instance.
+ */
+static void compact(astarte_storage_handle_t handle);
+
+/**
+ * @brief Grow a scratch buffer.
+ *
+ * @param[inout] scratch Scratch buffer to grow.
+ * @param[in] key_size Minimum size of the key buffer.
+ * @param[in] value_size Minimum size of the value buffer.
+ * @return ASTARTE_ERR_OUT_OF_MEMORY if a buffer could not be grown, ASTARTE_OK otherwise.
+ */
+static astarte_err_t grow_scratch(
+    astarte_storage_scratch_t *scratch, size_t key_size, size_t value_size);
 
 /************************************************
  *         Global functions definitions         *
@@ -26,11 +61,21 @@
 // NOLINTNEXTLINE(misc-unused-parameters)
 astarte_err_t astarte_storage_open(astarte_storage_handle_t *handle)
 {
+    handle->context = NULL;
 #ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
+    // The index is built on first use, avoiding to read all the stored keys for a single lookup
+    handle->context = calloc(1, sizeof(astarte_storage_context_t));
+    if (!handle->context) {
+        ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+        return ASTARTE_ERR;
+    }
+    astarte_nvs_key_value_index_init(&handle->context->index);
     esp_err_t esp_err
         = nvs_open_from_partition(CONFIG_ASTARTE_PROPERTY_PERSISTENCY_NVS_PARTITION_LABEL,
             NVS_NAMESPACE, NVS_READWRITE, &handle->nvs_handle);
     if (esp_err != ESP_OK) {
+        free(handle->context);
+        handle->context = NULL;
         return ASTARTE_ERR;
     }
 #endif
@@ -39,9 +84,40 @@ astarte_err_t astarte_storage_open(astarte_storage_handle_t *handle)
 
 void astarte_storage_close(astarte_storage_handle_t handle)
 {
+    if (handle.context) {
+        if (handle.context->in_transaction) {
+            astarte_storage_commit_transaction(handle);
+        } else {
+            compact(handle);
+        }
+        astarte_nvs_key_value_index_destroy(&handle.context->index);
+        free(handle.context);
+    }
     nvs_close(handle.nvs_handle);
 }
 
+astarte_err_t astarte_storage_begin_transaction(astarte_storage_handle_t handle)
+{
+    if (handle.context->in_transaction) {
+        ESP_LOGE(TAG, "A transaction is already in progress.");
+        return ASTARTE_ERR;
+    }
+    handle.context->in_transaction = true;
+    return ASTARTE_OK;
+}
+
+astarte_err_t astarte_storage_commit_transaction(astarte_storage_handle_t handle)
+{
+    if (!handle.context->in_transaction) {
+        ESP_LOGE(TAG, "No transaction is in progress.");
+        return ASTARTE_ERR;
+    }
+    handle.context->in_transaction = false;
+    // No iterator is used past the end of a transaction, the pairs can be moved safely
+    compact(handle);
+    return commit(handle);
+}
+
 astarte_err_t astarte_storage_store_property(astarte_storage_handle_t handle,
     const char *interface_name, const char *path, int32_t major, const void *data, size_t data_len)
 {
@@ -66,7 +142,8 @@ astarte_err_t astarte_storage_store_property(astarte_storage_handle_t handle,
     memcpy(value + sizeof(int32_t), data, data_len);
 
     // Set the property value in NVS
-    esp_err_t esp_err = astarte_nvs_key_value_set(handle.nvs_handle, key, value, value_len);
+    esp_err_t esp_err = astarte_nvs_key_value_set(
+        handle.nvs_handle, &handle.context->index, key, value, value_len);
     if (esp_err != ESP_OK) {
         free(key);
         free(value);
@@ -75,13 +152,7 @@ astarte_err_t astarte_storage_store_property(astarte_storage_handle_t handle,
     free(key);
     free(value);
 
-    // Commit the changes
-    esp_err = nvs_commit(handle.nvs_handle);
-    if (esp_err != ESP_OK) {
-        return ASTARTE_ERR;
-    }
-
-    return ASTARTE_OK;
+    return (handle.context->in_transaction) ? ASTARTE_OK : commit(handle);
 }
 
 astarte_err_t astarte_storage_contains_property(astarte_storage_handle_t handle,
@@ -102,7 +173,8 @@ astarte_err_t astarte_storage_contains_property(astarte_storage_handle_t handle,
 
     // Get length of data
     size_t value_len = 0;
-    esp_err_t esp_err = astarte_nvs_key_value_get(handle.nvs_handle, key, NULL, &value_len);
+    esp_err_t esp_err = astarte_nvs_key_value_get(
+        handle.nvs_handle, &handle.context->index, key, NULL, &value_len);
     if ((esp_err != ESP_ERR_NVS_NOT_FOUND) && (esp_err != ESP_OK)) {
         free(key);
         return ASTARTE_ERR;
@@ -121,7 +193,7 @@ astarte_err_t astarte_storage_contains_property(astarte_storage_handle_t handle,
     }
 
     // Get stored data
-    astarte_nvs_key_value_get(handle.nvs_handle, key, value, &value_len);
+    astarte_nvs_key_value_get(handle.nvs_handle, &handle.context->index, key, value, &value_len);
     free(key);
     if (esp_err != ESP_OK) {
         free(value);
@@ -162,7 +234,8 @@ astarte_err_t astarte_storage_load_property(astarte_storage_handle_t handle,
 
     // Get length of data
     size_t value_len = 0;
-    esp_err_t esp_err = astarte_nvs_key_value_get(handle.nvs_handle, key, NULL, &value_len);
+    esp_err_t esp_err = astarte_nvs_key_value_get(
+        handle.nvs_handle, &handle.context->index, key, NULL, &value_len);
     if (esp_err == ESP_ERR_NVS_NOT_FOUND) {
         free(key);
         return ASTARTE_ERR_NOT_FOUND;
@@ -189,7 +262,7 @@ astarte_err_t astarte_storage_load_property(astarte_storage_handle_t handle,
     }
 
     // Get the data from NVS
-    astarte_nvs_key_value_get(handle.nvs_handle, key, value, &value_len);
+    astarte_nvs_key_value_get(handle.nvs_handle, &handle.context->index, key, value, &value_len);
     free(key);
     if (esp_err != ESP_OK) {
         free(value);
@@ -229,7 +302,8 @@ astarte_err_t astarte_storage_delete_property(
     strncat(strncpy(key, interface_name, key_len), path, key_len - strlen(interface_name) - 1);
 
     // Erase the property value using the full key
-    esp_err_t esp_err = astarte_nvs_key_value_erase_key(handle.nvs_handle, key);
+    esp_err_t esp_err
+        = astarte_nvs_key_value_erase_key(handle.nvs_handle, &handle.context->index, key);
     free(key);
     if (esp_err == ESP_ERR_NVS_NOT_FOUND) {
         return ASTARTE_ERR_NOT_FOUND;
@@ -238,18 +312,13 @@ astarte_err_t astarte_storage_delete_property(
         return ASTARTE_ERR;
     }
 
-    // Commit the changes to NVS
-    esp_err = nvs_commit(handle.nvs_handle);
-    if (esp_err != ESP_OK) {
-        return ASTARTE_ERR;
-    }
-
-    return ASTARTE_OK;
+    return (handle.context->in_transaction) ? ASTARTE_OK : commit(handle);
 }
 
 astarte_err_t astarte_storage_clear(astarte_storage_handle_t handle)
 {
     esp_err_t esp_err = nvs_erase_all(handle.nvs_handle);
+    astarte_nvs_key_value_index_destroy(&handle.context->index);
     if (esp_err != ESP_OK) {
         return ASTARTE_ERR;
     }
@@ -412,3 +481,111 @@ end:
 
     return astarte_storage_err;
 }
+
+void astarte_storage_scratch_init(astarte_storage_scratch_t *scratch)
+{
+    memset(scratch, 0, sizeof(astarte_storage_scratch_t));
+}
+
+void astarte_storage_scratch_destroy(astarte_storage_scratch_t *scratch)
+{
+    free(scratch->key);
+    free(scratch->value);
+    memset(scratch, 0, sizeof(astarte_storage_scratch_t));
+}
+
+astarte_err_t astarte_storage_iterator_read_property(astarte_storage_iterator_t *iterator,
+    astarte_storage_scratch_t *scratch, astarte_storage_property_t *property)
+{
+    astarte_err_t err = grow_scratch(scratch, SCRATCH_MIN_KEY_SIZE, SCRATCH_MIN_VALUE_SIZE);
+    if (err != ASTARTE_OK) {
+        return err;
+    }
+
+    // The key is read one char after the start of the buffer, leaving room to terminate the
+    // interface name in place
+    size_t key_len = scratch->key_size - 1;
+    size_t value_len = scratch->value_size;
+    esp_err_t esp_err = astarte_nvs_key_value_iterator_read_element(
+        &iterator->nvs_key_value_iterator, scratch->key + 1, &key_len, scratch->value, &value_len);
+    if (esp_err == ESP_ERR_NVS_INVALID_LENGTH) {
+        err = grow_scratch(scratch, key_len + 1, value_len);
+        if (err != ASTARTE_OK) {
+            return err;
+        }
+        key_len = scratch->key_size - 1;
+        value_len = scratch->value_size;
+        esp_err = astarte_nvs_key_value_iterator_read_element(&iterator->nvs_key_value_iterator,
+            scratch->key + 1, &key_len, scratch->value, &value_len);
+    }
+    if (esp_err != ESP_OK) {
+        return ASTARTE_ERR;
+    }
+
+    // Split interface name and path, the path keeps its leading '/'
+    char *path = strchr(scratch->key + 1, '/');
+    if (!path || (value_len < sizeof(int32_t))) {
+        ESP_LOGE(TAG, "Malformed property in storage.");
+        return ASTARTE_ERR;
+    }
+    size_t interface_name_len = path - (scratch->key + 1);
+    memmove(scratch->key, scratch->key + 1, interface_name_len);
+    scratch->key[interface_name_len] = '\0';
+
+    property->interface_name = scratch->key;
+    property->path = path;
+    memcpy(&property->major, scratch->value, sizeof(int32_t));
+    property->data = scratch->value + sizeof(int32_t);
+    property->data_len = value_len - sizeof(int32_t);
+    return ASTARTE_OK;
+}
+
+/************************************************
+ *         Static functions definitions         *
+ ***********************************************/
+
+static astarte_err_t commit(astarte_storage_handle_t handle)
+{
+    esp_err_t esp_err = nvs_commit(handle.nvs_handle);
+    if (esp_err != ESP_OK) {
+        return ASTARTE_ERR;
+    }
+    return ASTARTE_OK;
+}
+
+static void compact(astarte_storage_handle_t handle)
+{
+#ifdef CONFIG_ASTARTE_USE_PROPERTY_PERSISTENCY
+    if (handle.context->index.holes_count < CONFIG_ASTARTE_PROPERTY_PERSISTENCY_COMPACT_THRESHOLD) {
+        return;
+    }
+    esp_err_t esp_err = astarte_nvs_key_value_compact(handle.nvs_handle, &handle.context->index);
+    if ((esp_err != ESP_OK) || (commit(handle) != ASTARTE_OK)) {
+        ESP_LOGW(TAG, "Failed compacting the stored properties.");
+    }
+#endif
+}
+
+static astarte_err_t grow_scratch(
+    astarte_storage_scratch_t *scratch, size_t key_size, size_t value_size)
+{
+    if (key_size > scratch->key_size) {
+        char *key = realloc(scratch->key, key_size);
+        if (!key) {
+            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+            return ASTARTE_ERR_OUT_OF_MEMORY;
+        }
+        scratch->key = key;
+        scratch->key_size = key_size;
+    }
+    if (value_size > scratch->value_size) {
+        uint8_t *value = realloc(scratch->value, value_size);
+        if (!value) {
+            ESP_LOGE(TAG, "Out of memory %s: %d", __FILE__, __LINE__);
+            return ASTARTE_ERR_OUT_OF_MEMORY;
+        }
+        scratch->value = value;
+        scratch->value_size = value_size;
+    }
+    return ASTARTE_OK;
+}
@@ -5,52 +5,297 @@
  */
 #include "astarte_zlib.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CONFIG_ASTARTE_ZLIB_ALLOC_SPIRAM
+#include <esp_heap_caps.h>
+#endif
+
+/************************************************
+ *        Defines, constants and typedef        *
+ ***********************************************/
+
+#define COMPRESSOR_MIN_BUFFER_SIZE 64
+
+/************************************************
+ *         Static functions declaration         *
+ ***********************************************/
+
+/**
+ * @brief Double the size of the output buffer of a compressor, or allocate it for the first time.
+ *
+ * @param compressor Compressor owning the buffer.
+ * @return Z_OK on success, Z_MEM_ERROR if the buffer could not be grown.
+ */
+static int grow_buffer(astarte_zlib_compressor_t *compressor);
+/**
+ * @brief Allocation function passed to zlib, reusing the free blocks of the context pool.
+ *
+ * @param opaque Context owning the pool.
+ * @param items Number of items to allocate.
+ * @param size Size of each item.
+ * @return The allocated memory, Z_NULL if out of memory.
+ */
+static voidpf pool_alloc(voidpf opaque, uInt items, uInt size);
+/**
+ * @brief Free function passed to zlib, the blocks of the context pool are kept for reuse.
+ *
+ * @param opaque Context owning the pool.
+ * @param address Memory to free.
+ */
+static void pool_free(voidpf opaque, voidpf address);
+/**
+ * @brief Allocate memory for zlib, in external RAM when configured.
+ *
+ * @param size Size of the memory to allocate.
+ * @return The allocated memory, NULL if out of memory.
+ */
+static void *alloc_block(size_t size);
+/**
+ * @brief Prepare a stream of a context to be used, without initializing it.
+ *
+ * @param context Context owning the stream.
+ * @param stream Stream to prepare.
+ */
+static void setup_stream(astarte_zlib_context_t *context, z_stream *stream);
+
 /************************************************
  *         Global functions definitions         *
  ***********************************************/
 
-// NOLINTBEGIN: This function is pretty much identical to the one contained in zlib.
-int ZEXPORT astarte_zlib_compress(
-    Bytef *dest, uLongf *destLen, const Bytef *source, uLong sourceLen)
+void astarte_zlib_context_init(astarte_zlib_context_t *context, int windowBits, int memLevel)
 {
-    z_stream stream;
-    int err;
-    const uInt max = (uInt) -1;
-    uLong left;
+    memset(context, 0, sizeof(astarte_zlib_context_t));
+    context->windowBits = windowBits;
+    context->memLevel = memLevel;
+}
 
-    left = *destLen;
-    *destLen = 0;
+void astarte_zlib_context_release(astarte_zlib_context_t *context)
+{
+    if (context->deflate_ready) {
+        deflateEnd(&context->deflate_stream);
+        context->deflate_ready = false;
+    }
+    if (context->inflate_ready) {
+        inflateEnd(&context->inflate_stream);
+        context->inflate_ready = false;
+    }
+    for (size_t i = 0; i < ASTARTE_ZLIB_POOL_SIZE; i++) {
+        free(context->pool[i].ptr);
+        memset(&context->pool[i], 0, sizeof(astarte_zlib_block_t));
+    }
+}
 
-    stream.zalloc = (alloc_func) 0;
-    stream.zfree = (free_func) 0;
-    stream.opaque = (voidpf) 0;
+int astarte_zlib_compressor_init(
+    astarte_zlib_compressor_t *compressor, astarte_zlib_context_t *context, size_t reserved)
+{
+    memset(compressor, 0, sizeof(astarte_zlib_compressor_t));
+    compressor->reserved = reserved;
 
-    int windowBits = 9; // Smallest possible window
-    int memLevel = 1; // Smallest possible memory usage
-    err = deflateInit2(
-        &stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, memLevel, Z_DEFAULT_STRATEGY);
-    if (err != Z_OK)
+    // The stream is initialized once, then only reset
+    int err = Z_OK;
+    if (context->deflate_ready) {
+        err = deflateReset(&context->deflate_stream);
+    } else {
+        setup_stream(context, &context->deflate_stream);
+        err = deflateInit2(&context->deflate_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+            context->windowBits, context->memLevel, Z_DEFAULT_STRATEGY);
+        context->deflate_ready = (err == Z_OK);
+    }
+    if (err != Z_OK) {
         return err;
+    }
+    compressor->stream = &context->deflate_stream;
+    return grow_buffer(compressor);
+}
 
-    stream.next_out = dest;
-    stream.avail_out = 0;
-    stream.next_in = (z_const Bytef *) source;
-    stream.avail_in = 0;
+int astarte_zlib_compressor_append(
+    astarte_zlib_compressor_t *compressor, const void *data, size_t len)
+{
+    z_stream *stream = compressor->stream;
+    stream->next_in = (z_const Bytef *) data;
+    stream->avail_in = (uInt) len;
+    while (stream->avail_in > 0) {
+        if ((stream->avail_out == 0) && (grow_buffer(compressor) != Z_OK)) {
+            return Z_MEM_ERROR;
+        }
+        int err = deflate(stream, Z_NO_FLUSH);
+        if (err != Z_OK) {
+            return err;
+        }
+    }
+    return Z_OK;
+}
 
+int astarte_zlib_compressor_finish(astarte_zlib_compressor_t *compressor, size_t *out_len)
+{
+    z_stream *stream = compressor->stream;
+    int err = Z_OK;
     do {
-        if (stream.avail_out == 0) {
-            stream.avail_out = left > (uLong) max ? max : (uInt) left;
-            left -= stream.avail_out;
+        if ((stream->avail_out == 0) && (grow_buffer(compressor) != Z_OK)) {
+            return Z_MEM_ERROR;
         }
-        if (stream.avail_in == 0) {
-            stream.avail_in = sourceLen > (uLong) max ? max : (uInt) sourceLen;
-            sourceLen -= stream.avail_in;
+        err = deflate(stream, Z_FINISH);
+    } while ((err == Z_OK) || ((err == Z_BUF_ERROR) && (stream->avail_out == 0)));
+    if (err != Z_STREAM_END) {
+        return err;
+    }
+    *out_len = compressor->reserved + stream->total_out;
+    return Z_OK;
+}
+
+void astarte_zlib_compressor_destroy(astarte_zlib_compressor_t *compressor)
+{
+    free(compressor->buffer);
+    memset(compressor, 0, sizeof(astarte_zlib_compressor_t));
+}
+
+int astarte_zlib_uncompress_split(astarte_zlib_context_t *context, const Bytef *source,
+    uLong sourceLen, char delimiter, char *buffer, size_t buffer_size,
+    astarte_zlib_entry_cbk_t cbk, void *user_data, uLongf *destLen)
+{
+    *destLen = 0;
+
+    // A window bits of zero uses the window size of the stream header. Resetting the stream frees
+    // its window, the pool keeps the memory for the next stream with the same window size.
+    z_stream *stream = &context->inflate_stream;
+    int err = Z_OK;
+    if (context->inflate_ready) {
+        err = inflateReset2(stream, 0);
+    } else {
+        setup_stream(context, stream);
+        err = inflateInit2(stream, 0);
+        context->inflate_ready = (err == Z_OK);
+    }
+    if (err != Z_OK) {
+        return err;
+    }
+    stream->next_in = (z_const Bytef *) source;
+    stream->avail_in = (uInt) sourceLen;
+
+    // Length of the partial entry kept at the start of the buffer
+    size_t pending_len = 0;
+    do {
+        // The partial entry fills the whole buffer, it is too long
+        if (pending_len == buffer_size) {
+            err = Z_BUF_ERROR;
+            break;
+        }
+        stream->next_out = (Bytef *) buffer + pending_len;
+        stream->avail_out = (uInt) (buffer_size - pending_len);
+        err = inflate(stream, Z_NO_FLUSH);
+        if ((err != Z_OK) && (err != Z_STREAM_END)) {
+            break;
         }
-        err = deflate(&stream, sourceLen ? Z_NO_FLUSH : Z_FINISH);
+
+        size_t decoded_len = buffer_size - stream->avail_out;
+        size_t entry_start = 0;
+        for (size_t i = pending_len; i < decoded_len; i++) {
+            if (buffer[i] == delimiter) {
+                if (i > entry_start) {
+                    cbk(buffer + entry_start, i - entry_start, user_data);
+                }
+                entry_start = i + 1;
+            }
+        }
+        // The last entry is not followed by a delimiter
+        if ((err == Z_STREAM_END) && (decoded_len > entry_start)) {
+            cbk(buffer + entry_start, decoded_len - entry_start, user_data);
+            entry_start = decoded_len;
+        }
+        pending_len = decoded_len - entry_start;
+        memmove(buffer, buffer + entry_start, pending_len);
     } while (err == Z_OK);
 
-    *destLen = stream.total_out;
-    deflateEnd(&stream);
-    return err == Z_STREAM_END ? Z_OK : err;
+    *destLen = stream->total_out;
+    return (err == Z_STREAM_END) ? Z_OK : err;
+}
+
+/************************************************
+ *         Static functions definitions         *
+ ***********************************************/
+
+static int grow_buffer(astarte_zlib_compressor_t *compressor)
+{
+    size_t buffer_size = (compressor->buffer)
+        ? compressor->buffer_size * 2
+        : compressor->reserved + COMPRESSOR_MIN_BUFFER_SIZE;
+    Bytef *buffer = realloc(compressor->buffer, buffer_size);
+    if (!buffer) {
+        return Z_MEM_ERROR;
+    }
+    size_t used = compressor->reserved + compressor->stream->total_out;
+    compressor->buffer = buffer;
+    compressor->buffer_size = buffer_size;
+    compressor->stream->next_out = buffer + used;
+    compressor->stream->avail_out = (uInt) (buffer_size - used);
+    return Z_OK;
+}
+
+static voidpf pool_alloc(voidpf opaque, uInt items, uInt size)
+{
+    astarte_zlib_context_t *context = (astarte_zlib_context_t *) opaque;
+    size_t block_size = (size_t) items * size;
+
+    astarte_zlib_block_t *empty = NULL;
+    astarte_zlib_block_t *unused = NULL;
+    for (size_t i = 0; i < ASTARTE_ZLIB_POOL_SIZE; i++) {
+        astarte_zlib_block_t *block = &context->pool[i];
+        if (!block->ptr) {
+            empty = (empty) ? empty : block;
+        } else if (!block->used) {
+            if (block->size == block_size) {
+                block->used = true;
+                return block->ptr;
+            }
+            unused = (unused) ? unused : block;
+        }
+    }
+
+    // Make room in the pool for the new block, evicting an unused block of a different size
+    if (!empty && unused) {
+        free(unused->ptr);
+        memset(unused, 0, sizeof(astarte_zlib_block_t));
+        empty = unused;
+    }
+    void *ptr = alloc_block(block_size);
+    if (ptr && empty) {
+        empty->ptr = ptr;
+        empty->size = block_size;
+        empty->used = true;
+    }
+    return ptr;
+}
+
+static void pool_free(voidpf opaque, voidpf address)
+{
+    astarte_zlib_context_t *context = (astarte_zlib_context_t *) opaque;
+    for (size_t i = 0; i < ASTARTE_ZLIB_POOL_SIZE; i++) {
+        if (context->pool[i].ptr == address) {
+            context->pool[i].used = false;
+            return;
+        }
+    }
+    // Blocks not fitting in the pool are freed immediately
+    free(address);
+}
+
+static void *alloc_block(size_t size)
+{
+#ifdef CONFIG_ASTARTE_ZLIB_ALLOC_SPIRAM
+    void *ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (ptr) {
+        return ptr;
+    }
+#endif
+    return malloc(size);
+}
+
+static void setup_stream(astarte_zlib_context_t *context, z_stream *stream)
+{
+    memset(stream, 0, sizeof(z_stream));
+    stream->zalloc = pool_alloc;
+    stream->zfree = pool_free;
+    stream->opaque = context;
 }
-// NOLINTEND
@@ -288,3 +288,79 @@ void test_astarte_bson_deserializer_bson_document_lookup(void)
     TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
         astarte_bson_deserializer_element_lookup(doc, "element string foo", &element_foo));
 }
+
+struct complete_document
+{
+    double element_double;
+    char element_string[16];
+    uint8_t element_binary[18];
+    bool element_bool_false;
+    bool element_bool_true;
+    int64_t element_datetime;
+    int32_t element_int32;
+    int64_t element_int64;
+    int32_t element_array[2];
+    int32_t element_missing;
+};
+
+void test_astarte_bson_deserializer_decode_struct(void)
+{
+    // Fields in a different order than the document elements
+    const astarte_bson_struct_field_t fields[] = {
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct complete_document, element_int32, "element int32", BSON_TYPE_INT32),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct complete_document, element_int64, "element int64", BSON_TYPE_INT64),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct complete_document, element_double, "element double", BSON_TYPE_DOUBLE),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct complete_document, element_string, "element string", BSON_TYPE_STRING),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct complete_document, element_binary, "element binary", BSON_TYPE_BINARY),
+        ASTARTE_BSON_STRUCT_FIELD(struct complete_document, element_bool_false,
+            "element bool false", BSON_TYPE_BOOLEAN),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct complete_document, element_bool_true, "element bool true", BSON_TYPE_BOOLEAN),
+        ASTARTE_BSON_STRUCT_FIELD(struct complete_document, element_datetime,
+            "element UTC datetime", BSON_TYPE_DATETIME),
+        // The array contains an int32 and a double
+        ASTARTE_BSON_STRUCT_ARRAY_FIELD(
+            struct complete_document, element_array, "element array", BSON_TYPE_INT32),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct complete_document, element_missing, "element missing", BSON_TYPE_INT32),
+    };
+    const size_t fields_count = sizeof(fields) / sizeof(fields[0]);
+
+    astarte_bson_document_t doc = astarte_bson_deserializer_init_doc(complete_bson_document);
+    struct complete_document decoded = { 0 };
+    uint32_t invalid_fields = 0U;
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_bson_deserializer_decode_struct(
+            doc, fields, fields_count, &decoded, &invalid_fields));
+
+    TEST_ASSERT_EQUAL_HEX32((1U << 8) | (1U << 9), invalid_fields);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 42.3, decoded.element_double);
+    TEST_ASSERT_EQUAL_STRING("hello world", decoded.element_string);
+    TEST_ASSERT_EQUAL_MEMORY("bin encoded string", decoded.element_binary, 18);
+    TEST_ASSERT_FALSE(decoded.element_bool_false);
+    TEST_ASSERT_TRUE(decoded.element_bool_true);
+    TEST_ASSERT_EQUAL_INT64(1686304399422, decoded.element_datetime);
+    TEST_ASSERT_EQUAL_INT32(10, decoded.element_int32);
+    TEST_ASSERT_EQUAL_INT64(17179869184, decoded.element_int64);
+
+    // Without the invalid fields the whole struct is decoded
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_bson_deserializer_decode_struct(doc, fields, fields_count - 2, &decoded, NULL));
+
+    // A string not fitting in the struct member is invalid
+    const astarte_bson_struct_field_t short_string[] = {
+        { .name = "element string",
+            .name_len = sizeof("element string") - 1,
+            .type = BSON_TYPE_STRING,
+            .offset = offsetof(struct complete_document, element_string),
+            .size = sizeof("hello world") - 1 },
+    };
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_bson_deserializer_decode_struct(doc, short_string, 1, &decoded, &invalid_fields));
+    TEST_ASSERT_EQUAL_HEX32(1U, invalid_fields);
+}
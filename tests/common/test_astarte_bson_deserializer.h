@@ -30,6 +30,7 @@ void test_astarte_bson_deserializer_check_validity(void);
 void test_astarte_bson_deserializer_empty_bson_document(void);
 void test_astarte_bson_deserializer_complete_bson_document(void);
 void test_astarte_bson_deserializer_bson_document_lookup(void);
+void test_astarte_bson_deserializer_decode_struct(void);
 
 #ifdef __cplusplus
 }
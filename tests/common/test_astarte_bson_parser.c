@@ -0,0 +1,203 @@
+/**
+ * This file is part of Astarte.
+ *
+ * Copyright 2023 SECO Mind Srl
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ *
+ **/
+
+#include "test_astarte_bson_parser.h"
+#include "astarte_bson_parser.h"
+#include "astarte_bson_serializer.h"
+#include "astarte_bson_types.h"
+#include "unity.h"
+
+#include <string.h>
+
+#define BLOB_SIZE 300
+
+typedef struct
+{
+    int elements;
+    int end_documents;
+    int max_depth;
+    int32_t int32_value;
+    bool bool_value;
+    char string[16];
+    size_t string_len;
+    uint8_t blob[BLOB_SIZE];
+    size_t blob_len;
+    int stop_after;
+} parsed_t;
+
+static astarte_err_t sink(const astarte_bson_parser_event_t *event, void *user_data)
+{
+    parsed_t *parsed = (parsed_t *) user_data;
+    if ((int) event->depth > parsed->max_depth) {
+        parsed->max_depth = (int) event->depth;
+    }
+    switch (event->type) {
+        case ASTARTE_BSON_PARSER_EVENT_ELEMENT:
+            parsed->elements++;
+            if (event->element.type == BSON_TYPE_INT32) {
+                TEST_ASSERT_EQUAL_STRING("i", event->element.name);
+                parsed->int32_value = astarte_bson_deserializer_element_to_int32(event->element);
+            } else if (event->element.type == BSON_TYPE_BOOLEAN) {
+                parsed->bool_value = astarte_bson_deserializer_element_to_bool(event->element);
+            } else if (event->element.type == BSON_TYPE_BINARY) {
+                TEST_ASSERT_EQUAL(BLOB_SIZE, event->value_len);
+            }
+            break;
+        case ASTARTE_BSON_PARSER_EVENT_CHUNK:
+            if (event->element.type == BSON_TYPE_STRING) {
+                TEST_ASSERT_TRUE(event->chunk_offset + event->chunk_len < sizeof(parsed->string));
+                memcpy(parsed->string + event->chunk_offset, event->chunk, event->chunk_len);
+                parsed->string_len += event->chunk_len;
+            } else {
+                TEST_ASSERT_EQUAL_STRING("v", event->element.name);
+                TEST_ASSERT_EQUAL(parsed->blob_len, event->chunk_offset);
+                memcpy(parsed->blob + event->chunk_offset, event->chunk, event->chunk_len);
+                parsed->blob_len += event->chunk_len;
+            }
+            break;
+        case ASTARTE_BSON_PARSER_EVENT_END_DOCUMENT:
+            parsed->end_documents++;
+            break;
+    }
+    if ((parsed->stop_after > 0) && (parsed->elements == parsed->stop_after)) {
+        return ASTARTE_ERR_NOT_FOUND;
+    }
+    return ASTARTE_OK;
+}
+
+static const uint8_t *build_document(astarte_bson_serializer_handle_t bson, int *size)
+{
+    uint8_t blob[BLOB_SIZE];
+    for (size_t i = 0; i < BLOB_SIZE; i++) {
+        blob[i] = (uint8_t) i;
+    }
+    astarte_bson_serializer_handle_t nested = astarte_bson_serializer_new();
+    astarte_bson_serializer_append_int32(nested, "i", 42);
+    astarte_bson_serializer_append_end_of_document(nested);
+
+    astarte_bson_serializer_append_string(bson, "s", "hello");
+    astarte_bson_serializer_append_document(
+        bson, "d", astarte_bson_serializer_get_document(nested, NULL));
+    astarte_bson_serializer_append_binary(bson, "v", blob, BLOB_SIZE);
+    astarte_bson_serializer_append_boolean(bson, "b", true);
+    astarte_bson_serializer_append_end_of_document(bson);
+    astarte_bson_serializer_destroy(nested);
+    return astarte_bson_serializer_get_document(bson, size);
+}
+
+void test_astarte_bson_parser_fragments(void)
+{
+    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
+    int size = 0;
+    const uint8_t *document = build_document(bson, &size);
+
+    const size_t fragment_sizes[] = { 1, 3, 7, 64, (size_t) size };
+    for (size_t i = 0; i < sizeof(fragment_sizes) / sizeof(fragment_sizes[0]); i++) {
+        parsed_t parsed = { 0 };
+        astarte_bson_parser_t parser;
+        astarte_bson_parser_init(&parser, sink, &parsed);
+        for (size_t offset = 0; offset < size; offset += fragment_sizes[i]) {
+            TEST_ASSERT_FALSE(astarte_bson_parser_is_complete(&parser));
+            size_t fragment_len = size - offset;
+            if (fragment_len > fragment_sizes[i]) {
+                fragment_len = fragment_sizes[i];
+            }
+            TEST_ASSERT_EQUAL(
+                ASTARTE_OK, astarte_bson_parser_feed(&parser, document + offset, fragment_len));
+        }
+        TEST_ASSERT_TRUE(astarte_bson_parser_is_complete(&parser));
+        TEST_ASSERT_EQUAL(5, parsed.elements);
+        TEST_ASSERT_EQUAL(2, parsed.end_documents);
+        TEST_ASSERT_EQUAL(1, parsed.max_depth);
+        TEST_ASSERT_EQUAL(42, parsed.int32_value);
+        TEST_ASSERT_TRUE(parsed.bool_value);
+        TEST_ASSERT_EQUAL(strlen("hello"), parsed.string_len);
+        TEST_ASSERT_EQUAL_MEMORY("hello", parsed.string, parsed.string_len);
+        TEST_ASSERT_EQUAL(BLOB_SIZE, parsed.blob_len);
+        for (size_t j = 0; j < BLOB_SIZE; j++) {
+            TEST_ASSERT_EQUAL((uint8_t) j, parsed.blob[j]);
+        }
+
+        // Nothing can follow the document
+        TEST_ASSERT_EQUAL(ASTARTE_ERR_INVALID_SIZE, astarte_bson_parser_feed(&parser, document, 1));
+    }
+
+    astarte_bson_serializer_destroy(bson);
+}
+
+void test_astarte_bson_parser_malformed(void)
+{
+    parsed_t parsed = { 0 };
+    astarte_bson_parser_t parser;
+
+    // Unsupported type
+    const uint8_t unsupported[] = { 0x08, 0x00, 0x00, 0x00, 0x0a, 'n', 0x00, 0x00 };
+    astarte_bson_parser_init(&parser, sink, &parsed);
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_bson_parser_feed(&parser, unsupported, 4));
+    TEST_ASSERT_EQUAL(ASTARTE_ERR,
+        astarte_bson_parser_feed(&parser, unsupported + 4, sizeof(unsupported) - 4));
+    // The error is kept for the following fragments
+    TEST_ASSERT_EQUAL(ASTARTE_ERR, astarte_bson_parser_feed(&parser, unsupported, 1));
+
+    // String longer than the document
+    const uint8_t long_string[]
+        = { 0x0e, 0x00, 0x00, 0x00, 0x02, 's', 0x00, 0x10, 0x00, 0x00, 0x00, 'a', 0x00, 0x00 };
+    astarte_bson_parser_init(&parser, sink, &parsed);
+    TEST_ASSERT_EQUAL(
+        ASTARTE_ERR, astarte_bson_parser_feed(&parser, long_string, sizeof(long_string)));
+
+    // Document terminated before its end
+    const uint8_t early_end[] = { 0x06, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    astarte_bson_parser_init(&parser, sink, &parsed);
+    TEST_ASSERT_EQUAL(ASTARTE_ERR, astarte_bson_parser_feed(&parser, early_end, sizeof(early_end)));
+
+    // Nested document larger than the enclosing one
+    const uint8_t large_nested[] = { 0x0d, 0x00, 0x00, 0x00, 0x03, 'd', 0x00, 0x20, 0x00, 0x00,
+        0x00, 0x00, 0x00 };
+    astarte_bson_parser_init(&parser, sink, &parsed);
+    TEST_ASSERT_EQUAL(
+        ASTARTE_ERR, astarte_bson_parser_feed(&parser, large_nested, sizeof(large_nested)));
+
+    // Element name longer than the parser buffer
+    uint8_t long_name[ASTARTE_BSON_PARSER_MAX_NAME_LEN + 16] = { 0 };
+    long_name[0] = sizeof(long_name);
+    long_name[4] = BSON_TYPE_BOOLEAN;
+    memset(long_name + 5, 'n', ASTARTE_BSON_PARSER_MAX_NAME_LEN + 1);
+    astarte_bson_parser_init(&parser, sink, &parsed);
+    TEST_ASSERT_EQUAL(
+        ASTARTE_ERR_INVALID_SIZE, astarte_bson_parser_feed(&parser, long_name, sizeof(long_name)));
+}
+
+void test_astarte_bson_parser_sink_error(void)
+{
+    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
+    int size = 0;
+    const uint8_t *document = build_document(bson, &size);
+
+    parsed_t parsed = { .stop_after = 2 };
+    astarte_bson_parser_t parser;
+    astarte_bson_parser_init(&parser, sink, &parsed);
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND, astarte_bson_parser_feed(&parser, document, size));
+    TEST_ASSERT_EQUAL(2, parsed.elements);
+    TEST_ASSERT_FALSE(astarte_bson_parser_is_complete(&parser));
+
+    astarte_bson_serializer_destroy(bson);
+}
@@ -28,6 +28,9 @@
 
 #include <esp_log.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #define TAG "BSON SERIALZIER TEST"
 
 void test_astarte_bson_serializer_empty_document(void)
@@ -45,10 +48,8 @@ void test_astarte_bson_serializer_empty_document(void)
     astarte_bson_serializer_destroy(bson);
 }
 
-void test_astarte_bson_serializer_complete_document(void)
+static void append_complete_document_elements(astarte_bson_serializer_handle_t bson)
 {
-    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
-
     astarte_bson_serializer_append_double(bson, "element double", (double) 42.3);
     astarte_bson_serializer_append_string(bson, "element string", "hello world");
     const uint8_t bin[] = { 0x62, 0x69, 0x6e, 0x20, 0x65, 0x6e, 0x63, 0x6f, 0x64, 0x65, 0x64, 0x20,
@@ -79,15 +80,341 @@ void test_astarte_bson_serializer_complete_document(void)
     astarte_bson_serializer_append_int32_array(bson, "element int32 array", arr_int32, 4);
     const int64_t arr_int64[] = { -4294970141, 5149762780, 4294967307, 4294967950 };
     astarte_bson_serializer_append_int64_array(bson, "element int64 array", arr_int64, 4);
+}
+
+void test_astarte_bson_serializer_complete_document(void)
+{
+    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
+
+    append_complete_document_elements(bson);
+    astarte_bson_serializer_append_end_of_document(bson);
+
+    int ser_bson_len = 0;
+    const void *ser_bson = astarte_bson_serializer_get_document(bson, &ser_bson_len);
 
+    TEST_ASSERT_EQUAL(sizeof(serialized_bson_complete_document), ser_bson_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(serialized_bson_complete_document, (const uint8_t *) ser_bson,
+        sizeof(serialized_bson_complete_document));
+
+    astarte_bson_serializer_destroy(bson);
+}
+
+void test_astarte_bson_serializer_with_buffer(void)
+{
+    // Large enough buffer, the document should be built in place
+    uint8_t buf[sizeof(serialized_bson_complete_document)];
+    astarte_bson_serializer_storage_t storage;
+    astarte_bson_serializer_handle_t bson
+        = astarte_bson_serializer_init_with_buffer(&storage, buf, sizeof(buf));
+    append_complete_document_elements(bson);
     astarte_bson_serializer_append_end_of_document(bson);
 
     int ser_bson_len = 0;
     const void *ser_bson = astarte_bson_serializer_get_document(bson, &ser_bson_len);
 
+    TEST_ASSERT_EQUAL_PTR(buf, ser_bson);
+    TEST_ASSERT_EQUAL(sizeof(serialized_bson_complete_document), ser_bson_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(serialized_bson_complete_document, (const uint8_t *) ser_bson,
+        sizeof(serialized_bson_complete_document));
+
+    astarte_bson_serializer_deinit(bson);
+
+    // Small buffer, the document should be moved to the heap once it does not fit anymore
+    uint8_t small_buf[16];
+    bson = astarte_bson_serializer_init_with_buffer(&storage, small_buf, sizeof(small_buf));
+    append_complete_document_elements(bson);
+    astarte_bson_serializer_append_end_of_document(bson);
+
+    ser_bson = astarte_bson_serializer_get_document(bson, &ser_bson_len);
+
+    TEST_ASSERT_TRUE(ser_bson != (const void *) small_buf);
     TEST_ASSERT_EQUAL(sizeof(serialized_bson_complete_document), ser_bson_len);
     TEST_ASSERT_EQUAL_HEX8_ARRAY(serialized_bson_complete_document, (const uint8_t *) ser_bson,
         sizeof(serialized_bson_complete_document));
 
+    astarte_bson_serializer_deinit(bson);
+}
+
+void test_astarte_bson_serializer_reset(void)
+{
+    uint8_t buf[sizeof(serialized_bson_complete_document)];
+    astarte_bson_serializer_storage_t storage;
+    astarte_bson_serializer_handle_t bson
+        = astarte_bson_serializer_init_with_buffer(&storage, buf, sizeof(buf));
+    append_complete_document_elements(bson);
+    astarte_bson_serializer_append_end_of_document(bson);
+
+    astarte_bson_serializer_reset(bson);
+    astarte_bson_serializer_append_end_of_document(bson);
+
+    int ser_bson_len = 0;
+    const void *ser_bson = astarte_bson_serializer_get_document(bson, &ser_bson_len);
+
+    TEST_ASSERT_EQUAL_PTR(buf, ser_bson);
+    TEST_ASSERT_EQUAL(sizeof(serialized_bson_empty_document), ser_bson_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(serialized_bson_empty_document, (const uint8_t *) ser_bson,
+        sizeof(serialized_bson_empty_document));
+
+    astarte_bson_serializer_deinit(bson);
+}
+
+void test_astarte_bson_serializer_large_array(void)
+{
+    // Enough elements to use keys of one to four digits
+    const int count = 1005;
+    double *arr_d = calloc(count, sizeof(double));
+    TEST_ASSERT_NOT_NULL(arr_d);
+    for (int i = 0; i < count; i++) {
+        arr_d[i] = (double) i / 3.0;
+    }
+    const char *arr_s[] = { "a", "bb", "", "ccc", "d", "e", "f", "g", "h", "i", "j", "klm" };
+    const int count_s = sizeof(arr_s) / sizeof(arr_s[0]);
+
+    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
+    astarte_bson_serializer_append_double_array(bson, "double array", arr_d, count);
+    astarte_bson_serializer_append_string_array(bson, "string array", arr_s, count_s);
+    astarte_bson_serializer_append_end_of_document(bson);
+
+    // Build the same document appending each element of the arrays separately
+    astarte_bson_serializer_handle_t expected = astarte_bson_serializer_new();
+    astarte_bson_serializer_handle_t array = astarte_bson_serializer_new();
+    for (int i = 0; i < count; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "%i", i);
+        astarte_bson_serializer_append_double(array, key, arr_d[i]);
+    }
+    astarte_bson_serializer_append_end_of_document(array);
+    astarte_bson_serializer_append_document(
+        expected, "double array", astarte_bson_serializer_get_document(array, NULL));
+    size_t double_array_size = astarte_bson_serializer_document_size(array);
+    astarte_bson_serializer_reset(array);
+    for (int i = 0; i < count_s; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "%i", i);
+        astarte_bson_serializer_append_string(array, key, arr_s[i]);
+    }
+    astarte_bson_serializer_append_end_of_document(array);
+    astarte_bson_serializer_append_document(
+        expected, "string array", astarte_bson_serializer_get_document(array, NULL));
+    astarte_bson_serializer_append_end_of_document(expected);
+
+    int ser_bson_len = 0;
+    const uint8_t *ser_bson = astarte_bson_serializer_get_document(bson, &ser_bson_len);
+    int expected_len = 0;
+    uint8_t *expected_bson
+        = (uint8_t *) astarte_bson_serializer_get_document(expected, &expected_len);
+    // The two documents differ only in the type of the arrays
+    size_t double_array_pos = sizeof(int32_t);
+    size_t string_array_pos
+        = double_array_pos + sizeof(uint8_t) + sizeof("double array") + double_array_size;
+    expected_bson[double_array_pos] = BSON_TYPE_ARRAY;
+    expected_bson[string_array_pos] = BSON_TYPE_ARRAY;
+
+    TEST_ASSERT_EQUAL(expected_len, ser_bson_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_bson, ser_bson, expected_len);
+
+    astarte_bson_serializer_destroy(array);
+    astarte_bson_serializer_destroy(expected);
+    astarte_bson_serializer_destroy(bson);
+    free(arr_d);
+}
+
+void test_astarte_bson_serializer_nested(void)
+{
+    // Small buffer, the document is moved to the heap while the nested documents are open
+    uint8_t buf[16];
+    astarte_bson_serializer_storage_t storage;
+    astarte_bson_serializer_handle_t bson
+        = astarte_bson_serializer_init_with_buffer(&storage, buf, sizeof(buf));
+    astarte_bson_serializer_nested_t document
+        = astarte_bson_serializer_begin_document(bson, "document");
+    append_complete_document_elements(bson);
+    astarte_bson_serializer_nested_t array = astarte_bson_serializer_begin_array(bson, "array");
+    astarte_bson_serializer_append_int32(bson, "0", 10);
+    astarte_bson_serializer_append_int32(bson, "1", 20);
+    astarte_bson_serializer_end_array(bson, array);
+    astarte_bson_serializer_end_document(bson, document);
+    astarte_bson_serializer_append_end_of_document(bson);
+
+    // Build the same document from separate serializers
+    astarte_bson_serializer_handle_t inner = astarte_bson_serializer_new();
+    append_complete_document_elements(inner);
+    const int32_t arr_int32[] = { 10, 20 };
+    astarte_bson_serializer_append_int32_array(inner, "array", arr_int32, 2);
+    astarte_bson_serializer_append_end_of_document(inner);
+    astarte_bson_serializer_handle_t expected = astarte_bson_serializer_new();
+    astarte_bson_serializer_append_document(
+        expected, "document", astarte_bson_serializer_get_document(inner, NULL));
+    astarte_bson_serializer_append_end_of_document(expected);
+
+    int ser_bson_len = 0;
+    const void *ser_bson = astarte_bson_serializer_get_document(bson, &ser_bson_len);
+    int expected_len = 0;
+    const void *expected_bson = astarte_bson_serializer_get_document(expected, &expected_len);
+
+    TEST_ASSERT_EQUAL(expected_len, ser_bson_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(
+        (const uint8_t *) expected_bson, (const uint8_t *) ser_bson, expected_len);
+
+    astarte_bson_serializer_destroy(expected);
+    astarte_bson_serializer_destroy(inner);
+    astarte_bson_serializer_deinit(bson);
+}
+
+void test_astarte_bson_serializer_fixed(void)
+{
+    // Exact size buffer, the document should be built in place
+    uint8_t buf[sizeof(serialized_bson_complete_document)];
+    astarte_bson_serializer_storage_t storage;
+    astarte_bson_serializer_handle_t bson
+        = astarte_bson_serializer_init_fixed(&storage, buf, sizeof(buf));
+    append_complete_document_elements(bson);
+    astarte_bson_serializer_append_end_of_document(bson);
+
+    int ser_bson_len = 0;
+    const void *ser_bson = astarte_bson_serializer_get_document(bson, &ser_bson_len);
+
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_bson_serializer_get_error(bson));
+    TEST_ASSERT_EQUAL_PTR(buf, ser_bson);
+    TEST_ASSERT_EQUAL(sizeof(serialized_bson_complete_document), ser_bson_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(serialized_bson_complete_document, (const uint8_t *) ser_bson,
+        sizeof(serialized_bson_complete_document));
+
+    astarte_bson_serializer_deinit(bson);
+
+    // Small buffer, the overflow should be recorded and the document size still computed
+    uint8_t small_buf[sizeof(serialized_bson_complete_document) - 1];
+    bson = astarte_bson_serializer_init_fixed(&storage, small_buf, sizeof(small_buf));
+    append_complete_document_elements(bson);
+    astarte_bson_serializer_append_end_of_document(bson);
+
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_OUT_OF_MEMORY, astarte_bson_serializer_get_error(bson));
+    TEST_ASSERT_NULL(astarte_bson_serializer_get_document(bson, NULL));
+    TEST_ASSERT_EQUAL(
+        sizeof(serialized_bson_complete_document), astarte_bson_serializer_document_size(bson));
+
+    // Resetting the serializer clears the error
+    astarte_bson_serializer_reset(bson);
+    astarte_bson_serializer_append_end_of_document(bson);
+
+    ser_bson = astarte_bson_serializer_get_document(bson, &ser_bson_len);
+
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_bson_serializer_get_error(bson));
+    TEST_ASSERT_EQUAL(sizeof(serialized_bson_empty_document), ser_bson_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(serialized_bson_empty_document, (const uint8_t *) ser_bson,
+        sizeof(serialized_bson_empty_document));
+
+    astarte_bson_serializer_deinit(bson);
+}
+
+void test_astarte_bson_serializer_size_calculator(void)
+{
+    astarte_bson_serializer_storage_t storage;
+    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_init_size_calculator(&storage);
+    astarte_bson_serializer_nested_t document
+        = astarte_bson_serializer_begin_document(bson, "document");
+    append_complete_document_elements(bson);
+    astarte_bson_serializer_end_document(bson, document);
+    astarte_bson_serializer_append_end_of_document(bson);
+
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_bson_serializer_get_error(bson));
+    TEST_ASSERT_NULL(astarte_bson_serializer_get_document(bson, NULL));
+    // Document header, element type, "document" name and terminator
+    TEST_ASSERT_EQUAL(sizeof(serialized_bson_complete_document) + sizeof(int32_t) + sizeof(uint8_t)
+            + sizeof("document") + sizeof(uint8_t),
+        astarte_bson_serializer_document_size(bson));
+
+    astarte_bson_serializer_deinit(bson);
+}
+
+struct struct_document
+{
+    double element_double;
+    char element_string[16];
+    uint8_t element_binary[4];
+    bool element_bool;
+    int64_t element_datetime;
+    int32_t element_int32;
+    int64_t element_int64;
+    int32_t element_array[12];
+};
+
+void test_astarte_bson_serializer_struct(void)
+{
+    const astarte_bson_struct_field_t fields[] = {
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct struct_document, element_double, "element double", BSON_TYPE_DOUBLE),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct struct_document, element_string, "element string", BSON_TYPE_STRING),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct struct_document, element_binary, "element binary", BSON_TYPE_BINARY),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct struct_document, element_bool, "element bool", BSON_TYPE_BOOLEAN),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct struct_document, element_datetime, "element datetime", BSON_TYPE_DATETIME),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct struct_document, element_int32, "element int32", BSON_TYPE_INT32),
+        ASTARTE_BSON_STRUCT_FIELD(
+            struct struct_document, element_int64, "element int64", BSON_TYPE_INT64),
+        ASTARTE_BSON_STRUCT_ARRAY_FIELD(
+            struct struct_document, element_array, "element array", BSON_TYPE_INT32),
+    };
+    const size_t fields_count = sizeof(fields) / sizeof(fields[0]);
+    struct struct_document value = {
+        .element_double = 42.3,
+        .element_string = "hello world",
+        .element_binary = { 0xde, 0xad, 0xbe, 0xef },
+        .element_bool = true,
+        .element_datetime = 1686304399422,
+        .element_int32 = 10,
+        .element_int64 = 17179869184,
+        .element_array = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 },
+    };
+
+    astarte_bson_serializer_handle_t bson = astarte_bson_serializer_new();
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_bson_serializer_append_struct(bson, fields, fields_count, &value));
+    astarte_bson_serializer_append_end_of_document(bson);
+
+    // Build the same document appending each field separately
+    astarte_bson_serializer_handle_t expected = astarte_bson_serializer_new();
+    astarte_bson_serializer_append_double(expected, "element double", value.element_double);
+    astarte_bson_serializer_append_string(expected, "element string", value.element_string);
+    astarte_bson_serializer_append_binary(
+        expected, "element binary", value.element_binary, sizeof(value.element_binary));
+    astarte_bson_serializer_append_boolean(expected, "element bool", value.element_bool);
+    astarte_bson_serializer_append_datetime(expected, "element datetime", value.element_datetime);
+    astarte_bson_serializer_append_int32(expected, "element int32", value.element_int32);
+    astarte_bson_serializer_append_int64(expected, "element int64", value.element_int64);
+    astarte_bson_serializer_append_int32_array(expected, "element array", value.element_array, 12);
+    astarte_bson_serializer_append_end_of_document(expected);
+
+    int ser_bson_len = 0;
+    const void *ser_bson = astarte_bson_serializer_get_document(bson, &ser_bson_len);
+    int expected_len = 0;
+    const void *expected_bson = astarte_bson_serializer_get_document(expected, &expected_len);
+
+    TEST_ASSERT_EQUAL(expected_len, ser_bson_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(
+        (const uint8_t *) expected_bson, (const uint8_t *) ser_bson, expected_len);
+
+    // The size calculator computes the same size without writing the document
+    astarte_bson_serializer_storage_t storage;
+    astarte_bson_serializer_handle_t size_bson
+        = astarte_bson_serializer_init_size_calculator(&storage);
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_bson_serializer_append_struct(size_bson, fields, fields_count, &value));
+    astarte_bson_serializer_append_end_of_document(size_bson);
+    TEST_ASSERT_EQUAL(expected_len, astarte_bson_serializer_document_size(size_bson));
+    astarte_bson_serializer_deinit(size_bson);
+
+    // A string member that is not null terminated is rejected
+    memset(value.element_string, 'a', sizeof(value.element_string));
+    astarte_bson_serializer_reset(bson);
+    TEST_ASSERT_EQUAL(
+        ASTARTE_ERR, astarte_bson_serializer_append_struct(bson, fields, fields_count, &value));
+    TEST_ASSERT_EQUAL(sizeof(int32_t), astarte_bson_serializer_document_size(bson));
+
+    astarte_bson_serializer_destroy(expected);
     astarte_bson_serializer_destroy(bson);
 }
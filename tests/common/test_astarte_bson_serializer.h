@@ -28,6 +28,13 @@ extern "C" {
 
 void test_astarte_bson_serializer_empty_document(void);
 void test_astarte_bson_serializer_complete_document(void);
+void test_astarte_bson_serializer_with_buffer(void);
+void test_astarte_bson_serializer_reset(void);
+void test_astarte_bson_serializer_large_array(void);
+void test_astarte_bson_serializer_nested(void);
+void test_astarte_bson_serializer_fixed(void);
+void test_astarte_bson_serializer_size_calculator(void);
+void test_astarte_bson_serializer_struct(void);
 
 #ifdef __cplusplus
 }
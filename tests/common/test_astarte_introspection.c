@@ -0,0 +1,126 @@
+/**
+ * This file is part of Astarte.
+ *
+ * Copyright 2023 SECO Mind Srl
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ *
+ **/
+
+#include "unity.h"
+
+#include "astarte_introspection.h"
+#include "test_astarte_introspection.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <esp_log.h>
+
+#define TAG "INTROSPECTION TEST"
+
+#define TEST_INTERFACES_COUNT 20
+
+void test_astarte_introspection_add_get(void)
+{
+    astarte_introspection_t introspection;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_introspection_init(&introspection));
+
+    // Add enough interfaces to force the hash table to grow a couple of times
+    char names[TEST_INTERFACES_COUNT][32];
+    astarte_interface_t interfaces[TEST_INTERFACES_COUNT];
+    struct astarte_device_interface *entries[TEST_INTERFACES_COUNT];
+    for (int i = 0; i < TEST_INTERFACES_COUNT; i++) {
+        snprintf(names[i], sizeof(names[i]), "org.astarte.Interface%d", i);
+        interfaces[i] = (astarte_interface_t){
+            .name = names[i],
+            .major_version = 1,
+            .minor_version = 0,
+            .ownership = OWNERSHIP_DEVICE,
+            .type = TYPE_DATASTREAM,
+        };
+        TEST_ASSERT_EQUAL(
+            ASTARTE_OK, astarte_introspection_add(&introspection, &interfaces[i], &entries[i]));
+    }
+    TEST_ASSERT_EQUAL(TEST_INTERFACES_COUNT, introspection.entries_count);
+
+    for (int i = 0; i < TEST_INTERFACES_COUNT; i++) {
+        struct astarte_device_interface *entry
+            = astarte_introspection_get(&introspection, names[i], strlen(names[i]));
+        TEST_ASSERT_EQUAL_PTR(entries[i], entry);
+        TEST_ASSERT_EQUAL_PTR(&interfaces[i], entry->interface);
+    }
+
+    // Names are compared exactly, prefixes or longer names should not match
+    TEST_ASSERT_NULL(astarte_introspection_get(&introspection, "org.astarte.Interface", 21));
+    TEST_ASSERT_NULL(astarte_introspection_get(&introspection, "org.astarte.Interface100", 24));
+    // Names do not need to be NULL terminated
+    TEST_ASSERT_EQUAL_PTR(
+        entries[1], astarte_introspection_get(&introspection, "org.astarte.Interface10", 22));
+
+    // Insertion order is preserved
+    struct astarte_device_interface *entry = introspection.head;
+    for (int i = 0; i < TEST_INTERFACES_COUNT; i++) {
+        TEST_ASSERT_EQUAL_PTR(entries[i], entry);
+        entry = entry->next;
+    }
+    TEST_ASSERT_NULL(entry);
+
+    astarte_introspection_destroy(&introspection);
+}
+
+void test_astarte_introspection_topic_prefix(void)
+{
+    astarte_introspection_t introspection;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_introspection_init(&introspection));
+
+    const astarte_interface_t interface = {
+        .name = "org.astarte.Test",
+        .major_version = 0,
+        .minor_version = 1,
+        .ownership = OWNERSHIP_SERVER,
+        .type = TYPE_PROPERTIES,
+    };
+    struct astarte_device_interface *entry = NULL;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_introspection_add(&introspection, &interface, &entry));
+    // No device topic yet
+    TEST_ASSERT_NULL(entry->topic_prefix);
+
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_introspection_set_device_topic(&introspection, "realm/device"));
+    TEST_ASSERT_EQUAL_STRING("realm/device/org.astarte.Test", entry->topic_prefix);
+    TEST_ASSERT_EQUAL(strlen("realm/device/org.astarte.Test"), entry->topic_prefix_len);
+
+    // Entries added after the device topic has been set get their prefix immediately
+    const astarte_interface_t other_interface = {
+        .name = "org.astarte.Other",
+        .major_version = 1,
+        .minor_version = 0,
+        .ownership = OWNERSHIP_DEVICE,
+        .type = TYPE_DATASTREAM,
+    };
+    struct astarte_device_interface *other_entry = NULL;
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_introspection_add(&introspection, &other_interface, &other_entry));
+    TEST_ASSERT_EQUAL_STRING("realm/device/org.astarte.Other", other_entry->topic_prefix);
+
+    // A new device topic updates all the prefixes
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_introspection_set_device_topic(&introspection, "realm/other_device"));
+    TEST_ASSERT_EQUAL_STRING("realm/other_device/org.astarte.Test", entry->topic_prefix);
+    TEST_ASSERT_EQUAL_STRING("realm/other_device/org.astarte.Other", other_entry->topic_prefix);
+
+    astarte_introspection_destroy(&introspection);
+}
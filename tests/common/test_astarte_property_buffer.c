@@ -0,0 +1,139 @@
+/**
+ * This file is part of Astarte.
+ *
+ * Copyright 2023 SECO Mind Srl
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ *
+ **/
+
+#include "test_astarte_property_buffer.h"
+#include "astarte_property_buffer.h"
+#include "unity.h"
+
+#define INTERFACE_NAME "org.astarteplatform.test.Properties"
+#define MIN_INTERVAL_MS 1000
+
+void test_astarte_property_buffer_coalesce(void)
+{
+    astarte_property_buffer_t buffer;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_property_buffer_init(&buffer, 4));
+
+    const uint8_t value_1[] = { 0x01, 0x02, 0x03 };
+    const uint8_t value_2[] = { 0x04, 0x05 };
+    TEST_ASSERT_NULL(astarte_property_buffer_get_pending(&buffer, INTERFACE_NAME, "/a"));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_property_buffer_store(&buffer, INTERFACE_NAME, "/a", 1, value_1, sizeof(value_1)));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_property_buffer_store(&buffer, INTERFACE_NAME, "/a", 2, value_2, sizeof(value_2)));
+    // Only the last change of a property is kept
+    TEST_ASSERT_EQUAL(1, buffer.pending_count);
+    const astarte_property_buffer_entry_t *pending
+        = astarte_property_buffer_get_pending(&buffer, INTERFACE_NAME, "/a");
+    TEST_ASSERT_NOT_NULL(pending);
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_BUFFER_STORE, pending->op);
+    TEST_ASSERT_EQUAL(2, pending->major);
+    TEST_ASSERT_EQUAL(sizeof(value_2), pending->data_len);
+    TEST_ASSERT_EQUAL_MEMORY(value_2, pending->data, sizeof(value_2));
+    TEST_ASSERT_EQUAL_STRING(INTERFACE_NAME, astarte_property_buffer_interface_name(pending));
+    TEST_ASSERT_EQUAL_STRING("/a", astarte_property_buffer_path(pending));
+
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_property_buffer_delete(&buffer, INTERFACE_NAME, "/a"));
+    TEST_ASSERT_EQUAL(1, buffer.pending_count);
+    pending = astarte_property_buffer_get_pending(&buffer, INTERFACE_NAME, "/a");
+    TEST_ASSERT_NOT_NULL(pending);
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_BUFFER_DELETE, pending->op);
+    // Keys splitting the same string differently are distinct
+    TEST_ASSERT_NULL(astarte_property_buffer_get_pending(&buffer, INTERFACE_NAME "/a", ""));
+
+    astarte_property_buffer_entry_t *entry = astarte_property_buffer_next_due(&buffer, 0, 0);
+    TEST_ASSERT_EQUAL_PTR(pending, entry);
+    astarte_property_buffer_mark_written(&buffer, entry, 0);
+    TEST_ASSERT_EQUAL(0, buffer.pending_count);
+    TEST_ASSERT_NULL(astarte_property_buffer_get_pending(&buffer, INTERFACE_NAME, "/a"));
+    TEST_ASSERT_NULL(astarte_property_buffer_next_due(&buffer, 0, 0));
+
+    astarte_property_buffer_destroy(&buffer);
+}
+
+void test_astarte_property_buffer_min_interval(void)
+{
+    astarte_property_buffer_t buffer;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_property_buffer_init(&buffer, 4));
+
+    const uint8_t value = 0x01;
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_property_buffer_store(&buffer, INTERFACE_NAME, "/a", 1, &value, 1));
+    // The first write of a property is never delayed
+    astarte_property_buffer_entry_t *entry
+        = astarte_property_buffer_next_due(&buffer, 500, MIN_INTERVAL_MS);
+    TEST_ASSERT_NOT_NULL(entry);
+    astarte_property_buffer_mark_written(&buffer, entry, 500);
+
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_property_buffer_store(&buffer, INTERFACE_NAME, "/a", 1, &value, 1));
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_property_buffer_store(&buffer, INTERFACE_NAME, "/b", 1, &value, 1));
+    entry = astarte_property_buffer_next_due(&buffer, 1000, MIN_INTERVAL_MS);
+    TEST_ASSERT_NOT_NULL(entry);
+    TEST_ASSERT_EQUAL_STRING("/b", astarte_property_buffer_path(entry));
+    astarte_property_buffer_mark_written(&buffer, entry, 1000);
+    TEST_ASSERT_NULL(astarte_property_buffer_next_due(&buffer, 1000, MIN_INTERVAL_MS));
+    TEST_ASSERT_EQUAL(1, buffer.pending_count);
+
+    // The pending change is written once the interval is elapsed, or when forced
+    TEST_ASSERT_NOT_NULL(astarte_property_buffer_next_due(&buffer, 1000, 0));
+    entry = astarte_property_buffer_next_due(&buffer, 500 + MIN_INTERVAL_MS, MIN_INTERVAL_MS);
+    TEST_ASSERT_NOT_NULL(entry);
+    TEST_ASSERT_EQUAL_STRING("/a", astarte_property_buffer_path(entry));
+
+    astarte_property_buffer_destroy(&buffer);
+}
+
+void test_astarte_property_buffer_full(void)
+{
+    astarte_property_buffer_t buffer;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_property_buffer_init(&buffer, 2));
+
+    const uint8_t value = 0x01;
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_property_buffer_store(&buffer, INTERFACE_NAME, "/a", 1, &value, 1));
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_property_buffer_store(&buffer, INTERFACE_NAME, "/b", 1, &value, 1));
+    // Pending changes are never dropped
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_QUEUE_FULL,
+        astarte_property_buffer_store(&buffer, INTERFACE_NAME, "/c", 1, &value, 1));
+    TEST_ASSERT_EQUAL(
+        ASTARTE_ERR_QUEUE_FULL, astarte_property_buffer_delete(&buffer, INTERFACE_NAME, "/c"));
+    // Changes of buffered properties are still accepted
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_property_buffer_delete(&buffer, INTERFACE_NAME, "/b"));
+
+    // Written entries are reused, starting from the least recently written one
+    astarte_property_buffer_entry_t *entry = astarte_property_buffer_next_due(&buffer, 0, 0);
+    TEST_ASSERT_EQUAL_STRING("/a", astarte_property_buffer_path(entry));
+    astarte_property_buffer_mark_written(&buffer, entry, 10);
+    entry = astarte_property_buffer_next_due(&buffer, 0, 0);
+    TEST_ASSERT_EQUAL_STRING("/b", astarte_property_buffer_path(entry));
+    astarte_property_buffer_mark_written(&buffer, entry, 20);
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_property_buffer_store(&buffer, INTERFACE_NAME, "/c", 1, &value, 1));
+    TEST_ASSERT_NOT_NULL(astarte_property_buffer_get_pending(&buffer, INTERFACE_NAME, "/c"));
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_property_buffer_store(&buffer, INTERFACE_NAME, "/a", 1, &value, 1));
+    TEST_ASSERT_NULL(astarte_property_buffer_get_pending(&buffer, INTERFACE_NAME, "/b"));
+    TEST_ASSERT_EQUAL(2, buffer.pending_count);
+
+    astarte_property_buffer_destroy(&buffer);
+}
@@ -0,0 +1,118 @@
+/**
+ * This file is part of Astarte.
+ *
+ * Copyright 2023 SECO Mind Srl
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ *
+ **/
+
+#include "test_astarte_property_cache.h"
+#include "astarte_property_cache.h"
+#include "unity.h"
+
+#define INTERFACE_NAME "org.astarteplatform.test.Properties"
+#define MAX_VALUE_SIZE 8
+
+void test_astarte_property_cache_check_set(void)
+{
+    astarte_property_cache_t cache;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_property_cache_init(&cache, 4, MAX_VALUE_SIZE));
+
+    const uint8_t value_1[] = { 0x01, 0x02, 0x03 };
+    const uint8_t value_2[] = { 0x01, 0x02, 0x04 };
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_MISS,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, value_1, sizeof(value_1)));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_property_cache_set(&cache, INTERFACE_NAME, "/a", 1, value_1, sizeof(value_1)));
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_SAME,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, value_1, sizeof(value_1)));
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_CHANGED,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, value_2, sizeof(value_2)));
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_CHANGED,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, value_1, 2));
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_CHANGED,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 2, value_1, sizeof(value_1)));
+    // Keys splitting the same string differently are distinct
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_MISS,
+        astarte_property_cache_check(&cache, INTERFACE_NAME "/a", "", 1, value_1, sizeof(value_1)));
+
+    // Updating a property replaces its value
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_property_cache_set(&cache, INTERFACE_NAME, "/a", 1, value_2, sizeof(value_2)));
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_SAME,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, value_2, sizeof(value_2)));
+
+    astarte_property_cache_remove(&cache, INTERFACE_NAME, "/a");
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_MISS,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, value_2, sizeof(value_2)));
+
+    astarte_property_cache_destroy(&cache);
+}
+
+void test_astarte_property_cache_large_value(void)
+{
+    astarte_property_cache_t cache;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_property_cache_init(&cache, 4, MAX_VALUE_SIZE));
+
+    uint8_t value[MAX_VALUE_SIZE + 1] = { 0 };
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_property_cache_set(&cache, INTERFACE_NAME, "/a", 1, value, sizeof(value)));
+    // Only the hash of large values is kept, equal values have to be checked in storage
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_MISS,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, value, sizeof(value)));
+    value[MAX_VALUE_SIZE] = 0x01;
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_CHANGED,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, value, sizeof(value)));
+
+    astarte_property_cache_destroy(&cache);
+}
+
+void test_astarte_property_cache_eviction(void)
+{
+    astarte_property_cache_t cache;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_property_cache_init(&cache, 2, MAX_VALUE_SIZE));
+
+    const uint8_t value = 0x01;
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_property_cache_set(&cache, INTERFACE_NAME, "/a", 1, &value, 1));
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_property_cache_set(&cache, INTERFACE_NAME, "/b", 1, &value, 1));
+    // Use the first property, the second one becomes the least recently used
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_SAME,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, &value, 1));
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_property_cache_set(&cache, INTERFACE_NAME, "/c", 1, &value, 1));
+
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_SAME,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, &value, 1));
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_MISS,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/b", 1, &value, 1));
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_SAME,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/c", 1, &value, 1));
+
+    astarte_property_cache_clear(&cache);
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_MISS,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, &value, 1));
+
+    // A disabled cache never contains any property
+    astarte_property_cache_destroy(&cache);
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_property_cache_init(&cache, 0, MAX_VALUE_SIZE));
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_property_cache_set(&cache, INTERFACE_NAME, "/a", 1, &value, 1));
+    TEST_ASSERT_EQUAL(ASTARTE_PROPERTY_CACHE_MISS,
+        astarte_property_cache_check(&cache, INTERFACE_NAME, "/a", 1, &value, 1));
+    astarte_property_cache_destroy(&cache);
+}
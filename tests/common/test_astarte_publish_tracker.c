@@ -0,0 +1,150 @@
+/**
+ * This file is part of Astarte.
+ *
+ * Copyright 2023 SECO Mind Srl
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ *
+ **/
+
+#include "test_astarte_publish_tracker.h"
+#include "astarte_publish_tracker.h"
+#include "unity.h"
+
+#define CAPACITY 2
+
+static void callback_1(astarte_device_publish_event_t *event)
+{
+    (void) event;
+}
+
+static void callback_2(astarte_device_publish_event_t *event)
+{
+    (void) event;
+}
+
+void test_astarte_publish_tracker_reserve_complete(void)
+{
+    astarte_publish_tracker_t tracker;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_publish_tracker_init(&tracker, CAPACITY));
+
+    int user_data_1 = 1;
+    int user_data_2 = 2;
+    astarte_device_publish_ticket_t ticket_1 = 0;
+    astarte_device_publish_ticket_t ticket_2 = 0;
+    astarte_device_publish_ticket_t ticket_3 = 0;
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_publish_tracker_reserve(&tracker, callback_1, &user_data_1, 0, &ticket_1));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_publish_tracker_reserve(&tracker, callback_2, &user_data_2, 0, &ticket_2));
+    TEST_ASSERT_TRUE(ticket_1 != 0);
+    TEST_ASSERT_TRUE(ticket_2 != 0);
+    TEST_ASSERT_TRUE(ticket_1 != ticket_2);
+
+    // The tracker is full
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_OUT_OF_MEMORY,
+        astarte_publish_tracker_reserve(&tracker, callback_1, NULL, 0, &ticket_3));
+
+    astarte_publish_tracker_entry_t completed;
+    TEST_ASSERT_FALSE(astarte_publish_tracker_set_msg_id(&tracker, ticket_1, 10, 0, &completed));
+    TEST_ASSERT_FALSE(astarte_publish_tracker_set_msg_id(&tracker, ticket_2, 11, 0, &completed));
+
+    // Unknown message ids are not matched
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_publish_tracker_complete(&tracker, 12, false, 0, &completed));
+
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_publish_tracker_complete(&tracker, 11, false, 0, &completed));
+    TEST_ASSERT_EQUAL(ticket_2, completed.ticket);
+    TEST_ASSERT_TRUE(completed.callback == callback_2);
+    TEST_ASSERT_EQUAL_PTR(&user_data_2, completed.user_data);
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_publish_tracker_complete(&tracker, 11, false, 0, &completed));
+
+    // A freed entry can be reserved again, cancelled entries are not completed
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_publish_tracker_reserve(&tracker, callback_1, NULL, 0, &ticket_3));
+    TEST_ASSERT_TRUE(ticket_3 != ticket_1);
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_publish_tracker_cancel(&tracker, ticket_3));
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND, astarte_publish_tracker_cancel(&tracker, ticket_3));
+
+    TEST_ASSERT_TRUE(astarte_publish_tracker_pop_any(&tracker, &completed));
+    TEST_ASSERT_EQUAL(ticket_1, completed.ticket);
+    TEST_ASSERT_FALSE(astarte_publish_tracker_pop_any(&tracker, &completed));
+
+    astarte_publish_tracker_destroy(&tracker);
+}
+
+void test_astarte_publish_tracker_early_ack(void)
+{
+    astarte_publish_tracker_t tracker;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_publish_tracker_init(&tracker, CAPACITY));
+
+    astarte_device_publish_ticket_t ticket = 0;
+    astarte_publish_tracker_entry_t completed;
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_publish_tracker_reserve(&tracker, callback_1, NULL, 0, &ticket));
+
+    // The acknowledgment is received before the message id is assigned
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_publish_tracker_complete(&tracker, 20, true, 100, &completed));
+    TEST_ASSERT_TRUE(astarte_publish_tracker_set_msg_id(&tracker, ticket, 20, 150, &completed));
+    TEST_ASSERT_EQUAL(ticket, completed.ticket);
+    TEST_ASSERT_FALSE(astarte_publish_tracker_pop_any(&tracker, &completed));
+
+    // Stale acknowledgments are ignored
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_publish_tracker_reserve(&tracker, callback_1, NULL, 0, &ticket));
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_publish_tracker_complete(&tracker, 21, true, 100, &completed));
+    TEST_ASSERT_FALSE(astarte_publish_tracker_set_msg_id(&tracker, ticket, 21, 5000, &completed));
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_publish_tracker_complete(&tracker, 21, true, 5000, &completed));
+    TEST_ASSERT_EQUAL(ticket, completed.ticket);
+
+    astarte_publish_tracker_destroy(&tracker);
+}
+
+void test_astarte_publish_tracker_expired(void)
+{
+    astarte_publish_tracker_t tracker;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_publish_tracker_init(&tracker, CAPACITY));
+
+    astarte_device_publish_ticket_t ticket_1 = 0;
+    astarte_device_publish_ticket_t ticket_2 = 0;
+    astarte_publish_tracker_entry_t expired;
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_publish_tracker_reserve(&tracker, callback_1, NULL, 1000, &ticket_1));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_publish_tracker_reserve(&tracker, callback_1, NULL, UINT32_MAX - 99, &ticket_2));
+
+    // Entries without a message id are never expired
+    TEST_ASSERT_FALSE(astarte_publish_tracker_pop_expired(&tracker, 10000, 500, &expired));
+
+    TEST_ASSERT_FALSE(astarte_publish_tracker_set_msg_id(&tracker, ticket_1, 1, 1000, &expired));
+    TEST_ASSERT_FALSE(astarte_publish_tracker_pop_expired(&tracker, 1500, 500, &expired));
+    TEST_ASSERT_TRUE(astarte_publish_tracker_pop_expired(&tracker, 1501, 500, &expired));
+    TEST_ASSERT_EQUAL(ticket_1, expired.ticket);
+    TEST_ASSERT_FALSE(astarte_publish_tracker_pop_expired(&tracker, 1501, 500, &expired));
+
+    // Time wrapping around is handled
+    TEST_ASSERT_FALSE(
+        astarte_publish_tracker_set_msg_id(&tracker, ticket_2, 2, UINT32_MAX - 99, &expired));
+    TEST_ASSERT_FALSE(astarte_publish_tracker_pop_expired(&tracker, 400, 500, &expired));
+    TEST_ASSERT_TRUE(astarte_publish_tracker_pop_expired(&tracker, 401, 500, &expired));
+    TEST_ASSERT_EQUAL(ticket_2, expired.ticket);
+
+    astarte_publish_tracker_destroy(&tracker);
+}
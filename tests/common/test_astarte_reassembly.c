@@ -0,0 +1,130 @@
+/**
+ * This file is part of Astarte.
+ *
+ * Copyright 2023 SECO Mind Srl
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ *
+ **/
+
+#include "test_astarte_reassembly.h"
+#include "astarte_reassembly.h"
+#include "unity.h"
+
+#include <string.h>
+
+#define TOPIC "realm/device/org.astarteplatform.test.Blob/value"
+#define MAX_MESSAGE_SIZE 128
+
+void test_astarte_reassembly_fragments(void)
+{
+    astarte_reassembly_t reassembly;
+    astarte_reassembly_init(&reassembly, MAX_MESSAGE_SIZE);
+
+    const char payload[] = "0123456789abcdef";
+    const size_t payload_len = strlen(payload);
+    bool complete = true;
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_reassembly_add(&reassembly, TOPIC, strlen(TOPIC), payload, 6, 0, payload_len,
+            &complete));
+    TEST_ASSERT_FALSE(complete);
+    // Only the first fragment carries the topic
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_reassembly_add(&reassembly, NULL, 0, payload + 6, 6, 6, payload_len, &complete));
+    TEST_ASSERT_FALSE(complete);
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_reassembly_add(&reassembly, NULL, 0, payload + 12, 4, 12, payload_len, &complete));
+    TEST_ASSERT_TRUE(complete);
+    TEST_ASSERT_EQUAL(strlen(TOPIC), reassembly.topic_len);
+    TEST_ASSERT_EQUAL_MEMORY(TOPIC, reassembly.buffer, strlen(TOPIC));
+    TEST_ASSERT_EQUAL(payload_len, reassembly.data_len);
+    TEST_ASSERT_EQUAL_MEMORY(payload, astarte_reassembly_data(&reassembly), payload_len);
+
+    // The buffer is reused for a smaller message
+    char *buffer = reassembly.buffer;
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_reassembly_add(&reassembly, "t", 1, payload, 2, 0, 4, &complete));
+    TEST_ASSERT_FALSE(complete);
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_reassembly_add(&reassembly, NULL, 0, payload + 2, 2, 2, 4, &complete));
+    TEST_ASSERT_TRUE(complete);
+    TEST_ASSERT_EQUAL_PTR(buffer, reassembly.buffer);
+    TEST_ASSERT_EQUAL_MEMORY("0123", astarte_reassembly_data(&reassembly), 4);
+
+    astarte_reassembly_destroy(&reassembly);
+    TEST_ASSERT_NULL(reassembly.buffer);
+}
+
+void test_astarte_reassembly_max_size(void)
+{
+    astarte_reassembly_t reassembly;
+    astarte_reassembly_init(&reassembly, MAX_MESSAGE_SIZE);
+
+    char payload[MAX_MESSAGE_SIZE] = { 0 };
+    size_t max_payload_len = MAX_MESSAGE_SIZE - strlen(TOPIC);
+    bool complete = true;
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_INVALID_SIZE,
+        astarte_reassembly_add(&reassembly, TOPIC, strlen(TOPIC), payload, 8, 0,
+            max_payload_len + 1, &complete));
+    TEST_ASSERT_FALSE(complete);
+    // The following fragments of the discarded message are not accepted
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_reassembly_add(
+            &reassembly, NULL, 0, payload, 8, 8, max_payload_len + 1, &complete));
+
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_reassembly_add(
+            &reassembly, TOPIC, strlen(TOPIC), payload, 8, 0, max_payload_len, &complete));
+    // A fragment exceeding the announced length drops the message
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_INVALID_SIZE,
+        astarte_reassembly_add(
+            &reassembly, NULL, 0, payload, max_payload_len, 8, max_payload_len, &complete));
+    TEST_ASSERT_FALSE(reassembly.in_progress);
+
+    astarte_reassembly_destroy(&reassembly);
+}
+
+void test_astarte_reassembly_unexpected_fragment(void)
+{
+    astarte_reassembly_t reassembly;
+    astarte_reassembly_init(&reassembly, MAX_MESSAGE_SIZE);
+
+    const char payload[] = "0123456789";
+    bool complete = true;
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_reassembly_add(&reassembly, NULL, 0, payload, 5, 5, 10, &complete));
+
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_reassembly_add(&reassembly, TOPIC, strlen(TOPIC), payload, 5, 0, 10, &complete));
+    // A missing fragment drops the message
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_reassembly_add(&reassembly, NULL, 0, payload, 2, 8, 10, &complete));
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_reassembly_add(&reassembly, NULL, 0, payload + 5, 5, 5, 10, &complete));
+    TEST_ASSERT_FALSE(complete);
+
+    // A new message replaces the incomplete one
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_reassembly_add(&reassembly, TOPIC, strlen(TOPIC), payload, 5, 0, 10, &complete));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_reassembly_add(&reassembly, "x", 1, payload, 4, 0, 8, &complete));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_reassembly_add(&reassembly, NULL, 0, payload + 4, 4, 4, 8, &complete));
+    TEST_ASSERT_TRUE(complete);
+    TEST_ASSERT_EQUAL(1, reassembly.topic_len);
+    TEST_ASSERT_EQUAL_MEMORY("01234567", astarte_reassembly_data(&reassembly), 8);
+
+    astarte_reassembly_destroy(&reassembly);
+}
@@ -0,0 +1,113 @@
+/**
+ * This file is part of Astarte.
+ *
+ * Copyright 2023 SECO Mind Srl
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ *
+ **/
+
+#include "test_astarte_routes.h"
+#include "astarte_routes.h"
+#include "unity.h"
+
+#include <string.h>
+
+static void callback_a(astarte_device_data_view_event_t *event)
+{
+    (void) event;
+}
+
+static void callback_b(astarte_device_data_view_event_t *event)
+{
+    (void) event;
+}
+
+static const astarte_route_node_t *match(const astarte_routes_t *routes, const char *path)
+{
+    return astarte_routes_match(routes, path, strlen(path));
+}
+
+void test_astarte_routes_match(void)
+{
+    astarte_routes_t routes = { 0 };
+    int data_1 = 1;
+    int data_2 = 2;
+    int data_3 = 3;
+    TEST_ASSERT_EQUAL(
+        ASTARTE_OK, astarte_routes_add(&routes, "/%{sensor_id}/value", callback_a, &data_1));
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_routes_add(&routes, "/a/%{x}/c", callback_a, &data_2));
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_routes_add(&routes, "/%{y}/b/d", callback_b, &data_3));
+
+    const astarte_route_node_t *route = match(&routes, "/sensor1/value");
+    TEST_ASSERT_NOT_NULL(route);
+    TEST_ASSERT_EQUAL_PTR(&data_1, route->user_data);
+    route = match(&routes, "/a/b/c");
+    TEST_ASSERT_NOT_NULL(route);
+    TEST_ASSERT_EQUAL_PTR(&data_2, route->user_data);
+    // The literal segment is tried first, then the parameter is matched instead
+    route = match(&routes, "/a/b/d");
+    TEST_ASSERT_NOT_NULL(route);
+    TEST_ASSERT_EQUAL_PTR(callback_b, route->callback);
+    TEST_ASSERT_EQUAL_PTR(&data_3, route->user_data);
+    // The path does not need to be NULL terminated
+    TEST_ASSERT_EQUAL_PTR(route, astarte_routes_match(&routes, "/a/b/dxyz", strlen("/a/b/d")));
+
+    TEST_ASSERT_NULL(match(&routes, "/sensor1"));
+    TEST_ASSERT_NULL(match(&routes, "/sensor1/value/other"));
+    TEST_ASSERT_NULL(match(&routes, "/a/b/e"));
+
+    // Adding an equal pattern replaces the callback
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_routes_add(&routes, "/%{id}/value", callback_b, &data_3));
+    route = match(&routes, "/sensor1/value");
+    TEST_ASSERT_NOT_NULL(route);
+    TEST_ASSERT_EQUAL_PTR(callback_b, route->callback);
+    TEST_ASSERT_EQUAL_PTR(&data_3, route->user_data);
+
+    astarte_routes_destroy(&routes);
+    TEST_ASSERT_NULL(match(&routes, "/a/b/c"));
+}
+
+void test_astarte_routes_fallback(void)
+{
+    astarte_routes_t routes = { 0 };
+    int data_1 = 1;
+    int data_2 = 2;
+    TEST_ASSERT_NULL(match(&routes, "/value"));
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_routes_add(&routes, "/value", callback_a, &data_1));
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_routes_add(&routes, NULL, callback_b, &data_2));
+
+    const astarte_route_node_t *route = match(&routes, "/value");
+    TEST_ASSERT_NOT_NULL(route);
+    TEST_ASSERT_EQUAL_PTR(&data_1, route->user_data);
+    route = match(&routes, "/other/value");
+    TEST_ASSERT_EQUAL_PTR(&routes.root, route);
+    TEST_ASSERT_EQUAL_PTR(callback_b, route->callback);
+    TEST_ASSERT_EQUAL_PTR(&data_2, route->user_data);
+
+    astarte_routes_destroy(&routes);
+}
+
+void test_astarte_routes_invalid_pattern(void)
+{
+    astarte_routes_t routes = { 0 };
+    const char *patterns[] = { "", "a", "/", "/a//b", "/a/" };
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        TEST_ASSERT_EQUAL(ASTARTE_ERR_INVALID_INTERFACE_PATH,
+            astarte_routes_add(&routes, patterns[i], callback_a, NULL));
+    }
+    TEST_ASSERT_NULL(match(&routes, "/a"));
+    astarte_routes_destroy(&routes);
+}
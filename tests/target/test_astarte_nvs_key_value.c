@@ -25,6 +25,7 @@
 
 #include <esp_log.h>
 #include <nvs_flash.h>
+#include <stdio.h>
 
 #define TAG "NVS KEY VALUE TEST"
 
@@ -48,9 +49,12 @@ void test_astarte_nvs_key_value_set_get_cycle(void)
     TEST_ASSERT_EQUAL(ESP_OK, nvs_open(nvs_namespace, NVS_READWRITE, &nvs_handle));
 
     // Set key value pairs in NVS
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key1, (void *) value1, 2));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key2, (void *) value2, 5));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key3, (void *) value3, 1));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key1, (void *) value1, 2));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key2, (void *) value2, 5));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key3, (void *) value3, 1));
 
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
@@ -60,19 +64,22 @@ void test_astarte_nvs_key_value_set_get_cycle(void)
     uint8_t read_value3[1] = { 0 };
 
     // Read length of each value from NVS
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key2, NULL, &length2));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key2, NULL, &length2));
     TEST_ASSERT_EQUAL(5, length2);
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key3, NULL, &length3));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key3, NULL, &length3));
     TEST_ASSERT_EQUAL(1, length3);
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key1, NULL, &length1));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key1, NULL, &length1));
     TEST_ASSERT_EQUAL(2, length1);
 
     // Read all values from NVS
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key3, read_value3, &length3));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key3, read_value3, &length3));
     TEST_ASSERT_EQUAL_UINT8_ARRAY(value3, read_value3, length3);
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key1, read_value1, &length1));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key1, read_value1, &length1));
     TEST_ASSERT_EQUAL_UINT8_ARRAY(value1, read_value1, length1);
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key2, read_value2, &length2));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key2, read_value2, &length2));
     TEST_ASSERT_EQUAL_UINT8_ARRAY(value2, read_value2, length2);
 
     nvs_close(nvs_handle);
@@ -100,39 +107,46 @@ void test_astarte_nvs_key_value_erase_key(void)
     TEST_ASSERT_EQUAL(ESP_OK, nvs_open(nvs_namespace, NVS_READWRITE, &nvs_handle));
 
     // Set key value pairs in NVS
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key1, (void *) value1, 2));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key2, (void *) value2, 5));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key3, (void *) value3, 1));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key4, (void *) value4, 4));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key1, (void *) value1, 2));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key2, (void *) value2, 5));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key3, (void *) value3, 1));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key4, (void *) value4, 4));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Remove one of the key pair values stored
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, key2));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, NULL, key2));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Check that all other keys/values are still present
     size_t length1 = 0, length2 = 0, length3 = 0, length4 = 0;
     TEST_ASSERT_EQUAL(
-        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, key2, NULL, &length2));
+        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, NULL, key2, NULL, &length2));
     TEST_ASSERT_EQUAL(0, length2);
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key3, NULL, &length3));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key3, NULL, &length3));
     TEST_ASSERT_EQUAL(1, length3);
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key1, NULL, &length1));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key1, NULL, &length1));
     TEST_ASSERT_EQUAL(2, length1);
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key4, NULL, &length4));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key4, NULL, &length4));
     TEST_ASSERT_EQUAL(4, length4);
     uint8_t read_value1[2] = { 0 };
     uint8_t read_value3[1] = { 0 };
     uint8_t read_value4[4] = { 0 };
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key3, read_value3, &length3));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key3, read_value3, &length3));
     TEST_ASSERT_EQUAL_UINT8_ARRAY(value3, read_value3, length3);
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key1, read_value1, &length1));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key1, read_value1, &length1));
     TEST_ASSERT_EQUAL_UINT8_ARRAY(value1, read_value1, length1);
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key4, read_value4, &length4));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key4, read_value4, &length4));
     TEST_ASSERT_EQUAL_UINT8_ARRAY(value4, read_value4, length4);
 
     // Remove one more of the key pair values stored
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, key4));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, NULL, key4));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Check that all other keys/values are still present
@@ -141,22 +155,24 @@ void test_astarte_nvs_key_value_erase_key(void)
     length3 = 0;
     length4 = 0;
     TEST_ASSERT_EQUAL(
-        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, key2, NULL, &length2));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key3, NULL, &length3));
+        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, NULL, key2, NULL, &length2));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key3, NULL, &length3));
     TEST_ASSERT_EQUAL(1, length3);
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key1, NULL, &length1));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key1, NULL, &length1));
     TEST_ASSERT_EQUAL(2, length1);
     TEST_ASSERT_EQUAL(
-        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, key4, NULL, &length4));
+        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, NULL, key4, NULL, &length4));
     read_value1[0] = 0;
     read_value3[0] = 0;
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key3, read_value3, &length3));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key3, read_value3, &length3));
     TEST_ASSERT_EQUAL_UINT8_ARRAY(value3, read_value3, length3);
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key1, read_value1, &length1));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key1, read_value1, &length1));
     TEST_ASSERT_EQUAL_UINT8_ARRAY(value1, read_value1, length1);
 
     // Remove one more of the key pair values stored
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, key1));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, NULL, key1));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Check that all other keys/values are still present
@@ -165,19 +181,20 @@ void test_astarte_nvs_key_value_erase_key(void)
     length3 = 0;
     length4 = 0;
     TEST_ASSERT_EQUAL(
-        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, key2, NULL, &length2));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key3, NULL, &length3));
+        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, NULL, key2, NULL, &length2));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key3, NULL, &length3));
     TEST_ASSERT_EQUAL(1, length3);
     TEST_ASSERT_EQUAL(
-        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, key1, NULL, &length1));
+        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, NULL, key1, NULL, &length1));
     TEST_ASSERT_EQUAL(
-        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, key4, NULL, &length4));
+        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, NULL, key4, NULL, &length4));
     read_value3[0] = 0;
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_get(nvs_handle, key3, read_value3, &length3));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_get(nvs_handle, NULL, key3, read_value3, &length3));
     TEST_ASSERT_EQUAL_UINT8_ARRAY(value3, read_value3, length3);
 
     // Remove one more of the key pair values stored
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, key3));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, NULL, key3));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Check that all other keys/values are still present
@@ -186,13 +203,13 @@ void test_astarte_nvs_key_value_erase_key(void)
     length3 = 0;
     length4 = 0;
     TEST_ASSERT_EQUAL(
-        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, key2, NULL, &length2));
+        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, NULL, key2, NULL, &length2));
     TEST_ASSERT_EQUAL(
-        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, key3, NULL, &length3));
+        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, NULL, key3, NULL, &length3));
     TEST_ASSERT_EQUAL(
-        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, key1, NULL, &length1));
+        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, NULL, key1, NULL, &length1));
     TEST_ASSERT_EQUAL(
-        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, key4, NULL, &length4));
+        ESP_ERR_NVS_NOT_FOUND, astarte_nvs_key_value_get(nvs_handle, NULL, key4, NULL, &length4));
 
     nvs_close(nvs_handle);
 }
@@ -238,10 +255,14 @@ void test_astarte_nvs_key_value_iterator(void)
     TEST_ASSERT_EQUAL(ESP_OK, nvs_open(nvs_namespace, NVS_READWRITE, &nvs_handle));
 
     // Set key value pairs in NVS
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key1, (void *) value1, 2));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key3, (void *) value3, 1));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key2, (void *) value2, 5));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key4, (void *) value4, 4));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key1, (void *) value1, 2));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key3, (void *) value3, 1));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key2, (void *) value2, 5));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key4, (void *) value4, 4));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Initialize an iterator for the NVS
@@ -341,7 +362,8 @@ void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_first_and_onl
     TEST_ASSERT_EQUAL(ESP_OK, nvs_open(nvs_namespace, NVS_READWRITE, &nvs_handle));
 
     // Set key value pairs in NVS
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key1, (void *) value1, 2));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key1, (void *) value1, 2));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Initialize an iterator for the NVS
@@ -398,10 +420,14 @@ void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_first(void)
     TEST_ASSERT_EQUAL(ESP_OK, nvs_open(nvs_namespace, NVS_READWRITE, &nvs_handle));
 
     // Set key value pairs in NVS
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key1, (void *) value1, 2));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key2, (void *) value2, 5));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key3, (void *) value3, 1));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key4, (void *) value4, 4));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key1, (void *) value1, 2));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key2, (void *) value2, 5));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key3, (void *) value3, 1));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key4, (void *) value4, 4));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Initialize an iterator for the NVS
@@ -431,7 +457,7 @@ void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_first(void)
     TEST_ASSERT_TRUE(has_next);
 
     // Remove the element just fetched
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, key1));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, NULL, key1));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Check the element the iterator is pointing to. Now it's the next element
@@ -514,10 +540,14 @@ void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_last(void)
     TEST_ASSERT_EQUAL(ESP_OK, nvs_open(nvs_namespace, NVS_READWRITE, &nvs_handle));
 
     // Set key value pairs in NVS
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key1, (void *) value1, 2));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key2, (void *) value2, 5));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key3, (void *) value3, 1));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key4, (void *) value4, 4));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key1, (void *) value1, 2));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key2, (void *) value2, 5));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key3, (void *) value3, 1));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key4, (void *) value4, 4));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Initialize an iterator for the NVS
@@ -602,7 +632,7 @@ void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_last(void)
     TEST_ASSERT_FALSE(has_next);
 
     // Remove the element just fetched
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, key4));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, NULL, key4));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     nvs_close(nvs_handle);
@@ -633,10 +663,14 @@ void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_middle(void)
     TEST_ASSERT_EQUAL(ESP_OK, nvs_open(nvs_namespace, NVS_READWRITE, &nvs_handle));
 
     // Set key value pairs in NVS
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key1, (void *) value1, 2));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key2, (void *) value2, 5));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key3, (void *) value3, 1));
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, key4, (void *) value4, 4));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key1, (void *) value1, 2));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key2, (void *) value2, 5));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key3, (void *) value3, 1));
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_set(nvs_handle, NULL, key4, (void *) value4, 4));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Initialize an iterator for the NVS
@@ -683,7 +717,7 @@ void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_middle(void)
     TEST_ASSERT_TRUE(has_next);
 
     // Remove the element just fetched
-    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, key2));
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, NULL, key2));
     TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
 
     // Check element
@@ -727,3 +761,147 @@ void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_middle(void)
 
     nvs_close(nvs_handle);
 }
+
+void test_astarte_nvs_key_value_index(void)
+{
+    // Prepare device by erasing default nvs partition
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_erase());
+    // Prepare device by initializing default nvs partition
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_init());
+
+    const char nvs_namespace[] = "NVS key value";
+    nvs_handle_t nvs_handle;
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_open(nvs_namespace, NVS_READWRITE, &nvs_handle));
+
+    // Store enough keys to grow the index
+    const int keys_count = 40;
+    char key[64] = { 0 };
+    astarte_nvs_key_value_index_t index;
+    astarte_nvs_key_value_index_init(&index);
+    for (int i = 0; i < keys_count; i++) {
+        snprintf(key, sizeof(key), "super long key that would not fit normally %d", i);
+        uint8_t value = i;
+        TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, &index, key, &value, 1));
+    }
+    TEST_ASSERT_EQUAL(keys_count, index.keys_count);
+
+    // Overwrite a key and erase some of them
+    uint8_t value = 100;
+    TEST_ASSERT_EQUAL(ESP_OK,
+        astarte_nvs_key_value_set(
+            nvs_handle, &index, "super long key that would not fit normally 7", &value, 1));
+    TEST_ASSERT_EQUAL(keys_count, index.keys_count);
+    for (int i = 0; i < keys_count; i += 3) {
+        snprintf(key, sizeof(key), "super long key that would not fit normally %d", i);
+        TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, &index, key));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
+
+    // The index and the stored keys should agree, also with an index built from scratch
+    astarte_nvs_key_value_index_t rebuilt_index;
+    astarte_nvs_key_value_index_init(&rebuilt_index);
+    for (int i = 0; i < keys_count; i++) {
+        snprintf(key, sizeof(key), "super long key that would not fit normally %d", i);
+        esp_err_t expected_err = (i % 3 == 0) ? ESP_ERR_NVS_NOT_FOUND : ESP_OK;
+        uint8_t expected_value = (i == 7) ? 100 : i;
+        astarte_nvs_key_value_index_t *indexes[] = { &index, &rebuilt_index, NULL };
+        for (size_t j = 0; j < sizeof(indexes) / sizeof(indexes[0]); j++) {
+            uint8_t read_value = 0;
+            size_t length = 1;
+            TEST_ASSERT_EQUAL(expected_err,
+                astarte_nvs_key_value_get(nvs_handle, indexes[j], key, &read_value, &length));
+            if (expected_err == ESP_OK) {
+                TEST_ASSERT_EQUAL(expected_value, read_value);
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL(index.keys_count, rebuilt_index.keys_count);
+    TEST_ASSERT_EQUAL(index.next_store_index, rebuilt_index.next_store_index);
+
+    astarte_nvs_key_value_index_destroy(&rebuilt_index);
+    astarte_nvs_key_value_index_destroy(&index);
+    nvs_close(nvs_handle);
+}
+
+void test_astarte_nvs_key_value_compact(void)
+{
+    // Prepare device by erasing default nvs partition
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_erase());
+    // Prepare device by initializing default nvs partition
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_init());
+
+    const char nvs_namespace[] = "NVS key value";
+    nvs_handle_t nvs_handle;
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_open(nvs_namespace, NVS_READWRITE, &nvs_handle));
+
+    const int keys_count = 20;
+    char key[64] = { 0 };
+    astarte_nvs_key_value_index_t index;
+    astarte_nvs_key_value_index_init(&index);
+    for (int i = 0; i < keys_count; i++) {
+        snprintf(key, sizeof(key), "super long key that would not fit normally %d", i);
+        uint8_t value = i;
+        TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_set(nvs_handle, &index, key, &value, 1));
+    }
+
+    // Erasing leaves holes, reused by the new keys
+    for (int i = 0; i < keys_count; i += 2) {
+        snprintf(key, sizeof(key), "super long key that would not fit normally %d", i);
+        TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_erase_key(nvs_handle, &index, key));
+    }
+    TEST_ASSERT_EQUAL(keys_count / 2, index.holes_count);
+    TEST_ASSERT_EQUAL(2 * keys_count, index.next_store_index);
+    uint8_t value = 100;
+    TEST_ASSERT_EQUAL(ESP_OK,
+        astarte_nvs_key_value_set(nvs_handle, &index, "reused hole key", &value, 1));
+    TEST_ASSERT_EQUAL(keys_count / 2 - 1, index.holes_count);
+    TEST_ASSERT_EQUAL(2 * keys_count, index.next_store_index);
+
+    // Compacting stores the remaining pairs one after the other
+    TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_compact(nvs_handle, &index));
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_commit(nvs_handle));
+    TEST_ASSERT_EQUAL(0, index.holes_count);
+    TEST_ASSERT_EQUAL(2 * index.keys_count, index.next_store_index);
+
+    // All the pairs should be found with the index, with a rebuilt index and by the iterator
+    astarte_nvs_key_value_index_t rebuilt_index;
+    astarte_nvs_key_value_index_init(&rebuilt_index);
+    for (int i = 0; i < keys_count; i++) {
+        snprintf(key, sizeof(key), "super long key that would not fit normally %d", i);
+        esp_err_t expected_err = (i % 2 == 0) ? ESP_ERR_NVS_NOT_FOUND : ESP_OK;
+        astarte_nvs_key_value_index_t *indexes[] = { &index, &rebuilt_index, NULL };
+        for (size_t j = 0; j < sizeof(indexes) / sizeof(indexes[0]); j++) {
+            uint8_t read_value = 0;
+            size_t length = 1;
+            TEST_ASSERT_EQUAL(expected_err,
+                astarte_nvs_key_value_get(nvs_handle, indexes[j], key, &read_value, &length));
+            if (expected_err == ESP_OK) {
+                TEST_ASSERT_EQUAL(i, read_value);
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL(0, rebuilt_index.holes_count);
+    TEST_ASSERT_EQUAL(index.next_store_index, rebuilt_index.next_store_index);
+
+    astarte_nvs_key_value_iterator_t iterator;
+    TEST_ASSERT_EQUAL(
+        ESP_OK, astarte_nvs_key_value_iterator_init(nvs_handle, NVS_TYPE_BLOB, &iterator));
+    size_t iterated_count = 1;
+    bool has_next = true;
+    while (has_next) {
+        size_t key_len = sizeof(key);
+        size_t length = 1;
+        TEST_ASSERT_EQUAL(ESP_OK,
+            astarte_nvs_key_value_iterator_get_element(&iterator, key, &key_len, &value, &length));
+        TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_iterator_peek(&iterator, &has_next));
+        if (has_next) {
+            TEST_ASSERT_EQUAL(ESP_OK, astarte_nvs_key_value_iterator_next(&iterator));
+            iterated_count++;
+        }
+    }
+    TEST_ASSERT_EQUAL(index.keys_count, iterated_count);
+
+    astarte_nvs_key_value_index_destroy(&rebuilt_index);
+    astarte_nvs_key_value_index_destroy(&index);
+    nvs_close(nvs_handle);
+}
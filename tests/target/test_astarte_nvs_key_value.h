@@ -34,6 +34,8 @@ void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_first_and_onl
 void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_first(void);
 void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_last(void);
 void test_astarte_nvs_key_value_iterator_on_changing_memory_remove_middle(void);
+void test_astarte_nvs_key_value_index(void);
+void test_astarte_nvs_key_value_compact(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,186 @@
+/**
+ * This file is part of Astarte.
+ *
+ * Copyright 2023 SECO Mind Srl
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later OR Apache-2.0
+ *
+ **/
+
+#include "test_astarte_offline_queue.h"
+#include "astarte_offline_queue.h"
+#include "unity.h"
+
+#include <string.h>
+
+#define TAG "ASTARTE OFFLINE QUEUE TEST"
+
+// The partition defined in the partition table of the test app
+#define PARTITION_LABEL "astarte_queue"
+
+#define TOPIC_SIZE 64
+#define FULL_PAYLOAD_SIZE 2000
+
+static const uint8_t payload_1[] = { 1, 2, 3, 4, 5 };
+static const uint8_t payload_2[] = { 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+static void open_empty_queue(astarte_offline_queue_t *queue)
+{
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_open(queue, PARTITION_LABEL));
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_clear(queue));
+    TEST_ASSERT_EQUAL(0, astarte_offline_queue_count(queue));
+}
+
+static void check_peek(astarte_offline_queue_t *queue, const char *topic, const uint8_t *payload,
+    size_t payload_len, int qos)
+{
+    char topic_read[TOPIC_SIZE] = { 0 };
+    static uint8_t payload_read[ASTARTE_OFFLINE_QUEUE_MAX_MESSAGE_SIZE];
+    size_t payload_read_len = sizeof(payload_read);
+    int qos_read = -1;
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_offline_queue_peek(
+            queue, topic_read, TOPIC_SIZE, payload_read, &payload_read_len, &qos_read));
+    TEST_ASSERT_EQUAL_STRING(topic, topic_read);
+    TEST_ASSERT_EQUAL(payload_len, payload_read_len);
+    TEST_ASSERT_EQUAL_MEMORY(payload, payload_read, payload_len);
+    TEST_ASSERT_EQUAL(qos, qos_read);
+}
+
+void test_astarte_offline_queue_push_pop(void)
+{
+    astarte_offline_queue_t queue;
+    open_empty_queue(&queue);
+
+    char topic_read[TOPIC_SIZE] = { 0 };
+    uint8_t payload_read[sizeof(payload_2)] = { 0 };
+    size_t payload_read_len = sizeof(payload_read);
+    int qos_read = 0;
+
+    // Peek fails on an empty queue
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_offline_queue_peek(
+            &queue, topic_read, TOPIC_SIZE, payload_read, &payload_read_len, &qos_read));
+
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_offline_queue_push(&queue, "topic/1", payload_1, sizeof(payload_1), 1, false));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_offline_queue_push(&queue, "topic/2", payload_2, sizeof(payload_2), 2, false));
+    TEST_ASSERT_EQUAL(2, astarte_offline_queue_count(&queue));
+
+    // Peek fails when the buffers are too small
+    payload_read_len = sizeof(payload_1) - 1;
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_INVALID_SIZE,
+        astarte_offline_queue_peek(
+            &queue, topic_read, TOPIC_SIZE, payload_read, &payload_read_len, &qos_read));
+
+    // Messages are returned in order, peeking does not remove them
+    check_peek(&queue, "topic/1", payload_1, sizeof(payload_1), 1);
+    check_peek(&queue, "topic/1", payload_1, sizeof(payload_1), 1);
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_pop(&queue));
+    TEST_ASSERT_EQUAL(1, astarte_offline_queue_count(&queue));
+    check_peek(&queue, "topic/2", payload_2, sizeof(payload_2), 2);
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_pop(&queue));
+    TEST_ASSERT_EQUAL(0, astarte_offline_queue_count(&queue));
+
+    payload_read_len = sizeof(payload_read);
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_offline_queue_peek(
+            &queue, topic_read, TOPIC_SIZE, payload_read, &payload_read_len, &qos_read));
+
+    // Messages too large for a sector are refused
+    static uint8_t large_payload[ASTARTE_OFFLINE_QUEUE_MAX_MESSAGE_SIZE];
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_INVALID_SIZE,
+        astarte_offline_queue_push(
+            &queue, "topic/large", large_payload, sizeof(large_payload), 0, false));
+
+    astarte_offline_queue_close(&queue);
+}
+
+void test_astarte_offline_queue_recovery(void)
+{
+    astarte_offline_queue_t queue;
+    open_empty_queue(&queue);
+
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_offline_queue_push(&queue, "topic/1", payload_1, sizeof(payload_1), 1, false));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_offline_queue_push(&queue, "topic/2", payload_2, sizeof(payload_2), 2, false));
+    check_peek(&queue, "topic/1", payload_1, sizeof(payload_1), 1);
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_pop(&queue));
+    astarte_offline_queue_close(&queue);
+
+    // Only the message not consumed is recovered
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_open(&queue, PARTITION_LABEL));
+    TEST_ASSERT_EQUAL(1, astarte_offline_queue_count(&queue));
+    check_peek(&queue, "topic/2", payload_2, sizeof(payload_2), 2);
+
+    // New messages are appended after the recovered ones
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_offline_queue_push(&queue, "topic/3", payload_1, sizeof(payload_1), 0, false));
+    astarte_offline_queue_close(&queue);
+
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_open(&queue, PARTITION_LABEL));
+    TEST_ASSERT_EQUAL(2, astarte_offline_queue_count(&queue));
+    check_peek(&queue, "topic/2", payload_2, sizeof(payload_2), 2);
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_pop(&queue));
+    check_peek(&queue, "topic/3", payload_1, sizeof(payload_1), 0);
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_pop(&queue));
+    TEST_ASSERT_EQUAL(0, astarte_offline_queue_count(&queue));
+
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_clear(&queue));
+    astarte_offline_queue_close(&queue);
+}
+
+void test_astarte_offline_queue_full(void)
+{
+    astarte_offline_queue_t queue;
+    open_empty_queue(&queue);
+
+    // Fill the queue with messages, each sector can contain two of them
+    static uint8_t payload[FULL_PAYLOAD_SIZE];
+    size_t pushed = 0;
+    while (true) {
+        payload[0] = (uint8_t) pushed;
+        astarte_err_t res
+            = astarte_offline_queue_push(&queue, "topic", payload, sizeof(payload), 1, false);
+        if (res == ASTARTE_ERR_QUEUE_FULL) {
+            break;
+        }
+        TEST_ASSERT_EQUAL(ASTARTE_OK, res);
+        pushed++;
+    }
+    TEST_ASSERT_EQUAL(pushed, astarte_offline_queue_count(&queue));
+    TEST_ASSERT_TRUE(pushed >= 2);
+
+    // Peek the oldest message, then drop it by pushing with the drop oldest policy
+    payload[0] = 0;
+    check_peek(&queue, "topic", payload, sizeof(payload), 1);
+    payload[0] = (uint8_t) pushed;
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_offline_queue_push(&queue, "topic", payload, sizeof(payload), 1, true));
+    TEST_ASSERT_EQUAL(pushed - 1, astarte_offline_queue_count(&queue));
+
+    // Popping after the drop does not remove the new oldest message
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_pop(&queue));
+    TEST_ASSERT_EQUAL(pushed - 1, astarte_offline_queue_count(&queue));
+
+    // The oldest sector, containing two messages, has been dropped
+    payload[0] = 2;
+    check_peek(&queue, "topic", payload, sizeof(payload), 1);
+
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_offline_queue_clear(&queue));
+    astarte_offline_queue_close(&queue);
+}
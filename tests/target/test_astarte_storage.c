@@ -509,6 +509,67 @@ void test_astarte_storage_iteration(void)
     astarte_storage_close(astarte_storage_handle);
 }
 
+void test_astarte_storage_iteration_read_property(void)
+{
+    // Prepare device by erasing default nvs partition
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_erase());
+    // Prepare device by initializing default nvs partition
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_init());
+
+    // A payload larger than the initial scratch buffer
+    uint8_t large_payload[64] = { 0 };
+    for (size_t i = 0; i < sizeof(large_payload); i++) {
+        large_payload[i] = i;
+    }
+
+    // Open storage
+    astarte_storage_handle_t astarte_storage_handle;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_storage_open(&astarte_storage_handle));
+
+    // Store properties
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_storage_store_property(astarte_storage_handle, I1_INAME, I1_P1_PNAME, I1_IMAJOR,
+            i1_p1_payload, I1_P1_PAYLOAD_LEN));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_storage_store_property(astarte_storage_handle, I2_INAME, I2_P1_PNAME, I2_IMAJOR,
+            large_payload, sizeof(large_payload)));
+
+    // Create iterator
+    astarte_storage_iterator_t astarte_storage_iterator;
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_storage_iterator_create(astarte_storage_handle, &astarte_storage_iterator));
+    astarte_storage_scratch_t scratch;
+    astarte_storage_scratch_init(&scratch);
+    astarte_storage_property_t property;
+
+    // Fetch first property
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_storage_iterator_read_property(&astarte_storage_iterator, &scratch, &property));
+    TEST_ASSERT_EQUAL_STRING(I1_INAME, property.interface_name);
+    TEST_ASSERT_EQUAL_STRING(I1_P1_PNAME, property.path);
+    TEST_ASSERT_EQUAL(I1_IMAJOR, property.major);
+    TEST_ASSERT_EQUAL(I1_P1_PAYLOAD_LEN, property.data_len);
+    TEST_ASSERT_EQUAL_MEMORY(i1_p1_payload, property.data, I1_P1_PAYLOAD_LEN);
+
+    // Fetch next property, growing the scratch buffer
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_storage_iterator_advance(&astarte_storage_iterator));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_storage_iterator_read_property(&astarte_storage_iterator, &scratch, &property));
+    TEST_ASSERT_EQUAL_STRING(I2_INAME, property.interface_name);
+    TEST_ASSERT_EQUAL_STRING(I2_P1_PNAME, property.path);
+    TEST_ASSERT_EQUAL(I2_IMAJOR, property.major);
+    TEST_ASSERT_EQUAL(sizeof(large_payload), property.data_len);
+    TEST_ASSERT_EQUAL_MEMORY(large_payload, property.data, sizeof(large_payload));
+
+    // Fetch next property
+    TEST_ASSERT_EQUAL(
+        ASTARTE_ERR_NOT_FOUND, astarte_storage_iterator_advance(&astarte_storage_iterator));
+
+    // Close storage
+    astarte_storage_scratch_destroy(&scratch);
+    astarte_storage_close(astarte_storage_handle);
+}
+
 void test_astarte_storage_iteration_empty_memory(void)
 {
     // Prepare device by erasing default nvs partition
@@ -528,3 +589,59 @@ void test_astarte_storage_iteration_empty_memory(void)
     // Close storage
     astarte_storage_close(astarte_storage_handle);
 }
+
+void test_astarte_storage_transaction(void)
+{
+    // Prepare device by erasing default nvs partition
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_erase());
+    // Prepare device by initializing default nvs partition
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_flash_init());
+
+    size_t payload_read_len = 0;
+
+    // Open storage
+    astarte_storage_handle_t astarte_storage_handle;
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_storage_open(&astarte_storage_handle));
+
+    // Commit without a transaction and nested transactions are rejected
+    TEST_ASSERT_EQUAL(ASTARTE_ERR, astarte_storage_commit_transaction(astarte_storage_handle));
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_storage_begin_transaction(astarte_storage_handle));
+    TEST_ASSERT_EQUAL(ASTARTE_ERR, astarte_storage_begin_transaction(astarte_storage_handle));
+
+    // Store and delete properties in the transaction
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_storage_store_property(astarte_storage_handle, I1_INAME, I1_P1_PNAME, I1_IMAJOR,
+            i1_p1_payload, I1_P1_PAYLOAD_LEN));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_storage_store_property(astarte_storage_handle, I1_INAME, I1_P2_PNAME, I1_IMAJOR,
+            i1_p2_payload, I1_P2_PAYLOAD_LEN));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_storage_store_property(astarte_storage_handle, I2_INAME, I2_P1_PNAME, I2_IMAJOR,
+            i2_p1_payload, I2_P1_PAYLOAD_LEN));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_storage_delete_property(astarte_storage_handle, I1_INAME, I1_P2_PNAME));
+
+    // Changes are visible through the same handle before the commit
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_storage_load_property(
+            astarte_storage_handle, I1_INAME, I1_P2_PNAME, NULL, NULL, &payload_read_len));
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_storage_commit_transaction(astarte_storage_handle));
+    astarte_storage_close(astarte_storage_handle);
+
+    // Changes are persisted after the commit
+    TEST_ASSERT_EQUAL(ASTARTE_OK, astarte_storage_open(&astarte_storage_handle));
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_storage_load_property(
+            astarte_storage_handle, I1_INAME, I1_P1_PNAME, NULL, NULL, &payload_read_len));
+    TEST_ASSERT_EQUAL(I1_P1_PAYLOAD_LEN, payload_read_len);
+    TEST_ASSERT_EQUAL(ASTARTE_OK,
+        astarte_storage_load_property(
+            astarte_storage_handle, I2_INAME, I2_P1_PNAME, NULL, NULL, &payload_read_len));
+    TEST_ASSERT_EQUAL(I2_P1_PAYLOAD_LEN, payload_read_len);
+    TEST_ASSERT_EQUAL(ASTARTE_ERR_NOT_FOUND,
+        astarte_storage_load_property(
+            astarte_storage_handle, I1_INAME, I1_P2_PNAME, NULL, NULL, &payload_read_len));
+
+    // Close storage
+    astarte_storage_close(astarte_storage_handle);
+}
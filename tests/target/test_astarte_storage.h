@@ -30,7 +30,9 @@ void test_astarte_storage_store_delete_cycle(void);
 void test_astarte_storage_contains(void);
 void test_astarte_storage_clear(void);
 void test_astarte_storage_iteration(void);
+void test_astarte_storage_iteration_read_property(void);
 void test_astarte_storage_iteration_empty_memory(void);
+void test_astarte_storage_transaction(void);
 
 #ifdef __cplusplus
 }
@@ -24,9 +24,17 @@
 #include <esp_log.h>
 
 #include "test_astarte_bson_deserializer.h"
+#include "test_astarte_bson_parser.h"
 #include "test_astarte_bson_serializer.h"
+#include "test_astarte_introspection.h"
 #include "test_astarte_linked_list.h"
+#include "test_astarte_publish_tracker.h"
+#include "test_astarte_property_cache.h"
+#include "test_astarte_property_buffer.h"
+#include "test_astarte_reassembly.h"
+#include "test_astarte_routes.h"
 #include "test_astarte_nvs_key_value.h"
+#include "test_astarte_offline_queue.h"
 #include "test_astarte_storage.h"
 
 void app_main(void)
@@ -34,17 +42,30 @@ void app_main(void)
     // Disable logs for the bson deserializer to avoid printouts
     esp_log_level_set("ASTARTE_BSON_SERIALIZER", ESP_LOG_NONE);
     esp_log_level_set("ASTARTE_BSON_DESERIALIZER", ESP_LOG_NONE);
+    esp_log_level_set("ASTARTE_BSON_PARSER", ESP_LOG_NONE);
     // esp_log_level_set("NVS_KEY_VALUE", ESP_LOG_NONE);
     // esp_log_level_set("ASTARTE_STORAGE", ESP_LOG_NONE);
 
     UNITY_BEGIN();
     RUN_TEST(test_astarte_bson_serializer_empty_document);
     RUN_TEST(test_astarte_bson_serializer_complete_document);
+    RUN_TEST(test_astarte_bson_serializer_with_buffer);
+    RUN_TEST(test_astarte_bson_serializer_reset);
+    RUN_TEST(test_astarte_bson_serializer_large_array);
+    RUN_TEST(test_astarte_bson_serializer_nested);
+    RUN_TEST(test_astarte_bson_serializer_fixed);
+    RUN_TEST(test_astarte_bson_serializer_size_calculator);
+    RUN_TEST(test_astarte_bson_serializer_struct);
 
     RUN_TEST(test_astarte_bson_deserializer_check_validity);
     RUN_TEST(test_astarte_bson_deserializer_empty_bson_document);
     RUN_TEST(test_astarte_bson_deserializer_complete_bson_document);
     RUN_TEST(test_astarte_bson_deserializer_bson_document_lookup);
+    RUN_TEST(test_astarte_bson_deserializer_decode_struct);
+
+    RUN_TEST(test_astarte_bson_parser_fragments);
+    RUN_TEST(test_astarte_bson_parser_malformed);
+    RUN_TEST(test_astarte_bson_parser_sink_error);
 
     RUN_TEST(test_astarte_linked_list_is_empty);
     RUN_TEST(test_astarte_linked_list_append_remove_tail);
@@ -52,6 +73,28 @@ void app_main(void)
     RUN_TEST(test_astarte_linked_list_iterator);
     RUN_TEST(test_astarte_linked_list_iterator_replace);
 
+    RUN_TEST(test_astarte_introspection_add_get);
+    RUN_TEST(test_astarte_introspection_topic_prefix);
+
+    RUN_TEST(test_astarte_publish_tracker_reserve_complete);
+    RUN_TEST(test_astarte_publish_tracker_early_ack);
+    RUN_TEST(test_astarte_publish_tracker_expired);
+
+    RUN_TEST(test_astarte_property_cache_check_set);
+    RUN_TEST(test_astarte_property_cache_large_value);
+    RUN_TEST(test_astarte_property_cache_eviction);
+    RUN_TEST(test_astarte_property_buffer_coalesce);
+    RUN_TEST(test_astarte_property_buffer_min_interval);
+    RUN_TEST(test_astarte_property_buffer_full);
+
+    RUN_TEST(test_astarte_reassembly_fragments);
+    RUN_TEST(test_astarte_reassembly_max_size);
+    RUN_TEST(test_astarte_reassembly_unexpected_fragment);
+
+    RUN_TEST(test_astarte_routes_match);
+    RUN_TEST(test_astarte_routes_fallback);
+    RUN_TEST(test_astarte_routes_invalid_pattern);
+
     RUN_TEST(test_astarte_nvs_key_value_set_get_cycle);
     RUN_TEST(test_astarte_nvs_key_value_erase_key);
     RUN_TEST(test_astarte_nvs_key_value_iterator_to_empty_nvs);
@@ -60,11 +103,19 @@ void app_main(void)
     RUN_TEST(test_astarte_nvs_key_value_iterator_on_changing_memory_remove_first);
     RUN_TEST(test_astarte_nvs_key_value_iterator_on_changing_memory_remove_last);
     RUN_TEST(test_astarte_nvs_key_value_iterator_on_changing_memory_remove_middle);
+    RUN_TEST(test_astarte_nvs_key_value_index);
+    RUN_TEST(test_astarte_nvs_key_value_compact);
+
+    RUN_TEST(test_astarte_offline_queue_push_pop);
+    RUN_TEST(test_astarte_offline_queue_recovery);
+    RUN_TEST(test_astarte_offline_queue_full);
 
     RUN_TEST(test_astarte_storage_store_delete_cycle);
     RUN_TEST(test_astarte_storage_contains);
     RUN_TEST(test_astarte_storage_clear);
     RUN_TEST(test_astarte_storage_iteration);
+    RUN_TEST(test_astarte_storage_iteration_read_property);
     RUN_TEST(test_astarte_storage_iteration_empty_memory);
+    RUN_TEST(test_astarte_storage_transaction);
     UNITY_END();
 }